@@ -123,6 +123,43 @@ extern "C"
 
 #define DAO_MAX_COMBINE_CHANNELS 1024     /**< Maximum number of channels that can be combined by daoShmCombineShm2Shm */
 
+// Wake-up mechanisms posted by the writer on every new frame (IMAGE_METADATA::syncFlags)
+#define DAO_SYNC_SEM        0x01          /**< post each of the md[0].sem named semaphores */
+#define DAO_SYNC_FUTEX      0x02          /**< bump md[0].futexSeq and wake every futex waiter (Linux) */
+
+// Allocation flags of the shared memory mapping (DAO_SHM_OPTIONS::flags, stored in md[0].allocFlags)
+#define DAO_SHM_HUGEPAGE    0x01          /**< madvise(MADV_HUGEPAGE): transparent huge pages (tmpfs needs shmem_enabled=advise) */
+#define DAO_SHM_HUGETLB     0x02          /**< file is on a hugetlbfs mount (e.g. /dev/hugepages), size rounded to the huge page */
+#define DAO_SHM_POPULATE    0x04          /**< pre-fault every page when mapping (MAP_POPULATE) */
+#define DAO_SHM_MLOCK       0x08          /**< mlock the mapping (needs RLIMIT_MEMLOCK or CAP_IPC_LOCK) */
+#define DAO_SHM_NUMA        0x10          /**< bind the mapping to NUMA node DAO_SHM_OPTIONS::numaNode with mbind (Linux) */
+#define DAO_SHM_PAGE_ALIGN  0x20          /**< align every FIFO segment to DAO_SHM_PAGE_SIZE instead of DAO_CACHELINE_SIZE */
+#define DAO_SHM_COMPACT_MD  0x40          /**< store md[0] only, the per-segment state is in the DAO_FRAME_RECORD ring */
+#define DAO_SHM_MPSC        0x80          /**< several writers: slots reserved by ticket, published in ticket order */
+
+// Layout of the shared memory file:
+// [md x fifo_size (or 1) | reader cursors | frame records x fifo_size | packet maps x fifo_size
+//  | frame traces x fifo_size | pad to page]
+// [segment x fifo_size][keywords]
+#define DAO_SHM_LAYOUT_VERSION 5          /**< md[0].layoutVersion of the files created by this library */
+#define DAO_CACHELINE_SIZE  64            /**< every IMAGE_METADATA and every segment starts on a cache line */
+#define DAO_SHM_PAGE_SIZE   4096          /**< the first segment starts on a page */
+
+#if defined(_MSC_VER)
+#define DAO_CACHELINE_ALIGN __declspec(align(64))
+#else
+#define DAO_CACHELINE_ALIGN __attribute__ ((aligned(64)))
+#endif
+
+// Reader cursor registry, see daoShmReaderRegister
+#define DAO_MAX_READERS     32            /**< number of reader cursors in a shared memory */
+#define DAO_READER_BACKPRESSURE 0x01      /**< daoShmWaitForReaders waits for this reader */
+
+// Last phase of daoShmWaitForCounter / daoShmWaitForTargetCounter (DAO_WAIT_POLICY::block)
+#define DAO_WAIT_BLOCK_POLL  0            /**< keep polling with nanosleep(0) / Sleep(0) (legacy behaviour) */
+#define DAO_WAIT_BLOCK_FUTEX 1            /**< block on md[0].futexSeq, needs DAO_SYNC_FUTEX from the writer */
+#define DAO_WAIT_BLOCK_SEM   2            /**< block on semaphore DAO_WAIT_POLICY::semNb, needs DAO_SYNC_SEM */
+
 // Data types are defined as machine-independent types for portability
 
 #define _DATATYPE_UINT8                                1  /**< uint8_t       = char */
@@ -161,9 +198,43 @@ extern "C"
 #define _DATATYPE_COMPLEX_DOUBLE                      12  /**< complex double */
 #define SIZEOF_DATATYPE_COMPLEX_DOUBLE	              16
 
+#define _DATATYPE_FLOAT16                             13  /**< IEEE 754 half-precision binary floating-point format: binary16 */
+#define SIZEOF_DATATYPE_FLOAT16	                       2
+
+#define _DATATYPE_BFLOAT16                            14  /**< bfloat16: the upper 16 bits of a binary32 */
+#define SIZEOF_DATATYPE_BFLOAT16	                       2
+
 #define Dtype                                          9   /**< default data type for floating point */
 #define CDtype                                        11   /**< default data type for complex */
 
+#define DAO_NB_DATATYPE                               15  /**< one past the largest _DATATYPE_ value */
+
+/** @brief Sum of nbChannel sources into out for the elements [start, start + n), gains may be NULL */
+typedef void (*DAO_COMBINE_KERNEL)(void *out, void * const *src, const float *gains,
+                                   int nbChannel, uint64_t start, uint32_t n);
+
+/** @brief Conversion of n elements to float, used to read 16-bit float images */
+typedef void (*DAO_TO_FLOAT_KERNEL)(const void *src, float *dst, uint64_t n);
+
+/** @brief Conversion of n floats to the image type, rounded to nearest even */
+typedef void (*DAO_FROM_FLOAT_KERNEL)(const float *src, void *dst, uint64_t n);
+
+/** @brief Element size and typed kernels of a data type, see daoShmTypeInfo
+ *
+ * One entry per _DATATYPE_ value. It is looked up once when the IMAGE is created or
+ * opened and cached in IMAGE.type, so the write and combine paths do not branch on atype.
+ */
+typedef struct
+{
+    uint8_t atype;
+    uint8_t size;                       /**< bytes per element */
+    uint8_t isComplex;
+    const char *name;
+    DAO_COMBINE_KERNEL combine;         /**< used by daoShmCombineShm2Shm(Gain) */
+    DAO_TO_FLOAT_KERNEL toFloat;        /**< NULL for integer and complex types */
+    DAO_FROM_FLOAT_KERNEL fromFloat;
+} DAO_TYPE_INFO;
+
 /** @brief  Keyword
  * The IMAGE_KEYWORD structure includes :
  * 	- name
@@ -210,6 +281,150 @@ typedef struct
     double im;
 } complex_double;
 
+/** @brief Storage of a _DATATYPE_FLOAT16 element, see daoShmConvertToFloat */
+typedef struct
+{
+    uint16_t bits;
+} dao_float16;
+
+/** @brief Storage of a _DATATYPE_BFLOAT16 element, see daoShmConvertToFloat */
+typedef struct
+{
+    uint16_t bits;
+} dao_bfloat16;
+
+/** @brief Reader-side policy for the counter waits
+ * 
+ * A wait busy-spins with a CPU pause for spinNs, then spins with an exponentially growing
+ * number of pauses for backoffNs, then falls back to the block method.
+ * An all-zero policy is the legacy nanosleep(0) polling loop.
+ */
+typedef struct
+{
+    uint64_t spinNs;        /**< pure busy-spin phase duration [ns] */
+    uint64_t backoffNs;     /**< bounded spin with backoff phase duration [ns] */
+    uint8_t  block;         /**< DAO_WAIT_BLOCK_POLL, DAO_WAIT_BLOCK_FUTEX or DAO_WAIT_BLOCK_SEM */
+    int32_t  semNb;         /**< semaphore used by DAO_WAIT_BLOCK_SEM */
+} DAO_WAIT_POLICY;
+
+/** @brief Creation options of a shared memory, see daoShmImageCreateWithOptions
+ */
+typedef struct
+{
+    uint32_t flags;         /**< DAO_SHM_* allocation flags, applied by the creator and every process opening it */
+    int32_t  numaNode;      /**< NUMA node of the pages, used with DAO_SHM_NUMA */
+    uint32_t packetMax;     /**< largest packetTotal of the packet assembly maps, 0 for no assembly */
+    uint32_t trace;         /**< 1 to keep a DAO_FRAME_TRACE per FIFO segment, see daoShmTraceFrom */
+} DAO_SHM_OPTIONS;
+
+/** @brief Cursor of one reader, stored in the shared memory after the metadata blocks
+ * 
+ * One cache line per reader, written only by its owner (and by daoShmCheckReaders
+ * when the owner died), read by the writer and monitoring tools.
+ */
+typedef struct
+{
+    int32_t  pid;           /**< process owning the cursor, 0 if the cursor is free */
+    uint32_t readerId;      /**< index of the cursor in the table */
+    uint32_t flags;         /**< DAO_READER_* flags */
+    uint32_t lastIdx;       /**< FIFO segment of the last frame consumed */
+    uint64_t lastCnt0;      /**< cnt0 of the last frame consumed */
+    uint64_t heartbeatNs;   /**< CLOCK_MONOTONIC time of the last read or heartbeat [ns] */
+    char     name[32];      /**< reader name, for monitoring */
+} DAO_READER_CURSOR;
+
+/** @brief Per-segment record, one cache line per FIFO segment, after the reader cursors
+ * 
+ * Written by the producer on every commit, read lock-free by the consumers:
+ * a record is consistent if seq is even and unchanged after the copy (daoShmGetFrameRecord).
+ */
+typedef struct
+{
+    uint32_t seq;           /**< seqlock of the segment: odd while the writer is filling it */
+    uint32_t tag;           /**< user tag, see daoShmSetFrameInfo */
+    uint64_t cnt0;          /**< counter of the frame */
+    uint64_t frameId;       /**< frame id given to daoShmSetFrameInfo, cnt2 otherwise */
+    uint64_t atimeNs;       /**< acquisition time [ns, CLOCK_REALTIME], write time if not given */
+    uint64_t writeNs;       /**< time the write completed [ns, CLOCK_REALTIME] */
+    uint64_t filled;        /**< elements written in order from the start of the frame, nelement once committed */
+    uint64_t reserved[2];
+} DAO_FRAME_RECORD;
+
+#define DAO_TRACE_MAX_STAMPS 10                    /**< stamps of a DAO_FRAME_TRACE, one per pipeline stage */
+#define DAO_TRACE_NO_STAGE   0xFFFFFFFFU           /**< stage id of the stamps of a stage without id */
+#define DAO_TRACE_NO_ORIGIN  0xFFFFFFFFFFFFFFFFULL /**< originId filled from the frame record at commit */
+
+/** @brief Time spent by a frame in one pipeline stage, see DAO_FRAME_TRACE
+ */
+typedef struct
+{
+    uint32_t stageId;       /**< id of the stage, DAO_TRACE_NO_STAGE if it has none */
+    uint32_t reserved;
+    uint64_t enterTsc;      /**< daoShmTraceTsc when the stage got its input frame */
+    uint64_t exitTsc;       /**< daoShmTraceTsc when the stage committed its output frame */
+} DAO_TRACE_STAMP;
+
+/** @brief Pipeline trace of the frame written in a FIFO segment, after the packet maps
+ * 
+ * Only kept by the images created with DAO_SHM_OPTIONS::trace. Every stage copies the
+ * trace of its input frame and appends its own stamp (daoShmTraceFrom), so the trace of
+ * the last stream of a pipeline holds the path of the frame from the first stage.
+ * Written under the seqlock of the DAO_FRAME_RECORD, read with daoShmGetFrameTrace.
+ */
+typedef struct
+{
+    uint64_t originId;      /**< frame id (DAO_FRAME_RECORD::frameId) given by the first stage */
+    uint32_t nbStamp;       /**< number of stamps in use */
+    uint32_t dropped;       /**< stages not stamped because the array was full */
+    DAO_TRACE_STAMP stamp[DAO_TRACE_MAX_STAMPS];
+} DAO_FRAME_TRACE;
+
+#define DAO_PACKET_NO_FRAME 0xFFFFFFFFFFFFFFFFULL  /**< DAO_PACKET_MAP::frameNumber of a map without frame */
+
+/** @brief Assembly state of the frame written in a FIFO segment, see daoShmImagePacket2Shm
+ * 
+ * Followed by the completion bitmap: bit i of the uint64_t word i / 64 is set once packet i
+ * is in the segment. Packet i covers the elements from i * packetElems.
+ */
+typedef struct
+{
+    uint64_t frameNumber;   /**< frame being assembled, DAO_PACKET_NO_FRAME if none */
+    uint32_t received;      /**< number of distinct packets in the segment */
+    uint32_t packetTotal;   /**< number of packets of the frame */
+    uint32_t packetElems;   /**< number of elements of every packet but the last */
+    uint32_t writers;       /**< packet writers between their claim and their completion bit */
+    uint64_t startNs;       /**< time the first packet was written [ns, CLOCK_REALTIME] */
+    uint64_t reserved[4];
+} DAO_PACKET_MAP;
+
+/** @brief Consecutive FIFO segments returned by daoShmGetNextSegments
+ * 
+ * Segment k of the run starts at (char *)ptr + k * stride.
+ */
+typedef struct
+{
+    void    *ptr;           /**< first segment of the run */
+    uint32_t firstIdx;      /**< FIFO index of the first segment */
+    uint32_t count;         /**< number of segments in the run */
+    uint64_t stride;        /**< distance between two segments [bytes], md[0].segmentStride */
+} DAO_SEGMENT_RUN;
+
+/** @brief Time spent in each phase of the counter waits, accumulated per IMAGE
+ */
+typedef struct
+{
+    uint64_t nWaits;        /**< number of completed waits */
+    uint64_t spinNs;        /**< total time in the busy-spin phase [ns] */
+    uint64_t backoffNs;     /**< total time in the backoff phase [ns] */
+    uint64_t blockNs;       /**< total time blocked or polling [ns] */
+    uint64_t nSpinWakes;    /**< waits satisfied during the busy-spin phase */
+    uint64_t nBackoffWakes; /**< waits satisfied during the backoff phase */
+    uint64_t nBlockWakes;   /**< waits satisfied during the block phase */
+    uint64_t lastSpinNs;    /**< busy-spin time of the last wait [ns] */
+    uint64_t lastBackoffNs; /**< backoff time of the last wait [ns] */
+    uint64_t lastBlockNs;   /**< block time of the last wait [ns] */
+} DAO_WAIT_STATS;
+
 /** @brief Image metadata
  * 
  * This structure has a fixed size regardless of implementation when packed
@@ -264,16 +479,22 @@ typedef struct
      *  - 10: IEEE 754 double-precision binary floating-point format: binary64
      *  - 11: complex_float
      *  - 12: complex double
+     *  - 13: IEEE 754 half-precision binary floating-point format: binary16
+     *  - 14: bfloat16
      * 
      */
     uint8_t atype;                 
 	
 	// mem offset = 102 when packed
 
+    uint32_t recordOffset;          /**< offset of the DAO_FRAME_RECORD ring (only meaningful in md[0])      */
+
     double creation_time;           /**< creation time (since process start)                                          */
     double last_access;             /**< last time the image was accessed  (since process start)                      */
     
     // mem offset = 118 when packed
+    // The fields above are written once at creation. The fields below are
+    // written with every frame and start on their own cache line.
     
     /** @brief Acquisition time (beginning of exposure   
      * 
@@ -291,7 +512,7 @@ typedef struct
      * 
      * @warning sizeof(struct timespec) is implementation-specific, and could be smaller that 16 byte. Users may need to create and manage their own timespec implementation if data needs to be portable across machines.
      */
-    union
+    DAO_CACHELINE_ALIGN union
     {
 		struct timespec ts;
 		TIMESPECFIXED tsfixed;
@@ -341,6 +562,36 @@ typedef struct
     uint32_t fifo_size;
     uint32_t fifo_last_written;
 
+    // Futex wake-up members (only meaningful in md[0])
+    uint32_t futexSeq;              /**< incremented on every post, readers FUTEX_WAIT on this word           */
+    uint8_t  syncFlags;             /**< DAO_SYNC_* mechanisms posted by the writer                           */
+
+    // The members below are set at creation and read with every segment access: they start on
+    // their own cache line, away from fifo_last_written and futexSeq stored with every frame.
+    // lastNbArray stays in every md for the older readers, see DAO_SHM_COMPACT_MD.
+
+    // DAO_SHM_* allocation flags and NUMA node of the pages, -1 if not bound (only meaningful in md[0])
+    DAO_CACHELINE_ALIGN uint8_t allocFlags;
+    int16_t  numaNode;
+
+    // File layout (only meaningful in md[0])
+    uint8_t  layoutVersion;         /**< DAO_SHM_LAYOUT_VERSION                                               */
+    uint64_t dataOffset;            /**< offset of segment 0 from the start of the file, multiple of a page   */
+    uint64_t segmentStride;         /**< distance between two segments, multiple of a cache line              */
+    uint32_t readerOffset;          /**< offset of the DAO_READER_CURSOR table, 0 if there is none            */
+    uint32_t maxReaders;            /**< number of cursors in the table                                       */
+    uint32_t packetOffset;          /**< offset of the DAO_PACKET_MAP of segment 0, 0 if there is none         */
+    uint32_t packetStride;          /**< distance between two packet maps, multiple of a cache line           */
+    uint32_t packetMax;             /**< number of bits of every completion bitmap                            */
+    uint32_t traceOffset;           /**< offset of the DAO_FRAME_TRACE of segment 0, 0 if there is none        */
+
+    // Written by the readers, kept away from the cache lines of the writer (only meaningful in md[0])
+    DAO_CACHELINE_ALIGN uint32_t futexWaiters; /**< number of readers currently blocked on futexSeq           */
+
+    // Written by the writers with DAO_SHM_MPSC (only meaningful in md[0])
+    DAO_CACHELINE_ALIGN uint64_t mpscReserve;  /**< next ticket, taken with an atomic fetch-add                 */
+    uint64_t mpscCommit;                       /**< ticket allowed to publish next                             */
+
 #ifdef DATA_PACKED
 } __attribute__ ((__packed__)) IMAGE_METADATA;
 #else
@@ -468,6 +719,27 @@ typedef struct          		/**< structure used to store data arrays
     uint32_t fifo_last_read;
     uint64_t fifo_last_read_cnt0;
 
+    // last md[0].futexSeq consumed by this reader
+    uint32_t futex_last_seq;
+
+    // reader-side wait policy and statistics, see daoShmSetWaitPolicy
+    DAO_WAIT_POLICY wait_policy;
+    DAO_WAIT_STATS wait_stats;
+
+    // cursor of this reader in the shared memory, NULL if not registered
+    DAO_READER_CURSOR *reader;
+
+    // per-segment records (fifo_size of them) and the values given to daoShmSetFrameInfo for the next commit
+    DAO_FRAME_RECORD *record;
+    DAO_FRAME_RECORD record_next;
+
+    // data type of the image, set by daoShmImageCreate and daoShmShm2Img
+    const DAO_TYPE_INFO *type;
+
+    // per-segment traces (NULL without DAO_SHM_OPTIONS::trace) and the trace of the next commit
+    DAO_FRAME_TRACE *trace;
+    DAO_FRAME_TRACE trace_next;
+
     // total size is 152 byte = 1216 bit
     // (on Windows,  160 byte = 1280 bit)
 #ifdef DATA_PACKED
@@ -476,6 +748,31 @@ typedef struct          		/**< structure used to store data arrays
 } IMAGE;
 #endif
 
+#define DAO_COMBINER_RESYNC 1000          /**< default number of updates between two full sums of a combiner */
+
+/** @brief Incremental channel combiner, see daoShmCombinerInit
+ * 
+ * Keeps the weighted sum of the last-seen frame of every channel, and only applies the
+ * difference of the channels whose cnt0 advanced. FLOAT and DOUBLE images only.
+ */
+typedef struct
+{
+    IMAGE **imageCube;              /**< input images */
+    IMAGE *image;                   /**< output image */
+    int nbChannel;
+    int nbVal;
+    float *gains;                   /**< per-channel gains */
+    uint64_t *lastCnt0;             /**< cnt0 of the last frame seen on each channel */
+    void **last;                    /**< last frame seen on each channel, sized for the largest channel */
+    void *scratch;                  /**< incoming frame of the channel being updated, same size */
+    double *sum;                    /**< running weighted sum of the last frames */
+    uint32_t resyncPeriod;          /**< updates between two full sums, bounds the rounding drift */
+    uint32_t sinceResync;
+    uint8_t dirty;                  /**< a gain changed since the last update */
+    uint64_t nbUpdates;             /**< number of frames written to the output */
+    uint64_t nbChannelUpdates;      /**< number of channel differences applied */
+} DAO_COMBINER;
+
 #ifdef __cplusplus
 } //extern "C"
 #endif
@@ -497,24 +794,76 @@ DLL_EXPORT int_fast8_t daoShmImage2ShmQuiet(void *im, uint32_t nbVal, IMAGE *ima
 DLL_EXPORT int_fast8_t daoShmImagePart2Shm(char *im, uint32_t nbVal, IMAGE *image, uint32_t position,
                              uint16_t packetId, uint16_t packetTotal, uint64_t frameNumber); 
 DLL_EXPORT int_fast8_t daoShmImagePart2ShmFinalize(IMAGE *image); 
+DLL_EXPORT int_fast8_t daoShmImagePacket2Shm(void *im, IMAGE *image, uint32_t packetId, uint32_t packetTotal,
+                                             uint64_t frameNumber);
+DLL_EXPORT int_fast8_t daoShmGetPacketMap(IMAGE *image, uint32_t segment_idx, DAO_PACKET_MAP *map,
+                                          uint32_t *prefix);
+DLL_EXPORT int_fast8_t daoShmWaitWritten(IMAGE *image, uint64_t nbElem, uint64_t timeoutNs, uint32_t *segment_idx);
+DLL_EXPORT int_fast8_t daoShmWaitPacketPrefix(IMAGE *image, uint64_t nbElem, uint64_t timeoutNs,
+                                              uint32_t *segment_idx, uint64_t *frameNumber);
+DLL_EXPORT int_fast8_t daoShmAcquireWriteSlot(IMAGE *image, void **slot_ptr, uint32_t *slot_idx);
+DLL_EXPORT int_fast8_t daoShmCommitWriteSlot(IMAGE *image, uint32_t slot_idx);
 DLL_EXPORT int_fast8_t daoShmImageCreateSem(IMAGE *image, long NBsem);
 DLL_EXPORT int_fast8_t daoShmImageCreate_FIFO(IMAGE *image, const char *name, long naxis, uint32_t *size,
                            uint8_t atype, int shared, int NBkw, uint32_t fifo_size);
 DLL_EXPORT int_fast8_t daoShmImageCreate(IMAGE *image, const char *name, long naxis, uint32_t *size,
                            uint8_t atype, int shared, int NBkw);
+DLL_EXPORT int_fast8_t daoShmImageCreateWithOptions(IMAGE *image, const char *name, long naxis, uint32_t *size,
+                           uint8_t atype, int shared, int NBkw, uint32_t fifo_size,
+                           const DAO_SHM_OPTIONS *options);
+DLL_EXPORT int_fast8_t daoShmReadLegacy(const char *name, void *dst, uint64_t dstSize, uint64_t *cnt0);
+DLL_EXPORT int_fast8_t daoShmReaderRegister(IMAGE *image, const char *name, uint32_t flags);
+DLL_EXPORT int_fast8_t daoShmReaderUnregister(IMAGE *image);
+DLL_EXPORT int_fast8_t daoShmReaderHeartbeat(IMAGE *image);
+DLL_EXPORT int_fast8_t daoShmGetReaders(IMAGE *image, DAO_READER_CURSOR *cursors, uint32_t *nbReaders);
+DLL_EXPORT int_fast8_t daoShmGetSlowestReader(IMAGE *image, uint32_t *readerId, uint64_t *lag);
+DLL_EXPORT int_fast8_t daoShmCheckReaders(IMAGE *image, uint64_t staleNs, uint32_t *nbDead, uint32_t *nbStale);
+DLL_EXPORT int_fast8_t daoShmWaitForReaders(IMAGE *image, uint64_t maxLag, uint64_t timeoutNs);
+DLL_EXPORT int_fast8_t daoShmSetNumaNode(IMAGE *image, int node);
+DLL_EXPORT int_fast8_t daoShmGetNumaNode(IMAGE *image, int *node, float *fraction);
 
 DLL_EXPORT int_fast8_t daoShmCombineShm2Shm(IMAGE **imageCude, IMAGE *image, int nbChannel, int nbVal); 
+DLL_EXPORT const DAO_TYPE_INFO *daoShmTypeInfo(uint8_t atype);
+DLL_EXPORT int_fast8_t daoShmConvertToFloat(const void *src, uint8_t atype, float *dst, uint64_t n);
+DLL_EXPORT int_fast8_t daoShmConvertFromFloat(const float *src, void *dst, uint8_t atype, uint64_t n);
+DLL_EXPORT int_fast8_t daoShmCombineShm2ShmGain(IMAGE **imageCube, IMAGE *image, int nbChannel, int nbVal,
+                                                const float *gains);
+DLL_EXPORT int_fast8_t daoShmCombinerInit(DAO_COMBINER *comb, IMAGE **imageCube, IMAGE *image, int nbChannel,
+                                          int nbVal, const float *gains);
+DLL_EXPORT int_fast8_t daoShmCombinerUpdate(DAO_COMBINER *comb);
+DLL_EXPORT int_fast8_t daoShmCombinerSetGain(DAO_COMBINER *comb, int channel, float gain);
+DLL_EXPORT int_fast8_t daoShmCombinerFree(DAO_COMBINER *comb);
 DLL_EXPORT int_fast8_t daoShmWaitForSemaphore(IMAGE *image, int32_t semNb);
 DLL_EXPORT int_fast8_t daoShmWaitForSemaphoreTimeout(IMAGE *image, int32_t semNb, const struct timespec *timeout);
+DLL_EXPORT int_fast8_t daoShmWaitForFutex(IMAGE *image);
+DLL_EXPORT int_fast8_t daoShmWaitForFutexTimeout(IMAGE *image, const struct timespec *timeout);
+DLL_EXPORT int_fast8_t daoShmSetSyncFlags(IMAGE *image, uint8_t flags);
 DLL_EXPORT int_fast8_t daoShmWaitForCounter(IMAGE *image);
 DLL_EXPORT int_fast8_t daoShmWaitForTargetCounter(IMAGE *image, uint64_t targetCnt0);
+DLL_EXPORT int_fast8_t daoShmSetWaitPolicy(IMAGE *image, const DAO_WAIT_POLICY *policy);
+DLL_EXPORT int_fast8_t daoShmGetWaitStats(IMAGE *image, DAO_WAIT_STATS *stats);
+DLL_EXPORT int_fast8_t daoShmResetWaitStats(IMAGE *image);
 DLL_EXPORT uint64_t    daoShmGetCounter(IMAGE *image);
 
 DLL_EXPORT int_fast8_t daoShmGetNextSegment(IMAGE *image, void** segment_ptr, uint32_t* segment_idx, uint64_t *segment_cnt0);
 DLL_EXPORT int_fast8_t daoShmWaitForNextSegment(IMAGE *image);
+DLL_EXPORT int_fast8_t daoShmSetFrameInfo(IMAGE *image, uint64_t frameId, uint64_t atimeNs, uint32_t tag);
+DLL_EXPORT int_fast8_t daoShmGetFrameRecord(IMAGE *image, uint32_t segment_idx, DAO_FRAME_RECORD *record);
+DLL_EXPORT uint64_t daoShmTraceTsc(void);
+DLL_EXPORT double daoShmTraceTscPerNs(void);
+DLL_EXPORT int_fast8_t daoShmTraceBegin(IMAGE *image, uint32_t stageId, uint64_t enterTsc);
+DLL_EXPORT int_fast8_t daoShmTraceFrom(IMAGE *image, IMAGE *input, uint32_t segment_idx, uint32_t stageId,
+                                       uint64_t enterTsc);
+DLL_EXPORT int_fast8_t daoShmTraceFromTrace(IMAGE *image, const DAO_FRAME_TRACE *input, uint32_t stageId,
+                                            uint64_t enterTsc);
+DLL_EXPORT int_fast8_t daoShmGetFrameTrace(IMAGE *image, uint32_t segment_idx, DAO_FRAME_TRACE *trace);
+DLL_EXPORT int_fast8_t daoShmGetNextSegments(IMAGE *image, uint32_t maxN, DAO_SEGMENT_RUN runs[2], uint32_t *nbRuns,
+                                             uint64_t *segment_cnt0, struct timespec *segment_atime);
 DLL_EXPORT int_fast8_t daoShmGetArbitrarySegment(IMAGE *image, void** segment_ptr, uint_fast32_t fifo_idx);
 DLL_EXPORT int_fast8_t daoShmGetNewestSegment(IMAGE *image, void** segment_ptr, uint32_t* segment_idx, uint64_t *segment_cnt0);
 DLL_EXPORT int_fast8_t daoShmCheckSegmentOverwrite(IMAGE *image);
+DLL_EXPORT int_fast8_t daoShmReadConsistent(IMAGE *image, void *dst, uint32_t *segment_idx, uint64_t *segment_cnt0,
+                                            uint32_t maxRetry);
 DLL_EXPORT int_fast8_t daoShmResetTail(IMAGE *image, uint32_t* segment_idx, uint64_t *segment_cnt0);
 
 DLL_EXPORT int_fast8_t daoShmCloseShm(IMAGE *image);
@@ -523,6 +872,7 @@ DLL_EXPORT int_fast8_t daoShmTimestampShm(IMAGE *image);
 DLL_EXPORT int_fast8_t daoSemPost(IMAGE *image, int32_t semNb);
 DLL_EXPORT int_fast8_t daoSemPostAll(IMAGE *image);
 DLL_EXPORT int_fast8_t daoSemLogPost(IMAGE *image);
+DLL_EXPORT int_fast8_t daoFutexPost(IMAGE *image);
 
 #ifdef __cplusplus
 }
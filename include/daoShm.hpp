@@ -9,11 +9,15 @@
 #ifndef DAO_SHM_HPP
 #define DAO_SHM_HPP
 
+#include <atomic>
+#include <cstring>
 #include <stdexcept>
 #include <string>
 #include <time.h>
+#include <type_traits>
 #include <vector>
 #include <dao.h>
+#include <daoShmView.hpp>
 
 namespace Dao
 {
@@ -27,9 +31,24 @@ namespace Dao
         SEM1, SEM2, SEM3,
         SEM4, SEM5, SEM6,
         SEM7, SEM8, SEM9, 
-        SEM, SPIN, NONE
+        SEM, SPIN, NONE,
+        FUTEX
     };
 
+    /**
+     * @brief Trace of the frame read last by the calling thread, copied when it was read,
+     * with the time it was read. The next frame written by a Shm with traces
+     * (DAO_SHM_OPTIONS::trace) in the same thread continues this trace, see daoShmTraceFromTrace.
+     */
+    struct ShmTraceInput {
+        uint64_t shm_id = 0;        // Shm the frame was read from, 0 for none
+        uint64_t enter_tsc = 0;
+        DAO_FRAME_TRACE trace {};
+    };
+
+    inline thread_local ShmTraceInput shm_trace_input;
+    inline std::atomic<uint64_t> shm_next_id{1};
+
     template <typename T>
     class Shm {
         public:
@@ -38,13 +57,17 @@ namespace Dao
          * @param name Shared memory name.
          * @param shape Dao::Shape containing number of elements in each axis.
          * @param frame Initial shared memory data frame.
+         * @param depth Number of FIFO segments.
+         * @param options Allocation options (huge pages, pre-faulting, locking, NUMA node), or nullptr.
+         * To keep the frames next to the threads using them, set DAO_SHM_NUMA and
+         * numaNode = Dao::Numa::Core2Node(core).
          */
         Shm(const std::string &name, const Dao::Shape &shape, T *frame = nullptr,
-            uint32_t depth = 1) {
+            uint32_t depth = 1, const DAO_SHM_OPTIONS *options = nullptr) {
             if(shape.size() != 2 && shape.size() != 3)
                 throw std::runtime_error("invalid dao shape");
 
-            const auto status = daoShmImageCreate_FIFO(
+            const auto status = daoShmImageCreateWithOptions(
                 &image_,
                 name.c_str(),
                 shape.size(),
@@ -52,7 +75,8 @@ namespace Dao
                 inferDaoType(),
                 1, // shared memory
                 0, // no keywords
-                depth
+                depth,
+                options
             );
             md_ = (volatile IMAGE_METADATA *)image_.md;
             
@@ -80,6 +104,8 @@ namespace Dao
          * however the object itself will still persist afterward.
          */
         ~Shm() {
+            if(shm_trace_input.shm_id == id_)
+                shm_trace_input = ShmTraceInput();
             daoShmCloseShm(&image_);
         }
 
@@ -88,9 +114,186 @@ namespace Dao
          * @param frame Pointer to the frame array.
          */
         void set_frame(const T *frame) {
+            trace_output();
             daoShmImage2Shm((T*)frame, image_.md->nelement, &image_);
         }
 
+        /**
+         * @brief Segment of the shared memory reserved for in-place writing, see Shm::acquire.
+         * The segment is committed when the slot goes out of scope, unless commit was called before.
+         */
+        class WriteSlot {
+            public:
+            WriteSlot(const WriteSlot &) = delete;
+            WriteSlot &operator=(const WriteSlot &) = delete;
+
+            WriteSlot(WriteSlot &&other) noexcept
+                : shm_(other.shm_), data_(other.data_), idx_(other.idx_) {
+                other.shm_ = nullptr;
+            }
+
+            ~WriteSlot() {
+                commit();
+            }
+
+            /**
+             * @brief Pointer to the segment array.
+             */
+            T* data() const { return data_; }
+
+            /**
+             * @brief Number of elements in the segment.
+             */
+            uint64_t size() const { return shm_ ? shm_->get_element_count() : 0; }
+
+            T& operator[](uint64_t i) const { return data_[i]; }
+
+            /**
+             * @brief Publish the segment to the readers. Further calls have no effect.
+             * @return DAO_SUCCESS, or DAO_ERROR if another write happened since acquire.
+             */
+            int_fast8_t commit() {
+                int_fast8_t status = DAO_SUCCESS;
+                if(shm_) {
+                    shm_->trace_output();
+                    status = daoShmCommitWriteSlot(&shm_->image_, idx_);
+                    shm_ = nullptr;
+                }
+                return status;
+            }
+
+            private:
+            friend class Shm;
+            WriteSlot(Shm *shm, T *data, uint32_t idx) : shm_(shm), data_(data), idx_(idx) {}
+
+            Shm *shm_;
+            T *data_;
+            uint32_t idx_;
+        };
+
+        /**
+         * @brief Reserve the next segment of the shared memory to write a frame in place,
+         * avoiding the copy of set_frame.
+         * @return Guard giving access to the segment and committing it on destruction.
+         */
+        WriteSlot acquire() {
+            void *slot_ptr;
+            uint32_t slot_idx;
+            daoShmAcquireWriteSlot(&image_, &slot_ptr, &slot_idx);
+            return WriteSlot(this, (T*)slot_ptr, slot_idx);
+        }
+
+        /**
+         * @brief Publish a segment reserved with acquire.
+         * @param slot_idx Index of the acquired segment.
+         */
+        void commit(uint32_t slot_idx) {
+            trace_output();
+            if(daoShmCommitWriteSlot(&image_, slot_idx) != DAO_SUCCESS)
+                throw std::runtime_error("dao segment was not acquired");
+        }
+
+        /**
+         * @brief Write one packet of a frame, packets can come in any order. The shared memory
+         * must be created with DAO_SHM_OPTIONS::packetMax > 0. The last packet commits the frame.
+         * @param packet Packet of ceil(get_element_count() / packet_total) elements, fewer for the last one.
+         * @param packet_id Index of the packet in the frame.
+         * @param packet_total Number of packets of the frame.
+         * @param frame_number Number of the frame, increasing.
+         * @return DAO_SUCCESS, or DAO_ERROR for a packet older than the frame in assembly.
+         */
+        int_fast8_t set_packet(const T *packet, uint32_t packet_id, uint32_t packet_total, uint64_t frame_number) {
+            return daoShmImagePacket2Shm((void*)packet, &image_, packet_id, packet_total, frame_number);
+        }
+
+        /**
+         * @brief Write a frame given in float, converted in place into the next segment.
+         * For FLOAT16 and BFLOAT16 streams this halves the bytes written to the shared memory.
+         * Only for the types with a float conversion (float, double, dao_float16, dao_bfloat16).
+         * @param frame get_element_count() floats.
+         * @return DAO_SUCCESS, or DAO_ERROR if the shared memory type has no float conversion
+         * (nothing is written) or the write failed.
+         */
+        int_fast8_t set_frame_float(const float *frame) {
+            static_assert(has_float_conversion(), "set_frame_float needs a float, double, dao_float16 or dao_bfloat16 Shm");
+            const DAO_TYPE_INFO *info = daoShmTypeInfo(md_->atype);
+            if(info == nullptr || info->fromFloat == nullptr)
+                return DAO_ERROR;
+
+            void *slot_ptr;
+            uint32_t slot_idx;
+            if(daoShmAcquireWriteSlot(&image_, &slot_ptr, &slot_idx) != DAO_SUCCESS)
+                return DAO_ERROR;
+            info->fromFloat(frame, slot_ptr, md_->nelement);
+            trace_output();
+            return daoShmCommitWriteSlot(&image_, slot_idx);
+        }
+
+        /**
+         * @brief Read the newest frame converted to float, see get_frame for the synchronization.
+         * Only for the types with a float conversion (float, double, dao_float16, dao_bfloat16).
+         * @param frame Destination array of get_element_count() floats.
+         * @param sync Synchronization option (see Dao::ShmSync).
+         * @return DAO_SUCCESS, or DAO_ERROR if the synchronization failed or the shared memory type has no float conversion.
+         */
+        int_fast8_t get_frame_float(float *frame, ShmSync sync = ShmSync::NONE) {
+            static_assert(has_float_conversion(), "get_frame_float needs a float, double, dao_float16 or dao_bfloat16 Shm");
+            T *segment = this->get_frame(sync);
+            if(segment == nullptr)
+                return DAO_ERROR;
+            return daoShmConvertToFloat(segment, md_->atype, frame, md_->nelement);
+        }
+
+        /**
+         * @brief Wait until the elements before offset of the frame being written are in memory,
+         * so that a worker can start on its part of the frame during the readout. The progress
+         * comes from the packet maps, or from in-order daoShmImagePart2Shm writes; a committed
+         * frame is always complete.
+         * @param offset Number of leading elements needed.
+         * @param status DAO_SUCCESS, DAO_TIMEOUT, or DAO_OVERWRITE if the frame is already being rewritten.
+         * @param timeout_ns Maximum wait in ns, 0 to wait forever.
+         * @return Pointer to the segment of the frame, or nullptr if the wait failed.
+         */
+        T* wait_until_written(size_t offset, int_fast8_t &status, uint64_t timeout_ns = 0) {
+            uint32_t segment_idx;
+            status = daoShmWaitWritten(&image_, offset, timeout_ns, &segment_idx);
+            if(status != DAO_SUCCESS)
+                return nullptr;
+            return this->get_arbitrary_frame(segment_idx);
+        }
+
+        /**
+         * @brief Wait until rows 0..nb_rows-1 of the frame being written are in memory,
+         * see wait_until_written.
+         * @param nb_rows Number of leading rows, of md.size[0] elements each.
+         * @param status DAO_SUCCESS, DAO_TIMEOUT, or DAO_OVERWRITE if the frame is already being rewritten.
+         * @param timeout_ns Maximum wait in ns, 0 to wait forever.
+         * @param frame_number Number of the frame, with packet maps only (optional).
+         * @return Pointer to the segment of the frame, or nullptr if the wait failed.
+         */
+        T* wait_rows(uint32_t nb_rows, int_fast8_t &status, uint64_t timeout_ns = 0, uint64_t *frame_number = nullptr) {
+            uint32_t segment_idx;
+            uint64_t nb_elem = (uint64_t)nb_rows * md_->size[0];
+            if(md_->packetMax > 0)
+                status = daoShmWaitPacketPrefix(&image_, nb_elem, timeout_ns, &segment_idx, frame_number);
+            else
+                status = daoShmWaitWritten(&image_, nb_elem, timeout_ns, &segment_idx);
+            if(status != DAO_SUCCESS)
+                return nullptr;
+            return this->get_arbitrary_frame(segment_idx);
+        }
+
+        /**
+         * @brief Packet map of a FIFO segment: frame number, packets received and expected.
+         * @param prefix Number of leading packets received (optional).
+         */
+        DAO_PACKET_MAP get_packet_map(uint32_t fifo_idx, uint32_t *prefix = nullptr) {
+            DAO_PACKET_MAP map;
+            if(daoShmGetPacketMap(&image_, fifo_idx, &map, prefix) != DAO_SUCCESS)
+                throw std::runtime_error("dao shared memory has no packet maps");
+            return map;
+        }
+
         /**
          * @brief Retrieve a pointer to the newest segment of the shared memory frame array.
          * Optionally blocks until the next frame is written to shared memory.
@@ -107,6 +310,11 @@ namespace Dao
                         return nullptr;
                 } break;
 
+                case ShmSync::FUTEX: {
+                    if(daoShmWaitForFutex(&image_) != DAO_SUCCESS)
+                        return nullptr;
+                } break;
+
                 default: {
                     const int32_t semNb = (sync == ShmSync::SEM) ? (int32_t)ShmSync::SEM0 : (int32_t)sync;
                     if(daoShmWaitForSemaphore(&image_, semNb) != DAO_SUCCESS)
@@ -118,6 +326,7 @@ namespace Dao
             uint32_t segment_idx;
             uint64_t segment_cnt0;
             daoShmGetNewestSegment(&image_, &newest_data, &segment_idx, &segment_cnt0);
+            trace_input(segment_idx);
 
             return (T*)newest_data;
         }
@@ -126,7 +335,7 @@ namespace Dao
          * @brief Retrieve a pointer to the newest segment of the shared memory frame array.
          * Optionally blocks until the next frame is written to shared memory.
          * @param sync Synchronization option (see Dao::ShmSync).
-         * @param syncValue Specifies the timeout (seconds) for the semaphore sync options, or the cnt0 value to sync on when using the SPIN sync option.
+         * @param syncValue Specifies the timeout (seconds) for the semaphore and futex sync options, or the cnt0 value to sync on when using the SPIN sync option.
          * @return Pointer to the shared memory frame array, or nullptr if synchronization
          * failed internally.
          */
@@ -139,6 +348,15 @@ namespace Dao
                         return nullptr;
                 } break;
 
+                case ShmSync::FUTEX: {
+                    timespec ts;
+                    clock_gettime(CLOCK_REALTIME, &ts);
+                    ts.tv_sec += syncValue;
+
+                    if(daoShmWaitForFutexTimeout(&image_, &ts) != DAO_SUCCESS)
+                        return nullptr;
+                } break;
+
                 default: {
                     timespec ts;
                     clock_gettime(CLOCK_REALTIME, &ts);
@@ -154,6 +372,7 @@ namespace Dao
             uint32_t segment_idx;
             uint64_t segment_cnt0;
             daoShmGetNewestSegment(&image_, &newest_data, &segment_idx, &segment_cnt0);
+            trace_input(segment_idx);
 
             return (T*)newest_data;
         }
@@ -181,6 +400,8 @@ namespace Dao
             uint64_t segment_cnt0;
 
             status = daoShmGetNextSegment(&image_, &segment_ptr, &segment_idx, &segment_cnt0);
+            if(status == DAO_SUCCESS)
+                trace_input(segment_idx);
 
             return (T*)segment_ptr;
         }
@@ -208,10 +429,243 @@ namespace Dao
             uint32_t segment_idx;
 
             status = daoShmGetNextSegment(&image_, &segment_ptr, &segment_idx, &segment_cnt0);
+            if(status == DAO_SUCCESS)
+                trace_input(segment_idx);
 
             return (T*)segment_ptr;
         }
 
+        /**
+         * @brief Unread frames returned by get_next_frames, as one run of consecutive
+         * segments, or two when the FIFO wraps. Reuse the same batch between calls
+         * to avoid allocations.
+         */
+        class FrameBatch {
+            public:
+            /**
+             * @brief Number of frames in the batch.
+             */
+            uint32_t size() const { return runs_[0].count + (nb_runs_ > 1 ? runs_[1].count : 0); }
+
+            /**
+             * @brief Frame k of the batch, oldest first.
+             */
+            T* operator[](uint32_t k) const {
+                const DAO_SEGMENT_RUN &run = (k < runs_[0].count) ? runs_[0] : runs_[1];
+                const uint32_t i = (k < runs_[0].count) ? k : k - runs_[0].count;
+                return (T*)((char*)run.ptr + i * run.stride);
+            }
+
+            /**
+             * @brief Number of runs of consecutive segments (0, 1 or 2).
+             */
+            uint32_t run_count() const { return nb_runs_; }
+
+            /**
+             * @brief Run r: first frame, frame count and distance between frames in bytes.
+             */
+            const DAO_SEGMENT_RUN& run(uint32_t r) const { return runs_[r]; }
+
+            /**
+             * @brief Counter of each frame.
+             */
+            const uint64_t* cnt0() const { return cnt0_.data(); }
+
+            /**
+             * @brief Acquisition time of each frame.
+             */
+            const struct timespec* atime() const { return atime_.data(); }
+
+            private:
+            friend class Shm;
+            DAO_SEGMENT_RUN runs_[2] = {};
+            uint32_t nb_runs_ = 0;
+            std::vector<uint64_t> cnt0_;
+            std::vector<struct timespec> atime_;
+        };
+
+        /**
+         * @brief Retrieve all the unread frames, up to max_n, in one call.
+         * Optionally blocks until at least one frame is written to shared memory.
+         * @param batch Receives views on the frames, with their counters and timestamps.
+         * @param max_n Maximum number of frames returned.
+         * @param wait Flag to enable waiting until a new frame is ready.
+         * @return DAO_SUCCESS, DAO_OVERWRITE if frames were skipped, DAO_NOTREADY if
+         * no frame is ready (wait disabled), or DAO_ERROR if the wait failed.
+         */
+        int_fast8_t get_next_frames(FrameBatch &batch, uint32_t max_n, bool wait = false) {
+            batch.nb_runs_ = 0;
+            batch.runs_[0].count = 0;
+            if (wait) {
+                if (daoShmWaitForNextSegment(&image_) != DAO_SUCCESS)
+                    return DAO_ERROR;
+            }
+            if (batch.cnt0_.size() < max_n) {
+                batch.cnt0_.resize(max_n);
+                batch.atime_.resize(max_n);
+            }
+            return daoShmGetNextSegments(&image_, max_n, batch.runs_, &batch.nb_runs_,
+                                         batch.cnt0_.data(), batch.atime_.data());
+        }
+
+        /**
+         * @brief Select which wake-up mechanisms are posted on every write.
+         * @param flags Combination of DAO_SYNC_SEM and DAO_SYNC_FUTEX. Dropping DAO_SYNC_SEM
+         * saves the per-reader semaphore posts when every reader uses ShmSync::FUTEX.
+         */
+        void set_sync_flags(uint8_t flags) {
+            daoShmSetSyncFlags(&image_, flags);
+        }
+
+        /**
+         * @brief Set the spin-then-block policy used by ShmSync::SPIN and the FIFO waits.
+         * @param spinNs Pure busy-spin duration in nanoseconds.
+         * @param backoffNs Spin with backoff duration in nanoseconds, after the busy-spin.
+         * @param block Last phase: DAO_WAIT_BLOCK_POLL, DAO_WAIT_BLOCK_FUTEX or DAO_WAIT_BLOCK_SEM.
+         * @param semNb Semaphore used by DAO_WAIT_BLOCK_SEM.
+         */
+        void set_wait_policy(uint64_t spinNs, uint64_t backoffNs,
+                             uint8_t block = DAO_WAIT_BLOCK_FUTEX, int32_t semNb = 0) {
+            DAO_WAIT_POLICY policy = {spinNs, backoffNs, block, semNb};
+            if(daoShmSetWaitPolicy(&image_, &policy) != DAO_SUCCESS)
+                throw std::runtime_error("invalid dao wait policy");
+        }
+
+        /**
+         * @brief Time spent spinning and sleeping by the waits of this reader.
+         */
+        DAO_WAIT_STATS get_wait_stats() {
+            DAO_WAIT_STATS stats;
+            daoShmGetWaitStats(&image_, &stats);
+            return stats;
+        }
+
+        /**
+         * @brief Reset the wait statistics of this reader.
+         */
+        void reset_wait_stats() {
+            daoShmResetWaitStats(&image_);
+        }
+
+        /**
+         * @brief Bind the shared memory pages to a NUMA node, migrating the ones already faulted.
+         * @param node NUMA node, e.g. Dao::Numa::Core2Node(core), or -1 to remove the binding.
+         */
+        void set_numa_node(int node) {
+            if(daoShmSetNumaNode(&image_, node) != DAO_SUCCESS)
+                throw std::runtime_error("failed to bind shared memory to numa node");
+        }
+
+        /**
+         * @brief NUMA node currently holding the shared memory pages.
+         * @param fraction If not null, receives the fraction of the resident pages on that node.
+         * @return The node holding most of the pages, -1 if unknown or no page is resident.
+         */
+        int get_numa_node(float *fraction = nullptr) {
+            int node = -1;
+            daoShmGetNumaNode(&image_, &node, fraction);
+            return node;
+        }
+
+        /**
+         * @brief Register this reader in the cursor table of the shared memory, so that the
+         * writer can see its progress. Released by unregister_reader or the destructor.
+         * @param name Reader name, shown by monitoring tools.
+         * @param flags DAO_READER_BACKPRESSURE to be waited for by wait_for_readers.
+         */
+        void register_reader(const std::string &name, uint32_t flags = 0) {
+            if(daoShmReaderRegister(&image_, name.c_str(), flags) != DAO_SUCCESS)
+                throw std::runtime_error("failed to register reader");
+        }
+
+        /**
+         * @brief Release the cursor of this reader.
+         */
+        void unregister_reader() {
+            daoShmReaderUnregister(&image_);
+        }
+
+        /**
+         * @brief Refresh the heartbeat of this reader without reading a frame.
+         */
+        void reader_heartbeat() {
+            daoShmReaderHeartbeat(&image_);
+        }
+
+        /**
+         * @brief Cursors of the registered readers.
+         */
+        std::vector<DAO_READER_CURSOR> get_readers() {
+            std::vector<DAO_READER_CURSOR> cursors(DAO_MAX_READERS);
+            uint32_t nb_readers = 0;
+            daoShmGetReaders(&image_, cursors.data(), &nb_readers);
+            cursors.resize(nb_readers);
+            return cursors;
+        }
+
+        /**
+         * @brief Reader furthest behind the writer.
+         * @param lag Number of frames written since that reader's last read.
+         * @return The reader id, -1 if no reader is registered.
+         */
+        int slowest_reader(uint64_t &lag) {
+            uint32_t reader_id = 0;
+            lag = 0;
+            if(daoShmGetSlowestReader(&image_, &reader_id, &lag) != DAO_SUCCESS)
+                return -1;
+            return static_cast<int>(reader_id);
+        }
+
+        /**
+         * @brief Release the cursors of dead readers.
+         * @param stale_ns Heartbeat age above which a live reader is counted as stalled, 0 to skip.
+         * @param nb_stale If not null, receives the number of stalled readers.
+         * @return The number of dead readers released.
+         */
+        uint32_t check_readers(uint64_t stale_ns = 0, uint32_t *nb_stale = nullptr) {
+            uint32_t nb_dead = 0;
+            daoShmCheckReaders(&image_, stale_ns, &nb_dead, nb_stale);
+            return nb_dead;
+        }
+
+        /**
+         * @brief Wait until every DAO_READER_BACKPRESSURE reader is at most max_lag frames behind.
+         * @param max_lag Largest accepted lag, the FIFO depth minus one so that no such reader is lapped.
+         * @param timeout_ns Maximum wait in ns, 0 to wait forever.
+         * @return DAO_SUCCESS or DAO_TIMEOUT.
+         */
+        int_fast8_t wait_for_readers(uint64_t max_lag, uint64_t timeout_ns = 0) {
+            return daoShmWaitForReaders(&image_, max_lag, timeout_ns);
+        }
+
+        /**
+         * @brief Copy the newest frame out of the shared memory, guaranteed not torn by a
+         * concurrent write. Does not hold up the writer.
+         * @param frame Destination array of get_element_count() elements.
+         * @param cnt0 Counter of the frame copied.
+         * @param max_retry Maximum number of attempts, 0 to retry until consistent.
+         * @return DAO_SUCCESS, or DAO_OVERWRITE if every attempt was torn.
+         */
+        int_fast8_t read_consistent(T *frame, uint64_t &cnt0, uint32_t max_retry = 0) {
+            uint32_t segment_idx;
+            int_fast8_t status = daoShmReadConsistent(&image_, frame, &segment_idx, &cnt0, max_retry);
+            if(status == DAO_SUCCESS)
+                trace_input(segment_idx);
+            return status;
+        }
+
+        /**
+         * @brief Copy the newest frame out of the shared memory, guaranteed not torn by a
+         * concurrent write. Does not hold up the writer.
+         * @param frame Destination array of get_element_count() elements.
+         * @param max_retry Maximum number of attempts, 0 to retry until consistent.
+         * @return DAO_SUCCESS, or DAO_OVERWRITE if every attempt was torn.
+         */
+        int_fast8_t read_consistent(T *frame, uint32_t max_retry = 0) {
+            uint64_t cnt0;
+            return read_consistent(frame, cnt0, max_retry);
+        }
+
         /**
          * @brief Check if the last frame read from the FIFO has been overwritten.
          * @return Status code, either DAO_SUCCESS if not overwritten, or DAO_OVERWRITE otherwise.
@@ -232,6 +686,7 @@ namespace Dao
             void *segment_ptr;
 
             daoShmGetArbitrarySegment(&image_, &segment_ptr, segment_idx);
+            trace_input(segment_idx);
 
             return (T*)segment_ptr;
         }
@@ -244,6 +699,18 @@ namespace Dao
             return Dao::Shape(image_.md->size, image_.md->size + image_.md->naxis);            
         }
 
+        /**
+         * @brief Strided view of a frame, shaped like the shared memory (see Dao::make_view).
+         * @param frame Pointer returned by get_frame, get_next_frame or get_arbitrary_frame.
+         * @return Dao::ShmView<T, Rank>, indexed view(z, y, x).
+         */
+        template <size_t Rank>
+        ShmView<T, Rank> view(T *frame) const {
+            if (frame == nullptr)
+                throw std::runtime_error("no frame to view");
+            return make_view<Rank>(frame, this->get_shape());
+        }
+
         /**
          * @brief Get element count.
          * @return nelements.
@@ -265,9 +732,70 @@ namespace Dao
          * @return cnt0.
          */
         uint64_t get_counter(uint32_t fifo_idx) const {
-            volatile IMAGE_METADATA *segment_md_ = &(md_[fifo_idx % (md_->fifo_size)]);
+            volatile DAO_FRAME_RECORD *record_ = &(image_.record[fifo_idx % (md_->fifo_size)]);
+
+            return record_->cnt0;
+        }
+
+        /**
+         * @brief Set the frame id, acquisition time and tag recorded with the next frame written.
+         * @param frame_id Frame id, e.g. from the camera.
+         * @param atime_ns Acquisition time in ns (CLOCK_REALTIME).
+         * @param tag User value.
+         */
+        void set_frame_info(uint64_t frame_id, uint64_t atime_ns, uint32_t tag = 0) {
+            daoShmSetFrameInfo(&image_, frame_id, atime_ns, tag);
+        }
+
+        /**
+         * @brief Record (counter, frame id, acquisition and write times, tag) of a FIFO segment,
+         * never torn by a concurrent write.
+         */
+        DAO_FRAME_RECORD get_frame_record(uint32_t fifo_idx) {
+            DAO_FRAME_RECORD record;
+            daoShmGetFrameRecord(&image_, fifo_idx, &record);
+            return record;
+        }
+
+        /**
+         * @brief Record of the newest frame.
+         */
+        DAO_FRAME_RECORD get_frame_record() {
+            return this->get_frame_record(md_->fifo_last_written);
+        }
+
+        /**
+         * @brief True if the shared memory keeps a trace per frame (DAO_SHM_OPTIONS::trace).
+         */
+        bool has_trace() const {
+            return image_.trace != nullptr;
+        }
+
+        /**
+         * @brief Stage id stamped in the traces of the frames written by this object.
+         * A frame written after a frame was read in the same thread continues the trace of
+         * the frame read (see Dao::ShmTraceInput), otherwise it starts a new trace.
+         * @param stage_id Id of the pipeline stage, DAO_TRACE_NO_STAGE to stamp without id.
+         */
+        void set_trace_stage(uint32_t stage_id) {
+            trace_stage_ = stage_id;
+        }
 
-            return segment_md_->cnt0;
+        /**
+         * @brief Trace (origin frame id, stamp of every stage) of a FIFO segment,
+         * never torn by a concurrent write. Empty without traces.
+         */
+        DAO_FRAME_TRACE get_frame_trace(uint32_t fifo_idx) {
+            DAO_FRAME_TRACE trace;
+            daoShmGetFrameTrace(&image_, fifo_idx, &trace);
+            return trace;
+        }
+
+        /**
+         * @brief Trace of the newest frame.
+         */
+        DAO_FRAME_TRACE get_frame_trace() {
+            return this->get_frame_trace(md_->fifo_last_written);
         }
 
         /**
@@ -283,7 +811,7 @@ namespace Dao
          * @return cnt1.
          */
         uint64_t get_cnt1(uint32_t fifo_idx) const {
-            volatile IMAGE_METADATA *segment_md_ = &(md_[fifo_idx % (md_->fifo_size)]);
+            volatile IMAGE_METADATA *segment_md_ = segment_md(fifo_idx);
 
             return segment_md_->cnt1;
         }
@@ -301,7 +829,7 @@ namespace Dao
          * @return frame id (cnt2).
          */
         uint64_t get_frame_id(uint32_t fifo_idx) const {
-            volatile IMAGE_METADATA *segment_md_ = &(md_[fifo_idx % (md_->fifo_size)]);
+            volatile IMAGE_METADATA *segment_md_ = segment_md(fifo_idx);
 
             return segment_md_->cnt2;
         }
@@ -319,7 +847,7 @@ namespace Dao
          * @return Seconds since Unix epoch.
          */
         int64_t get_timestamp(uint32_t fifo_idx) const {
-            volatile IMAGE_METADATA *segment_md_ = &(md_[fifo_idx % (md_->fifo_size)]);
+            volatile IMAGE_METADATA *segment_md_ = segment_md(fifo_idx);
 
             return segment_md_->atime.tsfixed.secondlong;
         }
@@ -334,15 +862,69 @@ namespace Dao
 
         /**
          * @brief Get shared memory metadata.
+         * With DAO_SHM_COMPACT_MD only md[0] is stored, it holds the newest frame.
          * @return Pointer to shared memory metadata structure.
          */
         IMAGE_METADATA* get_meta_data(uint32_t fifo_idx) const {
-            volatile IMAGE_METADATA *segment_md_ = &(md_[fifo_idx % (md_->fifo_size)]);
+            volatile IMAGE_METADATA *segment_md_ = segment_md(fifo_idx);
 
             return const_cast<IMAGE_METADATA*>(segment_md_);
         }
 
         private:
+        /**
+         * @brief Metadata block of a FIFO segment, md[0] with DAO_SHM_COMPACT_MD.
+         */
+        volatile IMAGE_METADATA* segment_md(uint32_t fifo_idx) const {
+            if(md_->allocFlags & DAO_SHM_COMPACT_MD)
+                return md_;
+            return &(md_[fifo_idx % (md_->fifo_size)]);
+        }
+
+        /**
+         * @brief Copy the trace of the frame read, for the next frame written by the thread.
+         * Copied now since the segment may be rewritten before that write. A frame still
+         * being written (wait_until_written, wait_rows) has no trace yet and gives none.
+         */
+        void trace_input(uint32_t segment_idx) {
+            ShmTraceInput &input = shm_trace_input;
+            const uint32_t idx = segment_idx % md_->fifo_size;
+            input.shm_id = id_;
+            input.enter_tsc = daoShmTraceTsc();
+            if(((volatile DAO_FRAME_RECORD *)image_.record)[idx].seq & 1) {
+                std::memset(&input.trace, 0, sizeof(DAO_FRAME_TRACE));
+                input.trace.originId = DAO_TRACE_NO_ORIGIN;
+            } else if(image_.trace != nullptr) {
+                daoShmGetFrameTrace(&image_, segment_idx, &input.trace);
+            } else {
+                DAO_FRAME_RECORD record;
+                daoShmGetFrameRecord(&image_, segment_idx, &record);
+                std::memset(&input.trace, 0, sizeof(DAO_FRAME_TRACE));
+                input.trace.originId = record.frameId;
+            }
+        }
+
+        /**
+         * @brief Trace of the frame about to be committed: the one of the input frame
+         * followed by this stage, or a new one for a stage without input.
+         */
+        void trace_output() {
+            if(image_.trace == nullptr)
+                return;
+            if(shm_trace_input.shm_id != 0 && shm_trace_input.shm_id != id_)
+                daoShmTraceFromTrace(&image_, &shm_trace_input.trace, trace_stage_, shm_trace_input.enter_tsc);
+            else if(trace_stage_ != DAO_TRACE_NO_STAGE)
+                daoShmTraceBegin(&image_, trace_stage_, daoShmTraceTsc());
+        }
+
+        /**
+         * @brief True if T is one of the types converted to and from float (DAO_TYPE_INFO::fromFloat).
+         */
+        static constexpr bool has_float_conversion() {
+            return std::is_same_v<T, float> || std::is_same_v<T, double>
+                || std::is_same_v<T, dao_float16> || std::is_same_v<T, dao_bfloat16>;
+        }
+
         /**
          * @brief Compile time inference of dtype from T.
          * @return Dao data type (dtype).
@@ -360,6 +942,8 @@ namespace Dao
             else if(std::is_same_v<T, double>) return _DATATYPE_DOUBLE;
             else if(std::is_same_v<T, complex_float>) return _DATATYPE_COMPLEX_FLOAT;
             else if(std::is_same_v<T, complex_double>) return _DATATYPE_COMPLEX_DOUBLE;
+            else if(std::is_same_v<T, dao_float16>) return _DATATYPE_FLOAT16;
+            else if(std::is_same_v<T, dao_bfloat16>) return _DATATYPE_BFLOAT16;
         }
 
         /*
@@ -367,6 +951,8 @@ namespace Dao
         */
        IMAGE image_ {};
        volatile IMAGE_METADATA *md_;
+       uint32_t trace_stage_ = DAO_TRACE_NO_STAGE;
+       const uint64_t id_ = shm_next_id.fetch_add(1, std::memory_order_relaxed);
 
     };
 };
@@ -104,20 +104,6 @@ namespace Dao
 
                     m_log.Debug("File %s size: %zd", m_shm_filename.c_str(), m_shm_filesize);
                     m_map = (IMAGE_METADATA*) mmap(0, m_shm_filesize, PROT_READ | PROT_WRITE, MAP_SHARED, m_shm_file, 0);
-                    if(node >= 0)
-                    {
-                        // int numa_node = -1;
-                        // get_mempolicy(&numa_node, NULL, 0, (void*)m_map, MPOL_F_NODE | MPOL_F_ADDR);
-                        // m_log.Debug("Memory currently on numa node: %d", numa_node);
-                        // m_log.Debug("Moving memory to node %d", node);
-                        // numa_tonode_memory((void*) m_map, m_shm_filesize, node);
-                        // get_mempolicy(&numa_node, NULL, 0, (void*)m_map, MPOL_F_NODE | MPOL_F_ADDR);
-                        // m_log.Debug("Memory now on numa node: %d", numa_node);
-                    }
-                    else
-                    {
-                        m_log.Debug("node: %d", node);
-                    }
 
                     if (m_map == MAP_FAILED) 
                     {
@@ -129,6 +115,24 @@ namespace Dao
                     m_shm->memsize = m_shm_filesize;
                     m_shm->shmfd =m_shm_file;
                     m_shm->md = m_map;
+
+                    if(node >= 0)
+                    {
+                        int numa_node = -1;
+                        daoShmGetNumaNode(m_shm, &numa_node, NULL);
+                        m_log.Debug("Memory currently on numa node: %d", numa_node);
+                        m_log.Debug("Moving memory to node %d", node);
+                        if(daoShmSetNumaNode(m_shm, node) != DAO_SUCCESS)
+                        {
+                            m_log.Warning("Could not bind %s to numa node %d", m_shm_filename.c_str(), node);
+                        }
+                        daoShmGetNumaNode(m_shm, &numa_node, NULL);
+                        m_log.Debug("Memory now on numa node: %d", numa_node);
+                    }
+                    else
+                    {
+                        m_log.Debug("node: %d", node);
+                    }
                     m_atype = m_shm->md[0].atype;
                     m_shm->md[0].shared = 1;
                     m_shm_nElements = m_shm->md[0].size[0]* m_shm->md[0].size[1];
@@ -148,13 +152,28 @@ namespace Dao
                         return;
                     }
 
+                    if(m_shm->md[0].layoutVersion != DAO_SHM_LAYOUT_VERSION)
+                    {
+                        m_log.Error("IMAGE \"%s\" uses an unsupported layout (version %d)", m_shm_filename.c_str(), (int) m_shm->md[0].layoutVersion);
+                        CloseShm();
+                        return;
+                    }
+
+                    m_shm->record = (DAO_FRAME_RECORD*) ((char*) m_map + m_shm->md[0].recordOffset);
+                    memset(&m_shm->record_next, 0, sizeof(DAO_FRAME_RECORD));
+                    m_shm->reader = NULL;
+                    m_shm->type = daoShmTypeInfo(m_shm->md[0].atype);
+                    m_shm->trace = (m_shm->md[0].traceOffset != 0)
+                                   ? (DAO_FRAME_TRACE*) ((char*) m_map + m_shm->md[0].traceOffset) : NULL;
+                    memset(&m_shm->trace_next, 0, sizeof(DAO_FRAME_TRACE));
+
                     m_mapv = (char*) m_map;
-                    m_mapv += sizeof(IMAGE_METADATA);
+                    m_mapv += m_shm->md[0].dataOffset;
 
                     m_log.Debug("m_atype = %d", (int) m_atype);
                     // hack due to using void pointer.
                     m_shm->array.V = (void *) m_mapv;
-                    m_mapv += sizeof(T) * m_shm->md[0].nelement;
+                    m_mapv += m_shm->md[0].segmentStride * m_shm->md[0].fifo_size;
 
                     int kw;
                     m_shm->kw = (IMAGE_KEYWORD*) (m_mapv);
@@ -0,0 +1,296 @@
+/**
+ * @ Description: C++ DAO strided view over a shared memory segment
+ *
+ * A ShmView is a pointer, an extent and a stride per dimension. ROI, sub-cube and
+ * slice operations return new views over the same memory: no copy, no allocation.
+ * Indices are in mdspan order, the last one is the fastest varying: a Dao image of
+ * md.size = { nx, ny } is a view of extents { ny, nx }, indexed view(y, x).
+ */
+#ifndef DAO_SHM_VIEW_HPP
+#define DAO_SHM_VIEW_HPP
+
+#ifndef __cplusplus
+#error This is a C++ include file and cannot be used from plain C
+#endif
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+#if defined(__cpp_lib_span)
+#include <span>
+#endif
+#if defined(__cpp_lib_mdspan)
+#include <mdspan>
+#endif
+
+namespace Dao
+{
+    template <class T, size_t Rank>
+    class ShmView
+    {
+        static_assert(Rank >= 1, "a ShmView has at least one dimension");
+
+        public:
+            using element_type = T;
+            using value_type = typename std::remove_cv<T>::type;
+            using index_type = size_t;
+            using extents_type = std::array<size_t, Rank>;
+
+            /**
+             * @brief Empty view.
+             */
+            constexpr ShmView() : data_(nullptr), extents_{}, strides_{} {}
+
+            /**
+             * @brief Contiguous view, the last dimension is the fastest varying.
+             * @param data First element.
+             * @param extents Number of elements in each dimension.
+             */
+            constexpr ShmView(T *data, const extents_type &extents)
+            : data_(data), extents_(extents), strides_(contiguous_strides(extents)) {}
+
+            /**
+             * @brief Strided view.
+             * @param data First element.
+             * @param extents Number of elements in each dimension.
+             * @param strides Distance in elements between two consecutive indices of each dimension.
+             */
+            constexpr ShmView(T *data, const extents_type &extents, const extents_type &strides)
+            : data_(data), extents_(extents), strides_(strides) {}
+
+            /**
+             * @brief Read-only view of a view.
+             */
+            template <class U, typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+            constexpr ShmView(const ShmView<U, Rank> &other)
+            : data_(other.data()), extents_(other.extents()), strides_(other.strides()) {}
+
+            static constexpr size_t rank() { return Rank; }
+            constexpr T *data() const { return data_; }
+            constexpr const extents_type &extents() const { return extents_; }
+            constexpr const extents_type &strides() const { return strides_; }
+            constexpr size_t extent(size_t r) const { return extents_[r]; }
+            constexpr size_t stride(size_t r) const { return strides_[r]; }
+
+            /**
+             * @brief Number of elements of the view.
+             */
+            constexpr size_t size() const {
+                size_t n = 1;
+                for (size_t r = 0; r < Rank; ++r)
+                    n *= extents_[r];
+                return n;
+            }
+
+            constexpr bool empty() const { return size() == 0; }
+
+            /**
+             * @brief True if the elements are consecutive in memory, in index order.
+             */
+            constexpr bool is_contiguous() const {
+                size_t expected = 1;
+                for (size_t r = Rank; r-- > 0;) {
+                    if (extents_[r] != 1 && strides_[r] != expected)
+                        return false;
+                    expected *= extents_[r];
+                }
+                return true;
+            }
+
+            /**
+             * @brief Element at the given indices, one per dimension.
+             */
+            template <class... Index>
+            constexpr T &operator()(Index... index) const {
+                static_assert(sizeof...(Index) == Rank, "one index per dimension");
+                const size_t idx[Rank] = { static_cast<size_t>(index)... };
+                size_t offset = 0;
+                for (size_t r = 0; r < Rank; ++r)
+                    offset += idx[r] * strides_[r];
+                return data_[offset];
+            }
+
+            /**
+             * @brief Element at the given indices.
+             */
+            constexpr T &operator[](const extents_type &idx) const {
+                size_t offset = 0;
+                for (size_t r = 0; r < Rank; ++r)
+                    offset += idx[r] * strides_[r];
+                return data_[offset];
+            }
+
+            /**
+             * @brief Region of interest: count[r] elements from offset[r] in each dimension.
+             */
+            constexpr ShmView roi(const extents_type &offset, const extents_type &count) const {
+                size_t start = 0;
+                for (size_t r = 0; r < Rank; ++r)
+                    start += offset[r] * strides_[r];
+                return ShmView(data_ + start, count, strides_);
+            }
+
+            /**
+             * @brief Sub-range [first, first + count) of one dimension, the others whole.
+             */
+            constexpr ShmView sub(size_t dim, size_t first, size_t count) const {
+                extents_type extents = extents_;
+                extents[dim] = count;
+                return ShmView(data_ + first * strides_[dim], extents, strides_);
+            }
+
+            /**
+             * @brief Every step-th index of each dimension.
+             */
+            constexpr ShmView step(const extents_type &step) const {
+                extents_type extents = extents_;
+                extents_type strides = strides_;
+                for (size_t r = 0; r < Rank; ++r) {
+                    extents[r] = (extents_[r] + step[r] - 1) / step[r];
+                    strides[r] = strides_[r] * step[r];
+                }
+                return ShmView(data_, extents, strides);
+            }
+
+            /**
+             * @brief Slice at index i of dimension Dim, one dimension less.
+             */
+            template <size_t Dim, size_t R = Rank, typename = typename std::enable_if<(R > 1)>::type>
+            constexpr ShmView<T, Rank - 1> slice(size_t i) const {
+                static_assert(Dim < Rank, "slice dimension out of range");
+                std::array<size_t, Rank - 1> extents{};
+                std::array<size_t, Rank - 1> strides{};
+                for (size_t r = 0, k = 0; r < Rank; ++r) {
+                    if (r == Dim)
+                        continue;
+                    extents[k] = extents_[r];
+                    strides[k] = strides_[r];
+                    ++k;
+                }
+                return ShmView<T, Rank - 1>(data_ + i * strides_[Dim], extents, strides);
+            }
+
+            /**
+             * @brief Slice at index i of the first dimension, e.g. row i of an image.
+             */
+            template <size_t R = Rank, typename = typename std::enable_if<(R > 1)>::type>
+            constexpr ShmView<T, Rank - 1> operator[](size_t i) const {
+                return slice<0>(i);
+            }
+
+            /**
+             * @brief Forward iterator over the elements, in index order.
+             */
+            class iterator
+            {
+                public:
+                    using iterator_category = std::forward_iterator_tag;
+                    using value_type = typename ShmView::value_type;
+                    using difference_type = std::ptrdiff_t;
+                    using pointer = T *;
+                    using reference = T &;
+
+                    constexpr iterator() : view_(nullptr), ptr_(nullptr), idx_{} {}
+                    constexpr iterator(const ShmView *view, T *ptr) : view_(view), ptr_(ptr), idx_{} {}
+
+                    constexpr reference operator*() const { return *ptr_; }
+                    constexpr pointer operator->() const { return ptr_; }
+
+                    constexpr iterator &operator++() {
+                        // odometer, the last dimension first
+                        for (size_t r = Rank; r-- > 0;) {
+                            ptr_ += view_->strides_[r];
+                            if (++idx_[r] < view_->extents_[r])
+                                return *this;
+                            ptr_ -= idx_[r] * view_->strides_[r];
+                            idx_[r] = 0;
+                        }
+                        ptr_ = nullptr;
+                        return *this;
+                    }
+
+                    constexpr iterator operator++(int) {
+                        iterator previous = *this;
+                        ++(*this);
+                        return previous;
+                    }
+
+                    constexpr bool operator==(const iterator &other) const { return ptr_ == other.ptr_; }
+                    constexpr bool operator!=(const iterator &other) const { return ptr_ != other.ptr_; }
+
+                private:
+                    const ShmView *view_;
+                    T *ptr_;
+                    extents_type idx_;
+            };
+
+            constexpr iterator begin() const { return iterator(this, empty() ? nullptr : data_); }
+            constexpr iterator end() const { return iterator(this, nullptr); }
+
+#if defined(__cpp_lib_span)
+            /**
+             * @brief The elements as a std::span, the view must be contiguous.
+             */
+            std::span<T> as_span() const {
+                if (!is_contiguous())
+                    throw std::runtime_error("dao view is not contiguous");
+                return std::span<T>(data_, size());
+            }
+#endif
+
+#if defined(__cpp_lib_mdspan)
+            /**
+             * @brief The view as a std::mdspan with a strided layout.
+             */
+            std::mdspan<T, std::dextents<size_t, Rank>, std::layout_stride> to_mdspan() const {
+                using mapping = typename std::layout_stride::template mapping<std::dextents<size_t, Rank>>;
+                return { data_, mapping(std::dextents<size_t, Rank>(extents_), strides_) };
+            }
+#endif
+
+        private:
+            static constexpr extents_type contiguous_strides(const extents_type &extents) {
+                extents_type strides{};
+                size_t s = 1;
+                for (size_t r = Rank; r-- > 0;) {
+                    strides[r] = s;
+                    s *= extents[r];
+                }
+                return strides;
+            }
+
+            T *data_;
+            extents_type extents_;
+            extents_type strides_;
+    };
+
+    /**
+     * @brief View of a frame of the given Dao shape (md.size order, x first).
+     * Missing dimensions are set to 1 and the slowest ones are merged if Rank is smaller.
+     * @param data First element of the frame, e.g. from Shm::get_frame.
+     * @param shape Dao::Shm::get_shape of the shared memory.
+     */
+    template <size_t Rank, class T>
+    ShmView<T, Rank> make_view(T *data, const std::vector<uint32_t> &shape) {
+        std::array<size_t, Rank> extents;
+        extents.fill(1);
+        for (size_t k = 0; k < shape.size(); ++k) {
+            // shape[0] is the fastest varying, the last dimension of the view
+            size_t r = (k < Rank) ? Rank - 1 - k : 0;
+            extents[r] *= shape[k];
+        }
+        return ShmView<T, Rank>(data, extents);
+    }
+}
+
+#endif
@@ -9,14 +9,43 @@
  ***********************************************/
 
 #include <stdint.h>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstddef>
 #include <unistd.h>
+#ifdef __linux__
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define SIGNAL_CACHELINE_SIZE   64      // every signal has a cache line of its own
 
 namespace Dao
 {
+    //!  SignalSlot struct
+    /*!
+    One signal of a SignalTable: the count of signals sent and the count acknowledged
+    by the receivers, alone on their cache line so that spinning on one signal is not
+    disturbed by the signals sent on the others. The last two words let a receiver
+    block in the kernel (SignalReceiveSleep) until a sender wakes it.
+    */
+    struct alignas(SIGNAL_CACHELINE_SIZE) SignalSlot
+    {
+        std::atomic<uint64_t> signal{0};    // incremented by the senders
+        std::atomic<uint64_t> tracker{0};   // incremented by the receivers
+        std::atomic<uint32_t> wake{0};      // futex word, incremented by a sender waking the sleepers
+        std::atomic<uint32_t> sleepers{0};  // number of receivers blocked, or about to block
+    };
+
     //!  SignalTable class 
     /*!
     Class to house singaling between threads
+
+    Sending a signal is a release, receiving it an acquire: the data written by the
+    sender before SignalSend is visible to the receiver after SignalReceive* returns.
     */
    class SignalTable {
         public:
@@ -28,11 +57,12 @@ namespace Dao
             SignalTable(size_t max_signals=256)
             : maxSignals(max_signals)
             {
-                signal = new volatile uint64_t[max_signals];
-                tracker = new volatile uint64_t[max_signals];
-                SignalTableReset();
+                slots = new SignalSlot[max_signals];
             }
 
+            SignalTable(const SignalTable &) = delete;
+            SignalTable &operator=(const SignalTable &) = delete;
+
 
             /**
              * destroy the SignalTable object and free all associated memory
@@ -40,20 +70,23 @@ namespace Dao
              */
             virtual ~SignalTable()
             {
-                SignalTableReset();
-                delete[] signal;
-                delete[] tracker;
+                delete[] slots;
             }
 
 
             /**
-             * @brief default method for sending a signal. does no checking to see if anyone listening internally it just incriments a volatile signal counter
+             * @brief default method for sending a signal. does no checking to see if anyone listening internally it just incriments the signal counter (release)
              * @param index the index of which the signal is being incrmented this must be between 0->max_signals (default 256) 
              * @note No error checking occurs if index outside range 0->max_signals the system may segfault
              */
             inline void SignalSend( int index )
             {
-                signal[index]++;
+                // seq_cst pairs with SignalReceiveSleep: either the sleeper sees the signal or we see the sleeper
+                slots[index].signal.fetch_add(1, std::memory_order_seq_cst);
+                if (slots[index].sleepers.load(std::memory_order_seq_cst) != 0)
+                {
+                    Wake(slots[index]);
+                }
             }
 
 
@@ -93,7 +126,8 @@ namespace Dao
              */
             inline uint64_t SignalsPending( int index )
             {
-                return (signal[index] - tracker[index]);
+                uint64_t received = slots[index].tracker.load(std::memory_order_relaxed);
+                return (slots[index].signal.load(std::memory_order_acquire) - received);
             }
 
 
@@ -104,10 +138,15 @@ namespace Dao
              */
             inline int SignalReceive( int index )
             {
-                if (SignalsPending(index) > 0)
+                uint64_t received = slots[index].tracker.load(std::memory_order_relaxed);
+                while (slots[index].signal.load(std::memory_order_acquire) > received)
                 {
-                    tracker[index]++;
-                    return 1;
+                    // several receivers may race for the same signal, one of them gets it
+                    if (slots[index].tracker.compare_exchange_weak(received, received + 1, std::memory_order_acq_rel,
+                                                                   std::memory_order_relaxed))
+                    {
+                        return 1;
+                    }
                 }
                 return 0;
             }
@@ -120,8 +159,10 @@ namespace Dao
              */
             inline void SignalReceiveSpin( int index )
             {
-                while(tracker[index] >= signal[index]){} // tracker should never be greater then signal but we use >= incase something bad happens
-                tracker[index]++;
+                while (!SignalReceive(index))
+                {
+                    CpuRelax();
+                }
             }
 
 
@@ -129,32 +170,64 @@ namespace Dao
              * @brief Blocking with timeout. Spins on index until timeout is reached or singal received
              * @param index signal index to be checked 
              * @param timeout_us timeout in us
+             * @return 1 if a signal was received, 0 on timeout
              * @note No error checking occurs if index outside range 0->max_signals the system may segfault
-             * @note Not implimented
              */
-            inline uint64_t SignalReceiveSpinTimeout( int signum, uint64_t timeout_us )
+            inline uint64_t SignalReceiveSpinTimeout( int index, uint64_t timeout_us )
             {
-                // TODO: impliment version using a simple timeout
-                return 0;
+                const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+                for (uint32_t spin = 0; ; ++spin)
+                {
+                    if (SignalReceive(index))
+                    {
+                        return 1;
+                    }
+                    // the clock is read every 64 polls only, to keep the wake-up latency of the spin
+                    if ((spin & 63) == 63 && std::chrono::steady_clock::now() >= deadline)
+                    {
+                        return SignalReceive(index);
+                    }
+                    CpuRelax();
+                }
             }
 
             /**
-             * @brief Blocking with sleep. Spins on index signal but sleeps between checks
+             * @brief Blocking with sleep. The thread blocks in the kernel (futex) until a signal is sent on index,
+             * so it does not use any CPU while waiting. SignalSend only makes the wake-up system call when
+             * a receiver is sleeping on index.
              * @param index signal index to be checked 
-             * @param usleep us sleep time
+             * @param uSleep longest time blocked before checking the signal again in us, 0 to block until a signal is sent
              * @note No error checking occurs if index outside range 0->max_signals the system may segfault
-             * @note Not implimented
+             * @note Without futex (not Linux) the signal is polled every uSleep us
              */
             inline void SignalReceiveSleep( int index, uint64_t uSleep )
             {
+                if (SignalReceive(index))
+                {
+                    return;
+                }
+#ifdef __linux__
+                SignalSlot &slot = slots[index];
+                slot.sleepers.fetch_add(1, std::memory_order_seq_cst);
                 while (1)
                 {
-                    if (SignalReceive(index))
+                    // read the futex word before the check: a signal sent after the check changes it
+                    // and the futex wait then returns at once
+                    const uint32_t wake = slot.wake.load(std::memory_order_acquire);
+                    if (slot.signal.load(std::memory_order_seq_cst) > slot.tracker.load(std::memory_order_relaxed)
+                        && SignalReceive(index))
                     {
-                        return;
+                        break;
                     }
+                    FutexWait(slot.wake, wake, uSleep);
+                }
+                slot.sleepers.fetch_sub(1, std::memory_order_relaxed);
+#else
+                while (!SignalReceive(index))
+                {
                     usleep(uSleep);
                 }
+#endif
             }
 
 
@@ -189,6 +262,90 @@ namespace Dao
             }
 
 
+            /**
+             * @brief Counting fan-in latch. Spins until nSignals signals are pending on index, then acknowledges
+             * all of them at once. Workers report with SignalSend(index) on the same index, so waiting for N
+             * workers polls one cache line instead of N (see SignalReceiveSpinRange).
+             * @param index signal index shared by the workers
+             * @param nSignals number of signals to wait for
+             * @note Only one thread may wait on index
+             * @note No error checking occurs if index outside range 0->max_signals the system may segfault
+             */
+            inline void SignalReceiveSpinCount( int index, uint64_t nSignals )
+            {
+                uint64_t received = slots[index].tracker.load(std::memory_order_relaxed);
+                while (slots[index].signal.load(std::memory_order_acquire) - received < nSignals)
+                {
+                    CpuRelax();
+                }
+                slots[index].tracker.store(received + nSignals, std::memory_order_relaxed);
+            }
+
+
+            /**
+             * @brief Broadcast receive. Spins until a signal newer than seen is sent on index, without
+             * acknowledging it, so that every receiver sees every signal: one SignalSend(index) starts
+             * all the threads waiting on index.
+             * @param index signal index
+             * @param seen number of signals already seen by the caller, updated on return
+             * @note No error checking occurs if index outside range 0->max_signals the system may segfault
+             */
+            inline void SignalReceiveSpinBroadcast( int index, uint64_t &seen )
+            {
+                while (!SignalReceiveBroadcast(index, seen))
+                {
+                    CpuRelax();
+                }
+            }
+
+
+            /**
+             * @brief Non blocking broadcast receive. Check if a signal newer than seen was sent on index
+             * @param index signal index
+             * @param seen number of signals already seen by the caller, incremented if a new one is found
+             * @return 1 if a new signal was found, 0 otherwise
+             * @note No error checking occurs if index outside range 0->max_signals the system may segfault
+             */
+            inline int SignalReceiveBroadcast( int index, uint64_t &seen )
+            {
+                if (slots[index].signal.load(std::memory_order_acquire) > seen)
+                {
+                    seen++;
+                    return 1;
+                }
+                return 0;
+            }
+
+
+            /**
+             * @brief Sense-reversing barrier on one signal index. Returns once nThreads threads have called it
+             * for the same episode. The arrivals are counted in the signal counter of index and the sense is
+             * the tracker counter, incremented by the last thread to arrive, which releases the others.
+             * @param index signal index reserved to the barrier, not to be used with the other methods
+             * @param nThreads number of threads taking part, the same for every call
+             * @return true for the last thread to arrive (one per episode)
+             * @note No error checking occurs if index outside range 0->max_signals the system may segfault
+             */
+            inline bool SignalBarrierWait( int index, uint64_t nThreads )
+            {
+                SignalSlot &slot = slots[index];
+                const uint64_t sense = slot.tracker.load(std::memory_order_acquire);
+
+                if (slot.signal.fetch_add(1, std::memory_order_acq_rel) + 1 == nThreads)
+                {
+                    // the count is reset before the release, a thread leaving sees it at 0
+                    slot.signal.store(0, std::memory_order_relaxed);
+                    slot.tracker.store(sense + 1, std::memory_order_release);
+                    return true;
+                }
+                while (slot.tracker.load(std::memory_order_acquire) == sense)
+                {
+                    CpuRelax();
+                }
+                return false;
+            }
+
+
             /**
              * @brief resets the signals of index to zero
              * @param index singal index
@@ -197,8 +354,8 @@ namespace Dao
              */
             inline void SignalReset( int index )
             {
-                tracker[index] = 0;
-                signal[index] = 0;
+                slots[index].tracker.store(0, std::memory_order_relaxed);
+                slots[index].signal.store(0, std::memory_order_relaxed);
             }
 
 
@@ -214,10 +371,49 @@ namespace Dao
                 }
             }
         
+            /**
+             * @brief CPU hint for spin loops, lets the sibling hyper-thread run
+             */
+            static inline void CpuRelax()
+            {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#elif defined(__aarch64__)
+                __asm__ __volatile__("yield" ::: "memory");
+#endif
+            }
+        
         protected:
             size_t maxSignals;
-            volatile uint64_t * volatile signal;
-            volatile uint64_t * volatile tracker;
+            SignalSlot * slots;
+
+        private:
+            /*
+             * wake every receiver sleeping on slot
+             */
+            static inline void Wake( SignalSlot &slot )
+            {
+                slot.wake.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+                syscall(SYS_futex, reinterpret_cast<uint32_t *>(&slot.wake), FUTEX_WAKE_PRIVATE, INT_MAX,
+                        nullptr, nullptr, 0);
+#endif
+            }
+
+#ifdef __linux__
+            /*
+             * block while the futex word is still expected, at most uSleep us if not 0
+             */
+            static inline void FutexWait( std::atomic<uint32_t> &word, uint32_t expected, uint64_t uSleep )
+            {
+                static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+                struct timespec timeout;
+                timeout.tv_sec = (time_t)(uSleep / 1000000);
+                timeout.tv_nsec = (long)(uSleep % 1000000) * 1000;
+                syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected,
+                        uSleep != 0 ? &timeout : nullptr, nullptr, 0);
+            }
+#endif
     };
     // some signals to be known by all
     #define SIGNAL_THREAD_READY     0
@@ -0,0 +1,300 @@
+#ifndef DAO_STATIC_PARTITIONER_HPP
+#define DAO_STATIC_PARTITIONER_HPP
+
+/**
+ *  @file   daoStaticPartitioner.hpp
+ *  @brief  Deterministic parallel_for on a fixed set of pinned spinning threads
+ *
+ *  A range is cut into one contiguous chunk per thread, its boundaries multiples of
+ *  an alignment chosen by the caller (a cache line of elements), and chunk k always
+ *  goes to thread k. A call is started with one broadcast signal and joined with the
+ *  SignalTable barrier: no allocation, lock or system call per call. For the RT loop,
+ *  where the work stealing of Dao::TaskPool is not wanted.
+ ***********************************************/
+
+#include <daoThread.hpp>
+#include <daoSignalTable.hpp>
+#include <daoLog.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include <string>
+#include <vector>
+
+#define SP_SIGNAL_START     0   // broadcast by the caller, starts every worker
+#define SP_SIGNAL_JOIN      1   // barrier of the caller and the workers
+
+namespace Dao
+{
+    //!  JitterStats struct
+    /*!
+    Running statistics of a duration, without storing the samples (Welford)
+    */
+    struct JitterStats
+    {
+        uint64_t count = 0;
+        double minNs = std::numeric_limits<double>::max();
+        double maxNs = 0;
+        double meanNs = 0;
+        double m2 = 0;
+
+        inline void Add(double ns)
+        {
+            count++;
+            minNs = std::min(minNs, ns);
+            maxNs = std::max(maxNs, ns);
+            const double delta = ns - meanNs;
+            meanNs += delta / (double)count;
+            m2 += delta * (ns - meanNs);
+        }
+
+        //! standard deviation [ns]
+        inline double StdNs() const
+        {
+            return count > 1 ? std::sqrt(m2 / (double)(count - 1)) : 0.0;
+        }
+
+        //! peak to peak [ns]
+        inline double JitterNs() const
+        {
+            return count > 0 ? maxNs - minNs : 0.0;
+        }
+    };
+
+    //!  StaticPartitioner class
+    /*!
+    parallel_for on the calling thread and a fixed set of pinned worker threads, each
+    always running the same chunk of the range.
+
+    The caller runs chunk 0 and worker k-1 runs chunk k. The workers spin between calls
+    (they are meant to own their core, SCHED_FIFO when rt_enabled and root), so a call
+    costs the signal propagation and the barrier only. parallel_for must be called from
+    one thread at a time and is not reentrant.
+    */
+    class StaticPartitioner
+    {
+        public:
+            //! timing of the chunks of one thread over the calls, since the last ResetStats
+            struct alignas(SIGNAL_CACHELINE_SIZE) ThreadStats
+            {
+                int core;
+                JitterStats start;      // from the start of the call to the start of the chunk
+                JitterStats chunk;      // duration of the chunk
+            };
+
+            /**
+             * Create and start the workers
+             * @brief Constructor.
+             * @param name prefix of the worker thread names
+             * @param logger logger of the worker threads
+             * @param cores core of each worker, -1 not to pin it; one worker per entry
+             * @param rt_enabled SCHED_FIFO workers when running as root
+             */
+            StaticPartitioner(std::string name, Log::Logger& logger, const std::vector<int> &cores, bool rt_enabled=true)
+            : m_signals(2)
+            , m_stats(cores.size() + 1)
+            {
+                m_stats[0].core = -1;
+                for (size_t i = 0; i < cores.size(); ++i)
+                {
+                    m_stats[i + 1].core = cores[i];
+                    m_workers.push_back(new Worker(*this, name + std::to_string(i), logger, cores[i], (int)i + 1,
+                                                   rt_enabled));
+                }
+                ResetStats();
+                for (Worker *worker : m_workers)
+                {
+                    worker->Spawn();
+                    worker->Start();
+                }
+            }
+
+            StaticPartitioner(const StaticPartitioner &) = delete;
+            StaticPartitioner &operator=(const StaticPartitioner &) = delete;
+
+            /**
+             * Stop and join the workers
+             * @brief Destructor.
+             */
+            ~StaticPartitioner()
+            {
+                for (Worker *worker : m_workers)
+                {
+                    worker->Join();
+                    delete worker;
+                }
+            }
+
+            /**
+             * @brief Calls fn(b, e, k) on the chunk [b, e) of every thread k, in parallel. Returns when all are done.
+             * @param begin first index, the chunk boundaries are begin plus multiples of align
+             * @param end one past the last index
+             * @param align chunk granularity in indices, e.g. SIGNAL_CACHELINE_SIZE / sizeof(float) so that
+             * two threads never write the same cache line
+             * @param fn body, fn(b, e, k) with k the thread number (0 for the caller); called with b == e
+             * when the range is too short for every thread to get a chunk
+             * @note The first exception thrown by fn is rethrown once every chunk is done
+             */
+            template <class F>
+            void parallel_for(size_t begin, size_t end, size_t align, const F &fn)
+            {
+                m_call = [](const void *f, size_t b, size_t e, size_t k) { (*static_cast<const F *>(f))(b, e, k); };
+                m_fn = &fn;
+                m_begin = begin;
+                m_end = std::max(begin, end);
+                m_align = align > 0 ? align : 1;
+                m_failed.store(false, std::memory_order_relaxed);
+                m_start_ns = NowNs();
+
+                m_signals.SignalSend(SP_SIGNAL_START);
+                RunChunk(0);
+                m_signals.SignalBarrierWait(SP_SIGNAL_JOIN, m_workers.size() + 1);
+
+                m_call_stats.Add((double)(NowNs() - m_start_ns));
+                if (m_failed.load(std::memory_order_relaxed))
+                {
+                    std::rethrow_exception(m_error);
+                }
+            }
+
+            /**
+             * @brief chunk of thread k when [begin, end) is shared by nbThread threads
+             * @param b first index of the chunk
+             * @param e one past the last index of the chunk, b if the chunk is empty
+             */
+            static inline void GetChunk(size_t begin, size_t end, size_t align, size_t nbThread, size_t k,
+                                        size_t &b, size_t &e)
+            {
+                const size_t n = end > begin ? end - begin : 0;
+                const size_t units = (n + align - 1) / align;
+                b = begin + std::min(n, align * (units * k / nbThread));
+                e = begin + std::min(n, align * (units * (k + 1) / nbThread));
+            }
+
+            /**
+             * @brief number of threads sharing a range, the caller included
+             */
+            size_t Size() const
+            {
+                return m_workers.size() + 1;
+            }
+
+            /**
+             * @brief duration of the whole calls since the last ResetStats
+             * @note to be called between two calls, by the thread calling parallel_for
+             */
+            const JitterStats & GetCallStats() const
+            {
+                return m_call_stats;
+            }
+
+            /**
+             * @brief timing of the chunks of every thread, the caller first
+             * @note to be called between two calls, by the thread calling parallel_for
+             */
+            const std::vector<ThreadStats> & GetStats() const
+            {
+                return m_stats;
+            }
+
+            /**
+             * @brief restart the statistics
+             * @note to be called between two calls, by the thread calling parallel_for
+             */
+            void ResetStats()
+            {
+                m_call_stats = JitterStats();
+                for (ThreadStats &stats : m_stats)
+                {
+                    stats.start = JitterStats();
+                    stats.chunk = JitterStats();
+                }
+            }
+
+        private:
+            //! one worker thread, runs chunk k on every call
+            class Worker : public Thread
+            {
+                public:
+                    Worker(StaticPartitioner &partitioner, std::string name, Log::Logger& logger, int core, int k,
+                           bool rt_enabled)
+                    : Thread(name, logger, core, k, rt_enabled)
+                    , m_partitioner(partitioner)
+                    , m_seen(0)
+                    {
+                    }
+
+                protected:
+                    void RestartableThread() override
+                    {
+                        // one poll per call, so that Stop and Exit are seen between two calls
+                        if (!m_partitioner.m_signals.SignalReceiveBroadcast(SP_SIGNAL_START, m_seen))
+                        {
+                            SignalTable::CpuRelax();
+                            return;
+                        }
+                        m_partitioner.RunChunk((size_t)m_thread_number);
+                        m_partitioner.m_signals.SignalBarrierWait(SP_SIGNAL_JOIN, m_partitioner.m_workers.size() + 1);
+                    }
+
+                private:
+                    StaticPartitioner &m_partitioner;
+                    uint64_t m_seen;    // calls started so far
+            };
+
+            static inline uint64_t NowNs()
+            {
+                return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            /*
+             * run the chunk of thread k and time it
+             */
+            void RunChunk(size_t k)
+            {
+                ThreadStats &stats = m_stats[k];
+                size_t b, e;
+                GetChunk(m_begin, m_end, m_align, m_workers.size() + 1, k, b, e);
+                const uint64_t t0 = NowNs();
+                stats.start.Add((double)(t0 - m_start_ns));
+                try
+                {
+                    m_call(m_fn, b, e, k);
+                }
+                catch (...)
+                {
+                    bool expected = false;
+                    if (m_failed.compare_exchange_strong(expected, true, std::memory_order_relaxed))
+                    {
+                        m_error = std::current_exception();
+                    }
+                }
+                stats.chunk.Add((double)(NowNs() - t0));
+            }
+
+            std::vector<Worker*> m_workers;
+            SignalTable m_signals;
+
+            // the current call, written by the caller before SP_SIGNAL_START
+            void (*m_call)(const void *fn, size_t b, size_t e, size_t k) = nullptr;
+            const void * m_fn = nullptr;
+            size_t m_begin = 0;
+            size_t m_end = 0;
+            size_t m_align = 1;
+            uint64_t m_start_ns = 0;
+            std::atomic<bool> m_failed{false};
+            std::exception_ptr m_error;
+
+            // written by each thread during a call, read by the caller after SP_SIGNAL_JOIN
+            std::vector<ThreadStats> m_stats;
+            JitterStats m_call_stats;
+    };
+} // close namespace Dao
+
+#endif // DAO_STATIC_PARTITIONER_HPP
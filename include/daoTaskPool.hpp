@@ -0,0 +1,543 @@
+#ifndef DAO_TASK_POOL_HPP
+#define DAO_TASK_POOL_HPP
+
+/**
+ *  @file   daoTaskPool.hpp
+ *  @brief  Pool of pinned worker threads running parallel_for with work stealing
+ *
+ *  Every worker is a Dao::Thread (core affinity and SCHED_FIFO as set by ThreadBase)
+ *  owning a Chase-Lev deque of index ranges. A parallel_for pushes the whole range,
+ *  whoever runs a range larger than the grain splits it in two, keeps the lower half
+ *  and pushes the upper half on its own deque, where idle workers steal it.
+ ***********************************************/
+
+#include <daoThread.hpp>
+#include <daoSignalTable.hpp>
+#include <daoLog.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define TASKPOOL_SLEEP_US   1000    // longest sleep of an idle worker before checking for exit
+
+namespace Dao
+{
+    struct TaskJob;
+
+    //!  Task struct
+    /*!
+    A range [begin, end) of the indices of a job
+    */
+    struct Task
+    {
+        TaskJob * job;
+        size_t begin;
+        size_t end;
+    };
+
+    //!  TaskJob struct
+    /*!
+    One parallel_for call: the type-erased body and the count of indices not done yet
+    */
+    struct TaskJob
+    {
+        void (*call)(const void *fn, size_t begin, size_t end);
+        const void * fn;
+        size_t grain;
+        std::atomic<size_t> remaining;
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+    };
+
+    //!  TaskDeque class
+    /*!
+    Chase-Lev work-stealing deque of fixed capacity (Le et al., "Correct and efficient
+    work-stealing for weak memory models", 2013). The owner pushes and pops at the bottom,
+    the thieves steal at the top. The tasks are stored in relaxed atomics so that a thief
+    may read a slot the owner is rewriting; the read is discarded when its CAS fails.
+    */
+    class TaskDeque
+    {
+        public:
+            explicit TaskDeque(size_t capacity)
+            {
+                size_t size = 1;
+                while (size < capacity)
+                {
+                    size <<= 1;
+                }
+                m_mask = size - 1;
+                m_slots = new Slot[size];
+            }
+
+            TaskDeque(const TaskDeque &) = delete;
+            TaskDeque &operator=(const TaskDeque &) = delete;
+
+            ~TaskDeque()
+            {
+                delete[] m_slots;
+            }
+
+            /**
+             * @brief owner only. Adds a task at the bottom
+             * @return false if the deque is full, the task is not added
+             */
+            inline bool Push(const Task &task)
+            {
+                const int64_t b = m_bottom.load(std::memory_order_relaxed);
+                const int64_t t = m_top.load(std::memory_order_acquire);
+                if (b - t > (int64_t)m_mask)
+                {
+                    return false;
+                }
+                Slot &slot = m_slots[b & m_mask];
+                slot.job.store(task.job, std::memory_order_relaxed);
+                slot.begin.store(task.begin, std::memory_order_relaxed);
+                slot.end.store(task.end, std::memory_order_relaxed);
+                m_bottom.store(b + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+             * @brief owner only. Takes the task at the bottom, the last pushed
+             * @return false if the deque is empty
+             */
+            inline bool Pop(Task &task)
+            {
+                const int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+                m_bottom.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t t = m_top.load(std::memory_order_relaxed);
+                if (t > b)
+                {
+                    m_bottom.store(b + 1, std::memory_order_relaxed);
+                    return false;
+                }
+                Read(b, task);
+                if (t == b)
+                {
+                    // last task, race with the thieves for it
+                    bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                             std::memory_order_relaxed);
+                    m_bottom.store(b + 1, std::memory_order_relaxed);
+                    return won;
+                }
+                return true;
+            }
+
+            /**
+             * @brief any thread. Takes the task at the top, the first pushed
+             * @return false if the deque is empty or another thread took the task first
+             */
+            inline bool Steal(Task &task)
+            {
+                int64_t t = m_top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                const int64_t b = m_bottom.load(std::memory_order_acquire);
+                if (t >= b)
+                {
+                    return false;
+                }
+                Read(t, task);
+                return m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                     std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief number of tasks, approximate while other threads use the deque
+             */
+            inline size_t Size() const
+            {
+                int64_t size = m_bottom.load(std::memory_order_relaxed) - m_top.load(std::memory_order_relaxed);
+                return size > 0 ? (size_t)size : 0;
+            }
+
+        private:
+            struct Slot
+            {
+                std::atomic<TaskJob*> job{nullptr};
+                std::atomic<size_t> begin{0};
+                std::atomic<size_t> end{0};
+            };
+
+            inline void Read(int64_t index, Task &task) const
+            {
+                const Slot &slot = m_slots[index & m_mask];
+                task.job = slot.job.load(std::memory_order_relaxed);
+                task.begin = slot.begin.load(std::memory_order_relaxed);
+                task.end = slot.end.load(std::memory_order_relaxed);
+            }
+
+            // top and bottom on cache lines of their own, the thieves only write top
+            alignas(SIGNAL_CACHELINE_SIZE) std::atomic<int64_t> m_top{0};
+            alignas(SIGNAL_CACHELINE_SIZE) std::atomic<int64_t> m_bottom{0};
+            alignas(SIGNAL_CACHELINE_SIZE) Slot * m_slots;
+            size_t m_mask;
+    };
+
+    //!  TaskPool class
+    /*!
+    Pinned worker threads sharing the ranges of parallel_for calls by work stealing.
+
+    The thread calling parallel_for takes part in the work until the whole range is done,
+    so a pool of N workers runs a parallel_for on N+1 threads. Calls from threads outside
+    the pool are serialised; a parallel_for called from inside a task runs on the deque of
+    the calling worker and may be nested freely.
+
+    A worker finding no work spins for idle_spin_us, then sleeps on its signal of the pool
+    SignalTable until the next parallel_for.
+    */
+    class TaskPool
+    {
+        public:
+            //! utilisation of one worker since the last ResetStats
+            struct WorkerStats
+            {
+                int core;
+                uint64_t tasks;         // ranges executed
+                uint64_t steals;        // ranges taken from another deque
+                uint64_t busyNs;        // time spent executing ranges
+                uint64_t wallNs;        // time since the last ResetStats
+                double utilization;     // busyNs / wallNs
+            };
+
+            /**
+             * Create and start the workers of the pool
+             * @brief Constructor.
+             * @param name prefix of the worker thread names
+             * @param logger logger of the worker threads
+             * @param cores core of each worker, -1 not to pin it; one worker per entry
+             * @param rt_enabled SCHED_FIFO workers when running as root
+             * @param deque_capacity tasks per worker deque, a range is run without splitting further when full
+             * @param idle_spin_us time an idle worker spins before sleeping
+             */
+            TaskPool(std::string name, Log::Logger& logger, const std::vector<int> &cores, bool rt_enabled=true,
+                     size_t deque_capacity=1024, uint64_t idle_spin_us=50)
+            : m_signals(cores.size())
+            , m_idle_spin_us(idle_spin_us)
+            {
+                // one deque per worker and the one of the external callers, last
+                for (size_t i = 0; i <= cores.size(); ++i)
+                {
+                    m_deques.push_back(new TaskDeque(deque_capacity));
+                }
+                ResetStats();
+                for (size_t i = 0; i < cores.size(); ++i)
+                {
+                    m_workers.push_back(new Worker(*this, name + std::to_string(i), logger, cores[i], (int)i,
+                                                   rt_enabled));
+                }
+                for (Worker *worker : m_workers)
+                {
+                    worker->Spawn();
+                    worker->Start();
+                }
+            }
+
+            TaskPool(const TaskPool &) = delete;
+            TaskPool &operator=(const TaskPool &) = delete;
+
+            /**
+             * Stop and join the workers
+             * @brief Destructor.
+             */
+            ~TaskPool()
+            {
+                for (Worker *worker : m_workers)
+                {
+                    worker->Exit();
+                }
+                m_signals.SignalSendRange(0, (int)m_workers.size());
+                for (Worker *worker : m_workers)
+                {
+                    worker->Join();
+                    delete worker;
+                }
+                for (TaskDeque *deque : m_deques)
+                {
+                    delete deque;
+                }
+            }
+
+            /**
+             * @brief Calls fn(b, e) on sub-ranges [b, e) covering [begin, end), in parallel. Returns when all are done.
+             * @param begin first index
+             * @param end one past the last index
+             * @param grain largest sub-range not split further
+             * @param fn body, called concurrently on disjoint sub-ranges
+             * @note The first exception thrown by fn is rethrown once the other sub-ranges are done
+             */
+            template <class F>
+            void parallel_for(size_t begin, size_t end, size_t grain, const F &fn)
+            {
+                if (begin >= end)
+                {
+                    return;
+                }
+                TaskJob job;
+                job.call = [](const void *f, size_t b, size_t e) { (*static_cast<const F *>(f))(b, e); };
+                job.fn = &fn;
+                job.grain = grain > 0 ? grain : 1;
+                job.remaining.store(end - begin, std::memory_order_relaxed);
+
+                if (s_current.pool == this)
+                {
+                    Run(s_current.index, job, begin, end);
+                }
+                else
+                {
+                    // while it works the caller is the owner of the last deque, where nested calls go
+                    std::lock_guard<std::mutex> lock(m_submit_mutex);
+                    const Current previous = s_current;
+                    s_current = Current{this, m_workers.size(), 0};
+                    Run(m_workers.size(), job, begin, end);
+                    s_current = previous;
+                }
+                if (job.failed.load(std::memory_order_acquire))
+                {
+                    std::rethrow_exception(job.error);
+                }
+            }
+
+            /**
+             * @brief number of worker threads
+             */
+            size_t Size() const
+            {
+                return m_workers.size();
+            }
+
+            /**
+             * @brief utilisation of every worker since the last ResetStats
+             */
+            std::vector<WorkerStats> GetStats() const
+            {
+                const uint64_t now = NowNs();
+                std::vector<WorkerStats> stats;
+                for (const Worker *worker : m_workers)
+                {
+                    WorkerStats s;
+                    s.core = worker->m_core;
+                    s.tasks = worker->m_tasks.load(std::memory_order_relaxed);
+                    s.steals = worker->m_steals.load(std::memory_order_relaxed);
+                    s.busyNs = worker->m_busy_ns.load(std::memory_order_relaxed);
+                    s.wallNs = now - m_stats_start.load(std::memory_order_relaxed);
+                    s.utilization = s.wallNs > 0 ? (double)s.busyNs / (double)s.wallNs : 0.0;
+                    stats.push_back(s);
+                }
+                return stats;
+            }
+
+            /**
+             * @brief restart the utilisation counters of every worker
+             */
+            void ResetStats()
+            {
+                for (Worker *worker : m_workers)
+                {
+                    worker->m_tasks.store(0, std::memory_order_relaxed);
+                    worker->m_steals.store(0, std::memory_order_relaxed);
+                    worker->m_busy_ns.store(0, std::memory_order_relaxed);
+                }
+                m_stats_start.store(NowNs(), std::memory_order_relaxed);
+            }
+
+        private:
+            //! one worker thread of the pool
+            class Worker : public Thread
+            {
+                public:
+                    Worker(TaskPool &pool, std::string name, Log::Logger& logger, int core, int index, bool rt_enabled)
+                    : Thread(name, logger, core, index, rt_enabled)
+                    , m_pool(pool)
+                    , m_index(index)
+                    , m_idle_since(0)
+                    {
+                    }
+
+                    std::atomic<uint64_t> m_tasks{0};
+                    std::atomic<uint64_t> m_steals{0};
+                    std::atomic<uint64_t> m_busy_ns{0};
+                    using ThreadBase::m_core;
+
+                protected:
+                    void OnceOnSpawn() override
+                    {
+                        s_current.pool = &m_pool;
+                        s_current.index = (size_t)m_index;
+                    }
+
+                    void RestartableThread() override
+                    {
+                        if (m_pool.RunOnce((size_t)m_index))
+                        {
+                            m_idle_since = 0;
+                            return;
+                        }
+                        const uint64_t now = NowNs();
+                        if (m_idle_since == 0)
+                        {
+                            m_idle_since = now;
+                        }
+                        if (now - m_idle_since < m_pool.m_idle_spin_us * 1000)
+                        {
+                            SignalTable::CpuRelax();
+                            return;
+                        }
+                        // forget the wake-ups sent while busy, then look once more before sleeping:
+                        // a range pushed (or an exit requested) before a drained signal is seen here,
+                        // one pushed after wakes us
+                        while (m_pool.m_signals.SignalReceive(m_index))
+                        {
+                        }
+                        if (m_stop || m_pool.RunOnce((size_t)m_index))
+                        {
+                            m_idle_since = 0;
+                            return;
+                        }
+                        m_pool.m_signals.SignalReceiveSleep(m_index, TASKPOOL_SLEEP_US);
+                        m_idle_since = 0;
+                    }
+
+                private:
+                    TaskPool &m_pool;
+                    int m_index;
+                    uint64_t m_idle_since;
+            };
+
+            //! the pool and deque of the calling thread, if it is a worker (zero-initialised)
+            struct Current
+            {
+                TaskPool * pool;
+                size_t index;
+                unsigned depth;     // ranges being executed, more than one when nested
+            };
+            static inline thread_local Current s_current;
+
+            static inline uint64_t NowNs()
+            {
+                return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            /*
+             * push the job on the deque self, wake the workers and work until the job is done
+             */
+            void Run(size_t self, TaskJob &job, size_t begin, size_t end)
+            {
+                Task task{&job, begin, end};
+                if (!m_deques[self]->Push(task))
+                {
+                    Execute(self, task);
+                }
+                m_signals.SignalSendRange(0, (int)m_workers.size());
+                while (job.remaining.load(std::memory_order_acquire) != 0)
+                {
+                    if (!RunOnce(self))
+                    {
+                        SignalTable::CpuRelax();
+                    }
+                }
+            }
+
+            /*
+             * execute one range from the own deque of self, or stolen from another one
+             * return false if there was nothing to do
+             */
+            bool RunOnce(size_t self)
+            {
+                Task task;
+                if (m_deques[self]->Pop(task))
+                {
+                    Execute(self, task);
+                    return true;
+                }
+                // visit the other deques from a different one each time
+                const size_t nbDeque = m_deques.size();
+                size_t victim = (size_t)(NextRandom() % nbDeque);
+                for (size_t k = 0; k < nbDeque; ++k, victim = (victim + 1) % nbDeque)
+                {
+                    if (victim != self && m_deques[victim]->Steal(task))
+                    {
+                        if (self < m_workers.size())
+                        {
+                            m_workers[self]->m_steals.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        Execute(self, task);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            /*
+             * split the range down to the grain, pushing the upper halves, and run the rest
+             */
+            void Execute(size_t self, Task task)
+            {
+                TaskJob &job = *task.job;
+                // the time of a nested range is part of the busy time of the outer one
+                const bool outer = s_current.depth++ == 0;
+                const uint64_t t0 = outer ? NowNs() : 0;
+                while (task.end - task.begin > job.grain)
+                {
+                    const size_t mid = task.begin + (task.end - task.begin) / 2;
+                    if (!m_deques[self]->Push(Task{&job, mid, task.end}))
+                    {
+                        break;
+                    }
+                    task.end = mid;
+                }
+                try
+                {
+                    job.call(job.fn, task.begin, task.end);
+                }
+                catch (...)
+                {
+                    bool expected = false;
+                    if (job.failed.compare_exchange_strong(expected, true, std::memory_order_relaxed))
+                    {
+                        job.error = std::current_exception();
+                    }
+                }
+                s_current.depth--;
+                if (self < m_workers.size())
+                {
+                    Worker &worker = *m_workers[self];
+                    worker.m_tasks.fetch_add(1, std::memory_order_relaxed);
+                    if (outer)
+                    {
+                        worker.m_busy_ns.fetch_add(NowNs() - t0, std::memory_order_relaxed);
+                    }
+                }
+                job.remaining.fetch_sub(task.end - task.begin, std::memory_order_acq_rel);
+            }
+
+            /*
+             * xorshift, one state per thread
+             */
+            static inline uint64_t NextRandom()
+            {
+                static thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^ (uint64_t)(uintptr_t)&state;
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                return state;
+            }
+
+            std::vector<Worker*> m_workers;
+            std::vector<TaskDeque*> m_deques;
+            SignalTable m_signals;              // signal i wakes worker i
+            uint64_t m_idle_spin_us;
+            std::mutex m_submit_mutex;          // external callers share the last deque
+            std::atomic<uint64_t> m_stats_start{0};
+    };
+} // close namespace Dao
+
+#endif // DAO_TASK_POOL_HPP
@@ -112,8 +112,47 @@ namespace Dao
                     (*thread)->SignalWaitSleep(index, usleeppar);
                 }
             };
+
+            // collective signals of the threads of the table, on the shared signal table:
+            // one cache line per index for all the threads instead of one signal per thread
+
+            // start every thread waiting in SignalWaitBroadcast with a single store
+            void SignalBroadcast( int index )
+            {
+                m_signal_table.SignalSend(index);
+            };
+
+            // called by each thread, seen is its own count of the broadcasts already received
+            void SignalWaitBroadcast( int index, uint64_t &seen )
+            {
+                m_signal_table.SignalReceiveSpinBroadcast(index, seen);
+            };
+
+            // fan-in: each thread reports once, one waiter returns when all of them did
+            void SignalArrive( int index )
+            {
+                m_signal_table.SignalSend(index);
+            };
+
+            void SignalWaitAll( int index )
+            {
+                m_signal_table.SignalReceiveSpinCount(index, m_threads.size());
+            };
+
+            // barrier of the threads of the table, true for the last one to arrive
+            bool Barrier( int index )
+            {
+                return m_signal_table.SignalBarrierWait(index, m_threads.size());
+            };
+
+            SignalTable & GetSignalTable()
+            {
+                return m_signal_table;
+            };
+
         private:
             std::vector<ThreadIfce*> m_threads;
+            SignalTable m_signal_table;
 
     };
 }; //close namesapace Dao
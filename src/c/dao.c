@@ -17,6 +17,7 @@
 #include <ctype.h>
 #include <limits.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <time.h>
 
 #ifdef _WIN32
@@ -57,13 +58,42 @@ static int clock_gettime(int clk_id, struct timespec *t)
 #endif
 
 #if defined(__linux__)
+#ifdef _OPENMP
 #include <omp.h>
 #endif
+#include <linux/futex.h>
+#include <linux/magic.h>
+#include <numa.h>
+#include <numaif.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#endif
 
 #ifdef __APPLE__
 #include <stdatomic.h>
 #endif
 
+// CPU hint used in spin loops (lets the sibling hyper-thread run, saves power)
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define daoCpuRelax() _mm_pause()
+#elif defined(__aarch64__)
+#define daoCpuRelax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define daoCpuRelax()
+#endif
+
+// time stamp counter of the frame traces, CLOCK_MONOTONIC [ns] where there is none
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define DAO_TRACE_RDTSC 1
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define DAO_TRACE_RDTSC 1
+#else
+#define DAO_TRACE_RDTSC 0
+#endif
+
 // #ifdef __MACH__
 // #include <mach/mach_time.h>
 // #define CLOCK_REALTIME 0
@@ -457,10 +487,211 @@ void daoDestroyWindowsSecurityAttrs(SECURITY_ATTRIBUTES *sa, PACL dacl)
 
 #endif
 
+/*
+ * Size in bytes of one element of the given data type, 0 if unknown
+ */
+static size_t daoShmElementSize(uint8_t atype)
+{
+    const DAO_TYPE_INFO *info = daoShmTypeInfo(atype);
+    return (info == NULL) ? 0 : info->size;
+}
+
+/*
+ * Round v up to a multiple of align (a power of two)
+ */
+static inline uint64_t daoShmAlignUp(uint64_t v, uint64_t align)
+{
+    return (v + align - 1) & ~(align - 1);
+}
+
+/*
+ * Size of one packet map (header and completion bitmap), 0 without packet assembly
+ */
+static inline uint64_t daoShmPacketStride(uint32_t packetMax)
+{
+    if (packetMax == 0)
+    {
+        return 0;
+    }
+    return sizeof(DAO_PACKET_MAP) + daoShmAlignUp(((uint64_t)packetMax + 63) / 64 * sizeof(uint64_t), DAO_CACHELINE_SIZE);
+}
+
+/*
+ * Layout of the shared memory file for the given shape, see DAO_SHM_LAYOUT_VERSION
+ */
+static void daoShmLayout(uint64_t nelement, uint8_t atype, uint32_t fifo_size, uint8_t allocFlags,
+                         uint32_t packetMax, uint32_t trace, uint64_t *readerOffset, uint64_t *recordOffset,
+                         uint64_t *packetOffset, uint64_t *traceOffset, uint64_t *dataOffset,
+                         uint64_t *segmentStride)
+{
+    uint64_t align = (allocFlags & DAO_SHM_PAGE_ALIGN) ? DAO_SHM_PAGE_SIZE : DAO_CACHELINE_SIZE;
+    uint64_t mdCount = (allocFlags & DAO_SHM_COMPACT_MD) ? 1 : fifo_size;
+    uint64_t recordEnd;
+    uint64_t packetEnd;
+    *readerOffset = mdCount * sizeof(IMAGE_METADATA);
+    *recordOffset = *readerOffset + DAO_MAX_READERS * sizeof(DAO_READER_CURSOR);
+    recordEnd = *recordOffset + (uint64_t)fifo_size * sizeof(DAO_FRAME_RECORD);
+    *packetOffset = (packetMax > 0) ? recordEnd : 0;
+    packetEnd = recordEnd + (uint64_t)fifo_size * daoShmPacketStride(packetMax);
+    *traceOffset = trace ? packetEnd : 0;
+    *dataOffset = daoShmAlignUp(packetEnd + (trace ? (uint64_t)fifo_size * sizeof(DAO_FRAME_TRACE) : 0),
+                                DAO_SHM_PAGE_SIZE);
+    *segmentStride = daoShmAlignUp(nelement * daoShmElementSize(atype), align);
+}
+
+/*
+ * Number of IMAGE_METADATA blocks of the image: 1 with DAO_SHM_COMPACT_MD, fifo_size otherwise
+ */
+static inline uint32_t daoShmMdCount(const IMAGE_METADATA *md)
+{
+    return (md[0].allocFlags & DAO_SHM_COMPACT_MD) ? 1 : md[0].fifo_size;
+}
+
+/*
+ * Size of one metadata block in the files written before DAO_SHM_LAYOUT_VERSION,
+ * with (fifo = 1) or without (fifo = 0) the FIFO members. The fields up to
+ * fifo_last_written kept their offsets, only the ones after them are new.
+ */
+static uint64_t daoShmLegacyMdSize(int fifo)
+{
+    if (fifo)
+    {
+        return daoShmAlignUp(offsetof(IMAGE_METADATA, fifo_last_written) + sizeof(uint32_t), sizeof(uint64_t));
+    }
+    return offsetof(IMAGE_METADATA, fifo_size);
+}
+
+/*
+ * Size of a legacy file with the given metadata block size
+ */
+static uint64_t daoShmLegacyFileSize(const IMAGE_METADATA *md, uint32_t fifo_size, uint64_t mdSize)
+{
+    return fifo_size * (mdSize + md->nelement * daoShmElementSize(md->atype))
+           + md->NBkw * sizeof(IMAGE_KEYWORD);
+}
+
 /**
  * Extract image from a shared memory
  */
 //int_fast8_t daoShmShm2Img(const char *name, char *prefix, IMAGE *image)
+#ifndef _WIN32
+/*
+ * mmap flags for the DAO_SHM_* allocation flags
+ */
+static int daoShmMapFlags(uint8_t flags)
+{
+    int mapflags = MAP_SHARED;
+#if defined(MAP_POPULATE)
+    // with transparent huge pages or a NUMA binding the pages must be faulted
+    // after madvise / mbind, see daoShmApplyAllocFlags
+    if ((flags & DAO_SHM_POPULATE) && !(flags & (DAO_SHM_HUGEPAGE | DAO_SHM_NUMA)))
+    {
+        mapflags |= MAP_POPULATE;
+    }
+#endif
+    return mapflags;
+}
+
+/*
+ * Bind a mapping to a NUMA node (node < 0 restores the default policy).
+ * Pages already faulted by this process are migrated.
+ */
+static int daoShmBindNode(void *map, size_t size, int node)
+{
+#if defined(__linux__)
+    unsigned long mask[16]; // up to 1024 nodes
+    int nbBits = (int)(sizeof(mask) * 8);
+
+    if (numa_available() < 0)
+    {
+        daoWarning("NUMA is not available on this system\n");
+        return DAO_ERROR;
+    }
+    if (node < 0)
+    {
+        return (mbind(map, size, MPOL_DEFAULT, NULL, 0, 0) == 0) ? DAO_SUCCESS : DAO_ERROR;
+    }
+    if (node > numa_max_node() || node >= nbBits)
+    {
+        daoWarning("NUMA node %d does not exist (max node %d)\n", node, numa_max_node());
+        return DAO_ERROR;
+    }
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+    if (mbind(map, size, MPOL_BIND, mask, nbBits, MPOL_MF_MOVE) != 0)
+    {
+        daoWarning("mbind to NUMA node %d failed: %s\n", node, strerror(errno));
+        return DAO_ERROR;
+    }
+    return DAO_SUCCESS;
+#else
+    (void)map;
+    (void)size;
+    (void)node;
+    daoWarning("NUMA binding is only supported on Linux\n");
+    return DAO_ERROR;
+#endif
+}
+
+/*
+ * Apply the DAO_SHM_* allocation flags to a new mapping of the shared memory.
+ * Failures only cost performance, so they are reported as warnings.
+ * Returns the flags with DAO_SHM_NUMA cleared if the binding failed.
+ */
+static uint8_t daoShmApplyAllocFlags(void *map, size_t size, uint8_t flags, int mapflags, int node)
+{
+    // the binding must be in place before any page is faulted
+    if ((flags & DAO_SHM_NUMA) && daoShmBindNode(map, size, node) != DAO_SUCCESS)
+    {
+        flags &= ~DAO_SHM_NUMA;
+    }
+
+#if defined(MADV_HUGEPAGE)
+    if (flags & DAO_SHM_HUGEPAGE)
+    {
+        if (madvise(map, size, MADV_HUGEPAGE) != 0)
+        {
+            daoWarning("madvise(MADV_HUGEPAGE) failed: %s\n", strerror(errno));
+        }
+    }
+#endif
+
+    if (flags & DAO_SHM_POPULATE)
+    {
+        int populated = 0;
+#if defined(MAP_POPULATE)
+        populated = (mapflags & MAP_POPULATE) != 0;
+#endif
+#if defined(MADV_POPULATE_WRITE)
+        if (!populated)
+        {
+            populated = (madvise(map, size, MADV_POPULATE_WRITE) == 0);
+        }
+#endif
+        if (!populated)
+        {
+            // fault every page by hand, reading does not disturb a running writer
+            volatile char *p = (volatile char *)map;
+            size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            size_t off;
+            for (off = 0; off < size; off += page)
+            {
+                (void)p[off];
+            }
+        }
+    }
+
+    if (flags & DAO_SHM_MLOCK)
+    {
+        if (mlock(map, size) != 0)
+        {
+            daoWarning("mlock of %zu bytes failed: %s\n", size, strerror(errno));
+        }
+    }
+    return flags;
+}
+#endif
+
 int_fast8_t daoShmShm2Img(const char *name, IMAGE *image)
 {
     daoTrace("\n");
@@ -552,7 +783,20 @@ int_fast8_t daoShmShm2Img(const char *name, IMAGE *image)
 #else
             daoDebug("File %s size: %ld\n", shmName, file_stat.st_size);
 #endif
-        map = (IMAGE_METADATA*) mmap(0, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+        // allocation flags and NUMA node chosen by the creator, needed before mapping
+        uint8_t allocFlags = 0;
+        int16_t numaNode = -1;
+        uint8_t layoutVersion = 0;
+        if (pread(shmFd, &layoutVersion, sizeof(layoutVersion), offsetof(IMAGE_METADATA, layoutVersion)) != sizeof(layoutVersion)
+            || layoutVersion != DAO_SHM_LAYOUT_VERSION
+            || pread(shmFd, &allocFlags, sizeof(allocFlags), offsetof(IMAGE_METADATA, allocFlags)) != sizeof(allocFlags)
+            || pread(shmFd, &numaNode, sizeof(numaNode), offsetof(IMAGE_METADATA, numaNode)) != sizeof(numaNode))
+        {
+            allocFlags = 0;   // older layout, rejected below
+        }
+        int mapflags = daoShmMapFlags(allocFlags);
+
+        map = (IMAGE_METADATA*) mmap(0, file_stat.st_size, PROT_READ | PROT_WRITE, mapflags, shmFd, 0);
         if (map == MAP_FAILED) 
         {
             close(shmFd);
@@ -560,6 +804,7 @@ int_fast8_t daoShmShm2Img(const char *name, IMAGE *image)
             rval = DAO_ERROR;
             exit(0);
         }
+        daoShmApplyAllocFlags(map, file_stat.st_size, allocFlags, mapflags, numaNode);
 
         image->memsize = file_stat.st_size;
         image->shmfd = shmFd;
@@ -596,84 +841,57 @@ int_fast8_t daoShmShm2Img(const char *name, IMAGE *image)
 
         fifo_size = image->md[0].fifo_size;
 
-        mapv = (char*) map;
-        mapv += fifo_size * sizeof(IMAGE_METADATA);
+        /* Check the layout of the file */
+        uint64_t dataOffset = image->md[0].dataOffset;
+        uint64_t segmentStride = image->md[0].segmentStride;
+        image->reader = NULL;
+        image->type = daoShmTypeInfo(atype);
+        if (image->md[0].layoutVersion != DAO_SHM_LAYOUT_VERSION
+            || image->type == NULL
+            || dataOffset < daoShmMdCount(image->md) * sizeof(IMAGE_METADATA)
+            || image->md[0].maxReaders > DAO_MAX_READERS
+            || image->md[0].readerOffset + image->md[0].maxReaders * sizeof(DAO_READER_CURSOR) > dataOffset
+            || image->md[0].recordOffset + fifo_size * sizeof(DAO_FRAME_RECORD) > dataOffset
+            || (image->md[0].packetOffset == 0) != (image->md[0].packetMax == 0)
+            || image->md[0].packetStride != daoShmPacketStride(image->md[0].packetMax)
+            || image->md[0].packetOffset + (uint64_t)fifo_size * image->md[0].packetStride > dataOffset
+            || (image->md[0].traceOffset != 0
+                && image->md[0].traceOffset + (uint64_t)fifo_size * sizeof(DAO_FRAME_TRACE) > dataOffset)
+            || segmentStride < image->md[0].nelement * daoShmElementSize(atype)
+            || (uint64_t)image->memsize < dataOffset + fifo_size * segmentStride
+                                          + image->md[0].NBkw * sizeof(IMAGE_KEYWORD))
+        {
+            if ((uint64_t)image->memsize == daoShmLegacyFileSize(image->md, fifo_size, daoShmLegacyMdSize(1))
+                || (uint64_t)image->memsize == daoShmLegacyFileSize(image->md, 1, daoShmLegacyMdSize(0)))
+            {
+                daoError("%s uses the layout of an older DAO version, recreate it or read it with daoShmReadLegacy\n", name);
+            }
+            else
+            {
+                daoError("%s has an unknown layout (version %d)\n", name, (int) image->md[0].layoutVersion);
+            }
+            image->semptr = NULL;
+            image->semlog = NULL;
+            image->semReadPID = NULL;
+            image->semWritePID = NULL;
+            daoShmCloseShm(image);
+            return DAO_ERROR;
+        }
 
         daoDebug("atype = %d\n", (int) atype);
         fflush(stdout);
 
-        if(atype == _DATATYPE_UINT8)
-        {
-            daoDebug("atype = UINT8\n");
-            image->array.UI8 = (uint8_t*) mapv;
-            mapv += SIZEOF_DATATYPE_UINT8 * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_INT8)
-        {
-            daoDebug("atype = INT8\n");
-            image->array.SI8 = (int8_t*) mapv;
-            mapv += SIZEOF_DATATYPE_INT8 * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_UINT16)
-        {
-            daoDebug("atype = UINT16\n");
-            image->array.UI16 = (uint16_t*) mapv;
-            mapv += SIZEOF_DATATYPE_UINT16 * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_INT16)
-        {
-            daoDebug("atype = INT16\n");
-            image->array.SI16 = (int16_t*) mapv;
-            mapv += SIZEOF_DATATYPE_INT16 * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_UINT32)
-        {
-            daoDebug("atype = UINT32\n");
-            image->array.UI32 = (uint32_t*) mapv;
-            mapv += SIZEOF_DATATYPE_UINT32 * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_INT32)
-        {
-            daoDebug("atype = INT32\n");
-            image->array.SI32 = (int32_t*) mapv;
-            mapv += SIZEOF_DATATYPE_INT32 * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_UINT64)
-        {
-            daoDebug("atype = UINT64\n");
-            image->array.UI64 = (uint64_t*) mapv;
-            mapv += SIZEOF_DATATYPE_UINT64 * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_INT64)
-        {
-            daoDebug("atype = INT64\n");
-            image->array.SI64 = (int64_t*) mapv;
-            mapv += SIZEOF_DATATYPE_INT64 * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_FLOAT)
-        {
-            daoDebug("atype = FLOAT\n");
-            image->array.F = (float*) mapv;
-            mapv += SIZEOF_DATATYPE_FLOAT * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_DOUBLE)
-        {
-            daoDebug("atype = DOUBLE\n");
-            image->array.D = (double*) mapv;
-            mapv += SIZEOF_DATATYPE_DOUBLE * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_COMPLEX_FLOAT)
-        {
-            daoDebug("atype = COMPLEX_FLOAT\n");
-            image->array.CF = (complex_float*) mapv;
-            mapv += SIZEOF_DATATYPE_COMPLEX_FLOAT * fifo_size * image->md[0].nelement;
-        }
-        if(atype == _DATATYPE_COMPLEX_DOUBLE)
-        {
-            daoDebug("atype = COMPLEX_DOUBLE\n");
-            image->array.CD = (complex_double*) mapv;
-            mapv += SIZEOF_DATATYPE_COMPLEX_DOUBLE * fifo_size * image->md[0].nelement;
-        }
+        image->record = (DAO_FRAME_RECORD *)((char *)map + image->md[0].recordOffset);
+        memset(&image->record_next, 0, sizeof(DAO_FRAME_RECORD));
+        image->trace = (image->md[0].traceOffset != 0)
+                       ? (DAO_FRAME_TRACE *)((char *)map + image->md[0].traceOffset) : NULL;
+        memset(&image->trace_next, 0, sizeof(DAO_FRAME_TRACE));
+
+        mapv = (char*) map;
+        mapv += dataOffset;
+        image->array.V = (void*) mapv;
+        mapv += fifo_size * segmentStride;
+
         daoDebug("%ld keywords\n", (long) image->md[0].NBkw);
         fflush(stdout);
 
@@ -833,10 +1051,133 @@ int_fast8_t daoShmShm2Img(const char *name, IMAGE *image)
         uint32_t tmp32;
         uint64_t tmp64;
         daoShmResetTail(image, &tmp32, &tmp64);
+
+        // Only wake on posts made after opening
+        image->futex_last_seq = image->md[0].futexSeq;
+
+        // Legacy polling until daoShmSetWaitPolicy is called
+        memset(&image->wait_policy, 0, sizeof(DAO_WAIT_POLICY));
+        memset(&image->wait_stats, 0, sizeof(DAO_WAIT_STATS));
     }
     return(rval);
 }
 
+#ifdef _WIN32
+#define daoFseek _fseeki64
+#define daoFtell _ftelli64
+#else
+#define daoFseek fseeko
+#define daoFtell ftello
+#endif
+
+/*
+ * Read len bytes at offset of a file, 0 on success
+ */
+static int daoReadAt(FILE *file, uint64_t offset, void *dst, size_t len)
+{
+    if (daoFseek(file, (int64_t)offset, SEEK_SET) != 0)
+    {
+        return -1;
+    }
+    return (fread(dst, 1, len, file) == len) ? 0 : -1;
+}
+
+/**
+ * @brief Copy the newest frame of a shared memory written with the layout of an older DAO version
+ * 
+ * The file is read without being mapped, so it works while a writer built against the
+ * old library is running. The frame is read again if it changed while being copied.
+ * 
+ * @param name shared memory file
+ * @param dst destination buffer
+ * @param dstSize size of dst in bytes, at least one frame
+ * @param cnt0 counter of the copied frame
+ * @return int_fast8_t DAO_SUCCESS, DAO_OVERWRITE if no stable copy could be made, DAO_ERROR
+ */
+int_fast8_t daoShmReadLegacy(const char *name, void *dst, uint64_t dstSize, uint64_t *cnt0)
+{
+    daoTrace("\n");
+    IMAGE_METADATA md;
+    FILE *file;
+    uint64_t fileSize;
+    uint64_t mdSize;
+    uint64_t frameSize;
+    uint32_t fifo_size;
+    uint32_t last = 0;
+    uint64_t cnt0After;
+    uint8_t write;
+    int retry;
+    int_fast8_t rval = DAO_OVERWRITE;
+
+    file = fopen(name, "rb");
+    if (file == NULL)
+    {
+        daoError("Cannot open shared memory file %s\n", name);
+        return DAO_ERROR;
+    }
+    daoFseek(file, 0, SEEK_END);
+    fileSize = (uint64_t)daoFtell(file);
+
+    memset(&md, 0, sizeof(IMAGE_METADATA));
+    if (daoReadAt(file, 0, &md, daoShmLegacyMdSize(1)) != 0)
+    {
+        daoError("%s is too small to be a shared memory\n", name);
+        fclose(file);
+        return DAO_ERROR;
+    }
+
+    if (md.fifo_size > 0 && fileSize == daoShmLegacyFileSize(&md, md.fifo_size, daoShmLegacyMdSize(1)))
+    {
+        mdSize = daoShmLegacyMdSize(1);
+        fifo_size = md.fifo_size;
+    }
+    else if (fileSize == daoShmLegacyFileSize(&md, 1, daoShmLegacyMdSize(0)))
+    {
+        mdSize = daoShmLegacyMdSize(0);
+        fifo_size = 1;
+    }
+    else
+    {
+        daoError("%s does not use the layout of an older DAO version\n", name);
+        fclose(file);
+        return DAO_ERROR;
+    }
+
+    frameSize = md.nelement * daoShmElementSize(md.atype);
+    if (dstSize < frameSize)
+    {
+        daoError("destination of %llu bytes is smaller than a frame of %llu bytes\n",
+                 (unsigned long long)dstSize, (unsigned long long)frameSize);
+        fclose(file);
+        return DAO_ERROR;
+    }
+
+    for (retry = 0; retry < 10 && rval != DAO_SUCCESS; retry++)
+    {
+        if (fifo_size > 1)
+        {
+            daoReadAt(file, offsetof(IMAGE_METADATA, fifo_last_written), &last, sizeof(last));
+            last %= fifo_size;
+        }
+        if (daoReadAt(file, last * mdSize + offsetof(IMAGE_METADATA, cnt0), cnt0, sizeof(*cnt0)) != 0
+            || daoReadAt(file, fifo_size * mdSize + last * frameSize, dst, frameSize) != 0
+            || daoReadAt(file, last * mdSize + offsetof(IMAGE_METADATA, write), &write, sizeof(write)) != 0
+            || daoReadAt(file, last * mdSize + offsetof(IMAGE_METADATA, cnt0), &cnt0After, sizeof(cnt0After)) != 0)
+        {
+            daoError("Cannot read %s\n", name);
+            rval = DAO_ERROR;
+            break;
+        }
+        if (write == 0 && cnt0After == *cnt0)
+        {
+            rval = DAO_SUCCESS;
+        }
+    }
+
+    fclose(file);
+    return rval;
+}
+
 /**
  * Init 1D array in shared memory
  */
@@ -876,1639 +1217,3349 @@ int_fast8_t daoShmInit1D(const char *name, uint32_t nbVal, IMAGE **image)
 }
 
 /*
- * The image is send to the shared memory.
+ * Start of the data of FIFO segment idx
  */
-int_fast8_t daoShmImage2Shm(void *im, uint32_t nbVal, IMAGE *image) 
+static inline char * daoShmSegmentPtr(IMAGE *image, uint32_t idx)
 {
-    daoTrace("\n");
-
-    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
-
-    uint32_t last_written = vol_md[0].fifo_last_written;
-    uint32_t writing_idx = (last_written + 1) % (image->md[0].fifo_size);
-
-    uint64_t fifo_writing_offset = image->md[0].nelement * (uint64_t)writing_idx;
-
-    vol_md[writing_idx].write = 1;
-
-    if (image->md[writing_idx].atype == _DATATYPE_UINT8)
-        memcpy(&image->array.UI8[fifo_writing_offset], (unsigned char *)im, nbVal*sizeof(unsigned char)); 
-    else if (image->md[writing_idx].atype == _DATATYPE_INT8)
-        memcpy(&image->array.SI8[fifo_writing_offset], (char *)im, nbVal*sizeof(char));       
-    else if (image->md[writing_idx].atype == _DATATYPE_UINT16)
-        memcpy(&image->array.UI16[fifo_writing_offset], (unsigned short *)im, nbVal*sizeof(unsigned short));
-    else if (image->md[writing_idx].atype == _DATATYPE_INT16)
-        memcpy(&image->array.SI16[fifo_writing_offset], (short *)im, nbVal*sizeof(short));
-    else if (image->md[writing_idx].atype == _DATATYPE_UINT32)
-        memcpy(&image->array.UI32[fifo_writing_offset], (unsigned int *)im, nbVal*sizeof(unsigned int));
-    else if (image->md[writing_idx].atype == _DATATYPE_INT32)
-        memcpy(&image->array.SI32[fifo_writing_offset], (int *)im, nbVal*sizeof(int));
-    else if (image->md[writing_idx].atype == _DATATYPE_UINT64)
-        memcpy(&image->array.UI64[fifo_writing_offset], (unsigned long *)im, nbVal*sizeof(unsigned long));
-    else if (image->md[writing_idx].atype == _DATATYPE_INT64)
-        memcpy(&image->array.SI64[fifo_writing_offset], (long *)im, nbVal*sizeof(long));
-    else if (image->md[writing_idx].atype == _DATATYPE_FLOAT)
-        memcpy(&image->array.F[fifo_writing_offset], (float *)im, nbVal*sizeof(float));
-    else if (image->md[writing_idx].atype == _DATATYPE_DOUBLE)
-        memcpy(&image->array.D[fifo_writing_offset], (double *)im, nbVal*sizeof(double));
-    else if (image->md[writing_idx].atype == _DATATYPE_COMPLEX_FLOAT)
-        memcpy(&image->array.CF[fifo_writing_offset], (complex_float *)im, nbVal*sizeof(complex_float));
-    else if (image->md[writing_idx].atype == _DATATYPE_COMPLEX_DOUBLE)
-        memcpy(&image->array.CD[fifo_writing_offset], (complex_double *)im, nbVal*sizeof(complex_double));
-
-    daoShmImagePart2ShmFinalize(image);
-
-    return DAO_SUCCESS;
+    return (char *)image->array.V + (uint64_t)idx * image->md[0].segmentStride;
 }
 
 /*
- * The image is send to the shared memory.
+ * Metadata block of FIFO segment idx, md[0] for every segment with DAO_SHM_COMPACT_MD
  */
-int_fast8_t daoShmImage2ShmQuiet(void *im, uint32_t nbVal, IMAGE *image) 
+static inline IMAGE_METADATA * daoShmSegmentMd(IMAGE *image, uint32_t idx)
 {
-    daoTrace("\n");
-
-    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
-
-    uint32_t last_written = vol_md[0].fifo_last_written;
-    uint32_t writing_idx = (last_written + 1) % (image->md[0].fifo_size);
-
-    uint64_t fifo_writing_offset = image->md[0].nelement * (uint64_t)writing_idx;
-
-    image->md[writing_idx].write = 1;
-
-    if (image->md[0].atype == _DATATYPE_UINT8)
-        memcpy(&image->array.UI8[fifo_writing_offset], (unsigned char *)im, nbVal*sizeof(unsigned char)); 
-    else if (image->md[0].atype == _DATATYPE_INT8)
-        memcpy(&image->array.SI8[fifo_writing_offset], (char *)im, nbVal*sizeof(char));       
-    else if (image->md[0].atype == _DATATYPE_UINT16)
-        memcpy(&image->array.UI16[fifo_writing_offset], (unsigned short *)im, nbVal*sizeof(unsigned short));
-    else if (image->md[0].atype == _DATATYPE_INT16)
-        memcpy(&image->array.SI16[fifo_writing_offset], (short *)im, nbVal*sizeof(short));
-    else if (image->md[0].atype == _DATATYPE_UINT32)
-        memcpy(&image->array.UI32[fifo_writing_offset], (unsigned int *)im, nbVal*sizeof(unsigned int));
-    else if (image->md[0].atype == _DATATYPE_INT32)
-        memcpy(&image->array.SI32[fifo_writing_offset], (int *)im, nbVal*sizeof(int));
-    else if (image->md[0].atype == _DATATYPE_UINT64)
-        memcpy(&image->array.UI64[fifo_writing_offset], (unsigned long *)im, nbVal*sizeof(unsigned long));
-    else if (image->md[0].atype == _DATATYPE_INT64)
-        memcpy(&image->array.SI64[fifo_writing_offset], (long *)im, nbVal*sizeof(long));
-    else if (image->md[0].atype == _DATATYPE_FLOAT)
-        memcpy(&image->array.F[fifo_writing_offset], (float *)im, nbVal*sizeof(float));
-    else if (image->md[0].atype == _DATATYPE_DOUBLE)
-        memcpy(&image->array.D[fifo_writing_offset], (double *)im, nbVal*sizeof(double));
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_FLOAT)
-        memcpy(&image->array.CF[fifo_writing_offset], (complex_float *)im, nbVal*sizeof(complex_float));
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_DOUBLE)
-        memcpy(&image->array.CD[fifo_writing_offset], (complex_double *)im, nbVal*sizeof(complex_double));
-	
-    image->md[writing_idx].write = 0;
-
-    return DAO_SUCCESS;
+    return (image->md[0].allocFlags & DAO_SHM_COMPACT_MD) ? &image->md[0] : &image->md[idx];
 }
 
 /*
- * The image is send to the shared memory.
- * No release of semaphore since it is a part write
+ * Packet map of FIFO segment idx, NULL without packet assembly
  */
-int_fast8_t daoShmImagePart2Shm(char *im, uint32_t nbVal, IMAGE *image, uint32_t position,
-                             uint16_t packetId, uint16_t packetTotal, uint64_t frameNumber) 
+static inline volatile DAO_PACKET_MAP * daoShmPacketMap(IMAGE *image, uint32_t idx)
 {
-    daoTrace("\n");
-
-    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
-
-    uint32_t last_written = vol_md[0].fifo_last_written;
-    uint32_t writing_idx = (last_written + 1) % (image->md[0].fifo_size);
-
-    uint64_t fifo_writing_offset = image->md[0].nelement * (uint64_t)writing_idx;
-
-    uint64_t adjusted_position = (uint64_t)position + fifo_writing_offset;
-
-    image->md[writing_idx].write = 1;
-
-    if (image->md[0].atype == _DATATYPE_UINT8)
-        memcpy(&image->array.UI8[adjusted_position], (unsigned char *)im, nbVal*sizeof(unsigned char)); 
-    else if (image->md[0].atype == _DATATYPE_INT8)
-        memcpy(&image->array.SI8[adjusted_position], (char *)im, nbVal*sizeof(char));       
-    else if (image->md[0].atype == _DATATYPE_UINT16)
-        memcpy(&image->array.UI16[adjusted_position], (unsigned short *)im, nbVal*sizeof(unsigned short));
-    else if (image->md[0].atype == _DATATYPE_INT16)
-        memcpy(&image->array.SI16[adjusted_position], (short *)im, nbVal*sizeof(short));
-    else if (image->md[0].atype == _DATATYPE_UINT32)
-        memcpy(&image->array.UI32[adjusted_position], (unsigned int *)im, nbVal*sizeof(unsigned int));
-    else if (image->md[0].atype == _DATATYPE_INT32)
-        memcpy(&image->array.SI32[adjusted_position], (int *)im, nbVal*sizeof(int));
-    else if (image->md[0].atype == _DATATYPE_UINT64)
-        memcpy(&image->array.UI64[adjusted_position], (unsigned long *)im, nbVal*sizeof(unsigned long));
-    else if (image->md[0].atype == _DATATYPE_INT64)
-        memcpy(&image->array.SI64[adjusted_position], (long *)im, nbVal*sizeof(long));
-    else if (image->md[0].atype == _DATATYPE_FLOAT)
-        memcpy(&image->array.F[adjusted_position], (float *)im, nbVal*sizeof(float));
-    else if (image->md[0].atype == _DATATYPE_DOUBLE)
-        memcpy(&image->array.D[adjusted_position], (double *)im, nbVal*sizeof(double));
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_FLOAT)
-        memcpy(&image->array.CF[adjusted_position], (complex_float *)im, nbVal*sizeof(complex_float));
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_DOUBLE)
-        memcpy(&image->array.CD[adjusted_position], (complex_double *)im, nbVal*sizeof(complex_double));
-
-    image->md[writing_idx].lastPos = position;
-    image->md[writing_idx].lastNb = nbVal;
-    image->md[writing_idx].packetNb = packetId;
-    image->md[writing_idx].packetTotal = packetTotal;
-    image->md[writing_idx].lastNbArray[packetId] = frameNumber;
-    image->md[writing_idx].write = 0;
-
-    return DAO_SUCCESS;
+    if (image->md[0].packetMax == 0)
+    {
+        return NULL;
+    }
+    return (volatile DAO_PACKET_MAP *)((char *)image->md + image->md[0].packetOffset
+                                       + (uint64_t)idx * image->md[0].packetStride);
 }
 
 /*
- * The image has beed sent to the shared memory.
- * Release of semaphore since it is a part write
+ * Completion bitmap following a packet map
  */
-int_fast8_t daoShmImagePart2ShmFinalize(IMAGE *image) 
+static inline volatile uint64_t * daoShmPacketBits(volatile DAO_PACKET_MAP *map)
 {
-    daoTrace("\n");
+    return (volatile uint64_t *)(map + 1);
+}
 
+/*
+ * cnt0 of the newest segment
+ */
+static inline uint64_t daoShmNewestCnt0(IMAGE *image)
+{
     volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
 
-    uint32_t last_written = vol_md[0].fifo_last_written;
-    uint32_t writing_idx = (last_written + 1) % (image->md[0].fifo_size);
-
-    image->md[writing_idx].write = 0;
+    return vol_record[vol_md[0].fifo_last_written].cnt0;
+}
 
-    image->md[0].fifo_last_written = writing_idx;
+// Memory fences of the segment seqlock
+#ifdef _WIN32
+#define daoFenceRelease() MemoryBarrier()
+#define daoFenceAcquire() MemoryBarrier()
+#define daoFenceFull()    MemoryBarrier()
+#else
+#define daoFenceRelease() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define daoFenceAcquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define daoFenceFull()    __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
 
-    daoShmTimestampShm(image);
-    daoSemPostAll(image);
+/*
+ * Atomic read-modify-writes of the packet maps, return the previous value
+ */
+static inline uint64_t daoAtomicOr64(volatile uint64_t *p, uint64_t v)
+{
+#ifdef _WIN32
+    return (uint64_t)InterlockedOr64((volatile LONG64 *)p, (LONG64)v);
+#else
+    return __atomic_fetch_or(p, v, __ATOMIC_ACQ_REL);
+#endif
+}
 
-    if(image->semlog != NULL)
-    {
-        daoSemLogPost(image);
-    }
-	 
+static inline uint32_t daoAtomicAdd32(volatile uint32_t *p, uint32_t v)
+{
+#ifdef _WIN32
+    return (uint32_t)InterlockedExchangeAdd((volatile LONG *)p, (LONG)v);
+#else
+    return __atomic_fetch_add(p, v, __ATOMIC_ACQ_REL);
+#endif
+}
 
-    return DAO_SUCCESS;
+static inline uint64_t daoAtomicAdd64(volatile uint64_t *p, uint64_t v)
+{
+#ifdef _WIN32
+    return (uint64_t)InterlockedExchangeAdd64((volatile LONG64 *)p, (LONG64)v);
+#else
+    return __atomic_fetch_add(p, v, __ATOMIC_ACQ_REL);
+#endif
 }
 
-/**
- * @brief 
- * 
- * @param image 
- * @param NBsem 
- * @return int_fast8_t 
+/*
+ * Atomically replace *p by desired if it equals expected, non-zero on success
  */
-int_fast8_t daoImageCreateSem(IMAGE *image, long NBsem)
+static inline int daoCas64(volatile uint64_t *p, uint64_t expected, uint64_t desired)
 {
-    daoTrace("\n");
-    char shmSemName[256];
-    long s;
-//    int r;
-//    char command[256];
-//    int semfile[100];
-
 #ifdef _WIN32
-	WCHAR wideShmSemName[256];
-	PACL dacl;
+    return InterlockedCompareExchange64((volatile LONG64 *)p, (LONG64)desired, (LONG64)expected) == (LONG64)expected;
 #else
-	char fname[256];
-    long s1;
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
 #endif
+}
 
-	//printf("%p\n", image);
-	//printf("%p\n", &(image->md[0]));
-	//printf("%p\n", &(image->md[0].name));
-	//printf("%s\n", image->md[0].name);
-	//printf("%p\n", &strlen);
+/*
+ * Make the sequence of segment idx odd before its data is modified.
+ * Does nothing if a write is already open (partial writes).
+ */
+static inline void daoShmSegmentBeginWrite(IMAGE *image, uint32_t idx)
+{
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
+    uint32_t seq = vol_record[idx].seq;
 
-    // to get rid off warning
-    char * nameCopy = (char *)malloc((strlen(image->md[0].name)+1)*sizeof(char));
-    strcpy(nameCopy, image->md[0].name);
-	
-    char *token = strtok(nameCopy, PATH_SEPARATOR);
+    if ((seq & 1) == 0)
+    {
+        vol_record[idx].seq = seq + 1;
+        daoFenceRelease();
+    }
+}
 
-    char *semFName = NULL;
-    char *localName = NULL; 
+/*
+ * Make the sequence of segment idx even once its data and metadata are complete.
+ */
+static inline void daoShmSegmentEndWrite(IMAGE *image, uint32_t idx)
+{
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
+    uint32_t seq = vol_record[idx].seq;
 
-    while (token != NULL) 
+    if ((seq & 1) == 1)
     {
-        semFName = token;
-        token = strtok(NULL, PATH_SEPARATOR);
+        daoFenceRelease();
+        vol_record[idx].seq = seq + 1;
     }
-    if (semFName != NULL)
+}
+
+/*
+ * Write the trace of the frame committed in segment idx, under its seqlock: the trace given
+ * to daoShmTraceBegin or daoShmTraceFrom with the exit time of its last stage, or a trace
+ * without stamps. The origin of a new chain is the frame id of the record.
+ */
+static inline void daoShmTraceCommit(IMAGE *image, uint32_t idx)
+{
+    DAO_FRAME_TRACE *next = &image->trace_next;
+
+    if (image->trace == NULL)
     {
-        daoInfo("shm name = %s\n", semFName);   
-        localName = strtok(semFName, ".");
-        if (localName != NULL) 
-        {
-            daoInfo("local name: %s\n", localName);
-        }
-        else
-        {
-            daoError("invalid name format, should be <name.im.shm>\n");
-            free(nameCopy);
-            return DAO_ERROR;
-        }
+        return;
+    }
+    if (next->nbStamp + next->dropped == 0)
+    {
+        next->originId = DAO_TRACE_NO_ORIGIN;
+    }
+    else if (next->nbStamp > 0 && next->stamp[next->nbStamp - 1].exitTsc == 0)
+    {
+        next->stamp[next->nbStamp - 1].exitTsc = daoShmTraceTsc();
+    }
+    if (next->originId == DAO_TRACE_NO_ORIGIN)
+    {
+        next->originId = image->record[idx].frameId;
+    }
+    memcpy(&image->trace[idx], next, sizeof(DAO_FRAME_TRACE));
+    memset(next, 0, sizeof(DAO_FRAME_TRACE));
+}
+
+/*
+ * Fill the record of segment idx and set its cnt0 and time stamp: cnt0 follows the
+ * one of the segment before it. Called before idx is published in fifo_last_written.
+ * With DAO_SHM_COMPACT_MD, md[0].cnt0 is the counter of the newest segment and is left
+ * to daoShmPublishCompactCnt0, once fifo_last_written points to idx.
+ */
+static void daoShmTimestampSegment(IMAGE *image, uint32_t idx)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
 
+    uint32_t fifo_prior_write = (idx == 0)
+                                ? vol_md[0].fifo_size - 1
+                                : idx - 1;
+    volatile IMAGE_METADATA *segment_md = daoShmSegmentMd(image, idx);
+    volatile DAO_FRAME_RECORD *record = &vol_record[idx];
+    uint64_t now = (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+    uint64_t cnt0 = vol_record[fifo_prior_write].cnt0 + 1;
+
+    record->cnt0 = cnt0;
+    record->writeNs = now;
+    if (image->record_next.seq != 0)
+    {
+        // values given to daoShmSetFrameInfo, for this frame only
+        record->frameId = image->record_next.frameId;
+        record->atimeNs = image->record_next.atimeNs;
+        record->tag = image->record_next.tag;
+        image->record_next.seq = 0;
     }
     else
     {
-        daoError("invalid location, should be /tmp/<optional>/<name.im.shm>\n");
-        free(nameCopy);
-        return DAO_ERROR;
+        record->frameId = segment_md->cnt2;
+        record->atimeNs = now;
+        record->tag = 0;
     }
 
-    // Remove pre-existing semaphores if any
-#ifdef _WIN32
-    SECURITY_ATTRIBUTES *saShm = daoCreateWindowsSecurityAttrs(0644, &dacl);
-	if (!saShm) {
-		daoError("Could not create semaphore security attributes\n");
-		free(nameCopy);
-		return DAO_ERROR;
-	}
-	
-    if(image->md[0].sem != NBsem)
+    // the counter waits poll the md, the record must be complete first
+    daoFenceRelease();
+    segment_md->atime.tsfixed.secondlong = ((int64_t)(1e9 * t.tv_sec) + t.tv_nsec);
+    if ((image->md[0].allocFlags & DAO_SHM_COMPACT_MD) == 0)
     {
-        // Close existing semaphores ...
-        daoInfo("Closing semaphore\n");
-        for(s=0; s < image->md[0].sem; s++)
-        {
-            CloseHandle(image->semptr[s]);
-        }
-        image->md[0].sem = 0;
+        segment_md->cnt0 = cnt0;
+    }
+}
 
-        daoInfo("Done\n");
-        //free(image->semptr);
-        image->semptr = NULL;
+/*
+ * With DAO_SHM_COMPACT_MD, move md[0].cnt0 to the counter of segment idx, just published
+ * in fifo_last_written: a reader woken by cnt0 then reads the head of this frame
+ */
+static inline void daoShmPublishCompactCnt0(IMAGE *image, uint32_t idx)
+{
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+
+    if (image->md[0].allocFlags & DAO_SHM_COMPACT_MD)
+    {
+        daoFenceRelease();
+        vol_md[0].cnt0 = ((volatile DAO_FRAME_RECORD *)image->record)[idx].cnt0;
     }
-#else
-    if(image->md[0].sem != NBsem)
+}
+
+// DAO_PACKET_MAP::frameNumber while the map is reset for a new frame
+#define DAO_PACKET_LOCKED (DAO_PACKET_NO_FRAME - 1)
+
+/*
+ * Clear the packet map of segment idx, no frame in assembly
+ */
+static void daoShmPacketReset(IMAGE *image, uint32_t idx)
+{
+    volatile DAO_PACKET_MAP *map = daoShmPacketMap(image, idx);
+    volatile uint64_t *bits = daoShmPacketBits(map);
+    uint32_t w;
+
+    for (w = 0; w < (image->md[0].packetMax + 63) / 64; w++)
     {
-        // Close existing semaphores ...
-        daoInfo("Closing semaphore\n");
-        for(s=0; s < image->md[0].sem; s++)
-        {
-            sem_close(image->semptr[s]);
-        }
-        image->md[0].sem = 0;
+        bits[w] = 0;
+    }
+    map->received = 0;
+    map->packetTotal = 0;
+    daoFenceRelease();
+    map->frameNumber = DAO_PACKET_NO_FRAME;
+}
 
-        daoInfo("Remove associated files\n");
-		// ... and remove associated files
-        for(s1=NBsem; s1<100; s1++)
+/*
+ * Publish the next segment: clear its write flag, complete its record, move the FIFO
+ * head and post the readers. Common body of the finalize and commit calls.
+ */
+static int_fast8_t daoShmPublishSegment(IMAGE *image)
+{
+
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+
+    uint32_t last_written = vol_md[0].fifo_last_written;
+    uint32_t writing_idx = (last_written + 1) % (image->md[0].fifo_size);
+    uint32_t next_idx = (writing_idx + 1) % image->md[0].fifo_size;
+    volatile DAO_PACKET_MAP *map = daoShmPacketMap(image, writing_idx);
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
+
+    daoShmSegmentMd(image, writing_idx)->write = 0;
+
+    // open the seqlock for writers that did not go through an acquire or partial write
+    daoShmSegmentBeginWrite(image, writing_idx);
+
+    if (map != NULL)
+    {
+        // the frame number and first packet time of a frame finalized by the caller go into its record
+        if (map->frameNumber < DAO_PACKET_LOCKED && image->record_next.seq == 0)
         {
-            sprintf(fname, "/dev/shm/sem.%s_sem%02ld", localName, s1);
-            daoDebug("removing %s\n", fname);
-            remove(fname);
+            daoShmSetFrameInfo(image, map->frameNumber, map->startNs, 0);
         }
-        daoInfo("Done\n");
-        //free(image->semptr);
-        image->semptr = NULL;
+        // free the map of the next segment before the packet writers can see it
+        daoShmPacketReset(image, next_idx);
+    }
+    vol_record[writing_idx].filled = image->md[0].nelement;
+    vol_record[next_idx].filled = 0;
+
+    // the record, trace and md of the segment are complete before the readers can see it
+    daoShmTimestampSegment(image, writing_idx);
+    daoShmTraceCommit(image, writing_idx);
+    daoShmSegmentEndWrite(image, writing_idx);
+    daoFenceRelease();
+    vol_md[0].fifo_last_written = writing_idx;
+    daoShmPublishCompactCnt0(image, writing_idx);
+    if(image->md[0].syncFlags & DAO_SYNC_SEM)
+    {
+        daoSemPostAll(image);
+    }
+    if(image->md[0].syncFlags & DAO_SYNC_FUTEX)
+    {
+        daoFutexPost(image);
     }
-#endif
-
 
-    if(image->md[0].sem == 0)
+    if(image->semlog != NULL)
     {
-        if(image->semptr!=NULL)
-            free(image->semptr);
+        daoSemLogPost(image);
+    }
+	 
 
-        image->md[0].sem = (uint16_t)NBsem;
-        daoInfo("malloc semptr %d entries\n", image->md[0].sem);
+    return DAO_SUCCESS;
+}
 
+/*
+ * Wait of the DAO_SHM_MPSC writers for their turn: spin, then yield the CPU
+ * since the writer holding the turn may be descheduled
+ */
+static inline void daoShmMpscWait(uint32_t *spin)
+{
+    if (++(*spin) < 1024)
+    {
+        daoCpuRelax();
+        return;
+    }
 #ifdef _WIN32
-        image->semptr = (HANDLE*) malloc(sizeof(HANDLE*)*image->md[0].sem);
+    Sleep(0);
 #else
-        image->semptr = (sem_t**) malloc(sizeof(sem_t**)*image->md[0].sem);
+    sched_yield();
 #endif
-        
-        for(s=0; s<NBsem; s++)
-        {
-#ifdef _WIN32
-            sprintf(shmSemName, "Local\\DAO_%s_sem%02ld", localName, s);
-			MultiByteToWideChar(CP_UTF8, 0, shmSemName, -1, wideShmSemName, 256);
-			
-			if (!(image->semptr[s] = CreateSemaphoreW(saShm, 0, 1, wideShmSemName))) {
-				DWORD last_error = GetLastError();
-				fprintf(stderr, "semaphore initialization error: %d\n", GetLastError());
-			}
-			ReleaseSemaphore(image->semptr[s], 1, NULL);
+}
 
-#else
-            sprintf(shmSemName, "%s_sem%02ld", localName, s);
-            if ((image->semptr[s] = sem_open(shmSemName, 0, 0644, 0))== SEM_FAILED) 
-            {
-                if ((image->semptr[s] = sem_open(shmSemName, O_CREAT, 0644, 1)) == SEM_FAILED) 
-                {
-                    perror("semaphore initilization\n");
-                }
-                else
-                {
-                    sem_init(image->semptr[s], 1, 0);
-                }
-            }
-#endif
-        }
-    }
+/**
+ * @brief Reserve the next FIFO segment for writing in place
+ * 
+ * The producer fills the segment directly, then publishes it with daoShmCommitWriteSlot.
+ * This avoids the copy made by daoShmImage2Shm. Only one slot can be acquired at a time.
+ * 
+ * With DAO_SHM_MPSC, the slot is reserved with a ticket taken by an atomic fetch-add on
+ * md[0].mpscReserve, so several processes can write the same image. The call waits while
+ * the slot still holds a frame of an older ticket that is not published.
+ * 
+ * @param image 
+ * @param slot_ptr Pointer to the start of the segment's array
+ * @param slot_idx Index of the segment, to be passed to daoShmCommitWriteSlot
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmAcquireWriteSlot(IMAGE *image, void **slot_ptr, uint32_t *slot_idx)
+{
+    daoTrace("\n");
 
-#ifdef _WIN32
-    daoDestroyWindowsSecurityAttrs(saShm, dacl);
-#endif
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    uint32_t writing_idx;
 
-    free(nameCopy);
-    return(0);
-}
+    if (image->md[0].allocFlags & DAO_SHM_MPSC)
+    {
+        uint64_t ticket = daoAtomicAdd64(&image->md[0].mpscReserve, 1);
+        uint32_t spin = 0;
+
+        // the segment is free once the ticket fifo_size before this one is published
+        while (vol_md[0].mpscCommit + image->md[0].fifo_size <= ticket)
+        {
+            daoShmMpscWait(&spin);
+        }
+        daoFenceAcquire();
+        writing_idx = (uint32_t)((ticket + 1) % image->md[0].fifo_size);
+    }
+    else
+    {
+        uint32_t last_written = vol_md[0].fifo_last_written;
+        writing_idx = (last_written + 1) % (image->md[0].fifo_size);
+    }
 
+    ((volatile IMAGE_METADATA *)daoShmSegmentMd(image, writing_idx))->write = 1;
+    daoShmSegmentBeginWrite(image, writing_idx);
 
+    *slot_ptr = daoShmSegmentPtr(image, writing_idx);
+    *slot_idx = writing_idx;
 
+    return DAO_SUCCESS;
+}
 
-/*
- * Create SHM
+/**
+ * @brief Publish a segment filled after daoShmAcquireWriteSlot
+ * 
+ * Sets cnt0, the time stamp and the write flag, moves the FIFO head and posts the readers.
+ * With DAO_SHM_MPSC, waits until the segments of the older tickets are published, so the
+ * frames reach the readers in ticket order.
+ * 
+ * @param image 
+ * @param slot_idx Index returned by daoShmAcquireWriteSlot
+ * @return int_fast8_t DAO_ERROR if slot_idx is not the acquired segment
  */
-int_fast8_t daoShmImageCreate_FIFO(IMAGE *image, const char *name, long naxis, 
-                              uint32_t *size, uint8_t atype, int shared, int NBkw, uint32_t fifo_size)
+int_fast8_t daoShmCommitWriteSlot(IMAGE *image, uint32_t slot_idx)
 {
     daoTrace("\n");
-    long i;//,ii;
-    long nelement;
-    struct timespec timenow;
-    char shmSemName[256];
-    size_t sharedsize = 0; // shared memory size in bytes
-    char shmName[256];
-    IMAGE_METADATA *map=NULL;
-    char *mapv; // pointed cast in bytes
-    int kw;
-//    char comment[80];
-//    char kname[16];
-    nelement = 1;
 
-#ifdef _WIN32
-    WCHAR wideShmSemName[256];
-	WCHAR wideShmName[256];
-	HANDLE shmFd; // shared memory file handle
-	HANDLE shmFm; // shared memory file mapping object
-#else
-    int shmFd; // shared memory file descriptor
-    int result;
-#endif
-	
-    for(i=0; i<naxis; i++)
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    uint32_t fifo_size = image->md[0].fifo_size;
+
+    if (image->md[0].allocFlags & DAO_SHM_MPSC)
     {
-        nelement*=size[i];
+        // the tickets acquired and not published are within fifo_size of mpscCommit,
+        // the one of this segment is the first of them ending on slot_idx
+        uint64_t commit = vol_md[0].mpscCommit;
+        uint64_t ticket = commit + (slot_idx + 2 * fifo_size - 1 - commit % fifo_size) % fifo_size;
+        uint32_t spin = 0;
+        int_fast8_t rval;
+
+        if (slot_idx >= fifo_size || ticket >= vol_md[0].mpscReserve)
+        {
+            daoError("Segment %u was not acquired for writing\n", slot_idx);
+            return DAO_ERROR;
+        }
+        while (vol_md[0].mpscCommit != ticket)
+        {
+            daoShmMpscWait(&spin);
+        }
+        daoFenceAcquire();
+        rval = daoShmPublishSegment(image);
+        daoFenceRelease();
+        vol_md[0].mpscCommit = ticket + 1;
+        return rval;
     }
 
-    
-    // compute total size to be allocated
-    if(shared==1)
+    if (slot_idx != (vol_md[0].fifo_last_written + 1) % fifo_size)
     {
-        char * nameCopy = (char *)malloc((strlen(name)+1)*sizeof(char));
-        strcpy(nameCopy, name);
-        char *token = strtok(nameCopy, PATH_SEPARATOR);
+        daoError("Segment %u was not acquired for writing\n", slot_idx);
+        return DAO_ERROR;
+    }
 
-        char *semFName = NULL;
-        char *localName = NULL;
+    return daoShmPublishSegment(image);
+}
 
-        while (token != NULL)
-        {
-            semFName = token;
-            token = strtok(NULL, PATH_SEPARATOR);
-        }
+/*
+ * The image is send to the shared memory.
+ */
+int_fast8_t daoShmImage2Shm(void *im, uint32_t nbVal, IMAGE *image) 
+{
+    daoTrace("\n");
 
-        if (semFName != NULL)
-        {
-            daoInfo("shm name = %s\n", semFName);
-            localName = strtok(semFName, ".");
-            if (localName != NULL)
-            {
-                daoInfo("local name: %s\n", localName);
-            }
-            else
-            {
-                daoError("invalid name format, should be <name.im.shm>\n");
-                free(nameCopy);
-                return DAO_ERROR;
-            }
-        }
-        else
-        {
-            daoError("invalid location, should be /tmp/<optional>/<name.im.shm>\n");
-            free(nameCopy);
-            return DAO_ERROR;
-        }
+    void *slot;
+    uint32_t slot_idx;
 
-        // create semlog
-#ifdef _WIN32
-        daoInfo("Creation Local\\DAO_%s_semlog\n", semFName);
-        sprintf(shmSemName, "Local\\DAO_%s_semlog", semFName);
-        image->semlog = NULL;
-		
-		MultiByteToWideChar(CP_UTF8, 0, shmSemName, -1, wideShmSemName, 256);
-		
-		PACL daclSem;
-		SECURITY_ATTRIBUTES *saSem = daoCreateWindowsSecurityAttrs(0600, &daclSem);
-		if (!saSem) {
-			daoError("Error creating security attributes for semaphore\n");
-			free(nameCopy);
-			return DAO_ERROR;
-		}
-		
-		if (!(image->semlog = CreateSemaphoreW(saSem, 0, 1, wideShmSemName))) {
-			DWORD last_error = GetLastError();
-			fprintf(stderr, "semaphore initialization error: %d\n", GetLastError());
-		}
-		ReleaseSemaphore(image->semlog, 1, NULL);
-		daoDestroyWindowsSecurityAttrs(saSem, daclSem);
+    if (daoShmAcquireWriteSlot(image, &slot, &slot_idx) != DAO_SUCCESS)
+    {
+        return DAO_ERROR;
+    }
+    memcpy(slot, im, nbVal * image->type->size);
 
-#else
-        daoInfo("Creation %s_semlog\n", semFName);
-        sprintf(shmSemName, "%s_semlog", semFName);
-        remove(shmSemName);
-        image->semlog = NULL;
+    return daoShmCommitWriteSlot(image, slot_idx);
+}
 
-        if ((image->semlog = sem_open(shmSemName, O_CREAT, 0644, 1)) == SEM_FAILED)
-        {
-            perror("semaphore creation / initilization");}
-        else
-        {
-            sem_init(image->semlog, 1, 0);
-        }
-#endif
+/*
+ * The image is send to the shared memory, without publishing it.
+ * Refused with DAO_SHM_MPSC: the next segment may be reserved by another writer.
+ */
+int_fast8_t daoShmImage2ShmQuiet(void *im, uint32_t nbVal, IMAGE *image) 
+{
+    daoTrace("\n");
 
-        /* First, determine the space requirements for storing all copies of the image metadata */
-        sharedsize = fifo_size * sizeof(IMAGE_METADATA);
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
 
-        /* Now add the space requirements for the buffers themselves */
-        if(atype == _DATATYPE_UINT8)
-        {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_UINT8;
-        }
-        if(atype == _DATATYPE_INT8)
-        {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_INT8;
-        }
-        if(atype == _DATATYPE_UINT16)
+    if (image->md[0].allocFlags & DAO_SHM_MPSC)
+    {
+        daoError("%s has several writers, daoShmImage2ShmQuiet is not supported\n", image->name);
+        return DAO_ERROR;
+    }
+
+    uint32_t last_written = vol_md[0].fifo_last_written;
+    uint32_t writing_idx = (last_written + 1) % (image->md[0].fifo_size);
+
+    daoShmSegmentMd(image, writing_idx)->write = 1;
+    daoShmSegmentBeginWrite(image, writing_idx);
+
+    memcpy(daoShmSegmentPtr(image, writing_idx), im, nbVal * image->type->size);
+	
+    daoShmSegmentEndWrite(image, writing_idx);
+    daoShmSegmentMd(image, writing_idx)->write = 0;
+
+    return DAO_SUCCESS;
+}
+
+/*
+ * Wait until the packet writers of a map are down to the ones held by the caller.
+ * Called with the map DAO_PACKET_LOCKED: the writers still counted are past their
+ * claim and finish their copy without waiting on anything.
+ */
+static inline void daoShmPacketDrain(volatile DAO_PACKET_MAP *map, uint32_t held)
+{
+    daoFenceFull();
+    while (map->writers != held)
+    {
+        daoCpuRelax();
+    }
+    daoFenceAcquire();
+}
+
+/*
+ * Commit the complete frame of a map DAO_PACKET_LOCKED by the caller, which holds held
+ * writers of the map. The map gets its frame number back once fifo_last_written has
+ * moved, so a late packet of the frame sees the segment is no longer written.
+ */
+static int_fast8_t daoShmPacketCommit(IMAGE *image, volatile DAO_PACKET_MAP *map, uint64_t frameNumber,
+                                      uint32_t held)
+{
+    int_fast8_t rval;
+
+    daoShmPacketDrain(map, held);
+    // the frame number and first packet time of an assembled frame go into its record
+    if (image->record_next.seq == 0)
+    {
+        daoShmSetFrameInfo(image, frameNumber, map->startNs, 0);
+    }
+    rval = daoShmPublishSegment(image);
+    // with fifo_size 1 the commit already reset the map for the next frame
+    daoFenceRelease();
+    daoCas64(&map->frameNumber, DAO_PACKET_LOCKED, frameNumber);
+    return rval;
+}
+
+/*
+ * Take the packet map of the segment being written for frameNumber, counted in its writers
+ * until daoShmPacketWrite sets the completion bit of the packet.
+ * An incomplete older frame in the map is dropped once its writers are done, a packet older
+ * than the frame in assembly is refused. Waits while another thread commits a complete frame.
+ */
+static int_fast8_t daoShmPacketClaim(IMAGE *image, uint32_t packetTotal, uint64_t frameNumber,
+                                     uint32_t *idx, volatile DAO_PACKET_MAP **packetMap)
+{
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    uint32_t packetElems = (uint32_t)((image->md[0].nelement + packetTotal - 1) / packetTotal);
+
+    for (;;)
+    {
+        uint32_t writing_idx = (vol_md[0].fifo_last_written + 1) % image->md[0].fifo_size;
+        volatile DAO_PACKET_MAP *map = daoShmPacketMap(image, writing_idx);
+        uint64_t current = map->frameNumber;
+
+        daoFenceAcquire();
+        if (current == frameNumber)
         {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_UINT16;
+            // counted first, then checked: a thread dropping or committing the frame
+            // locks the map first, then waits for the writers counted
+            daoAtomicAdd32(&map->writers, 1);
+            daoFenceFull();
+            if (map->frameNumber != frameNumber
+                || writing_idx != (vol_md[0].fifo_last_written + 1) % image->md[0].fifo_size)
+            {
+                daoAtomicAdd32(&map->writers, (uint32_t)-1);
+                continue;
+            }
+            *idx = writing_idx;
+            *packetMap = map;
+            return DAO_SUCCESS;
         }
-        if(atype == _DATATYPE_INT16)
+        if (current == DAO_PACKET_LOCKED || (current < frameNumber && map->received == map->packetTotal))
         {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_INT16;
+            // map being reset, or complete frame being committed
+            daoCpuRelax();
+            continue;
         }
-        if(atype == _DATATYPE_INT32)
+        if (current != DAO_PACKET_NO_FRAME && current > frameNumber)
         {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_INT32;
+            daoWarning("packet of frame %llu arrived during frame %llu, dropped\n",
+                       (unsigned long long)frameNumber, (unsigned long long)current);
+            return DAO_ERROR;
         }
-        if(atype == _DATATYPE_UINT32)
+        if (!daoCas64(&map->frameNumber, current, DAO_PACKET_LOCKED))
         {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_UINT32;
+            continue;
         }
-        if(atype == _DATATYPE_INT64)
+        if (writing_idx != (vol_md[0].fifo_last_written + 1) % image->md[0].fifo_size)
         {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_INT64;
+            // the segment was committed since the map was read
+            map->frameNumber = current;
+            continue;
         }
-        if(atype == _DATATYPE_UINT64)
+        if (current != DAO_PACKET_NO_FRAME)
         {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_UINT64;
+            // the late packets of the frame finish before the map changes hands
+            daoShmPacketDrain(map, 0);
+            if (map->received == map->packetTotal)
+            {
+                // completed meanwhile, its last writer left the commit to this thread
+                daoShmPacketCommit(image, map, current, 0);
+                continue;
+            }
+            daoWarning("frame %llu dropped with %u of %u packets\n", (unsigned long long)current,
+                       map->received, map->packetTotal);
+            volatile uint64_t *bits = daoShmPacketBits(map);
+            uint32_t w;
+            for (w = 0; w < (map->packetTotal + 63) / 64; w++)
+            {
+                bits[w] = 0;
+            }
         }
-        if(atype == _DATATYPE_FLOAT)
+        struct timespec t;
+        clock_gettime(CLOCK_REALTIME, &t);
+        map->received = 0;
+        map->packetTotal = packetTotal;
+        map->packetElems = packetElems;
+        map->startNs = (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+        // atomic: a writer that saw the lock may still be undoing its count
+        daoAtomicAdd32(&map->writers, 1);
+        daoFenceRelease();
+        map->frameNumber = frameNumber;
+        *idx = writing_idx;
+        *packetMap = map;
+        return DAO_SUCCESS;
+    }
+}
+
+/*
+ * Common body of daoShmImagePart2Shm and daoShmImagePacket2Shm, refused with DAO_SHM_MPSC
+ */
+static int_fast8_t daoShmPacketWrite(const char *im, uint32_t nbVal, IMAGE *image, uint32_t position,
+                                     uint32_t packetId, uint32_t packetTotal, uint64_t frameNumber)
+{
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_PACKET_MAP *map = NULL;
+    uint32_t writing_idx;
+    int_fast8_t rval = DAO_SUCCESS;
+
+    size_t elem_size = image->type->size;
+
+    // the next segment may be reserved by another writer
+    if (image->md[0].allocFlags & DAO_SHM_MPSC)
+    {
+        daoError("%s has several writers, partial writes are not supported\n", image->name);
+        return DAO_ERROR;
+    }
+
+    if (image->md[0].packetMax > 0)
+    {
+        if (packetTotal == 0 || packetTotal > image->md[0].packetMax || packetId >= packetTotal)
         {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_FLOAT;
+            daoError("packet %u of %u out of the assembly map (%u packets)\n", packetId, packetTotal,
+                     image->md[0].packetMax);
+            return DAO_ERROR;
         }
-        if(atype == _DATATYPE_DOUBLE)
+        if (daoShmPacketClaim(image, packetTotal, frameNumber, &writing_idx, &map) != DAO_SUCCESS)
         {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_DOUBLE;
+            return DAO_ERROR;
         }
-        if(atype == _DATATYPE_COMPLEX_FLOAT)
+    }
+    else
+    {
+        writing_idx = (vol_md[0].fifo_last_written + 1) % image->md[0].fifo_size;
+    }
+
+    IMAGE_METADATA *segment_md = daoShmSegmentMd(image, writing_idx);
+
+    segment_md->write = 1;
+    daoShmSegmentBeginWrite(image, writing_idx);
+
+    memcpy(daoShmSegmentPtr(image, writing_idx) + (uint64_t)position * elem_size, im, nbVal * elem_size);
+
+    segment_md->lastPos = position;
+    segment_md->lastNb = nbVal;
+    segment_md->packetNb = packetId;
+    segment_md->packetTotal = packetTotal;
+    if (packetId < sizeof(segment_md->lastNbArray) / sizeof(segment_md->lastNbArray[0]))
+    {
+        segment_md->lastNbArray[packetId] = frameNumber;
+    }
+
+    if (map == NULL)
+    {
+        segment_md->write = 0;
+        // in-order writes extend the filled part of the frame, see daoShmWaitWritten
+        volatile DAO_FRAME_RECORD *record = &((volatile DAO_FRAME_RECORD *)image->record)[writing_idx];
+        uint64_t filled = record->filled;
+        if (position <= filled && (uint64_t)position + nbVal > filled)
         {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_COMPLEX_FLOAT;
+            daoFenceRelease();
+            record->filled = (uint64_t)position + nbVal;
         }
-        if(atype == _DATATYPE_COMPLEX_DOUBLE)
+        return DAO_SUCCESS;
+    }
+
+    // the write flag of an assembled frame is cleared by its commit, other packets may be
+    // still copying; the bit publishes the data of the packet, the last one commits the frame
+    uint64_t bit = 1ULL << (packetId % 64);
+    if ((daoAtomicOr64(&daoShmPacketBits(map)[packetId / 64], bit) & bit) == 0
+        && daoAtomicAdd32(&map->received, 1) + 1 == packetTotal)
+    {
+        if (daoCas64(&map->frameNumber, frameNumber, DAO_PACKET_LOCKED))
         {
-            sharedsize += fifo_size * nelement * SIZEOF_DATATYPE_COMPLEX_DOUBLE;
+            rval = daoShmPacketCommit(image, map, frameNumber, 1);
         }
+        // otherwise a thread dropping the frame holds the lock and commits it
+    }
+    daoAtomicAdd32(&map->writers, (uint32_t)-1);
 
-        /* And finally, set aside space for the keywords */
-        sharedsize += NBkw * sizeof(IMAGE_KEYWORD);
+    return rval;
+}
 
-#ifdef _WIN32
-        sprintf(shmName, "%s", name);
-		MultiByteToWideChar(CP_UTF8, 0, shmName, -1, wideShmName, 256);
-		
-		PACL daclFile;
-		SECURITY_ATTRIBUTES *saFile = daoCreateWindowsSecurityAttrs(0600, &daclFile);
-		if (!saFile) {
-			daoError("Error creating security attributes for file\n");
-			exit(0);
-		}
+/*
+ * The image is send to the shared memory.
+ * No release of semaphore since it is a part write, unless the image has packet
+ * maps and this is the last packet of the frame
+ */
+int_fast8_t daoShmImagePart2Shm(char *im, uint32_t nbVal, IMAGE *image, uint32_t position,
+                             uint16_t packetId, uint16_t packetTotal, uint64_t frameNumber) 
+{
+    daoTrace("\n");
 
-		// Use OPEN_ALWAYS instead of CREATE_ALWAYS.
-		// CREATE_ALWAYS truncates the file on open, but Windows returns
-		// ERROR_USER_MAPPED_FILE (1224) if any other process currently has the
-		// file memory-mapped (e.g. a reader is still connected).
-		// OPEN_ALWAYS creates the file if absent, or opens it without
-		// truncating if it already exists.  We zero the mapped region
-		// explicitly below to get the same clean-slate effect.
-		shmFd = CreateFileW(wideShmName, GENERIC_READ | GENERIC_WRITE,
-							FILE_SHARE_READ | FILE_SHARE_WRITE,
-							saFile, OPEN_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+    return daoShmPacketWrite(im, nbVal, image, position, packetId, packetTotal, frameNumber);
+}
 
-		if (shmFd == INVALID_HANDLE_VALUE)
-		{
-			DWORD error_num = GetLastError();
-			daoError("Error opening file (%s) for writing, error %d\n", shmName, error_num);
-			exit(0);
-		}
-		
-		// Create file mapping handle. Specifying the full sharedsize here
-		// will extend the file if it is smaller than required (e.g. first
-		// run, or size changed).
-		shmFm = CreateFileMapping(shmFd, NULL, PAGE_READWRITE,
-								  (DWORD)(sharedsize >> 32), (DWORD)sharedsize, NULL);
-		if (shmFm == NULL) {
-			CloseHandle(shmFd);
-			daoError("Error creating file mapping (%s)\n", shmName);
-			exit(0);
-		}
-		
-		image->shmfd = shmFd;
-		image->shmfm = shmFm;
-		image->memsize = sharedsize;
-		
-		// Now map file into memory - "map" will be our pointer
-		map = (IMAGE_METADATA*) MapViewOfFile(shmFm, FILE_MAP_ALL_ACCESS, 0, 0, sharedsize);
-		if (map == NULL) {
-			CloseHandle(shmFd);
-			CloseHandle(shmFm);
+/**
+ * @brief Write one packet of a frame in the packet assembly mode
+ * 
+ * The image must be created with DAO_SHM_OPTIONS::packetMax > 0, so without DAO_SHM_MPSC. The frame is cut in
+ * packetTotal packets of ceil(nelement / packetTotal) elements, the last one shorter.
+ * Packets can arrive in any order and from several threads; the one completing the
+ * frame commits it and posts the readers, as daoShmImagePart2ShmFinalize.
+ * A packet of a newer frame drops the incomplete frame in assembly.
+ * 
+ * @param im packet data
+ * @param image 
+ * @param packetId index of the packet in the frame
+ * @param packetTotal number of packets of the frame, at most md[0].packetMax
+ * @param frameNumber number of the frame, increasing
+ * @return int_fast8_t DAO_ERROR for a packet of a frame older than the one in assembly
+ */
+int_fast8_t daoShmImagePacket2Shm(void *im, IMAGE *image, uint32_t packetId, uint32_t packetTotal,
+                                  uint64_t frameNumber)
+{
+    daoTrace("\n");
+
+    if (image->md[0].packetMax == 0 || packetTotal == 0)
+    {
+        daoError("%s has no packet maps\n", image->name);
+        return DAO_ERROR;
+    }
+
+    uint64_t nelement = image->md[0].nelement;
+    uint64_t packetElems = (nelement + packetTotal - 1) / packetTotal;
+    uint64_t position = (uint64_t)packetId * packetElems;
+    uint64_t nbVal = (position < nelement) ? nelement - position : 0;
+
+    if (nbVal > packetElems)
+    {
+        nbVal = packetElems;
+    }
+    return daoShmPacketWrite((const char *)im, (uint32_t)nbVal, image, (uint32_t)position, packetId,
+                             packetTotal, frameNumber);
+}
+
+/*
+ * The image has beed sent to the shared memory.
+ * Release of semaphore since it is a part write.
+ * Refused with DAO_SHM_MPSC: the segment is published by daoShmCommitWriteSlot.
+ */
+int_fast8_t daoShmImagePart2ShmFinalize(IMAGE *image) 
+{
+    daoTrace("\n");
+
+    if (image->md[0].allocFlags & DAO_SHM_MPSC)
+    {
+        daoError("%s has several writers, daoShmImagePart2ShmFinalize is not supported\n", image->name);
+        return DAO_ERROR;
+    }
+
+    return daoShmPublishSegment(image);
+}
+
+/**
+ * @brief 
+ * 
+ * @param image 
+ * @param NBsem 
+ * @return int_fast8_t 
+ */
+int_fast8_t daoImageCreateSem(IMAGE *image, long NBsem)
+{
+    daoTrace("\n");
+    char shmSemName[256];
+    long s;
+//    int r;
+//    char command[256];
+//    int semfile[100];
+
+#ifdef _WIN32
+	WCHAR wideShmSemName[256];
+	PACL dacl;
+#else
+	char fname[256];
+    long s1;
+#endif
+
+	//printf("%p\n", image);
+	//printf("%p\n", &(image->md[0]));
+	//printf("%p\n", &(image->md[0].name));
+	//printf("%s\n", image->md[0].name);
+	//printf("%p\n", &strlen);
+
+    // to get rid off warning
+    char * nameCopy = (char *)malloc((strlen(image->md[0].name)+1)*sizeof(char));
+    strcpy(nameCopy, image->md[0].name);
+	
+    char *token = strtok(nameCopy, PATH_SEPARATOR);
+
+    char *semFName = NULL;
+    char *localName = NULL; 
+
+    while (token != NULL) 
+    {
+        semFName = token;
+        token = strtok(NULL, PATH_SEPARATOR);
+    }
+    if (semFName != NULL)
+    {
+        daoInfo("shm name = %s\n", semFName);   
+        localName = strtok(semFName, ".");
+        if (localName != NULL) 
+        {
+            daoInfo("local name: %s\n", localName);
+        }
+        else
+        {
+            daoError("invalid name format, should be <name.im.shm>\n");
+            free(nameCopy);
+            return DAO_ERROR;
+        }
+
+    }
+    else
+    {
+        daoError("invalid location, should be /tmp/<optional>/<name.im.shm>\n");
+        free(nameCopy);
+        return DAO_ERROR;
+    }
+
+    // Remove pre-existing semaphores if any
+#ifdef _WIN32
+    SECURITY_ATTRIBUTES *saShm = daoCreateWindowsSecurityAttrs(0644, &dacl);
+	if (!saShm) {
+		daoError("Could not create semaphore security attributes\n");
+		free(nameCopy);
+		return DAO_ERROR;
+	}
+	
+    if(image->md[0].sem != NBsem)
+    {
+        // Close existing semaphores ...
+        daoInfo("Closing semaphore\n");
+        for(s=0; s < image->md[0].sem; s++)
+        {
+            CloseHandle(image->semptr[s]);
+        }
+        image->md[0].sem = 0;
+
+        daoInfo("Done\n");
+        //free(image->semptr);
+        image->semptr = NULL;
+    }
+#else
+    if(image->md[0].sem != NBsem)
+    {
+        // Close existing semaphores ...
+        daoInfo("Closing semaphore\n");
+        for(s=0; s < image->md[0].sem; s++)
+        {
+            sem_close(image->semptr[s]);
+        }
+        image->md[0].sem = 0;
+
+        daoInfo("Remove associated files\n");
+		// ... and remove associated files
+        for(s1=NBsem; s1<100; s1++)
+        {
+            sprintf(fname, "/dev/shm/sem.%s_sem%02ld", localName, s1);
+            daoDebug("removing %s\n", fname);
+            remove(fname);
+        }
+        daoInfo("Done\n");
+        //free(image->semptr);
+        image->semptr = NULL;
+    }
+#endif
+
+
+    if(image->md[0].sem == 0)
+    {
+        if(image->semptr!=NULL)
+            free(image->semptr);
+
+        image->md[0].sem = (uint16_t)NBsem;
+        daoInfo("malloc semptr %d entries\n", image->md[0].sem);
+
+#ifdef _WIN32
+        image->semptr = (HANDLE*) malloc(sizeof(HANDLE*)*image->md[0].sem);
+#else
+        image->semptr = (sem_t**) malloc(sizeof(sem_t**)*image->md[0].sem);
+#endif
+        
+        for(s=0; s<NBsem; s++)
+        {
+#ifdef _WIN32
+            sprintf(shmSemName, "Local\\DAO_%s_sem%02ld", localName, s);
+			MultiByteToWideChar(CP_UTF8, 0, shmSemName, -1, wideShmSemName, 256);
+			
+			if (!(image->semptr[s] = CreateSemaphoreW(saShm, 0, 1, wideShmSemName))) {
+				DWORD last_error = GetLastError();
+				fprintf(stderr, "semaphore initialization error: %d\n", GetLastError());
+			}
+			ReleaseSemaphore(image->semptr[s], 1, NULL);
+
+#else
+            sprintf(shmSemName, "%s_sem%02ld", localName, s);
+            if ((image->semptr[s] = sem_open(shmSemName, 0, 0644, 0))== SEM_FAILED) 
+            {
+                if ((image->semptr[s] = sem_open(shmSemName, O_CREAT, 0644, 1)) == SEM_FAILED) 
+                {
+                    perror("semaphore initilization\n");
+                }
+                else
+                {
+                    sem_init(image->semptr[s], 1, 0);
+                }
+            }
+#endif
+        }
+    }
+
+#ifdef _WIN32
+    daoDestroyWindowsSecurityAttrs(saShm, dacl);
+#endif
+
+    free(nameCopy);
+    return(0);
+}
+
+
+
+
+/*
+ * Create SHM
+ */
+int_fast8_t daoShmImageCreate_FIFO(IMAGE *image, const char *name, long naxis, 
+                              uint32_t *size, uint8_t atype, int shared, int NBkw, uint32_t fifo_size)
+{
+    return daoShmImageCreateWithOptions(image, name, naxis, size, atype, shared, NBkw, fifo_size, NULL);
+}
+
+/**
+ * @brief Create a FIFO SHM with the given allocation options
+ * 
+ * The options are recorded in the SHM so that daoShmShm2Img applies the same ones.
+ * 
+ * @param options allocation flags, NULL for the defaults
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmImageCreateWithOptions(IMAGE *image, const char *name, long naxis, 
+                              uint32_t *size, uint8_t atype, int shared, int NBkw, uint32_t fifo_size,
+                              const DAO_SHM_OPTIONS *options)
+{
+    daoTrace("\n");
+    uint8_t allocFlags = (options != NULL) ? (uint8_t)options->flags : 0;
+    int numaNode = (options != NULL) ? options->numaNode : -1;
+    uint32_t packetMax = (options != NULL) ? options->packetMax : 0;
+    uint32_t trace = (options != NULL) ? options->trace : 0;
+    uint64_t readerOffset;
+    uint64_t recordOffset;
+    uint64_t packetOffset;
+    uint64_t traceOffset;
+    uint64_t dataOffset;
+    uint64_t segmentStride;
+    size_t elemSize = daoShmElementSize(atype);
+    long i;//,ii;
+    long nelement;
+    struct timespec timenow;
+    char shmSemName[256];
+    size_t sharedsize = 0; // shared memory size in bytes
+    char shmName[256];
+    IMAGE_METADATA *map=NULL;
+    char *mapv; // pointed cast in bytes
+    int kw;
+//    char comment[80];
+//    char kname[16];
+    nelement = 1;
+
+#ifdef _WIN32
+    WCHAR wideShmSemName[256];
+	WCHAR wideShmName[256];
+	HANDLE shmFd; // shared memory file handle
+	HANDLE shmFm; // shared memory file mapping object
+#else
+    int shmFd; // shared memory file descriptor
+    int result;
+#endif
+	
+    for(i=0; i<naxis; i++)
+    {
+        nelement*=size[i];
+    }
+
+    if(elemSize == 0)
+    {
+        daoError("unknown data type %d\n", (int) atype);
+        return DAO_ERROR;
+    }
+    if((allocFlags & DAO_SHM_MPSC) && packetMax > 0)
+    {
+        // the packet assembly is a partial write, single-producer
+        daoError("DAO_SHM_MPSC images cannot have packet maps\n");
+        return DAO_ERROR;
+    }
+    if(shared==1)
+    {
+        daoShmLayout(nelement, atype, fifo_size, allocFlags, packetMax, trace, &readerOffset, &recordOffset,
+                     &packetOffset, &traceOffset, &dataOffset, &segmentStride);
+    }
+    else
+    {
+        // the metadata of a local image is never compacted, its records, packet maps and traces follow the md blocks
+        allocFlags &= ~DAO_SHM_COMPACT_MD;
+        readerOffset = 0;
+        recordOffset = (uint64_t)fifo_size * sizeof(IMAGE_METADATA);
+        packetOffset = (packetMax > 0) ? recordOffset + (uint64_t)fifo_size * sizeof(DAO_FRAME_RECORD) : 0;
+        traceOffset = trace ? recordOffset + (uint64_t)fifo_size * (sizeof(DAO_FRAME_RECORD)
+                                                                    + daoShmPacketStride(packetMax)) : 0;
+        dataOffset = 0;
+        segmentStride = nelement * elemSize;
+    }
+    
+    // compute total size to be allocated
+    if(shared==1)
+    {
+        char * nameCopy = (char *)malloc((strlen(name)+1)*sizeof(char));
+        strcpy(nameCopy, name);
+        char *token = strtok(nameCopy, PATH_SEPARATOR);
+
+        char *semFName = NULL;
+        char *localName = NULL;
+
+        while (token != NULL)
+        {
+            semFName = token;
+            token = strtok(NULL, PATH_SEPARATOR);
+        }
+
+        if (semFName != NULL)
+        {
+            daoInfo("shm name = %s\n", semFName);
+            localName = strtok(semFName, ".");
+            if (localName != NULL)
+            {
+                daoInfo("local name: %s\n", localName);
+            }
+            else
+            {
+                daoError("invalid name format, should be <name.im.shm>\n");
+                free(nameCopy);
+                return DAO_ERROR;
+            }
+        }
+        else
+        {
+            daoError("invalid location, should be /tmp/<optional>/<name.im.shm>\n");
+            free(nameCopy);
+            return DAO_ERROR;
+        }
+
+        // create semlog
+#ifdef _WIN32
+        daoInfo("Creation Local\\DAO_%s_semlog\n", semFName);
+        sprintf(shmSemName, "Local\\DAO_%s_semlog", semFName);
+        image->semlog = NULL;
+		
+		MultiByteToWideChar(CP_UTF8, 0, shmSemName, -1, wideShmSemName, 256);
+		
+		PACL daclSem;
+		SECURITY_ATTRIBUTES *saSem = daoCreateWindowsSecurityAttrs(0600, &daclSem);
+		if (!saSem) {
+			daoError("Error creating security attributes for semaphore\n");
+			free(nameCopy);
+			return DAO_ERROR;
+		}
+		
+		if (!(image->semlog = CreateSemaphoreW(saSem, 0, 1, wideShmSemName))) {
+			DWORD last_error = GetLastError();
+			fprintf(stderr, "semaphore initialization error: %d\n", GetLastError());
+		}
+		ReleaseSemaphore(image->semlog, 1, NULL);
+		daoDestroyWindowsSecurityAttrs(saSem, daclSem);
+
+#else
+        daoInfo("Creation %s_semlog\n", semFName);
+        sprintf(shmSemName, "%s_semlog", semFName);
+        remove(shmSemName);
+        image->semlog = NULL;
+
+        if ((image->semlog = sem_open(shmSemName, O_CREAT, 0644, 1)) == SEM_FAILED)
+        {
+            perror("semaphore creation / initilization");}
+        else
+        {
+            sem_init(image->semlog, 1, 0);
+        }
+#endif
+
+        /* Metadata blocks padded to a page, then the segments, each on a cache line (or a page) */
+        sharedsize = dataOffset + fifo_size * segmentStride;
+
+        /* And finally, set aside space for the keywords */
+        sharedsize += NBkw * sizeof(IMAGE_KEYWORD);
+
+#ifdef _WIN32
+        sprintf(shmName, "%s", name);
+		MultiByteToWideChar(CP_UTF8, 0, shmName, -1, wideShmName, 256);
+		
+		PACL daclFile;
+		SECURITY_ATTRIBUTES *saFile = daoCreateWindowsSecurityAttrs(0600, &daclFile);
+		if (!saFile) {
+			daoError("Error creating security attributes for file\n");
+			exit(0);
+		}
+
+		// Use OPEN_ALWAYS instead of CREATE_ALWAYS.
+		// CREATE_ALWAYS truncates the file on open, but Windows returns
+		// ERROR_USER_MAPPED_FILE (1224) if any other process currently has the
+		// file memory-mapped (e.g. a reader is still connected).
+		// OPEN_ALWAYS creates the file if absent, or opens it without
+		// truncating if it already exists.  We zero the mapped region
+		// explicitly below to get the same clean-slate effect.
+		shmFd = CreateFileW(wideShmName, GENERIC_READ | GENERIC_WRITE,
+							FILE_SHARE_READ | FILE_SHARE_WRITE,
+							saFile, OPEN_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+
+		if (shmFd == INVALID_HANDLE_VALUE)
+		{
+			DWORD error_num = GetLastError();
+			daoError("Error opening file (%s) for writing, error %d\n", shmName, error_num);
+			exit(0);
+		}
+		
+		// Create file mapping handle. Specifying the full sharedsize here
+		// will extend the file if it is smaller than required (e.g. first
+		// run, or size changed).
+		shmFm = CreateFileMapping(shmFd, NULL, PAGE_READWRITE,
+								  (DWORD)(sharedsize >> 32), (DWORD)sharedsize, NULL);
+		if (shmFm == NULL) {
+			CloseHandle(shmFd);
+			daoError("Error creating file mapping (%s)\n", shmName);
+			exit(0);
+		}
+		
+		image->shmfd = shmFd;
+		image->shmfm = shmFm;
+		image->memsize = sharedsize;
+		
+		// Now map file into memory - "map" will be our pointer
+		map = (IMAGE_METADATA*) MapViewOfFile(shmFm, FILE_MAP_ALL_ACCESS, 0, 0, sharedsize);
+		if (map == NULL) {
+			CloseHandle(shmFd);
+			CloseHandle(shmFm);
 			daoError("Error creating view of file mapping (%s)\n", shmName);
 		}
 
-		// Zero the region so stale data from a previous writer session is
-		// cleared (equivalent to the truncation that CREATE_ALWAYS would do).
-		memset(map, 0, sharedsize);
+		// Zero the region so stale data from a previous writer session is
+		// cleared (equivalent to the truncation that CREATE_ALWAYS would do).
+		memset(map, 0, sharedsize);
+
+		if ((allocFlags & ~(DAO_SHM_PAGE_ALIGN | DAO_SHM_COMPACT_MD | DAO_SHM_MPSC)) != 0)
+		{
+			daoWarning("SHM allocation flags are not supported on Windows\n");
+		}
+		allocFlags &= DAO_SHM_PAGE_ALIGN | DAO_SHM_COMPACT_MD | DAO_SHM_MPSC;
+		map->allocFlags = allocFlags;
+		map->numaNode = -1;
+
+#else
+        //sprintf(shmName, "%s/%s.im.shm", SHAREDMEMDIR, name);
+        sprintf(shmName, "%s", name);
+        shmFd = open(shmName, O_RDWR | O_CREAT | O_TRUNC, (mode_t)0600);
+
+        if (shmFd == -1) 
+        {
+            daoError("Error opening file (%s) for writing\n", shmName);
+            exit(0);
+        }
+
+        if (allocFlags & DAO_SHM_HUGETLB)
+        {
+#if defined(__linux__)
+            // hugetlbfs files must be a whole number of huge pages
+            struct statfs fs;
+            if (fstatfs(shmFd, &fs) == 0 && fs.f_type == HUGETLBFS_MAGIC)
+            {
+                size_t hugepage = (size_t)fs.f_bsize;
+                sharedsize = (sharedsize + hugepage - 1) / hugepage * hugepage;
+            }
+            else
+#endif
+            {
+                daoWarning("%s is not on a hugetlbfs mount, using normal pages\n", shmName);
+                allocFlags &= ~DAO_SHM_HUGETLB;
+            }
+        }
+
+        image->shmfd = shmFd;
+        image->memsize = sharedsize;
+
+        if (allocFlags & DAO_SHM_HUGETLB)
+        {
+            // hugetlbfs does not support write(), size the file directly
+            if (ftruncate(shmFd, sharedsize) == -1)
+            {
+                close(shmFd);
+                perror("Error sizing the hugetlbfs file");
+                exit(0);
+            }
+        }
+        else
+        {
+            result = lseek(shmFd, sharedsize-1, SEEK_SET);
+            if (result == -1) 
+            {
+                close(shmFd);
+                daoError("Error calling lseek() to 'stretch' the file\n");
+                exit(0);
+            }
+
+            result = write(shmFd, "", 1);
+            if (result != 1) 
+            {
+                close(shmFd);
+                perror("Error writing last byte of the file");
+                exit(0);
+            }
+        }
+
+        int mapflags = daoShmMapFlags(allocFlags);
+        map = (IMAGE_METADATA*) mmap(0, sharedsize, PROT_READ | PROT_WRITE, mapflags, shmFd, 0);
+        if (map == MAP_FAILED) 
+        {
+            close(shmFd);
+            perror("Error mmapping the file");
+            exit(0);
+        }
+        allocFlags = daoShmApplyAllocFlags(map, sharedsize, allocFlags, mapflags, numaNode);
+        map->allocFlags = allocFlags;
+        map->numaNode = (allocFlags & DAO_SHM_NUMA) ? (int16_t)numaNode : -1;
+#endif
+	
+        image->md = (IMAGE_METADATA*) map;
+        image->md[0].fifo_size = fifo_size;
+
+        for (uint32_t fifo_idx = 0; fifo_idx < daoShmMdCount(image->md); ++fifo_idx)
+        {
+            image->md[fifo_idx].shared = 1;
+            image->md[fifo_idx].sem = 0;
+        }
+
+        free(nameCopy);
+
+#ifdef _WIN32
+        daoDestroyWindowsSecurityAttrs(saFile, daclFile);
+#endif
+    }
+    else
+    {
+        image->md = (IMAGE_METADATA*) calloc(fifo_size, sizeof(IMAGE_METADATA) + sizeof(DAO_FRAME_RECORD)
+                                                        + daoShmPacketStride(packetMax)
+                                                        + (trace ? sizeof(DAO_FRAME_TRACE) : 0));
+        image->md[0].fifo_size = fifo_size;
+
+        for (uint32_t fifo_idx = 0; fifo_idx < fifo_size; ++fifo_idx)
+        {
+            image->md[fifo_idx].shared = 0;
+        }
+
+        if(NBkw>0)
+        {
+            image->kw = (IMAGE_KEYWORD*) malloc(sizeof(IMAGE_KEYWORD)*NBkw);
+        }
+        else
+        {
+            image->kw = NULL;
+        }
+    }
+
+    strcpy(image->name, name); // local name
+    for (uint32_t fifo_idx = 0; fifo_idx < daoShmMdCount(image->md); ++fifo_idx)
+    {
+        image->md[fifo_idx].atype = atype;
+        image->md[fifo_idx].naxis = (uint8_t)naxis;
+
+        strcpy(image->md[fifo_idx].name, name);
+
+        for(i=0; i<naxis; i++)
+        {
+            image->md[fifo_idx].size[i] = size[i];
+        }
+        image->md[fifo_idx].NBkw = NBkw;
+    }
+    image->md[0].layoutVersion = DAO_SHM_LAYOUT_VERSION;
+    image->md[0].dataOffset = dataOffset;
+    image->md[0].segmentStride = segmentStride;
+    // reader cursors, zeroed with the rest of the file
+    image->md[0].readerOffset = (uint32_t)readerOffset;
+    image->md[0].maxReaders = (shared == 1) ? DAO_MAX_READERS : 0;
+    image->reader = NULL;
+    image->type = daoShmTypeInfo(atype);
+    // frame records, zeroed with the rest of the file
+    image->md[0].recordOffset = (uint32_t)recordOffset;
+    image->record = (DAO_FRAME_RECORD *)((char *)image->md + recordOffset);
+    memset(&image->record_next, 0, sizeof(DAO_FRAME_RECORD));
+    // packet maps, no frame in assembly
+    image->md[0].packetOffset = (uint32_t)packetOffset;
+    image->md[0].packetStride = (uint32_t)daoShmPacketStride(packetMax);
+    image->md[0].packetMax = packetMax;
+    for (uint32_t fifo_idx = 0; packetMax > 0 && fifo_idx < fifo_size; ++fifo_idx)
+    {
+        ((DAO_PACKET_MAP *)((char *)image->md + packetOffset + (uint64_t)fifo_idx * image->md[0].packetStride))->frameNumber
+            = DAO_PACKET_NO_FRAME;
+    }
+    // frame traces, zeroed with the rest of the file
+    image->md[0].traceOffset = (uint32_t)traceOffset;
+    image->trace = trace ? (DAO_FRAME_TRACE *)((char *)image->md + traceOffset) : NULL;
+    memset(&image->trace_next, 0, sizeof(DAO_FRAME_TRACE));
+
+
+    if(shared==1)
+    {
+        mapv = (char*) map;
+        mapv += dataOffset;
+        image->array.V = (void*) (mapv);
+        memset(image->array.V, '\0', segmentStride * fifo_size);
+        mapv += segmentStride * fifo_size;
+        image->kw = (IMAGE_KEYWORD*) (mapv);
+    }
+    else
+    {
+        image->array.V = calloc((size_t) nelement * (size_t) fifo_size, elemSize);
+    }
+
+    if(image->array.V == NULL)
+    {
+        daoError("memory allocation failed\n");
+        fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
+        fprintf(stderr,"Image name = %s\n",name);
+        fprintf(stderr,"Image size = ");
+        fprintf(stderr,"%ld", (long) size[0]);
+        for(i=1; i<naxis; i++)
+        {
+            fprintf(stderr,"x%ld", (long) size[i]);
+        }
+        fprintf(stderr,"\n");
+        fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
+            (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*elemSize);
+        fprintf(stderr," %c[%d;m",(char) 27, 0);
+        exit(0);
+    }
+
+    clock_gettime(CLOCK_REALTIME, &timenow);
+
+    for (uint32_t fifo_idx = 0; fifo_idx < daoShmMdCount(image->md); ++fifo_idx)
+    {
+        image->md[fifo_idx].last_access = 1.0*timenow.tv_sec + 0.000000001*timenow.tv_nsec;
+        image->md[fifo_idx].creation_time = image->md[0].last_access;
+        image->md[fifo_idx].write = 0;
+        image->md[fifo_idx].cnt0 = 0;
+        image->md[fifo_idx].cnt1 = 0;
+        image->md[fifo_idx].nelement = nelement;
+    }
+
+    if(shared==1)
+    {
+        daoInfo("Creating Semaphores\n");
+        daoImageCreateSem(image, 10); // by default, create 10 semaphores
+        daoInfo("Semaphores created\n");
+
+#ifdef __APPLE__
+        for (int i = 0; i < image->md[0].sem; i++)
+        {
+            while (sem_trywait(image->semptr[i]) == 0) 
+            {
+                // Draining kernel-level semaphore
+            }
+            atomic_store(&image->md[0].semCounter[i], 0);
+        }
+        atomic_store(&image->md[0].semLogCounter, 0);
+#endif
+    }
+    else
+    {
+		image->md[0].sem = 0; // no semaphores
+    }
+
+    // post both semaphores and futex by default, see daoShmSetSyncFlags
+    image->md[0].futexSeq = 0;
+    image->md[0].futexWaiters = 0;
+    image->md[0].syncFlags = DAO_SYNC_SEM | DAO_SYNC_FUTEX;
+    image->futex_last_seq = 0;
+    memset(&image->wait_policy, 0, sizeof(DAO_WAIT_POLICY));
+    memset(&image->wait_stats, 0, sizeof(DAO_WAIT_STATS));
+
+    // set fifo last written position
+    image->md[0].fifo_size = fifo_size;
+    image->md[0].fifo_last_written = fifo_size - 1;
+    // ticket t of the DAO_SHM_MPSC writers publishes segment (t + 1) % fifo_size
+    image->md[0].mpscReserve = fifo_size - 1;
+    image->md[0].mpscCommit = fifo_size - 1;
+
+    // set up FIFO tail
+
+    uint32_t tmp32;
+    uint64_t tmp64;
+    daoShmResetTail(image, &tmp32, &tmp64);
+
+    // initialize keywords
+    for(kw=0; kw<image->md[0].NBkw; kw++)
+    {
+        image->kw[kw].type = 'N';
+    }
+    return(0);
+}
+
+/*
+ * Combine engine
+ * The output is processed by tiles small enough to stay in L1, and every channel is streamed
+ * through the tile before moving on, instead of nbChannel strided reads per pixel.
+ * Float kernels are selected at run time (AVX-512, AVX2 or scalar), large images are split
+ * across OpenMP threads when the library is built with waf --openmp.
+ */
+#define DAO_COMBINE_TILE        2048            // elements per tile (8 kB of float)
+#define DAO_COMBINE_OMP_MIN     (1 << 18)       // nbVal from which the tiles are shared by OpenMP threads
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DAO_COMBINE_X86 1
 #else
-        //sprintf(shmName, "%s/%s.im.shm", SHAREDMEMDIR, name);
-        sprintf(shmName, "%s", name);
-        shmFd = open(shmName, O_RDWR | O_CREAT | O_TRUNC, (mode_t)0600);
+#define DAO_COMBINE_X86 0
+#endif
 
-        if (shmFd == -1) 
+// out = gain * in when first, out += gain * in otherwise
+typedef void (*daoCombineKernelF32)(float *out, const float *in, float gain, uint32_t n, int first);
+typedef void (*daoCombineKernelF64)(double *out, const double *in, double gain, uint32_t n, int first);
+
+static void daoCombineF32Scalar(float *out, const float *in, float gain, uint32_t n, int first)
+{
+    uint32_t i;
+    if (first)
+    {
+        for (i = 0; i < n; i++)
+            out[i] = gain * in[i];
+    }
+    else
+    {
+        for (i = 0; i < n; i++)
+            out[i] += gain * in[i];
+    }
+}
+
+static void daoCombineF64Scalar(double *out, const double *in, double gain, uint32_t n, int first)
+{
+    uint32_t i;
+    if (first)
+    {
+        for (i = 0; i < n; i++)
+            out[i] = gain * in[i];
+    }
+    else
+    {
+        for (i = 0; i < n; i++)
+            out[i] += gain * in[i];
+    }
+}
+
+#if DAO_COMBINE_X86
+__attribute__((target("avx2,fma")))
+static void daoCombineF32Avx2(float *out, const float *in, float gain, uint32_t n, int first)
+{
+    __m256 g = _mm256_set1_ps(gain);
+    uint32_t i = 0;
+    if (first)
+    {
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(g, _mm256_loadu_ps(in + i)));
+    }
+    else
+    {
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(out + i, _mm256_fmadd_ps(g, _mm256_loadu_ps(in + i), _mm256_loadu_ps(out + i)));
+    }
+    daoCombineF32Scalar(out + i, in + i, gain, n - i, first);
+}
+
+__attribute__((target("avx2,fma")))
+static void daoCombineF64Avx2(double *out, const double *in, double gain, uint32_t n, int first)
+{
+    __m256d g = _mm256_set1_pd(gain);
+    uint32_t i = 0;
+    if (first)
+    {
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(out + i, _mm256_mul_pd(g, _mm256_loadu_pd(in + i)));
+    }
+    else
+    {
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(out + i, _mm256_fmadd_pd(g, _mm256_loadu_pd(in + i), _mm256_loadu_pd(out + i)));
+    }
+    daoCombineF64Scalar(out + i, in + i, gain, n - i, first);
+}
+
+__attribute__((target("avx512f")))
+static void daoCombineF32Avx512(float *out, const float *in, float gain, uint32_t n, int first)
+{
+    __m512 g = _mm512_set1_ps(gain);
+    uint32_t i = 0;
+    if (first)
+    {
+        for (; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(out + i, _mm512_mul_ps(g, _mm512_loadu_ps(in + i)));
+    }
+    else
+    {
+        for (; i + 16 <= n; i += 16)
+            _mm512_storeu_ps(out + i, _mm512_fmadd_ps(g, _mm512_loadu_ps(in + i), _mm512_loadu_ps(out + i)));
+    }
+    daoCombineF32Scalar(out + i, in + i, gain, n - i, first);
+}
+
+__attribute__((target("avx512f")))
+static void daoCombineF64Avx512(double *out, const double *in, double gain, uint32_t n, int first)
+{
+    __m512d g = _mm512_set1_pd(gain);
+    uint32_t i = 0;
+    if (first)
+    {
+        for (; i + 8 <= n; i += 8)
+            _mm512_storeu_pd(out + i, _mm512_mul_pd(g, _mm512_loadu_pd(in + i)));
+    }
+    else
+    {
+        for (; i + 8 <= n; i += 8)
+            _mm512_storeu_pd(out + i, _mm512_fmadd_pd(g, _mm512_loadu_pd(in + i), _mm512_loadu_pd(out + i)));
+    }
+    daoCombineF64Scalar(out + i, in + i, gain, n - i, first);
+}
+#endif
+
+static daoCombineKernelF32 daoCombineF32 = NULL;
+static daoCombineKernelF64 daoCombineF64 = NULL;
+
+/*
+ * Pick the widest float kernels supported by this CPU, once
+ */
+static void daoCombineSelectKernels()
+{
+    daoCombineKernelF32 kf = daoCombineF32Scalar;
+    daoCombineKernelF64 kd = daoCombineF64Scalar;
+    const char *name = "scalar";
+
+#if DAO_COMBINE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        kf = daoCombineF32Avx512;
+        kd = daoCombineF64Avx512;
+        name = "avx512";
+    }
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        kf = daoCombineF32Avx2;
+        kd = daoCombineF64Avx2;
+        name = "avx2";
+    }
+#endif
+    daoDebug("combine kernels: %s\n", name);
+    daoCombineF64 = kd;
+    daoCombineF32 = kf;
+}
+
+/*
+ * 16-bit float conversions
+ * binary16 uses F16C and bfloat16 uses AVX-512 BF16 when the CPU has them, selected at run
+ * time like the combine kernels. The scalar versions round to nearest even and keep
+ * infinities, NaNs and binary16 subnormals. VCVTNEPS2BF16 flushes float subnormals to zero.
+ */
+#if DAO_COMBINE_X86 && (defined(__clang__) || __GNUC__ >= 10)
+#define DAO_CONVERT_BF16 1
+#else
+#define DAO_CONVERT_BF16 0
+#endif
+
+typedef void (*daoConvertKernelToF32)(const uint16_t *src, float *dst, uint64_t n);
+typedef void (*daoConvertKernelFromF32)(const float *src, uint16_t *dst, uint64_t n);
+
+static inline float daoBitsToFloat(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static inline uint32_t daoFloatToBits(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static inline float daoHalfToFloat(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+
+    if (exp == 0x1f)
+    {
+        return daoBitsToFloat(sign | 0x7f800000 | (mant << 13));
+    }
+    if (exp != 0)
+    {
+        return daoBitsToFloat(sign | ((exp + 112) << 23) | (mant << 13));
+    }
+    if (mant == 0)
+    {
+        return daoBitsToFloat(sign);
+    }
+    // subnormal, normalised for binary32
+    exp = 113;
+    while ((mant & 0x400) == 0)
+    {
+        mant <<= 1;
+        exp--;
+    }
+    return daoBitsToFloat(sign | (exp << 23) | ((mant & 0x3ff) << 13));
+}
+
+static inline uint16_t daoFloatToHalf(float f)
+{
+    uint32_t x = daoFloatToBits(f);
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t absx = x & 0x7fffffff;
+
+    if (absx >= 0x7f800000)
+    {
+        return (uint16_t)(sign | 0x7c00 | ((absx > 0x7f800000) ? 0x200 : 0));
+    }
+    if (absx >= 0x477ff000)
+    {
+        // 65520 and above round to infinity
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if (absx < 0x38800000)
+    {
+        // binary16 subnormal, in units of 2^-24
+        uint32_t e = absx >> 23;
+        uint32_t m = (absx & 0x7fffff) | 0x800000;
+        uint32_t shift;
+        uint32_t r, rem, half;
+        if (absx < 0x33000000)
         {
-            daoError("Error opening file (%s) for writing\n", shmName);
-            exit(0);
+            return (uint16_t)sign;
+        }
+        shift = 126 - e;
+        r = m >> shift;
+        rem = m & ((1u << shift) - 1);
+        half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (r & 1)))
+        {
+            r++;
         }
+        return (uint16_t)(sign | r);
+    }
+    absx -= 0x38000000;
+    return (uint16_t)(sign | ((absx + 0xfff + ((absx >> 13) & 1)) >> 13));
+}
+
+static inline uint16_t daoFloatToBf16(float f)
+{
+    uint32_t x = daoFloatToBits(f);
+    if ((x & 0x7fffffff) > 0x7f800000)
+    {
+        return (uint16_t)((x >> 16) | 0x40);
+    }
+    return (uint16_t)((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+}
+
+static void daoF16ToF32Scalar(const uint16_t *src, float *dst, uint64_t n)
+{
+    uint64_t i;
+    for (i = 0; i < n; i++)
+        dst[i] = daoHalfToFloat(src[i]);
+}
+
+static void daoF32ToF16Scalar(const float *src, uint16_t *dst, uint64_t n)
+{
+    uint64_t i;
+    for (i = 0; i < n; i++)
+        dst[i] = daoFloatToHalf(src[i]);
+}
+
+static void daoBf16ToF32Scalar(const uint16_t *src, float *dst, uint64_t n)
+{
+    uint64_t i;
+    for (i = 0; i < n; i++)
+        dst[i] = daoBitsToFloat((uint32_t)src[i] << 16);
+}
+
+static void daoF32ToBf16Scalar(const float *src, uint16_t *dst, uint64_t n)
+{
+    uint64_t i;
+    for (i = 0; i < n; i++)
+        dst[i] = daoFloatToBf16(src[i]);
+}
+
+#if DAO_COMBINE_X86
+__attribute__((target("avx,f16c")))
+static void daoF16ToF32F16c(const uint16_t *src, float *dst, uint64_t n)
+{
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + i))));
+    daoF16ToF32Scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx,f16c")))
+static void daoF32ToF16F16c(const float *src, uint16_t *dst, uint64_t n)
+{
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm_storeu_si128((__m128i *)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+    daoF32ToF16Scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void daoBf16ToF32Avx2(const uint16_t *src, float *dst, uint64_t n)
+{
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(_mm256_slli_epi32(w, 16)));
+    }
+    daoBf16ToF32Scalar(src + i, dst + i, n - i);
+}
+#endif
+
+#if DAO_CONVERT_BF16
+__attribute__((target("avx512f,avx512bf16")))
+static void daoF32ToBf16Avx512(const float *src, uint16_t *dst, uint64_t n)
+{
+    uint64_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256bh h = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), (__m256i)h);
+    }
+    daoF32ToBf16Scalar(src + i, dst + i, n - i);
+}
+#endif
+
+static daoConvertKernelToF32 daoF16ToF32 = NULL;
+static daoConvertKernelFromF32 daoF32ToF16 = NULL;
+static daoConvertKernelToF32 daoBf16ToF32 = NULL;
+static daoConvertKernelFromF32 daoF32ToBf16 = NULL;
+
+/*
+ * Pick the 16-bit float conversions supported by this CPU, once
+ */
+static void daoConvertSelectKernels()
+{
+    daoConvertKernelToF32 h2f = daoF16ToF32Scalar;
+    daoConvertKernelFromF32 f2h = daoF32ToF16Scalar;
+    daoConvertKernelToF32 b2f = daoBf16ToF32Scalar;
+    daoConvertKernelFromF32 f2b = daoF32ToBf16Scalar;
+
+#if DAO_COMBINE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c"))
+    {
+        h2f = daoF16ToF32F16c;
+        f2h = daoF32ToF16F16c;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        b2f = daoBf16ToF32Avx2;
+    }
+#endif
+#if DAO_CONVERT_BF16
+    if (__builtin_cpu_supports("avx512bf16"))
+    {
+        f2b = daoF32ToBf16Avx512;
+    }
+#endif
+    daoDebug("16-bit float conversions: %s, %s\n", (h2f == daoF16ToF32Scalar) ? "scalar" : "f16c",
+             (f2b == daoF32ToBf16Scalar) ? "scalar" : "avx512bf16");
+    daoF16ToF32 = h2f;
+    daoF32ToF16 = f2h;
+    daoBf16ToF32 = b2f;
+    daoF32ToBf16 = f2b;
+}
+
+// Registry entries, the kernels are selected on first use
+static void daoConvertF16ToFloat(const void *src, float *dst, uint64_t n)
+{
+    if (daoF16ToF32 == NULL)
+        daoConvertSelectKernels();
+    daoF16ToF32((const uint16_t *)src, dst, n);
+}
+
+static void daoConvertFloatToF16(const float *src, void *dst, uint64_t n)
+{
+    if (daoF32ToF16 == NULL)
+        daoConvertSelectKernels();
+    daoF32ToF16(src, (uint16_t *)dst, n);
+}
+
+static void daoConvertBf16ToFloat(const void *src, float *dst, uint64_t n)
+{
+    if (daoBf16ToF32 == NULL)
+        daoConvertSelectKernels();
+    daoBf16ToF32((const uint16_t *)src, dst, n);
+}
+
+static void daoConvertFloatToBf16(const float *src, void *dst, uint64_t n)
+{
+    if (daoF32ToBf16 == NULL)
+        daoConvertSelectKernels();
+    daoF32ToBf16(src, (uint16_t *)dst, n);
+}
+
+static void daoConvertF32ToFloat(const void *src, float *dst, uint64_t n)
+{
+    memcpy(dst, src, n * sizeof(float));
+}
+
+static void daoConvertFloatToF32(const float *src, void *dst, uint64_t n)
+{
+    memcpy(dst, src, n * sizeof(float));
+}
+
+static void daoConvertF64ToFloat(const void *src, float *dst, uint64_t n)
+{
+    uint64_t i;
+    for (i = 0; i < n; i++)
+        dst[i] = (float)((const double *)src)[i];
+}
+
+static void daoConvertFloatToF64(const float *src, void *dst, uint64_t n)
+{
+    uint64_t i;
+    for (i = 0; i < n; i++)
+        ((double *)dst)[i] = src[i];
+}
+
+// Integer tiles: modular sum as before without gains, double accumulator with gains
+#define DAO_COMBINE_INT_TILE(NAME, T)                                           \
+static void NAME(void *out, void * const *src, const float *gains,              \
+                 int nbChannel, uint64_t start, uint32_t n)                     \
+{                                                                               \
+    uint32_t i;                                                                 \
+    int k;                                                                      \
+    T *o = (T *)out + start;                                                    \
+    if (gains == NULL)                                                          \
+    {                                                                           \
+        const T *s0 = (const T *)src[0] + start;                                \
+        for (i = 0; i < n; i++)                                                 \
+            o[i] = s0[i];                                                       \
+        for (k = 1; k < nbChannel; k++)                                         \
+        {                                                                       \
+            const T *sk = (const T *)src[k] + start;                            \
+            for (i = 0; i < n; i++)                                             \
+                o[i] += sk[i];                                                  \
+        }                                                                       \
+    }                                                                           \
+    else                                                                        \
+    {                                                                           \
+        double acc[DAO_COMBINE_TILE];                                           \
+        for (i = 0; i < n; i++)                                                 \
+            acc[i] = 0;                                                         \
+        for (k = 0; k < nbChannel; k++)                                         \
+        {                                                                       \
+            const T *sk = (const T *)src[k] + start;                            \
+            double g = gains[k];                                                \
+            for (i = 0; i < n; i++)                                             \
+                acc[i] += g * sk[i];                                            \
+        }                                                                       \
+        for (i = 0; i < n; i++)                                                 \
+            o[i] = (T)acc[i];                                                   \
+    }                                                                           \
+}
+
+// Floating point tiles go through the SIMD kernels, complex values as interleaved re/im (W = 2)
+#define DAO_COMBINE_FP_TILE(NAME, T, KERNEL, W)                                 \
+static void NAME(void *out, void * const *src, const float *gains,              \
+                 int nbChannel, uint64_t start, uint32_t n)                     \
+{                                                                               \
+    int k;                                                                      \
+    for (k = 0; k < nbChannel; k++)                                             \
+    {                                                                           \
+        KERNEL((T *)out + start * W, (const T *)src[k] + start * W,             \
+               gains == NULL ? (T)1 : (T)gains[k], n * W, k == 0);              \
+    }                                                                           \
+}
+
+// 16-bit float tiles are widened, combined by the float kernel and rounded once
+#define DAO_COMBINE_HALF_TILE(NAME, TO_FLOAT, FROM_FLOAT)                       \
+static void NAME(void *out, void * const *src, const float *gains,              \
+                 int nbChannel, uint64_t start, uint32_t n)                     \
+{                                                                               \
+    float acc[DAO_COMBINE_TILE];                                                \
+    float in[DAO_COMBINE_TILE];                                                 \
+    int k;                                                                      \
+    for (k = 0; k < nbChannel; k++)                                             \
+    {                                                                           \
+        TO_FLOAT((const uint16_t *)src[k] + start, in, n);                      \
+        daoCombineF32(acc, in, gains == NULL ? 1.0f : gains[k], n, k == 0);     \
+    }                                                                           \
+    FROM_FLOAT(acc, (uint16_t *)out + start, n);                                \
+}
+
+DAO_COMBINE_INT_TILE(daoCombineTileU8, uint8_t)
+DAO_COMBINE_INT_TILE(daoCombineTileI8, int8_t)
+DAO_COMBINE_INT_TILE(daoCombineTileU16, uint16_t)
+DAO_COMBINE_INT_TILE(daoCombineTileI16, int16_t)
+DAO_COMBINE_INT_TILE(daoCombineTileU32, uint32_t)
+DAO_COMBINE_INT_TILE(daoCombineTileI32, int32_t)
+DAO_COMBINE_INT_TILE(daoCombineTileU64, uint64_t)
+DAO_COMBINE_INT_TILE(daoCombineTileI64, int64_t)
+DAO_COMBINE_FP_TILE(daoCombineTileF32, float, daoCombineF32, 1)
+DAO_COMBINE_FP_TILE(daoCombineTileF64, double, daoCombineF64, 1)
+DAO_COMBINE_FP_TILE(daoCombineTileC64, float, daoCombineF32, 2)
+DAO_COMBINE_FP_TILE(daoCombineTileC128, double, daoCombineF64, 2)
+
+DAO_COMBINE_HALF_TILE(daoCombineTileF16, daoConvertF16ToFloat, daoConvertFloatToF16)
+DAO_COMBINE_HALF_TILE(daoCombineTileBf16, daoConvertBf16ToFloat, daoConvertFloatToBf16)
+
+#undef DAO_COMBINE_INT_TILE
+#undef DAO_COMBINE_FP_TILE
+#undef DAO_COMBINE_HALF_TILE
+
+/*
+ * Data type registry, indexed by atype. A new type is one line here.
+ */
+static const DAO_TYPE_INFO daoTypeTable[DAO_NB_DATATYPE] =
+{
+    { 0,                        0,                      0, NULL,         NULL,               NULL,                  NULL },
+    { _DATATYPE_UINT8,          sizeof(uint8_t),        0, "uint8",      daoCombineTileU8,   NULL,                  NULL },
+    { _DATATYPE_INT8,           sizeof(int8_t),         0, "int8",       daoCombineTileI8,   NULL,                  NULL },
+    { _DATATYPE_UINT16,         sizeof(uint16_t),       0, "uint16",     daoCombineTileU16,  NULL,                  NULL },
+    { _DATATYPE_INT16,          sizeof(int16_t),        0, "int16",      daoCombineTileI16,  NULL,                  NULL },
+    { _DATATYPE_UINT32,         sizeof(uint32_t),       0, "uint32",     daoCombineTileU32,  NULL,                  NULL },
+    { _DATATYPE_INT32,          sizeof(int32_t),        0, "int32",      daoCombineTileI32,  NULL,                  NULL },
+    { _DATATYPE_UINT64,         sizeof(uint64_t),       0, "uint64",     daoCombineTileU64,  NULL,                  NULL },
+    { _DATATYPE_INT64,          sizeof(int64_t),        0, "int64",      daoCombineTileI64,  NULL,                  NULL },
+    { _DATATYPE_FLOAT,          sizeof(float),          0, "float32",    daoCombineTileF32,  daoConvertF32ToFloat,  daoConvertFloatToF32 },
+    { _DATATYPE_DOUBLE,         sizeof(double),         0, "float64",    daoCombineTileF64,  daoConvertF64ToFloat,  daoConvertFloatToF64 },
+    { _DATATYPE_COMPLEX_FLOAT,  sizeof(complex_float),  1, "complex64",  daoCombineTileC64,  NULL,                  NULL },
+    { _DATATYPE_COMPLEX_DOUBLE, sizeof(complex_double), 1, "complex128", daoCombineTileC128, NULL,                  NULL },
+    { _DATATYPE_FLOAT16,        sizeof(dao_float16),    0, "float16",    daoCombineTileF16,  daoConvertF16ToFloat,  daoConvertFloatToF16 },
+    { _DATATYPE_BFLOAT16,       sizeof(dao_bfloat16),   0, "bfloat16",   daoCombineTileBf16, daoConvertBf16ToFloat, daoConvertFloatToBf16 },
+};
+
+/**
+ * @brief Registry entry of a data type
+ * 
+ * @param atype _DATATYPE_ value
+ * @return const DAO_TYPE_INFO* NULL if the type is unknown
+ */
+const DAO_TYPE_INFO *daoShmTypeInfo(uint8_t atype)
+{
+    if (atype == 0 || atype >= DAO_NB_DATATYPE)
+    {
+        return NULL;
+    }
+    return &daoTypeTable[atype];
+}
+
+/**
+ * @brief Convert n elements of the given type to float
+ * 
+ * Used to read FLOAT16 and BFLOAT16 images, the conversion is vectorised when the CPU allows.
+ * 
+ * @param src elements of type atype
+ * @param atype _DATATYPE_FLOAT16, _DATATYPE_BFLOAT16, _DATATYPE_FLOAT or _DATATYPE_DOUBLE
+ * @param dst n floats
+ * @param n number of elements
+ * @return int_fast8_t DAO_ERROR if the type has no float conversion
+ */
+int_fast8_t daoShmConvertToFloat(const void *src, uint8_t atype, float *dst, uint64_t n)
+{
+    const DAO_TYPE_INFO *info = daoShmTypeInfo(atype);
+    if (info == NULL || info->toFloat == NULL)
+    {
+        daoError("no float conversion for data type %d\n", (int) atype);
+        return DAO_ERROR;
+    }
+    info->toFloat(src, dst, n);
+    return DAO_SUCCESS;
+}
 
+/**
+ * @brief Convert n floats to the given type, rounded to nearest even
+ * 
+ * @param src n floats
+ * @param dst elements of type atype
+ * @param atype _DATATYPE_FLOAT16, _DATATYPE_BFLOAT16, _DATATYPE_FLOAT or _DATATYPE_DOUBLE
+ * @param n number of elements
+ * @return int_fast8_t DAO_ERROR if the type has no float conversion
+ */
+int_fast8_t daoShmConvertFromFloat(const float *src, void *dst, uint8_t atype, uint64_t n)
+{
+    const DAO_TYPE_INFO *info = daoShmTypeInfo(atype);
+    if (info == NULL || info->fromFloat == NULL)
+    {
+        daoError("no float conversion for data type %d\n", (int) atype);
+        return DAO_ERROR;
+    }
+    info->fromFloat(src, dst, n);
+    return DAO_SUCCESS;
+}
 
-        image->shmfd = shmFd;
-        image->memsize = sharedsize;
+/**
+ * @brief Sum the newest segment of nbChannel images into the next segment of image
+ * 
+ * @param imageCube input images, of the same type as image
+ * @param image output image
+ * @param nbChannel number of input images (at most DAO_MAX_COMBINE_CHANNELS)
+ * @param nbVal number of elements to combine
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmCombineShm2Shm(IMAGE **imageCube, IMAGE *image, int nbChannel, int nbVal)
+{
+    daoTrace("\n");
+    return daoShmCombineShm2ShmGain(imageCube, image, nbChannel, nbVal, NULL);
+}
 
-        result = lseek(shmFd, sharedsize-1, SEEK_SET);
-        if (result == -1) 
-        {
-            close(shmFd);
-            daoError("Error calling lseek() to 'stretch' the file\n");
-            exit(0);
-        }
+/**
+ * @brief Weighted sum of the newest segment of nbChannel images into the next segment of image
+ * 
+ * @param imageCube input images, of the same type as image
+ * @param image output image
+ * @param nbChannel number of input images (at most DAO_MAX_COMBINE_CHANNELS)
+ * @param nbVal number of elements to combine
+ * @param gains one gain per channel, NULL for a plain sum
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmCombineShm2ShmGain(IMAGE **imageCube, IMAGE *image, int nbChannel, int nbVal,
+                                     const float *gains)
+{
+    daoTrace("\n");
+    void *src[DAO_MAX_COMBINE_CHANNELS];
+    void *out;
+    uint32_t writing_idx;
+    DAO_COMBINE_KERNEL kernel = image->type->combine;
+    int64_t nbTile;
+    int64_t t;
 
-        result = write(shmFd, "", 1);
-        if (result != 1) 
-        {
-            close(shmFd);
-            perror("Error writing last byte of the file");
-            exit(0);
-        }
+    // Fail if we are trying to combine too many channels
+    if (nbChannel > DAO_MAX_COMBINE_CHANNELS)
+    {
+        daoError("Attempted to combine more channels than is supported (%d > %d)\n",
+            nbChannel, DAO_MAX_COMBINE_CHANNELS);
+        return DAO_ERROR;
+    }
 
-        map = (IMAGE_METADATA*) mmap(0, sharedsize, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
-        if (map == MAP_FAILED) 
-        {
-            close(shmFd);
-            perror("Error mmapping the file");
-            exit(0);
-        }
-#endif
-	
-        image->md = (IMAGE_METADATA*) map;
-        image->md[0].fifo_size = fifo_size;
+    if (daoCombineF32 == NULL)
+    {
+        daoCombineSelectKernels();
+    }
 
-        for (uint32_t fifo_idx = 0; fifo_idx < fifo_size; ++fifo_idx)
-        {
-            image->md[fifo_idx].shared = 1;
-            image->md[fifo_idx].sem = 0;
-        }
+    // Get input image reading positions
+    for (int k = 0; k < nbChannel; ++k)
+    {
+        volatile IMAGE_METADATA *reading_md = (volatile IMAGE_METADATA *)imageCube[k]->md;
+        src[k] = daoShmSegmentPtr(imageCube[k], reading_md[0].fifo_last_written);
+    }
 
-        free(nameCopy);
+    daoShmAcquireWriteSlot(image, &out, &writing_idx);
 
-#ifdef _WIN32
-        daoDestroyWindowsSecurityAttrs(saFile, daclFile);
-#endif
+    if (nbChannel <= 0)
+    {
+        memset(out, 0, (size_t)nbVal * image->type->size);
+        return daoShmCommitWriteSlot(image, writing_idx);
     }
-    else
+
+    nbTile = ((int64_t)nbVal + DAO_COMBINE_TILE - 1) / DAO_COMBINE_TILE;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) if (nbVal >= DAO_COMBINE_OMP_MIN)
+#endif
+    for (t = 0; t < nbTile; t++)
     {
-        image->md = (IMAGE_METADATA*) malloc(sizeof(IMAGE_METADATA) * fifo_size);
-        image->md[0].fifo_size = fifo_size;
+        uint64_t start = (uint64_t)t * DAO_COMBINE_TILE;
+        uint32_t n = (uint32_t)((nbVal - start < DAO_COMBINE_TILE) ? nbVal - start : DAO_COMBINE_TILE);
+        kernel(out, src, gains, nbChannel, start, n);
+    }
 
-        for (uint32_t fifo_idx = 0; fifo_idx < fifo_size; ++fifo_idx)
-        {
-            image->md[fifo_idx].shared = 0;
-        }
+    return daoShmCommitWriteSlot(image, writing_idx);
+}
 
-        if(NBkw>0)
+/*
+ * Recompute the combiner sum from the last frames of all channels
+ */
+static void daoShmCombinerResync(DAO_COMBINER *comb)
+{
+    int k;
+    int i;
+
+    for (i = 0; i < comb->nbVal; i++)
+        comb->sum[i] = 0;
+
+    for (k = 0; k < comb->nbChannel; k++)
+    {
+        double g = comb->gains[k];
+        if (comb->image->md[0].atype == _DATATYPE_FLOAT)
         {
-            image->kw = (IMAGE_KEYWORD*) malloc(sizeof(IMAGE_KEYWORD)*NBkw);
+            const float *x = (const float *)comb->last[k];
+            for (i = 0; i < comb->nbVal; i++)
+                comb->sum[i] += g * x[i];
         }
         else
         {
-            image->kw = NULL;
+            const double *x = (const double *)comb->last[k];
+            for (i = 0; i < comb->nbVal; i++)
+                comb->sum[i] += g * x[i];
         }
     }
+    comb->sinceResync = 0;
+}
 
-    strcpy(image->name, name); // local name
-    for (uint32_t fifo_idx = 0; fifo_idx < fifo_size; ++fifo_idx)
-    {
-        image->md[fifo_idx].atype = atype;
-        image->md[fifo_idx].naxis = (uint8_t)naxis;
+/**
+ * @brief Set up an incremental combiner of nbChannel images into image
+ * 
+ * Unlike daoShmCombineShm2Shm, each update only costs the channels that changed.
+ * The newest frame of every channel is read once here.
+ * 
+ * @param comb combiner to initialise, release with daoShmCombinerFree
+ * @param imageCube input images, of the same type as image (FLOAT or DOUBLE)
+ * @param image output image
+ * @param nbChannel number of input images (at most DAO_MAX_COMBINE_CHANNELS)
+ * @param nbVal number of elements to combine, the first ones of every channel
+ * @param gains one gain per channel, NULL for a plain sum
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmCombinerInit(DAO_COMBINER *comb, IMAGE **imageCube, IMAGE *image, int nbChannel,
+                               int nbVal, const float *gains)
+{
+    daoTrace("\n");
+    uint8_t atype = image->md[0].atype;
+    size_t nbBytes = 0;
+    int k;
 
-        strcpy(image->md[fifo_idx].name, name);
+    memset(comb, 0, sizeof(DAO_COMBINER));
 
-        for(i=0; i<naxis; i++)
-        {
-            image->md[fifo_idx].size[i] = size[i];
-        }
-        image->md[fifo_idx].NBkw = NBkw;
+    if (atype != _DATATYPE_FLOAT && atype != _DATATYPE_DOUBLE)
+    {
+        daoError("Combiner only supports float and double images\n");
+        return DAO_ERROR;
     }
-
-
-    if(atype == _DATATYPE_UINT8)
+    if (nbChannel <= 0 || nbChannel > DAO_MAX_COMBINE_CHANNELS)
     {
-        if(shared==1)
-        {
-			mapv = (char*) map;
-            mapv += sizeof(IMAGE_METADATA) * fifo_size;
-            image->array.UI8 = (uint8_t*) (mapv);
-            memset(image->array.UI8, '\0', nelement*sizeof(uint8_t) * fifo_size);
-            mapv += sizeof(uint8_t)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
-		}
-        else
+        daoError("Invalid number of channels to combine (%d)\n", nbChannel);
+        return DAO_ERROR;
+    }
+    for (k = 0; k < nbChannel; k++)
+    {
+        if (imageCube[k]->md[0].atype != atype || imageCube[k]->md[0].nelement < (uint64_t)nbVal)
         {
-            image->array.UI8 = (uint8_t*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(uint8_t));
+            daoError("Channel %d does not match the output image\n", k);
+            return DAO_ERROR;
         }
-
-
-        if(image->array.UI8 == NULL)
+        // the frames are copied whole, the buffers hold the largest channel
+        if (imageCube[k]->md[0].nelement * daoShmElementSize(atype) > nbBytes)
         {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-                fprintf(stderr,"x%ld", (long) size[i]);
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(uint8_t));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
+            nbBytes = imageCube[k]->md[0].nelement * daoShmElementSize(atype);
         }
     }
 
-    if(atype == _DATATYPE_INT8)
+    comb->image = image;
+    comb->nbChannel = nbChannel;
+    comb->nbVal = nbVal;
+    comb->resyncPeriod = DAO_COMBINER_RESYNC;
+    comb->imageCube = (IMAGE **)malloc(nbChannel * sizeof(IMAGE *));
+    comb->gains = (float *)malloc(nbChannel * sizeof(float));
+    comb->lastCnt0 = (uint64_t *)malloc(nbChannel * sizeof(uint64_t));
+    comb->last = (void **)calloc(nbChannel, sizeof(void *));
+    comb->scratch = malloc(nbBytes);
+    comb->sum = (double *)malloc(nbVal * sizeof(double));
+    if (comb->imageCube == NULL || comb->gains == NULL || comb->lastCnt0 == NULL ||
+        comb->last == NULL || comb->scratch == NULL || comb->sum == NULL)
     {
-        if(shared==1)
-        {
-			mapv = (char*) map;
-            mapv += sizeof(IMAGE_METADATA) * fifo_size;
-            image->array.SI8 = (int8_t*) (mapv);
-            memset(image->array.SI8, '\0', nelement*sizeof(int8_t) * fifo_size);
-            mapv += sizeof(int8_t)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
-		}
-        else
-            image->array.SI8 = (int8_t*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(int8_t));
-
-
-        if(image->array.SI8 == NULL)
-        {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-                fprintf(stderr,"x%ld", (long) size[i]);
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(int8_t));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
-        }
+        daoError("Could not allocate combiner\n");
+        daoShmCombinerFree(comb);
+        return DAO_ERROR;
     }
 
-
-
-    if(atype == _DATATYPE_UINT16)
+    for (k = 0; k < nbChannel; k++)
     {
-        if(shared==1)
+        comb->imageCube[k] = imageCube[k];
+        comb->gains[k] = (gains == NULL) ? 1.0f : gains[k];
+        comb->last[k] = malloc(nbBytes);
+        if (comb->last[k] == NULL)
         {
-            mapv = (char*) map;
-            mapv += sizeof(IMAGE_METADATA) * fifo_size;
-            image->array.UI16 = (uint16_t*) (mapv);
-            memset(image->array.UI16, '\0', nelement*sizeof(uint16_t) * fifo_size);
-            mapv += sizeof(uint16_t)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
+            daoError("Could not allocate combiner\n");
+            daoShmCombinerFree(comb);
+            return DAO_ERROR;
         }
-        else
+        if (daoShmReadConsistent(imageCube[k], comb->last[k], NULL, &comb->lastCnt0[k], 0) != DAO_SUCCESS)
         {
-            image->array.UI16 = (uint16_t*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(uint16_t));
+            // no reference yet: the channel counts as zero until its next frame
+            memset(comb->last[k], 0, nbBytes);
+            comb->lastCnt0[k] = 0;
         }
+    }
+    daoShmCombinerResync(comb);
+
+    return DAO_SUCCESS;
+}
+
+/**
+ * @brief Apply the channels whose cnt0 advanced and write the sum to the next output segment
+ * 
+ * @param comb 
+ * @return int_fast8_t DAO_SUCCESS, or DAO_NOTREADY (nothing written) if no channel or gain changed
+ */
+int_fast8_t daoShmCombinerUpdate(DAO_COMBINER *comb)
+{
+    daoTrace("\n");
+    uint8_t atype = comb->image->md[0].atype;
+    int nbChanged = 0;
+    void *out;
+    uint32_t writing_idx;
+    int k;
+    int i;
 
-        if(image->array.UI16 == NULL)
+    for (k = 0; k < comb->nbChannel; k++)
+    {
+        uint64_t cnt0 = daoShmNewestCnt0(comb->imageCube[k]);
+        double g = comb->gains[k];
+        void *tmp;
+
+        if (cnt0 == comb->lastCnt0[k])
+            continue;
+
+        if (daoShmReadConsistent(comb->imageCube[k], comb->scratch, NULL, &cnt0, 0) != DAO_SUCCESS)
         {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-                fprintf(stderr,"x%ld", (long) size[i]);
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(uint16_t));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
+            // the reference is kept, the channel is read again at the next update
+            continue;
         }
-    }
 
-    if(atype == _DATATYPE_INT16)
-    {
-        if(shared==1)
+        if (atype == _DATATYPE_FLOAT)
         {
-            mapv = (char*) map;
-            mapv += sizeof(IMAGE_METADATA) * fifo_size;
-            image->array.SI16 = (int16_t*) (mapv);
-            memset(image->array.SI16, '\0', nelement*sizeof(int16_t) * fifo_size);
-            mapv += sizeof(int16_t)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
+            const float *x = (const float *)comb->scratch;
+            const float *x0 = (const float *)comb->last[k];
+            for (i = 0; i < comb->nbVal; i++)
+                comb->sum[i] += g * ((double)x[i] - x0[i]);
         }
         else
         {
-            image->array.SI16 = (int16_t*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(int16_t));
+            const double *x = (const double *)comb->scratch;
+            const double *x0 = (const double *)comb->last[k];
+            for (i = 0; i < comb->nbVal; i++)
+                comb->sum[i] += g * (x[i] - x0[i]);
         }
 
-        if(image->array.SI16 == NULL)
-        {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-            {
-                fprintf(stderr,"x%ld", (long) size[i]);
-            }
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(int16_t));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
-        }
+        // the new frame becomes the reference of this channel
+        tmp = comb->last[k];
+        comb->last[k] = comb->scratch;
+        comb->scratch = tmp;
+        comb->lastCnt0[k] = cnt0;
+        nbChanged++;
     }
 
+    if (nbChanged == 0 && !comb->dirty)
+    {
+        return DAO_NOTREADY;
+    }
 
-    if(atype == _DATATYPE_UINT32)
+    comb->dirty = 0;
+    comb->nbChannelUpdates += nbChanged;
+    if (++comb->sinceResync >= comb->resyncPeriod)
     {
-        if(shared==1)
-        {
-			mapv = (char*) map;
-            mapv += sizeof(IMAGE_METADATA) * fifo_size;
-            image->array.UI32 = (uint32_t*) (mapv);
-            memset(image->array.UI32, '\0', nelement*sizeof(uint32_t) * fifo_size);
-            mapv += sizeof(uint32_t)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
-        }
-        else
-        {
-            image->array.UI32 = (uint32_t*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(uint32_t));
-        }
+        daoShmCombinerResync(comb);
+    }
 
-        if(image->array.UI32 == NULL)
-        {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-            {
-                fprintf(stderr,"x%ld", (long) size[i]);
-            }
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(uint32_t));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
-        }
+    if (daoShmAcquireWriteSlot(comb->image, &out, &writing_idx) != DAO_SUCCESS)
+    {
+        return DAO_ERROR;
     }
-    
+    if (atype == _DATATYPE_FLOAT)
+    {
+        float *o = (float *)out;
+        for (i = 0; i < comb->nbVal; i++)
+            o[i] = (float)comb->sum[i];
+    }
+    else
+    {
+        memcpy(out, comb->sum, comb->nbVal * sizeof(double));
+    }
+    comb->nbUpdates++;
 
+    return daoShmCommitWriteSlot(comb->image, writing_idx);
+}
 
-    if(atype == _DATATYPE_INT32)
+/**
+ * @brief Change the gain of one channel of the combiner, applied at the next update
+ * 
+ * @param comb 
+ * @param channel 
+ * @param gain 
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmCombinerSetGain(DAO_COMBINER *comb, int channel, float gain)
+{
+    daoTrace("\n");
+    if (channel < 0 || channel >= comb->nbChannel)
     {
-        if(shared==1)
-        {
-			mapv = (char*) map;
-            mapv += sizeof(IMAGE_METADATA) * fifo_size;
-            image->array.SI32 = (int32_t*) (mapv);
-            memset(image->array.SI32, '\0', nelement*sizeof(int32_t) * fifo_size);
-            mapv += sizeof(int32_t)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
-        }
-        else
-        {
-            image->array.SI32 = (int32_t*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(int32_t));
-        }
+        daoError("Invalid combiner channel %d\n", channel);
+        return DAO_ERROR;
+    }
+    comb->gains[channel] = gain;
+    daoShmCombinerResync(comb);
+    // publish the new sum at the next update even if no channel changed
+    comb->dirty = 1;
+    return DAO_SUCCESS;
+}
 
-        if(image->array.SI32 == NULL)
-        {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-            {
-                fprintf(stderr,"x%ld", (long) size[i]);
-            }
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(int32_t));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
-        }
+/**
+ * @brief Release the memory held by a combiner
+ * 
+ * @param comb 
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmCombinerFree(DAO_COMBINER *comb)
+{
+    daoTrace("\n");
+    int k;
+
+    if (comb->last != NULL)
+    {
+        for (k = 0; k < comb->nbChannel; k++)
+            free(comb->last[k]);
     }
-    
-    
-    
-    if(atype == _DATATYPE_UINT64)
+    free(comb->last);
+    free(comb->imageCube);
+    free(comb->gains);
+    free(comb->lastCnt0);
+    free(comb->scratch);
+    free(comb->sum);
+    memset(comb, 0, sizeof(DAO_COMBINER));
+    return DAO_SUCCESS;
+}
+
+/* Function for compatibility - creates 1-deep DAO SHM */
+int_fast8_t daoShmImageCreate(IMAGE *image, const char *name, long naxis, 
+                              uint32_t *size, uint8_t atype, int shared, int NBkw)
+{
+    return daoShmImageCreate_FIFO(image, name, naxis, size, atype, shared, NBkw, 1);
+}
+
+/**
+ * @brief Bind the pages of a shared memory to a NUMA node
+ * 
+ * Pages already faulted by this process are migrated, pages faulted later by any
+ * process are allocated on the node. The node is recorded in md[0].numaNode so
+ * that daoShmShm2Img applies the same binding. Linux only.
+ * 
+ * @param image shared memory
+ * @param node NUMA node, -1 to remove the binding
+ * @return int_fast8_t DAO_SUCCESS or DAO_ERROR
+ */
+int_fast8_t daoShmSetNumaNode(IMAGE *image, int node)
+{
+    daoTrace("\n");
+#ifdef _WIN32
+    (void)image;
+    (void)node;
+    daoWarning("NUMA binding is only supported on Linux\n");
+    return DAO_ERROR;
+#else
+    if (image->md[0].shared != 1 || image->memsize <= 0)
     {
-        if(shared==1)
-        {
-			mapv = (char*) map;
-            mapv += sizeof(IMAGE_METADATA) * fifo_size;
-            image->array.UI64 = (uint64_t*) (mapv);
-            memset(image->array.UI64, '\0', nelement*sizeof(uint64_t) * fifo_size);
-            mapv += sizeof(uint64_t)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
-        }
-        else
-        {
-            image->array.UI64 = (uint64_t*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(uint64_t));
-        }
+        daoError("%s is not a shared memory\n", image->name);
+        return DAO_ERROR;
+    }
+    if (daoShmBindNode(image->md, (size_t)image->memsize, node) != DAO_SUCCESS)
+    {
+        return DAO_ERROR;
+    }
+    if (node >= 0)
+    {
+        image->md[0].numaNode = (int16_t)node;
+        image->md[0].allocFlags |= DAO_SHM_NUMA;
+    }
+    else
+    {
+        image->md[0].numaNode = -1;
+        image->md[0].allocFlags &= ~DAO_SHM_NUMA;
+    }
+    return DAO_SUCCESS;
+#endif
+}
 
-        if(image->array.SI64 == NULL)
-        {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-            {
-                fprintf(stderr,"x%ld", (long) size[i]);
-            }
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(uint64_t));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
-        }
+/**
+ * @brief Report the NUMA node holding the pages of a shared memory
+ * 
+ * Up to 4096 pages spread over the mapping are queried with move_pages. Pages
+ * not faulted yet are ignored.
+ * 
+ * @param image shared memory
+ * @param node node holding most of the pages, -1 if no page is resident
+ * @param fraction fraction of the resident pages on that node, may be NULL
+ * @return int_fast8_t DAO_SUCCESS, DAO_NOTREADY if no page is resident, DAO_ERROR
+ */
+int_fast8_t daoShmGetNumaNode(IMAGE *image, int *node, float *fraction)
+{
+    daoTrace("\n");
+    *node = -1;
+    if (fraction != NULL)
+    {
+        *fraction = 0.0f;
     }
-    
-    if(atype == _DATATYPE_INT64)
+#if defined(__linux__)
+    const size_t maxPages = 4096;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t nbPages;
+    size_t step;
+    size_t i;
+    int nbNodes;
+    void **pages;
+    int *status;
+    uint32_t *counts;
+    uint32_t nbResident = 0;
+    int n;
+
+    if (image->md[0].shared != 1 || image->memsize <= 0)
     {
-        if(shared==1)
-        {
-			mapv = (char*) map;
-            mapv += sizeof(IMAGE_METADATA) * fifo_size;
-            image->array.SI64 = (int64_t*) (mapv);
-            memset(image->array.SI64, '\0', nelement*sizeof(int64_t) * fifo_size);
-            mapv += sizeof(int64_t)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
-        }
-        else
-        {
-            image->array.SI64 = (int64_t*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(int64_t));
-        }
-
-        if(image->array.SI64 == NULL)
-        {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-            {
-                fprintf(stderr,"x%ld", (long) size[i]);
-            }
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(int64_t));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
-        }
+        daoError("%s is not a shared memory\n", image->name);
+        return DAO_ERROR;
+    }
+    if (numa_available() < 0)
+    {
+        daoWarning("NUMA is not available on this system\n");
+        return DAO_ERROR;
     }
 
+    nbPages = ((size_t)image->memsize + page - 1) / page;
+    step = (nbPages + maxPages - 1) / maxPages;
+    nbPages = (nbPages + step - 1) / step;
+    nbNodes = numa_max_node() + 1;
 
-    if(atype == _DATATYPE_FLOAT)	
+    pages = (void **)malloc(nbPages * sizeof(void *));
+    status = (int *)malloc(nbPages * sizeof(int));
+    counts = (uint32_t *)calloc((size_t)nbNodes, sizeof(uint32_t));
+    for (i = 0; i < nbPages; i++)
     {
-        if(shared==1)
-        {
-            mapv = (char*) map;
-            mapv += sizeof(IMAGE_METADATA) * fifo_size;
-            image->array.F = (float*) (mapv);
-            memset(image->array.F, '\0', nelement*sizeof(float) * fifo_size);
-            mapv += sizeof(float)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
-        }
-        else
-        {
-            image->array.F = (float*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(float));
-        }
+        pages[i] = (char *)image->md + i * step * page;
+    }
 
-        if(image->array.F == NULL)
-        {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-            {
-                fprintf(stderr,"x%ld", (long) size[i]);
-            }
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(float));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
-        }
+    if (move_pages(0, (unsigned long)nbPages, pages, NULL, status, 0) != 0)
+    {
+        daoError("move_pages failed: %s\n", strerror(errno));
+        free(pages);
+        free(status);
+        free(counts);
+        return DAO_ERROR;
     }
-    
-    if(atype == _DATATYPE_DOUBLE)
+    for (i = 0; i < nbPages; i++)
     {
-        if(shared==1)
-        {
-			mapv = (char*) map;
-			mapv += sizeof(IMAGE_METADATA) * fifo_size;
-			image->array.D = (double*) (mapv);
-            memset(image->array.D, '\0', nelement*sizeof(double) * fifo_size);
-            mapv += sizeof(double)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
-        }
-        else
+        // negative status: page not present (-ENOENT) or not queryable
+        if (status[i] >= 0 && status[i] < nbNodes)
         {
-            image->array.D = (double*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(double));
+            counts[status[i]]++;
+            nbResident++;
         }
-  
-        if(image->array.D == NULL)
+    }
+    for (n = 0; n < nbNodes; n++)
+    {
+        if (counts[n] > 0 && (*node < 0 || counts[n] > counts[*node]))
         {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-            {
-                fprintf(stderr,"x%ld", (long) size[i]);
-            }
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(double));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
+            *node = n;
         }
     }
-    
-    if(atype == _DATATYPE_COMPLEX_FLOAT)
+    if (fraction != NULL && *node >= 0)
     {
-        if(shared==1)
-        {
-			mapv = (char*) map;
-			mapv += sizeof(IMAGE_METADATA) * fifo_size;
-			image->array.CF = (complex_float*) (mapv);			
-            memset(image->array.CF, '\0', nelement*sizeof(complex_float) * fifo_size);
-            mapv += sizeof(complex_float)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
+        *fraction = (float)counts[*node] / (float)nbResident;
+    }
+
+    free(pages);
+    free(status);
+    free(counts);
+    return (*node >= 0) ? DAO_SUCCESS : DAO_NOTREADY;
+#else
+    (void)image;
+    daoWarning("NUMA placement is only reported on Linux\n");
+    return DAO_ERROR;
+#endif
+}
+
+/**
+ * @brief Wait for new data in SHM
+ * 
+ * @param image 
+ * @return uint_fast64_t 
+ */
+int_fast8_t daoShmWaitForSemaphore(IMAGE *image, int32_t semNb)
+{
+    daoTrace("\n");
+    // Wait for new image
+#ifdef _WIN32
+    // On Windows we use a single short-timeout wait and return DAO_TIMEOUT so
+    // that the *Python* caller can loop. If the loop were here in C, Python
+    // would never get control back between iterations and KeyboardInterrupt
+    // (Ctrl+C) could never fire.
+    //
+    // If the handle is NULL or invalid (writer hasn't started yet, or the
+    // writer exited and its semaphore was destroyed), try to reopen it by
+    // name before waiting. Named semaphores in the Local\ namespace are
+    // destroyed when the last handle is closed, so the reader must reopen
+    // them each time the writer restarts.
+    if (!image->semptr || !image->semptr[semNb]) {
+        // Build the semaphore name from the image name, same scheme as
+        // daoImageCreateSem / daoShmShm2Img.
+        char semName[256];
+        WCHAR wSemName[256];
+        char nameCopy[256];
+        strncpy(nameCopy, image->md[0].name, sizeof(nameCopy)-1);
+        nameCopy[sizeof(nameCopy)-1] = '\0';
+        char *tok = strtok(nameCopy, PATH_SEPARATOR);
+        char *last = NULL;
+        while (tok) { last = tok; tok = strtok(NULL, PATH_SEPARATOR); }
+        if (last) {
+            char *localName = strtok(last, ".");
+            if (localName) {
+                sprintf(semName, "Local\\DAO_%s_sem%02d", localName, (int)semNb);
+                MultiByteToWideChar(CP_UTF8, 0, semName, -1, wSemName, 256);
+                HANDLE h = OpenSemaphoreW(SEMAPHORE_ALL_ACCESS, FALSE, wSemName);
+                if (h && image->semptr) {
+                    image->semptr[semNb] = h;
+                }
+            }
         }
-        else
-        {
-            image->array.CF = (complex_float*) calloc ((size_t) nelement * (size_t) fifo_size, sizeof(complex_float));
+        // Still no handle — writer not running yet, report timeout so caller loops
+        if (!image->semptr || !image->semptr[semNb]) {
+            return DAO_TIMEOUT;
         }
+    }
 
-        if(image->array.CF == NULL)
-        {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
-            {
-                fprintf(stderr,"x%ld", (long) size[i]);
-            }
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(complex_float));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
+    DWORD dWaitResult = WaitForSingleObject(image->semptr[semNb], 100);
+    if (dWaitResult == WAIT_OBJECT_0) {
+        return DAO_SUCCESS;
+    } else if (dWaitResult == WAIT_TIMEOUT) {
+        return DAO_TIMEOUT;
+    } else {
+        DWORD err = GetLastError();
+        if (err == ERROR_INVALID_HANDLE) {
+            // The writer exited and its semaphore was destroyed.
+            // Invalidate the handle so the next call will reopen it.
+            CloseHandle(image->semptr[semNb]);
+            image->semptr[semNb] = NULL;
+            return DAO_TIMEOUT;
         }
+        daoError("Unexpected result from WaitForSingleObject (Windows system error no. %d).\n", err);
+        return DAO_ERROR;
     }
-    
-    if(atype == _DATATYPE_COMPLEX_DOUBLE)
+#elif defined(__APPLE__)
+    if (sem_wait(image->semptr[semNb]) == 0) 
     {
-        if(shared==1)
-        {
-			mapv = (char*) map;
-			mapv += sizeof(IMAGE_METADATA) * fifo_size;
-			image->array.CD = (complex_double*) (mapv);			
-            memset(image->array.CD, '\0', nelement*sizeof(complex_double) * fifo_size);
-            mapv += sizeof(complex_double)*nelement * fifo_size;
-            image->kw = (IMAGE_KEYWORD*) (mapv);
-        }
-        else
+        // Safely decrement the counter, but only if > 0
+        unsigned int val = atomic_load(&image->md[0].semCounter[semNb]);
+        while (val > 0)
         {
-            image->array.CD = (complex_double*) calloc ((size_t) nelement * (size_t) fifo_size,sizeof(complex_double));
+            if (atomic_compare_exchange_weak(&image->md[0].semCounter[semNb], &val, val - 1))
+                break;
+            // If CAS fails, val is updated, loop again
         }
+    } 
+    else
+    {
+        daoError("sem_wait failed on sem %d: %s\n", semNb, strerror(errno));
+        return DAO_ERROR;
+    }
+#else
+    sem_wait(image->semptr[semNb]);
+#endif
+
+    return DAO_SUCCESS;
+}
+
+/**
+ * @brief Wait for new data in SHM with time out
+ * 
+ * @param image 
+ * @return uint_fast64_t 
+ * @timeout timespec
+ */
+int_fast8_t daoShmWaitForSemaphoreTimeout(IMAGE *image, int32_t semNb, const struct timespec * timeout)
+{
+    daoTrace("\n");
+    // Wait for new image
+#ifdef _WIN32
+    // Convert absolute timespec to milliseconds from now
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    DWORD millis =
+        (timeout->tv_sec - now.tv_sec) * 1000 +
+        (timeout->tv_nsec - now.tv_nsec) / 1000000;
 
-        if(image->array.CD == NULL)
+    if ((int)millis < 0) millis = 0; // prevent underflow
+
+	DWORD dWaitResult = WaitForSingleObject(image->semptr[semNb], millis);
+	switch (dWaitResult) {
+		case WAIT_OBJECT_0:
+			break;
+        case WAIT_TIMEOUT:
+            return DAO_TIMEOUT;
+		default:
+			daoError("Unexpected result from WaitForSingleObject (Windows system error no. %d).\n", GetLastError());
+			return DAO_ERROR;
+	}
+#elif defined(__APPLE__)
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    uint64_t now_ns = (uint64_t)now.tv_sec * 1e9 + now.tv_nsec;
+    uint64_t end_ns = (uint64_t)timeout->tv_sec * 1e9 + timeout->tv_nsec;
+
+    while (now_ns < end_ns)
+    {
+        unsigned int val = atomic_load(&image->md[0].semCounter[semNb]);
+        if (val > 0)
         {
-            daoError("memory allocation failed\n");
-            fprintf(stderr,"%c[%d;%dm", (char) 27, 1, 31);
-            fprintf(stderr,"Image name = %s\n",name);
-            fprintf(stderr,"Image size = ");
-            fprintf(stderr,"%ld", (long) size[0]);
-            for(i=1; i<naxis; i++)
+            if (sem_wait(image->semptr[semNb]) == 0)
             {
-                fprintf(stderr,"x%ld", (long) size[i]);
+                atomic_fetch_sub(&image->md[0].semCounter[semNb], 1);
+                return DAO_SUCCESS;
+            }
+            else
+            {
+                daoError("sem_wait failed: %s\n", strerror(errno));
+                return DAO_ERROR;
             }
-            fprintf(stderr,"\n");
-            fprintf(stderr,"Requested memory size = %ld elements * %ld buffers = %f Mb\n",
-                (long) nelement, (long) fifo_size, 1.0/1024/1024*nelement*fifo_size*sizeof(complex_double));
-            fprintf(stderr," %c[%d;m",(char) 27, 0);
-            exit(0);
         }
-    }
 
-    clock_gettime(CLOCK_REALTIME, &timenow);
+        // Sleep briefly (e.g., 100 µs)
+        struct timespec sleep_ts = {.tv_sec = 0, .tv_nsec = 100000};
+        nanosleep(&sleep_ts, NULL);
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        now_ns = (uint64_t)now.tv_sec * 1e9 + now.tv_nsec;
+    }
 
-    for (uint32_t fifo_idx = 0; fifo_idx < fifo_size; ++fifo_idx)
+    return DAO_TIMEOUT;
+#else
+    if (sem_timedwait(image->semptr[semNb], timeout) == -1)
     {
-        image->md[fifo_idx].last_access = 1.0*timenow.tv_sec + 0.000000001*timenow.tv_nsec;
-        image->md[fifo_idx].creation_time = image->md[0].last_access;
-        image->md[fifo_idx].write = 0;
-        image->md[fifo_idx].cnt0 = 0;
-        image->md[fifo_idx].cnt1 = 0;
-        image->md[fifo_idx].nelement = nelement;
+        return DAO_TIMEOUT;
     }
+#endif
 
-    if(shared==1)
+    return DAO_SUCCESS;
+}
+
+#if defined(__linux__)
+/*
+ * Raw futex syscall, glibc does not provide a wrapper.
+ * The SHM is mapped MAP_SHARED across processes, so FUTEX_PRIVATE_FLAG must not be used.
+ */
+static long daoFutex(volatile uint32_t *uaddr, int op, uint32_t val, const struct timespec *timeout, uint32_t val3)
+{
+    return syscall(SYS_futex, uaddr, op, val, timeout, NULL, val3);
+}
+#endif
+
+/**
+ * @brief Wait for new data in SHM by blocking on the futex sequence word
+ * 
+ * Any number of readers can block on the same word, unlike the IMAGE_NB_SEMAPHORE named semaphores.
+ * As with the semaphores, a post made while nobody waits is remembered (at most one).
+ * 
+ * @param image 
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmWaitForFutex(IMAGE *image)
+{
+    daoTrace("\n");
+    return daoShmWaitForFutexTimeout(image, NULL);
+}
+
+/**
+ * @brief Wait for new data in SHM by blocking on the futex sequence word, with time out
+ * 
+ * @param image 
+ * @param timeout absolute CLOCK_REALTIME time out (as for sem_timedwait), NULL to wait forever
+ * @return int_fast8_t DAO_SUCCESS, or DAO_TIMEOUT
+ */
+int_fast8_t daoShmWaitForFutexTimeout(IMAGE *image, const struct timespec *timeout)
+{
+    daoTrace("\n");
+    volatile IMAGE_METADATA *md = (volatile IMAGE_METADATA *)image->md;
+    uint32_t seq = md[0].futexSeq;
+
+    while (seq == image->futex_last_seq)
     {
-        daoInfo("Creating Semaphores\n");
-        daoImageCreateSem(image, 10); // by default, create 10 semaphores
-        daoInfo("Semaphores created\n");
+#if defined(__linux__)
+        long rc = 0;
+        int err = 0;
 
-#ifdef __APPLE__
-        for (int i = 0; i < image->md[0].sem; i++)
+        // Register as a waiter before re-checking, so that the writer either sees us or we see its post
+        __atomic_add_fetch(&image->md[0].futexWaiters, 1, __ATOMIC_SEQ_CST);
+        seq = __atomic_load_n(&image->md[0].futexSeq, __ATOMIC_SEQ_CST);
+        if (seq == image->futex_last_seq)
         {
-            while (sem_trywait(image->semptr[i]) == 0) 
+            rc = daoFutex(&md[0].futexSeq, FUTEX_WAIT_BITSET | FUTEX_CLOCK_REALTIME, seq, timeout, FUTEX_BITSET_MATCH_ANY);
+            err = errno;
+        }
+        __atomic_sub_fetch(&image->md[0].futexWaiters, 1, __ATOMIC_SEQ_CST);
+
+        if (rc == -1 && err == ETIMEDOUT)
+        {
+            return DAO_TIMEOUT;
+        }
+        // EAGAIN (word already changed) and EINTR simply re-check
+#else
+        // No futex outside Linux: poll the sequence word
+        if (timeout != NULL)
+        {
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            if (now.tv_sec > timeout->tv_sec ||
+                (now.tv_sec == timeout->tv_sec && now.tv_nsec >= timeout->tv_nsec))
             {
-                // Draining kernel-level semaphore
+                return DAO_TIMEOUT;
             }
-            atomic_store(&image->md[0].semCounter[i], 0);
         }
-        atomic_store(&image->md[0].semLogCounter, 0);
+    #ifdef _WIN32
+        Sleep(0);
+    #else
+        sched_yield();
+    #endif
 #endif
+        seq = md[0].futexSeq;
     }
-    else
-    {
-		image->md[0].sem = 0; // no semaphores
-    }
-
-    // set fifo last written position
-    image->md[0].fifo_size = fifo_size;
-    image->md[0].fifo_last_written = fifo_size - 1;
-
-    // set up FIFO tail
 
-    uint32_t tmp32;
-    uint64_t tmp64;
-    daoShmResetTail(image, &tmp32, &tmp64);
+    image->futex_last_seq = seq;
 
-    // initialize keywords
-    for(kw=0; kw<image->md[0].NBkw; kw++)
-    {
-        image->kw[kw].type = 'N';
-    }
-    return(0);
+    return DAO_SUCCESS;
 }
 
-int_fast8_t daoShmCombineShm2Shm(IMAGE **imageCube, IMAGE *image, int nbChannel, int nbVal)
+/**
+ * @brief Select which wake-up mechanisms the writer posts on every frame
+ * 
+ * Dropping DAO_SYNC_SEM removes the per-reader semaphore fan-out when all readers use the futex.
+ * 
+ * @param image 
+ * @param flags combination of DAO_SYNC_SEM and DAO_SYNC_FUTEX
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmSetSyncFlags(IMAGE *image, uint8_t flags)
 {
     daoTrace("\n");
-    int pp;
-    int k;
-    uint64_t fifo_reading_offset[DAO_MAX_COMBINE_CHANNELS];
-
-    // Get output image writing position
-    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
-
-    uint32_t last_written = vol_md[0].fifo_last_written;
-    uint32_t writing_idx = (last_written + 1) % (image->md[0].fifo_size);
+    image->md[0].syncFlags = flags;
+    return DAO_SUCCESS;
+}
 
-    uint64_t fifo_writing_offset = image->md[0].nelement * (uint64_t)writing_idx;
+static uint64_t daoWaitNow()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
 
-    vol_md[writing_idx].write = 1;
+// Wait conditions of the counter waits
+#define DAO_WAIT_CNT0_ABOVE     0   // md[0].cnt0 > value (1-deep images)
+#define DAO_WAIT_FIFO_MOVED     1   // md[0].fifo_last_written != value
+#define DAO_WAIT_CNT0_REACHED   2   // cnt0 of the newest segment >= value
 
-    // Fail if we are trying to combine too many channels
-    if (nbChannel > DAO_MAX_COMBINE_CHANNELS)
+static inline int daoWaitDone(volatile IMAGE_METADATA *md, int cond, uint64_t value)
+{
+    switch (cond)
     {
-        daoError("Attempted to combine more channels than is supported (%d > %d)\n",
-            nbChannel, DAO_MAX_COMBINE_CHANNELS);
-        return DAO_ERROR;
+        case DAO_WAIT_CNT0_ABOVE:
+            return md[0].cnt0 > value;
+        case DAO_WAIT_FIFO_MOVED:
+            return md[0].fifo_last_written != (uint32_t)value;
+        default:
+            if (md[0].fifo_size == 1 || (md[0].allocFlags & DAO_SHM_COMPACT_MD))
+                return md[0].cnt0 >= value;
+            return md[md[0].fifo_last_written].cnt0 >= value;
     }
+}
 
-    // Get input image reading positions
-    for (int k = 0; k < nbChannel; ++k)
+/*
+ * Common body of daoShmWaitForCounter and daoShmWaitForTargetCounter.
+ * Runs the busy-spin, backoff and block phases of image->wait_policy and accounts
+ * the time spent in each of them in image->wait_stats.
+ */
+static int_fast8_t daoShmWaitPolicy(IMAGE *image, int cond, uint64_t value)
+{
+    volatile IMAGE_METADATA *md = (volatile IMAGE_METADATA *)image->md;
+    DAO_WAIT_POLICY *policy = &image->wait_policy;
+    DAO_WAIT_STATS *stats = &image->wait_stats;
+    uint64_t t0 = daoWaitNow();
+    uint64_t tSpin = t0;
+    uint64_t tBackoff = t0;
+    uint64_t now = t0;
+    uint64_t *wakes = &stats->nBlockWakes;
+    int_fast8_t rval = DAO_SUCCESS;
+
+    // busy-spin
+    if (policy->spinNs > 0)
     {
-        volatile IMAGE_METADATA *reading_md = (volatile IMAGE_METADATA *)imageCube[k]->md;
-
-        uint32_t last_written = reading_md[0].fifo_last_written;
-        fifo_reading_offset[k] = imageCube[k]->md[0].nelement * (uint64_t)last_written;
+        while (!daoWaitDone(md, cond, value) && (now = daoWaitNow()) - t0 < policy->spinNs)
+        {
+            daoCpuRelax();
+        }
     }
-    
-    // check type and use proper array
-    if (image->md[0].atype == _DATATYPE_UINT8)
+    tSpin = tBackoff = now;
+    if (daoWaitDone(md, cond, value))
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.UI8[fifo_writing_offset + pp] = 0;
-            for(k=0;k<nbChannel;k++) 
-            {
-                image[0].array.UI8[fifo_writing_offset + pp]
-                    += imageCube[k][0].array.UI8[fifo_reading_offset[k] + pp];
-            }
-        }
+        wakes = &stats->nSpinWakes;
+        goto done;
     }
-    else if (image->md[0].atype == _DATATYPE_INT8)
+
+    // spin with backoff, doubling the pauses up to 1024 per check
+    if (policy->backoffNs > 0)
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.SI8[fifo_writing_offset + pp] = 0;
-            for(k=0;k<nbChannel;k++) 
+        uint32_t nPause = 1;
+        uint32_t k;
+        while (!daoWaitDone(md, cond, value) && (now = daoWaitNow()) - tSpin < policy->backoffNs)
+        {
+            for (k = 0; k < nPause; k++)
             {
-                image[0].array.SI8[fifo_writing_offset + pp]
-                    += imageCube[k][0].array.SI8[fifo_reading_offset[k] + pp];
+                daoCpuRelax();
             }
-        }
-    }
-    else if (image->md[0].atype == _DATATYPE_UINT16)
-    {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.UI16[fifo_writing_offset + pp] = 0;
-            for(k=0;k<nbChannel;k++) 
+            if (nPause < 1024)
             {
-                image[0].array.UI16[fifo_writing_offset + pp]
-                    += imageCube[k][0].array.UI16[fifo_reading_offset[k] + pp];
+                nPause <<= 1;
             }
         }
+        tBackoff = now;
+        if (daoWaitDone(md, cond, value))
+        {
+            wakes = &stats->nBackoffWakes;
+            goto done;
+        }
     }
-    else if (image->md[0].atype == _DATATYPE_INT16)
+
+    // block, unless the writer does not post the selected mechanism
+    if (policy->block == DAO_WAIT_BLOCK_FUTEX && (md[0].syncFlags & DAO_SYNC_FUTEX))
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.SI16[fifo_writing_offset + pp] = 0;
-            for(k=0;k<nbChannel;k++) 
+        while (1)
+        {
+#if defined(__linux__)
+            // sample the sequence before the condition: a post after this point changes the word
+            uint32_t seq = __atomic_load_n(&image->md[0].futexSeq, __ATOMIC_SEQ_CST);
+            if (daoWaitDone(md, cond, value))
+                break;
+            __atomic_add_fetch(&image->md[0].futexWaiters, 1, __ATOMIC_SEQ_CST);
+            if (!daoWaitDone(md, cond, value))
             {
-                image[0].array.SI16[fifo_writing_offset + pp]
-                    += imageCube[k][0].array.SI16[fifo_reading_offset[k] + pp];
+                daoFutex(&md[0].futexSeq, FUTEX_WAIT, seq, NULL, 0);
             }
+            __atomic_sub_fetch(&image->md[0].futexWaiters, 1, __ATOMIC_SEQ_CST);
+#else
+            if (daoWaitDone(md, cond, value))
+                break;
+    #ifdef _WIN32
+            Sleep(0);
+    #else
+            sched_yield();
+    #endif
+#endif
         }
     }
-    else if (image->md[0].atype == _DATATYPE_UINT32)
+    else if (policy->block == DAO_WAIT_BLOCK_SEM && (md[0].syncFlags & DAO_SYNC_SEM) &&
+             policy->semNb >= 0 && policy->semNb < (int32_t)image->md[0].sem)
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.UI32[fifo_writing_offset + pp] = 0;
-            for(k=0;k<nbChannel;k++) 
+        // posts are counted, stale ones only cost an extra check
+        while (!daoWaitDone(md, cond, value))
+        {
+            if (daoShmWaitForSemaphore(image, policy->semNb) != DAO_SUCCESS)
             {
-                image[0].array.UI32[fifo_writing_offset + pp]
-                    += imageCube[k][0].array.UI32[fifo_reading_offset[k] + pp];
+                rval = DAO_ERROR;
+                break;
             }
         }
     }
-    else if (image->md[0].atype == _DATATYPE_INT32)
+    else
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.SI32[fifo_writing_offset + pp] = 0;
-            for(k=0;k<nbChannel;k++) 
+    #ifdef _WIN32
+        while (!daoWaitDone(md, cond, value))
+        {
+            Sleep(0); // Yield the current time slice
+        }
+    #else
+        struct timespec req, rem;
+        req.tv_sec = 0;          // Seconds
+        req.tv_nsec = 0; // Nanoseconds
+        while (!daoWaitDone(md, cond, value))
+        {
+            // Spin
+            if (nanosleep(&req, &rem) < 0) 
             {
-                image[0].array.SI32[fifo_writing_offset + pp]
-                    += imageCube[k][0].array.SI32[fifo_reading_offset[k] + pp];
+                printf("Nanosleep interrupted\n");
+                rval = DAO_ERROR;
+                break;
             }
         }
+    #endif
     }
-    else if (image->md[0].atype == _DATATYPE_UINT64)
+    now = daoWaitNow();
+
+done:
+    stats->lastSpinNs = tSpin - t0;
+    stats->lastBackoffNs = tBackoff - tSpin;
+    stats->lastBlockNs = now - tBackoff;
+    stats->spinNs += stats->lastSpinNs;
+    stats->backoffNs += stats->lastBackoffNs;
+    stats->blockNs += stats->lastBlockNs;
+    if (rval == DAO_SUCCESS)
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.UI64[fifo_writing_offset + pp] = 0;
-            for(k=0;k<nbChannel;k++) 
-            {
-                image[0].array.UI64[fifo_writing_offset + pp]
-                    += imageCube[k][0].array.UI64[fifo_reading_offset[k] + pp];
-            }
-        }
+        stats->nWaits++;
+        (*wakes)++;
     }
-    else if (image->md[0].atype == _DATATYPE_INT64)
+
+    return rval;
+}
+
+/**
+ * @brief Wait for new data in SHM by spining on SHM counter
+ * 
+ * The spin follows the policy set with daoShmSetWaitPolicy.
+ * 
+ * @param image 
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmWaitForCounter(IMAGE *image)
+{
+    daoTrace("\n");
+    volatile IMAGE_METADATA *md = (volatile IMAGE_METADATA *)image->md;
+
+    if (md->fifo_size == 1) // Spin on our only cnt0 for 1-deep images
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.SI64[fifo_writing_offset + pp] = 0;
-            for(k=0;k<nbChannel;k++) 
-            {
-                image[0].array.SI64[fifo_writing_offset + pp]
-                    += imageCube[k][0].array.SI64[fifo_reading_offset[k] + pp];
-            }
-        }
+        return daoShmWaitPolicy(image, DAO_WAIT_CNT0_ABOVE, md->cnt0);
     }
-    else if (image->md[0].atype == _DATATYPE_FLOAT)
+    else // Spin on writing position for everything else
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.F[fifo_writing_offset + pp] = 0;
-            for(k=0;k<nbChannel;k++) 
-            {
-                image[0].array.F[fifo_writing_offset + pp]
-                    += imageCube[k][0].array.F[fifo_reading_offset[k] + pp];
-            }
-        }
+        return daoShmWaitPolicy(image, DAO_WAIT_FIFO_MOVED, md->fifo_last_written);
     }
-    else if (image->md[0].atype == _DATATYPE_DOUBLE)
+}
+
+/**
+ * @brief Wait for new data in SHM by spining until the provided SHM counter is reached or exceeded.
+ * 
+ * The spin follows the policy set with daoShmSetWaitPolicy.
+ * 
+ * @param image 
+ * @param targetCnt0 The cnt0 value to spin until. 
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmWaitForTargetCounter(IMAGE *image, uint64_t targetCnt0)
+{
+    daoTrace("\n");
+    return daoShmWaitPolicy(image, DAO_WAIT_CNT0_REACHED, targetCnt0);
+}
+
+/**
+ * @brief Set the spin-then-block policy of daoShmWaitForCounter and daoShmWaitForTargetCounter
+ * 
+ * The policy is local to this IMAGE (i.e. to this reader).
+ * 
+ * @param image 
+ * @param policy spin and backoff durations in ns, and the block method. NULL restores legacy polling.
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmSetWaitPolicy(IMAGE *image, const DAO_WAIT_POLICY *policy)
+{
+    daoTrace("\n");
+    if (policy == NULL)
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.D[fifo_writing_offset + pp] = 0;
-            for(k=0;k<nbChannel;k++) 
-            {
-                image[0].array.D[fifo_writing_offset + pp]
-                    += imageCube[k][0].array.D[fifo_reading_offset[k] + pp];
-            }
-        }
+        memset(&image->wait_policy, 0, sizeof(DAO_WAIT_POLICY));
+        return DAO_SUCCESS;
     }
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_FLOAT)
+    if (policy->block > DAO_WAIT_BLOCK_SEM)
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.CF[fifo_writing_offset + pp].re = 0;
-            image[0].array.CF[fifo_writing_offset + pp].im = 0;
-            for(k=0;k<nbChannel;k++) 
-            {
-                image[0].array.CF[fifo_writing_offset + pp].re
-                    += imageCube[k][0].array.CF[fifo_reading_offset[k] + pp].re;
-                image[0].array.CF[fifo_writing_offset + pp].im
-                    += imageCube[k][0].array.CF[fifo_reading_offset[k] + pp].im;
-            }
-        }
+        daoError("Unknown wait block method %u\n", policy->block);
+        return DAO_ERROR;
     }
-        else if (image->md[0].atype == _DATATYPE_COMPLEX_DOUBLE)
+    if (policy->block == DAO_WAIT_BLOCK_SEM &&
+        (policy->semNb < 0 || policy->semNb >= (int32_t)image->md[0].sem))
     {
-        for (pp=0; pp<nbVal; pp++)
-        {   
-            image[0].array.CD[fifo_writing_offset + pp].re = 0;
-            image[0].array.CD[fifo_writing_offset + pp].im = 0;
-            for(k=0;k<nbChannel;k++) 
-            {
-                image[0].array.CD[fifo_writing_offset + pp].re
-                    += imageCube[k][0].array.CD[fifo_reading_offset[k] + pp].re;
-                image[0].array.CD[fifo_writing_offset + pp].im
-                    += imageCube[k][0].array.CD[fifo_reading_offset[k] + pp].im;
-            }
-        }
+        daoError("Semaphore %d does not exist\n", policy->semNb);
+        return DAO_ERROR;
     }
-	
-    daoShmImagePart2ShmFinalize(image);
-
+    image->wait_policy = *policy;
     return DAO_SUCCESS;
 }
 
-/* Function for compatibility - creates 1-deep DAO SHM */
-int_fast8_t daoShmImageCreate(IMAGE *image, const char *name, long naxis, 
-                              uint32_t *size, uint8_t atype, int shared, int NBkw)
+/**
+ * @brief Retrieve the time spent spinning and sleeping by the counter waits
+ * 
+ * @param image 
+ * @param stats 
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmGetWaitStats(IMAGE *image, DAO_WAIT_STATS *stats)
 {
-    return daoShmImageCreate_FIFO(image, name, naxis, size, atype, shared, NBkw, 1);
+    daoTrace("\n");
+    *stats = image->wait_stats;
+    return DAO_SUCCESS;
 }
 
 /**
- * @brief Wait for new data in SHM
+ * @brief Reset the counter wait statistics
  * 
  * @param image 
- * @return uint_fast64_t 
+ * @return int_fast8_t 
  */
-int_fast8_t daoShmWaitForSemaphore(IMAGE *image, int32_t semNb)
+int_fast8_t daoShmResetWaitStats(IMAGE *image)
 {
     daoTrace("\n");
-    // Wait for new image
+    memset(&image->wait_stats, 0, sizeof(DAO_WAIT_STATS));
+    return DAO_SUCCESS;
+}
+
 #ifdef _WIN32
-    // On Windows we use a single short-timeout wait and return DAO_TIMEOUT so
-    // that the *Python* caller can loop. If the loop were here in C, Python
-    // would never get control back between iterations and KeyboardInterrupt
-    // (Ctrl+C) could never fire.
-    //
-    // If the handle is NULL or invalid (writer hasn't started yet, or the
-    // writer exited and its semaphore was destroyed), try to reopen it by
-    // name before waiting. Named semaphores in the Local\ namespace are
-    // destroyed when the last handle is closed, so the reader must reopen
-    // them each time the writer restarts.
-    if (!image->semptr || !image->semptr[semNb]) {
-        // Build the semaphore name from the image name, same scheme as
-        // daoImageCreateSem / daoShmShm2Img.
-        char semName[256];
-        WCHAR wSemName[256];
-        char nameCopy[256];
-        strncpy(nameCopy, image->md[0].name, sizeof(nameCopy)-1);
-        nameCopy[sizeof(nameCopy)-1] = '\0';
-        char *tok = strtok(nameCopy, PATH_SEPARATOR);
-        char *last = NULL;
-        while (tok) { last = tok; tok = strtok(NULL, PATH_SEPARATOR); }
-        if (last) {
-            char *localName = strtok(last, ".");
-            if (localName) {
-                sprintf(semName, "Local\\DAO_%s_sem%02d", localName, (int)semNb);
-                MultiByteToWideChar(CP_UTF8, 0, semName, -1, wSemName, 256);
-                HANDLE h = OpenSemaphoreW(SEMAPHORE_ALL_ACCESS, FALSE, wSemName);
-                if (h && image->semptr) {
-                    image->semptr[semNb] = h;
-                }
-            }
-        }
-        // Still no handle — writer not running yet, report timeout so caller loops
-        if (!image->semptr || !image->semptr[semNb]) {
-            return DAO_TIMEOUT;
-        }
-    }
+#define daoGetPid() ((int32_t)GetCurrentProcessId())
+#else
+#define daoGetPid() ((int32_t)getpid())
+#endif
 
-    DWORD dWaitResult = WaitForSingleObject(image->semptr[semNb], 100);
-    if (dWaitResult == WAIT_OBJECT_0) {
-        return DAO_SUCCESS;
-    } else if (dWaitResult == WAIT_TIMEOUT) {
-        return DAO_TIMEOUT;
-    } else {
-        DWORD err = GetLastError();
-        if (err == ERROR_INVALID_HANDLE) {
-            // The writer exited and its semaphore was destroyed.
-            // Invalidate the handle so the next call will reopen it.
-            CloseHandle(image->semptr[semNb]);
-            image->semptr[semNb] = NULL;
-            return DAO_TIMEOUT;
-        }
-        daoError("Unexpected result from WaitForSingleObject (Windows system error no. %d).\n", err);
-        return DAO_ERROR;
-    }
-#elif defined(__APPLE__)
-    if (sem_wait(image->semptr[semNb]) == 0) 
-    {
-        // Safely decrement the counter, but only if > 0
-        unsigned int val = atomic_load(&image->md[0].semCounter[semNb]);
-        while (val > 0)
-        {
-            if (atomic_compare_exchange_weak(&image->md[0].semCounter[semNb], &val, val - 1))
-                break;
-            // If CAS fails, val is updated, loop again
-        }
-    } 
-    else
+/*
+ * Atomically replace *p by desired if it equals expected, non-zero on success
+ */
+static int daoCas32(volatile int32_t *p, int32_t expected, int32_t desired)
+{
+#ifdef _WIN32
+    return InterlockedCompareExchange((volatile LONG *)p, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/*
+ * Non-zero if the process exists
+ */
+static int daoProcessAlive(int32_t pid)
+{
+#ifdef _WIN32
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+    DWORD status;
+    if (process == NULL)
     {
-        daoError("sem_wait failed on sem %d: %s\n", semNb, strerror(errno));
-        return DAO_ERROR;
+        return GetLastError() == ERROR_ACCESS_DENIED;
     }
+    status = WaitForSingleObject(process, 0);
+    CloseHandle(process);
+    return status == WAIT_TIMEOUT;
 #else
-    sem_wait(image->semptr[semNb]);
+    return kill(pid, 0) == 0 || errno == EPERM;
 #endif
+}
 
-    return DAO_SUCCESS;
+/*
+ * Reader cursor table of a shared memory, NULL if it has none
+ */
+static volatile DAO_READER_CURSOR *daoShmReaderTable(IMAGE *image)
+{
+    if (image->md[0].shared != 1 || image->md[0].readerOffset == 0)
+    {
+        return NULL;
+    }
+    return (volatile DAO_READER_CURSOR *)((char *)image->md + image->md[0].readerOffset);
+}
+
+/*
+ * Record the frame consumed by a registered reader
+ */
+static inline void daoShmReaderUpdate(IMAGE *image, uint32_t idx, uint64_t cnt0)
+{
+    volatile DAO_READER_CURSOR *reader = image->reader;
+    if (reader != NULL)
+    {
+        reader->lastIdx = idx;
+        reader->lastCnt0 = cnt0;
+        reader->heartbeatNs = daoWaitNow();
+    }
 }
 
 /**
- * @brief Wait for new data in SHM with time out
+ * @brief Register this IMAGE as a reader in the cursor table of the shared memory
  * 
- * @param image 
- * @return uint_fast64_t 
- * @timeout timespec
+ * The cursor (PID, last consumed cnt0, heartbeat) is then updated by daoShmGetNextSegment,
+ * daoShmGetNewestSegment and daoShmReadConsistent, so that the writer can see how far
+ * behind every reader is. Cursors of dead processes are reclaimed when the table is full.
+ * The cursor is released by daoShmReaderUnregister or daoShmCloseShm.
+ * 
+ * @param image shared memory opened by the reader
+ * @param name reader name, shown by monitoring tools (can be NULL)
+ * @param flags DAO_READER_BACKPRESSURE to be waited for by daoShmWaitForReaders
+ * @return int_fast8_t DAO_SUCCESS, DAO_ERROR if there is no table or no free cursor
  */
-int_fast8_t daoShmWaitForSemaphoreTimeout(IMAGE *image, int32_t semNb, const struct timespec * timeout)
+int_fast8_t daoShmReaderRegister(IMAGE *image, const char *name, uint32_t flags)
 {
     daoTrace("\n");
-    // Wait for new image
-#ifdef _WIN32
-    // Convert absolute timespec to milliseconds from now
-    struct timespec now;
-    clock_gettime(CLOCK_REALTIME, &now);
-
-    DWORD millis =
-        (timeout->tv_sec - now.tv_sec) * 1000 +
-        (timeout->tv_nsec - now.tv_nsec) / 1000000;
-
-    if ((int)millis < 0) millis = 0; // prevent underflow
-
-	DWORD dWaitResult = WaitForSingleObject(image->semptr[semNb], millis);
-	switch (dWaitResult) {
-		case WAIT_OBJECT_0:
-			break;
-        case WAIT_TIMEOUT:
-            return DAO_TIMEOUT;
-		default:
-			daoError("Unexpected result from WaitForSingleObject (Windows system error no. %d).\n", GetLastError());
-			return DAO_ERROR;
-	}
-#elif defined(__APPLE__)
-    struct timespec now;
-    clock_gettime(CLOCK_REALTIME, &now);
+    volatile DAO_READER_CURSOR *table = daoShmReaderTable(image);
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    int32_t pid = daoGetPid();
+    uint32_t k;
+    int pass;
 
-    uint64_t now_ns = (uint64_t)now.tv_sec * 1e9 + now.tv_nsec;
-    uint64_t end_ns = (uint64_t)timeout->tv_sec * 1e9 + timeout->tv_nsec;
+    if (table == NULL)
+    {
+        daoError("%s has no reader cursor table\n", image->name);
+        return DAO_ERROR;
+    }
+    if (image->reader != NULL)
+    {
+        daoShmReaderUnregister(image);
+    }
 
-    while (now_ns < end_ns)
+    for (pass = 0; pass < 2; pass++)
     {
-        unsigned int val = atomic_load(&image->md[0].semCounter[semNb]);
-        if (val > 0)
+        for (k = 0; k < image->md[0].maxReaders; k++)
         {
-            if (sem_wait(image->semptr[semNb]) == 0)
+            if (table[k].pid == 0 && daoCas32(&table[k].pid, 0, pid))
             {
-                atomic_fetch_sub(&image->md[0].semCounter[semNb], 1);
+                uint32_t idx = vol_md[0].fifo_last_written;
+                table[k].readerId = k;
+                table[k].flags = flags;
+                memset((void *)table[k].name, 0, sizeof(table[k].name));
+                if (name != NULL)
+                {
+                    strncpy((char *)table[k].name, name, sizeof(table[k].name) - 1);
+                }
+                image->reader = (DAO_READER_CURSOR *)&table[k];
+                daoShmReaderUpdate(image, idx, image->record[idx].cnt0);
                 return DAO_SUCCESS;
             }
-            else
-            {
-                daoError("sem_wait failed: %s\n", strerror(errno));
-                return DAO_ERROR;
-            }
         }
+        // table full: reclaim the cursors of dead readers and try again
+        daoShmCheckReaders(image, 0, NULL, NULL);
+    }
 
-        // Sleep briefly (e.g., 100 µs)
-        struct timespec sleep_ts = {.tv_sec = 0, .tv_nsec = 100000};
-        nanosleep(&sleep_ts, NULL);
+    daoError("no free reader cursor in %s (%d readers)\n", image->name, (int) image->md[0].maxReaders);
+    return DAO_ERROR;
+}
 
-        clock_gettime(CLOCK_REALTIME, &now);
-        now_ns = (uint64_t)now.tv_sec * 1e9 + now.tv_nsec;
+/**
+ * @brief Release the cursor of this IMAGE
+ * 
+ * @param image 
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmReaderUnregister(IMAGE *image)
+{
+    daoTrace("\n");
+    if (image->reader != NULL)
+    {
+        volatile DAO_READER_CURSOR *reader = image->reader;
+        reader->flags = 0;
+        daoCas32(&reader->pid, daoGetPid(), 0);
+        image->reader = NULL;
     }
+    return DAO_SUCCESS;
+}
 
-    return DAO_TIMEOUT;
-#else
-    if (sem_timedwait(image->semptr[semNb], timeout) == -1)
+/**
+ * @brief Refresh the heartbeat of this reader without consuming a frame
+ * 
+ * For readers that can stay idle longer than the stale delay used by the writer.
+ * 
+ * @param image 
+ * @return int_fast8_t DAO_ERROR if the IMAGE is not registered
+ */
+int_fast8_t daoShmReaderHeartbeat(IMAGE *image)
+{
+    if (image->reader == NULL)
     {
-        return DAO_TIMEOUT;
+        return DAO_ERROR;
     }
-#endif
-
+    image->reader->heartbeatNs = daoWaitNow();
     return DAO_SUCCESS;
 }
 
 /**
- * @brief Wait for new data in SHM by spining on SHM counter
+ * @brief Copy the cursors of the registered readers
  * 
  * @param image 
- * @return int_fast8_t 
+ * @param cursors array of DAO_MAX_READERS cursors
+ * @param nbReaders number of cursors copied
+ * @return int_fast8_t DAO_ERROR if there is no cursor table
  */
-int_fast8_t daoShmWaitForCounter(IMAGE *image)
+int_fast8_t daoShmGetReaders(IMAGE *image, DAO_READER_CURSOR *cursors, uint32_t *nbReaders)
 {
     daoTrace("\n");
-    volatile IMAGE_METADATA *md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_READER_CURSOR *table = daoShmReaderTable(image);
+    uint32_t k;
 
-    if (md->fifo_size == 1) // Spin on our only cnt0 for 1-deep images
+    *nbReaders = 0;
+    if (table == NULL)
     {
-    #ifdef _WIN32
-        volatile uint_fast64_t counter = md->cnt0;
-        while (md->cnt0 <= counter)
+        return DAO_ERROR;
+    }
+    for (k = 0; k < image->md[0].maxReaders; k++)
+    {
+        if (table[k].pid != 0)
         {
-            // Spin
+            memcpy(&cursors[*nbReaders], (const void *)&table[k], sizeof(DAO_READER_CURSOR));
+            (*nbReaders)++;
         }
-    #else
-        uint_fast64_t counter = image->md[0].cnt0;
-        struct timespec req, rem;
-        req.tv_sec = 0;          // Seconds
-        req.tv_nsec = 0; // Nanoseconds
-        while (md->cnt0 <= counter)
+    }
+    return DAO_SUCCESS;
+}
+
+/**
+ * @brief Find the registered reader furthest behind the writer
+ * 
+ * @param image 
+ * @param readerId cursor of the slowest reader
+ * @param lag number of frames written since that reader's last read
+ * @return int_fast8_t DAO_SUCCESS, DAO_NOTREADY if no reader is registered, DAO_ERROR
+ */
+int_fast8_t daoShmGetSlowestReader(IMAGE *image, uint32_t *readerId, uint64_t *lag)
+{
+    daoTrace("\n");
+    volatile DAO_READER_CURSOR *table = daoShmReaderTable(image);
+    uint64_t cnt0 = daoShmNewestCnt0(image);
+    int found = 0;
+    uint32_t k;
+
+    if (table == NULL)
+    {
+        return DAO_ERROR;
+    }
+    *lag = 0;
+    for (k = 0; k < image->md[0].maxReaders; k++)
+    {
+        if (table[k].pid != 0)
         {
-            // Spin
-            if (nanosleep(&req, &rem) < 0) 
+            uint64_t readerLag = (cnt0 > table[k].lastCnt0) ? cnt0 - table[k].lastCnt0 : 0;
+            if (!found || readerLag > *lag)
             {
-                printf("Nanosleep interrupted\n");
-                return DAO_ERROR;
+                *readerId = k;
+                *lag = readerLag;
+                found = 1;
             }
         }
-    #endif
-        return DAO_SUCCESS;
     }
-    else // Spin on writing position for everything else
+    return found ? DAO_SUCCESS : DAO_NOTREADY;
+}
+
+/**
+ * @brief Release the cursors of dead readers and count the stalled ones
+ * 
+ * @param image 
+ * @param staleNs heartbeat age above which a live reader is counted as stalled, 0 to skip
+ * @param nbDead number of cursors released because their process no longer exists (can be NULL)
+ * @param nbStale number of live readers whose heartbeat is older than staleNs (can be NULL)
+ * @return int_fast8_t DAO_ERROR if there is no cursor table
+ */
+int_fast8_t daoShmCheckReaders(IMAGE *image, uint64_t staleNs, uint32_t *nbDead, uint32_t *nbStale)
+{
+    daoTrace("\n");
+    volatile DAO_READER_CURSOR *table = daoShmReaderTable(image);
+    uint64_t now = daoWaitNow();
+    uint32_t dead = 0;
+    uint32_t stale = 0;
+    uint32_t k;
+
+    if (table == NULL)
     {
-    #ifdef _WIN32
-        volatile uint32_t fifo_position = md->fifo_last_written;
-        while (md->fifo_last_written == fifo_position)
+        return DAO_ERROR;
+    }
+    for (k = 0; k < image->md[0].maxReaders; k++)
+    {
+        int32_t pid = table[k].pid;
+        if (pid == 0)
         {
-            // Spin
+            continue;
         }
-    #else
-        uint32_t fifo_position = md->fifo_last_written;
-        struct timespec req, rem;
-        req.tv_sec = 0;          // Seconds
-        req.tv_nsec = 0; // Nanoseconds
-        while (md->fifo_last_written == fifo_position)
+        if (!daoProcessAlive(pid))
         {
-            // Spin
-            if (nanosleep(&req, &rem) < 0) 
+            if (daoCas32(&table[k].pid, pid, 0))
             {
-                printf("Nanosleep interrupted\n");
-                return DAO_ERROR;
+                daoWarning("reader %u (%s, pid %d) of %s died\n", k, (const char *)table[k].name, pid, image->name);
+                dead++;
             }
         }
-    #endif
-        return DAO_SUCCESS;
+        else if (staleNs > 0 && now > table[k].heartbeatNs && now - table[k].heartbeatNs > staleNs)
+        {
+            stale++;
+        }
     }
-
+    if (nbDead != NULL)
+        *nbDead = dead;
+    if (nbStale != NULL)
+        *nbStale = stale;
+    return DAO_SUCCESS;
 }
 
 /**
- * @brief Wait for new data in SHM by spining until the provided SHM counter is reached or exceeded.
+ * @brief Back-pressure: wait until every DAO_READER_BACKPRESSURE reader is at most maxLag frames behind
+ * 
+ * Called by the writer before writing, with maxLag = fifo_size - 1 no such reader is ever lapped.
+ * Readers whose process died are released and no longer waited for.
  * 
  * @param image 
- * @param targetCnt0 The cnt0 value to spin until. 
- * @return int_fast8_t 
+ * @param maxLag largest accepted lag in frames
+ * @param timeoutNs maximum wait [ns], 0 to wait forever
+ * @return int_fast8_t DAO_SUCCESS, DAO_TIMEOUT, DAO_ERROR if there is no cursor table
  */
-int_fast8_t daoShmWaitForTargetCounter(IMAGE *image, uint64_t targetCnt0)
+int_fast8_t daoShmWaitForReaders(IMAGE *image, uint64_t maxLag, uint64_t timeoutNs)
 {
     daoTrace("\n");
+    volatile DAO_READER_CURSOR *table = daoShmReaderTable(image);
+    uint64_t start = daoWaitNow();
+    uint32_t spin = 0;
 
-    volatile IMAGE_METADATA *md = (volatile IMAGE_METADATA *)image->md;
-
-    #ifdef _WIN32
-    if (md->fifo_size == 1) // Spin on our only cnt0 for 1-deep images
+    if (table == NULL)
     {
-        while (md->cnt0 < targetCnt0)
-        {
-            // Spin with small delay to avoid consuming 100% CPU
-            Sleep(0); // Yield the current time slice
-        }
+        return DAO_ERROR;
     }
-    else // Keep checking writing position
+    for (;;)
     {
-        while (1)
-        {
-            // Check counter of last position
-            uint32_t fifo_last_written = md[0].fifo_last_written;
-            if (md[fifo_last_written].cnt0 >= targetCnt0)
-                break;
-            Sleep(0); // Yield the current time slice
-        }
-    }
-#else
-    struct timespec req, rem;
-    req.tv_sec = 0;          // Seconds
-    req.tv_nsec = 0; // Nanoseconds
+        uint64_t cnt0 = daoShmNewestCnt0(image);
+        int behind = 0;
+        uint32_t k;
 
-    if (md->fifo_size == 1) // Spin on our only cnt0 for 1-deep images
-    {
-        while (md->cnt0 < targetCnt0)
+        for (k = 0; k < image->md[0].maxReaders; k++)
         {
-            // Spin
-            if (nanosleep(&req, &rem) < 0) 
+            if (table[k].pid != 0 && (table[k].flags & DAO_READER_BACKPRESSURE)
+                && cnt0 > table[k].lastCnt0 && cnt0 - table[k].lastCnt0 > maxLag)
             {
-                printf("Nanosleep interrupted\n");
-                return DAO_ERROR;
+                behind = 1;
+                break;
             }
         }
-    }
-    else // Keep checking writing position
-    {
-        while (1)
+        if (!behind)
         {
-            // Check counter of last position
-            uint32_t fifo_last_written = md[0].fifo_last_written;
-
-            if (md[fifo_last_written].cnt0 >= targetCnt0)
-                break;
-
-            // Spin
-            if (nanosleep(&req, &rem) < 0) 
-            {
-                printf("Nanosleep interrupted\n");
-                return DAO_ERROR;
-            }
+            return DAO_SUCCESS;
         }
+        if (timeoutNs > 0 && daoWaitNow() - start > timeoutNs)
+        {
+            return DAO_TIMEOUT;
+        }
+        if (++spin % 1024 == 0)
+        {
+            // a dead reader would block the writer forever
+            daoShmCheckReaders(image, 0, NULL, NULL);
+        }
+        daoCpuRelax();
     }
-#endif
-
-    return DAO_SUCCESS;
 }
 
 /**
@@ -2521,9 +4572,7 @@ uint_fast64_t daoShmGetCounter(IMAGE *image)
 {
     daoTrace("\n");
 
-    uint32_t fifo_last_written = image->md[0].fifo_last_written;
-
-    return image->md[fifo_last_written].cnt0;
+    return daoShmNewestCnt0(image);
 }
 
 /**
@@ -2549,6 +4598,7 @@ int_fast8_t daoShmGetNextSegment(IMAGE *image, void** segment_ptr, uint32_t* seg
 
     volatile IMAGE *vol_image = (volatile IMAGE *)image;
     volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
 
     uint32_t last_read_idx  = vol_image->fifo_last_read;
     uint64_t last_read_cnt0 = vol_image->fifo_last_read_cnt0;
@@ -2558,43 +4608,20 @@ int_fast8_t daoShmGetNextSegment(IMAGE *image, void** segment_ptr, uint32_t* seg
     uint64_t next_segment_cnt0 = last_read_cnt0 + 1;
 
     // Return if we haven't got any new data yet
-    if ((last_read_idx == vol_md[0].fifo_last_written) && (last_read_cnt0 == vol_md[last_read_idx].cnt0))
+    if ((last_read_idx == vol_md[0].fifo_last_written) && (last_read_cnt0 == vol_record[last_read_idx].cnt0))
     {
         return DAO_NOTREADY;
     }
 
-    if (vol_md[next_segment_idx].cnt0 != next_segment_cnt0)
+    if (vol_record[next_segment_idx].cnt0 != next_segment_cnt0)
     { // We have been lapped by the writer. Set our position to the newest segment and signal the overwrite condition
         return_val = DAO_OVERWRITE;
         next_segment_idx = vol_md[0].fifo_last_written;
-        next_segment_cnt0 = vol_md[next_segment_idx].cnt0;
+        next_segment_cnt0 = vol_record[next_segment_idx].cnt0;
     }
 
     // Set the segment pointer and index
-    if (image->md[0].atype == _DATATYPE_UINT8)
-        *segment_ptr = &(image->array.UI8[next_segment_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT8)
-        *segment_ptr = &(image->array.SI8[next_segment_idx * image->md[0].nelement]);      
-    else if (image->md[0].atype == _DATATYPE_UINT16)
-        *segment_ptr = &(image->array.UI16[next_segment_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT16)
-        *segment_ptr = &(image->array.SI16[next_segment_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_UINT32)
-        *segment_ptr = &(image->array.UI32[next_segment_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT32)
-        *segment_ptr = &(image->array.SI32[next_segment_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_UINT64)
-        *segment_ptr = &(image->array.UI64[next_segment_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT64)
-        *segment_ptr = &(image->array.SI64[next_segment_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_FLOAT)
-        *segment_ptr = &(image->array.F[next_segment_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_DOUBLE)
-        *segment_ptr = &(image->array.D[next_segment_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_FLOAT)
-        *segment_ptr = &(image->array.CF[next_segment_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_DOUBLE)
-        *segment_ptr = &(image->array.CD[next_segment_idx * image->md[0].nelement]);
+    *segment_ptr = daoShmSegmentPtr(image, next_segment_idx);
 
     *segment_idx = next_segment_idx;
     *segment_cnt0 = next_segment_cnt0;
@@ -2602,19 +4629,112 @@ int_fast8_t daoShmGetNextSegment(IMAGE *image, void** segment_ptr, uint32_t* seg
     // Update the bookkeeping variables for this FIFO tail our IMAGE struct
     vol_image->fifo_last_read = next_segment_idx;
     vol_image->fifo_last_read_cnt0 = next_segment_cnt0;
+    daoShmReaderUpdate(image, next_segment_idx, next_segment_cnt0);
 
     return return_val;
 }
 
-/**
- * @brief Wait until the next segment is written to the DAO shared memory.
- * 
- * @param image 
- * @return int_fast8_t
- */
-int_fast8_t daoShmWaitForNextSegment(IMAGE *image)
-{
-    return daoShmWaitForTargetCounter(image, image->fifo_last_read_cnt0 + 1);
+/**
+ * @brief Wait until the next segment is written to the DAO shared memory.
+ * 
+ * @param image 
+ * @return int_fast8_t
+ */
+int_fast8_t daoShmWaitForNextSegment(IMAGE *image)
+{
+    return daoShmWaitForTargetCounter(image, image->fifo_last_read_cnt0 + 1);
+}
+
+/**
+ * @brief Get all the unread segments of this shared memory in one call.
+ * 
+ * Batched version of daoShmGetNextSegment for readers processing frames in blocks.
+ * The segments are returned as one run of consecutive FIFO slots, or two runs when
+ * they wrap around the end of the FIFO, and the read tail moves past the last one.
+ * If the writer lapped the reader, the tail is moved to the oldest segment that is
+ * not about to be overwritten and DAO_OVERWRITE is returned.
+ * The writer keeps running: compare segment_cnt0 with the md cnt0 after processing
+ * to check that the oldest segments were not overwritten meanwhile.
+ * 
+ * @param image 
+ * @param maxN Maximum number of segments returned
+ * @param runs The runs of segments, oldest first
+ * @param nbRuns Number of runs filled, 0 if no segment is ready
+ * @param segment_cnt0 CNT0 of each segment returned, array of maxN (can be NULL)
+ * @param segment_atime Acquisition time of each segment returned, array of maxN (can be NULL)
+ * @return int_fast8_t DAO_SUCCESS, DAO_OVERWRITE if frames were skipped, DAO_NOTREADY if no new segment
+ */
+int_fast8_t daoShmGetNextSegments(IMAGE *image, uint32_t maxN, DAO_SEGMENT_RUN runs[2], uint32_t *nbRuns,
+                                  uint64_t *segment_cnt0, struct timespec *segment_atime)
+{
+    int_fast8_t return_val = DAO_SUCCESS;
+
+    volatile IMAGE *vol_image = (volatile IMAGE *)image;
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
+
+    uint32_t fifo_size = vol_md[0].fifo_size;
+    uint64_t stride = image->md[0].segmentStride;
+    uint32_t newest_idx = vol_md[0].fifo_last_written;
+    uint64_t newest_cnt0 = vol_record[newest_idx].cnt0;
+    uint64_t first_cnt0 = vol_image->fifo_last_read_cnt0 + 1;
+    uint32_t first_idx;
+    uint64_t n;
+    uint32_t k;
+
+    *nbRuns = 0;
+    if (maxN == 0 || newest_cnt0 < first_cnt0)
+    {
+        return DAO_NOTREADY;
+    }
+
+    n = newest_cnt0 - first_cnt0 + 1;
+    if (n > fifo_size)
+    { // We have been lapped by the writer, the slot after the newest one is the next to be written
+        return_val = DAO_OVERWRITE;
+        n = (fifo_size > 1) ? fifo_size - 1 : 1;
+        first_cnt0 = newest_cnt0 - n + 1;
+    }
+    if (n > maxN)
+    {
+        n = maxN;
+    }
+    first_idx = (uint32_t)((newest_idx + fifo_size - (newest_cnt0 - first_cnt0) % fifo_size) % fifo_size);
+
+    // Runs of consecutive slots, split where the FIFO wraps
+    runs[0].ptr = daoShmSegmentPtr(image, first_idx);
+    runs[0].firstIdx = first_idx;
+    runs[0].count = (uint32_t)((n < fifo_size - first_idx) ? n : fifo_size - first_idx);
+    runs[0].stride = stride;
+    *nbRuns = 1;
+    if (runs[0].count < n)
+    {
+        runs[1].ptr = daoShmSegmentPtr(image, 0);
+        runs[1].firstIdx = 0;
+        runs[1].count = (uint32_t)(n - runs[0].count);
+        runs[1].stride = stride;
+        *nbRuns = 2;
+    }
+
+    for (k = 0; k < n; k++)
+    {
+        uint32_t idx = (first_idx + k) % fifo_size;
+        if (segment_cnt0 != NULL)
+            segment_cnt0[k] = vol_record[idx].cnt0;
+        if (segment_atime != NULL)
+        {
+            uint64_t atimeNs = vol_record[idx].atimeNs;
+            segment_atime[k].tv_sec = (time_t)(atimeNs / 1000000000ULL);
+            segment_atime[k].tv_nsec = (long)(atimeNs % 1000000000ULL);
+        }
+    }
+
+    // Update the bookkeeping variables for this FIFO tail our IMAGE struct
+    vol_image->fifo_last_read = (first_idx + (uint32_t)n - 1) % fifo_size;
+    vol_image->fifo_last_read_cnt0 = first_cnt0 + n - 1;
+    daoShmReaderUpdate(image, vol_image->fifo_last_read, vol_image->fifo_last_read_cnt0);
+
+    return return_val;
 }
 
 /**
@@ -2629,30 +4749,7 @@ int_fast8_t daoShmGetArbitrarySegment(IMAGE *image, void** segment_ptr, uint_fas
 {
     uint32_t actual_idx = (uint32_t)(fifo_idx % image->md[0].fifo_size);
 
-    if (image->md[0].atype == _DATATYPE_UINT8)
-        *segment_ptr = &(image->array.UI8[actual_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT8)
-        *segment_ptr = &(image->array.SI8[actual_idx * image->md[0].nelement]);      
-    else if (image->md[0].atype == _DATATYPE_UINT16)
-        *segment_ptr = &(image->array.UI16[actual_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT16)
-        *segment_ptr = &(image->array.SI16[actual_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_UINT32)
-        *segment_ptr = &(image->array.UI32[actual_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT32)
-        *segment_ptr = &(image->array.SI32[actual_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_UINT64)
-        *segment_ptr = &(image->array.UI64[actual_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT64)
-        *segment_ptr = &(image->array.SI64[actual_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_FLOAT)
-        *segment_ptr = &(image->array.F[actual_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_DOUBLE)
-        *segment_ptr = &(image->array.D[actual_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_FLOAT)
-        *segment_ptr = &(image->array.CF[actual_idx * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_DOUBLE)
-        *segment_ptr = &(image->array.CD[actual_idx * image->md[0].nelement]);
+    *segment_ptr = daoShmSegmentPtr(image, actual_idx);
 
     return DAO_SUCCESS;
 }
@@ -2668,37 +4765,16 @@ int_fast8_t daoShmGetArbitrarySegment(IMAGE *image, void** segment_ptr, uint_fas
 int_fast8_t daoShmGetNewestSegment(IMAGE *image, void** segment_ptr, uint32_t* segment_idx, uint64_t *segment_cnt0)
 {
     volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
 
     uint32_t last_written = vol_md[0].fifo_last_written;
-    uint64_t cnt0 = vol_md[last_written].cnt0;
-
-    if (image->md[0].atype == _DATATYPE_UINT8)
-        *segment_ptr = &(image->array.UI8[last_written * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT8)
-        *segment_ptr = &(image->array.SI8[last_written * image->md[0].nelement]);      
-    else if (image->md[0].atype == _DATATYPE_UINT16)
-        *segment_ptr = &(image->array.UI16[last_written * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT16)
-        *segment_ptr = &(image->array.SI16[last_written * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_UINT32)
-        *segment_ptr = &(image->array.UI32[last_written * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT32)
-        *segment_ptr = &(image->array.SI32[last_written * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_UINT64)
-        *segment_ptr = &(image->array.UI64[last_written * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_INT64)
-        *segment_ptr = &(image->array.SI64[last_written * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_FLOAT)
-        *segment_ptr = &(image->array.F[last_written * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_DOUBLE)
-        *segment_ptr = &(image->array.D[last_written * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_FLOAT)
-        *segment_ptr = &(image->array.CF[last_written * image->md[0].nelement]);
-    else if (image->md[0].atype == _DATATYPE_COMPLEX_DOUBLE)
-        *segment_ptr = &(image->array.CD[last_written * image->md[0].nelement]);
+    uint64_t cnt0 = vol_record[last_written].cnt0;
+
+    *segment_ptr = daoShmSegmentPtr(image, last_written);
 
     *segment_idx = last_written;
     *segment_cnt0 = cnt0;
+    daoShmReaderUpdate(image, last_written, cnt0);
 
     return DAO_SUCCESS;
 }
@@ -2720,12 +4796,12 @@ int_fast8_t daoShmCheckSegmentOverwrite(IMAGE *image)
     int_fast8_t return_val = DAO_SUCCESS;
 
     volatile IMAGE *vol_image = (volatile IMAGE *)image;
-    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
 
     uint32_t last_read_idx = vol_image->fifo_last_read;
     uint64_t last_read_cnt0 = vol_image->fifo_last_read_cnt0;
 
-    if (vol_md[last_read_idx].write == 1 || vol_md[last_read_idx].cnt0 != last_read_cnt0)
+    if ((vol_record[last_read_idx].seq & 1) || vol_record[last_read_idx].cnt0 != last_read_cnt0)
     {
         return_val = DAO_OVERWRITE;
     }
@@ -2733,6 +4809,62 @@ int_fast8_t daoShmCheckSegmentOverwrite(IMAGE *image)
     return return_val;
 }
 
+/**
+ * @brief Copy the newest segment out of the shared memory, retrying if the writer modified it meanwhile
+ * 
+ * The copy is validated with the segment sequence counter, so it never holds a mix of two frames.
+ * The writer is never held up: a torn copy is simply repeated.
+ * 
+ * @param image 
+ * @param dst Destination buffer of nelement elements
+ * @param segment_idx Index of the segment copied (can be NULL)
+ * @param segment_cnt0 CNT0 of the segment copied (can be NULL)
+ * @param maxRetry Maximum number of attempts, 0 to retry until a consistent copy is made
+ * @return int_fast8_t DAO_SUCCESS, or DAO_OVERWRITE if every attempt was torn
+ */
+int_fast8_t daoShmReadConsistent(IMAGE *image, void *dst, uint32_t *segment_idx, uint64_t *segment_cnt0,
+                                 uint32_t maxRetry)
+{
+    daoTrace("\n");
+
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
+    size_t nbBytes = image->md[0].nelement * image->type->size;
+    uint32_t attempt = 0;
+
+    while (maxRetry == 0 || attempt < maxRetry)
+    {
+        uint32_t idx = vol_md[0].fifo_last_written;
+        uint32_t seq = vol_record[idx].seq;
+        uint64_t cnt0;
+
+        attempt++;
+        daoFenceAcquire();
+        if (seq & 1)
+        {
+            // writer busy on this segment
+            daoCpuRelax();
+            continue;
+        }
+
+        cnt0 = vol_record[idx].cnt0;
+        memcpy(dst, daoShmSegmentPtr(image, idx), nbBytes);
+
+        daoFenceAcquire();
+        if (vol_record[idx].seq == seq)
+        {
+            if (segment_idx != NULL)
+                *segment_idx = idx;
+            if (segment_cnt0 != NULL)
+                *segment_cnt0 = cnt0;
+            daoShmReaderUpdate(image, idx, cnt0);
+            return DAO_SUCCESS;
+        }
+    }
+
+    return DAO_OVERWRITE;
+}
+
 /**
  * @brief Reset the reading tail on this SHM image struct to the current newest segment.
  * 
@@ -2744,9 +4876,10 @@ int_fast8_t daoShmCheckSegmentOverwrite(IMAGE *image)
 int_fast8_t daoShmResetTail(IMAGE *image, uint32_t* segment_idx, uint64_t *segment_cnt0)
 {
     volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
 
     uint32_t new_segment_idx = vol_md[0].fifo_last_written;
-    uint64_t new_segment_cnt0 = vol_md[new_segment_idx].cnt0;
+    uint64_t new_segment_cnt0 = vol_record[new_segment_idx].cnt0;
 
     *segment_idx = new_segment_idx;
     *segment_cnt0 = new_segment_cnt0;
@@ -2804,6 +4937,9 @@ int_fast8_t daoShmCloseShm(IMAGE *image)
     }
 #endif
 
+    // Release the reader cursor
+    daoShmReaderUnregister(image);
+
     // Free PID arrays if they exist
     if (image->semReadPID) {
         free(image->semReadPID);
@@ -2858,22 +4994,437 @@ int_fast8_t daoShmCloseShm(IMAGE *image)
  */
 int_fast8_t daoShmTimestampShm(IMAGE *image)
 {
-    struct timespec t;
-    clock_gettime(CLOCK_REALTIME, &t);
-
     volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
 
     uint32_t fifo_last_written = vol_md[0].fifo_last_written;
-    uint32_t fifo_prior_write = (fifo_last_written == 0)
-                                ? vol_md[0].fifo_size - 1
-                                : fifo_last_written - 1;
 
-    vol_md[fifo_last_written].atime.tsfixed.secondlong = ((int64_t)(1e9 * t.tv_sec) + t.tv_nsec);
-    vol_md[fifo_last_written].cnt0 = vol_md[fifo_prior_write].cnt0 + 1;
+    daoShmTimestampSegment(image, fifo_last_written);
+    daoShmPublishCompactCnt0(image, fifo_last_written);
+
+    return DAO_SUCCESS;
+}
+
+/**
+ * @brief Set the frame id, acquisition time and tag recorded with the next frame written
+ * 
+ * The values go into the DAO_FRAME_RECORD of the segment at the next commit
+ * (daoShmImage2Shm, daoShmCommitWriteSlot, daoShmImagePart2ShmFinalize), then are cleared.
+ * Without this call the record holds cnt2 and the write time.
+ * 
+ * @param image 
+ * @param frameId frame id, e.g. from the camera
+ * @param atimeNs acquisition time [ns, CLOCK_REALTIME]
+ * @param tag user value
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmSetFrameInfo(IMAGE *image, uint64_t frameId, uint64_t atimeNs, uint32_t tag)
+{
+    image->record_next.frameId = frameId;
+    image->record_next.atimeNs = atimeNs;
+    image->record_next.tag = tag;
+    image->record_next.seq = 1;
+    return DAO_SUCCESS;
+}
+
+/**
+ * @brief Copy the record of a FIFO segment, lock-free
+ * 
+ * The copy is retried while the writer modifies the segment, so the record is never
+ * a mix of two frames.
+ * 
+ * @param image 
+ * @param segment_idx FIFO index of the segment (modulo fifo_size)
+ * @param record copy of the record
+ * @return int_fast8_t 
+ */
+int_fast8_t daoShmGetFrameRecord(IMAGE *image, uint32_t segment_idx, DAO_FRAME_RECORD *record)
+{
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
+    uint32_t idx = segment_idx % image->md[0].fifo_size;
+
+    for (;;)
+    {
+        uint32_t seq = vol_record[idx].seq;
+        daoFenceAcquire();
+        if ((seq & 1) == 0)
+        {
+            memcpy(record, (const void *)&vol_record[idx], sizeof(DAO_FRAME_RECORD));
+            daoFenceAcquire();
+            if (vol_record[idx].seq == seq)
+            {
+                record->seq = seq;
+                return DAO_SUCCESS;
+            }
+        }
+        daoCpuRelax();
+    }
+}
+
+/**
+ * @brief Time stamp of the frame traces
+ * 
+ * The TSC on x86, the same for every core of a machine with an invariant TSC,
+ * CLOCK_MONOTONIC in ns elsewhere. Convert to ns with daoShmTraceTscPerNs.
+ * 
+ * @return uint64_t 
+ */
+uint64_t daoShmTraceTsc(void)
+{
+#if DAO_TRACE_RDTSC
+    return __rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Ticks of daoShmTraceTsc per ns
+ * 
+ * Measured against CLOCK_MONOTONIC over 20 ms on the first call, 1 without a TSC.
+ * 
+ * @return double 
+ */
+double daoShmTraceTscPerNs(void)
+{
+#if DAO_TRACE_RDTSC
+    static volatile double tscPerNs = 0;
+
+    if (tscPerNs == 0)
+    {
+        struct timespec t0;
+        struct timespec t1;
+        uint64_t tsc0;
+        uint64_t tsc1;
+        double ns;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        tsc0 = daoShmTraceTsc();
+        do
+        {
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+        } while (ns < 20e6);
+        tsc1 = daoShmTraceTsc();
+        tscPerNs = (double)(tsc1 - tsc0) / ns;
+    }
+    return tscPerNs;
+#else
+    return 1.0;
+#endif
+}
+
+/*
+ * Append the stamp of a stage to a trace, counted as dropped when the trace is full
+ */
+static void daoShmTraceAppend(DAO_FRAME_TRACE *trace, uint32_t stageId, uint64_t enterTsc)
+{
+    if (trace->nbStamp < DAO_TRACE_MAX_STAMPS)
+    {
+        trace->stamp[trace->nbStamp].stageId = stageId;
+        trace->stamp[trace->nbStamp].reserved = 0;
+        trace->stamp[trace->nbStamp].enterTsc = enterTsc;
+        trace->stamp[trace->nbStamp].exitTsc = 0;
+        trace->nbStamp++;
+    }
+    else
+    {
+        trace->dropped++;
+    }
+}
+
+/**
+ * @brief Start a new trace with the next frame written, for the first stage of a pipeline
+ * 
+ * The origin of the trace is the frame id of the record (see daoShmSetFrameInfo), the
+ * stage is stamped from enterTsc to the commit. Needs an image created with DAO_SHM_OPTIONS::trace.
+ * 
+ * @param image 
+ * @param stageId id of the stage writing the image
+ * @param enterTsc daoShmTraceTsc when the stage started on the frame
+ * @return int_fast8_t DAO_ERROR if the image has no traces
+ */
+int_fast8_t daoShmTraceBegin(IMAGE *image, uint32_t stageId, uint64_t enterTsc)
+{
+    if (image->trace == NULL)
+    {
+        daoDebug("%s has no frame traces\n", image->name);
+        return DAO_ERROR;
+    }
+    memset(&image->trace_next, 0, sizeof(DAO_FRAME_TRACE));
+    image->trace_next.originId = DAO_TRACE_NO_ORIGIN;
+    daoShmTraceAppend(&image->trace_next, stageId, enterTsc);
+    return DAO_SUCCESS;
+}
+
+/**
+ * @brief Continue the trace of an input frame with the next frame written
+ * 
+ * Copies the trace of segment segment_idx of input and appends the stamp of this stage,
+ * from enterTsc to the commit. An input without traces starts a new trace with the
+ * frame id of its record as origin. Needs an image created with DAO_SHM_OPTIONS::trace.
+ * The input trace is copied now: call it while the input frame is still the one read,
+ * or copy the trace when reading and use daoShmTraceFromTrace.
+ * 
+ * @param image image written by the stage
+ * @param input image read by the stage
+ * @param segment_idx FIFO index of the input frame
+ * @param stageId id of the stage writing the image
+ * @param enterTsc daoShmTraceTsc when the stage got the input frame
+ * @return int_fast8_t DAO_ERROR if the image has no traces
+ */
+int_fast8_t daoShmTraceFrom(IMAGE *image, IMAGE *input, uint32_t segment_idx, uint32_t stageId,
+                            uint64_t enterTsc)
+{
+    DAO_FRAME_TRACE inputTrace;
+
+    if (input->trace != NULL)
+    {
+        daoShmGetFrameTrace(input, segment_idx, &inputTrace);
+    }
+    else
+    {
+        DAO_FRAME_RECORD record;
+        daoShmGetFrameRecord(input, segment_idx, &record);
+        memset(&inputTrace, 0, sizeof(DAO_FRAME_TRACE));
+        inputTrace.originId = record.frameId;
+    }
+    return daoShmTraceFromTrace(image, &inputTrace, stageId, enterTsc);
+}
+
+/**
+ * @brief Continue a trace copied when the input frame was read with the next frame written
+ * 
+ * Like daoShmTraceFrom, from a copy of the input trace (daoShmGetFrameTrace, or a trace
+ * without stamps with the frame id of the record as origin for an input without traces),
+ * so the input segment may be rewritten between the read and the write.
+ * 
+ * @param image image written by the stage
+ * @param input trace of the input frame
+ * @param stageId id of the stage writing the image
+ * @param enterTsc daoShmTraceTsc when the stage got the input frame
+ * @return int_fast8_t DAO_ERROR if the image has no traces
+ */
+int_fast8_t daoShmTraceFromTrace(IMAGE *image, const DAO_FRAME_TRACE *input, uint32_t stageId,
+                                 uint64_t enterTsc)
+{
+    if (image->trace == NULL)
+    {
+        daoDebug("%s has no frame traces\n", image->name);
+        return DAO_ERROR;
+    }
+    memcpy(&image->trace_next, input, sizeof(DAO_FRAME_TRACE));
+    daoShmTraceAppend(&image->trace_next, stageId, enterTsc);
+    return DAO_SUCCESS;
+}
+
+/**
+ * @brief Copy the trace of a FIFO segment, lock-free
+ * 
+ * Retried while the writer modifies the segment, like daoShmGetFrameRecord.
+ * 
+ * @param image 
+ * @param segment_idx FIFO index of the segment (modulo fifo_size)
+ * @param trace copy of the trace
+ * @return int_fast8_t DAO_ERROR if the image has no traces
+ */
+int_fast8_t daoShmGetFrameTrace(IMAGE *image, uint32_t segment_idx, DAO_FRAME_TRACE *trace)
+{
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
+    uint32_t idx = segment_idx % image->md[0].fifo_size;
+
+    if (image->trace == NULL)
+    {
+        memset(trace, 0, sizeof(DAO_FRAME_TRACE));
+        return DAO_ERROR;
+    }
+    for (;;)
+    {
+        uint32_t seq = vol_record[idx].seq;
+        daoFenceAcquire();
+        if ((seq & 1) == 0)
+        {
+            memcpy(trace, (const void *)&image->trace[idx], sizeof(DAO_FRAME_TRACE));
+            daoFenceAcquire();
+            if (vol_record[idx].seq == seq)
+            {
+                return DAO_SUCCESS;
+            }
+        }
+        daoCpuRelax();
+    }
+}
+
+/*
+ * Number of leading packets of the map that are in the segment
+ */
+static uint32_t daoShmPacketPrefix(volatile DAO_PACKET_MAP *map, uint32_t packetTotal)
+{
+    volatile uint64_t *bits = daoShmPacketBits(map);
+    uint32_t prefix = 0;
+    uint32_t w;
+
+    for (w = 0; w < (packetTotal + 63) / 64; w++)
+    {
+        uint64_t word = bits[w];
+        if (word != ~0ULL)
+        {
+            while (word & 1)
+            {
+                prefix++;
+                word >>= 1;
+            }
+            break;
+        }
+        prefix += 64;
+    }
+    daoFenceAcquire();
+    return (prefix < packetTotal) ? prefix : packetTotal;
+}
+
+/**
+ * @brief Copy the packet map of a FIFO segment
+ * 
+ * @param image 
+ * @param segment_idx FIFO index of the segment (modulo fifo_size)
+ * @param map copy of the map header, without the bitmap
+ * @param prefix number of leading packets in the segment, can be NULL
+ * @return int_fast8_t DAO_ERROR if the image has no packet maps
+ */
+int_fast8_t daoShmGetPacketMap(IMAGE *image, uint32_t segment_idx, DAO_PACKET_MAP *map, uint32_t *prefix)
+{
+    daoTrace("\n");
+    volatile DAO_PACKET_MAP *packetMap = daoShmPacketMap(image, segment_idx % image->md[0].fifo_size);
 
+    if (packetMap == NULL)
+    {
+        return DAO_ERROR;
+    }
+    memcpy(map, (const void *)packetMap, sizeof(DAO_PACKET_MAP));
+    daoFenceAcquire();
+    if (prefix != NULL)
+    {
+        *prefix = (map->frameNumber < DAO_PACKET_LOCKED) ? daoShmPacketPrefix(packetMap, map->packetTotal) : 0;
+    }
     return DAO_SUCCESS;
 }
 
+/*
+ * Common body of daoShmWaitWritten and daoShmWaitPacketPrefix: wait until the first nbElem
+ * elements of the frame after the newest are written, according to the packet map of its
+ * segment if there is one, to the filled mark of its record otherwise.
+ */
+static int_fast8_t daoShmWaitPrefix(IMAGE *image, uint64_t nbElem, uint64_t timeoutNs,
+                                    uint32_t *segment_idx, uint64_t *frameNumber)
+{
+    volatile IMAGE_METADATA *vol_md = (volatile IMAGE_METADATA *)image->md;
+    volatile DAO_FRAME_RECORD *vol_record = (volatile DAO_FRAME_RECORD *)image->record;
+    uint32_t fifo_size = image->md[0].fifo_size;
+    uint32_t head = vol_md[0].fifo_last_written;
+    uint32_t idx = (head + 1) % fifo_size;
+    uint64_t cnt0 = vol_record[head].cnt0;
+    volatile DAO_PACKET_MAP *map = daoShmPacketMap(image, idx);
+    uint64_t start = daoWaitNow();
+
+    if (nbElem > image->md[0].nelement)
+    {
+        nbElem = image->md[0].nelement;
+    }
+    *segment_idx = idx;
+    for (;;)
+    {
+        uint64_t newest = daoShmNewestCnt0(image);
+
+        if (newest > cnt0)
+        {
+            // committed
+            if (newest - cnt0 >= fifo_size)
+            {
+                return DAO_OVERWRITE;
+            }
+            if (frameNumber != NULL)
+            {
+                *frameNumber = vol_record[idx].frameId;
+            }
+            return DAO_SUCCESS;
+        }
+        if (map == NULL)
+        {
+            uint64_t filled = vol_record[idx].filled;
+            daoFenceAcquire();
+            if (filled >= nbElem)
+            {
+                return DAO_SUCCESS;
+            }
+        }
+        else
+        {
+            uint64_t current = map->frameNumber;
+            daoFenceAcquire();
+            if (current < DAO_PACKET_LOCKED
+                && (uint64_t)daoShmPacketPrefix(map, map->packetTotal) * map->packetElems >= nbElem
+                && map->frameNumber == current)
+            {
+                if (frameNumber != NULL)
+                {
+                    *frameNumber = current;
+                }
+                return DAO_SUCCESS;
+            }
+        }
+        if (timeoutNs > 0 && daoWaitNow() - start > timeoutNs)
+        {
+            return DAO_TIMEOUT;
+        }
+        daoCpuRelax();
+    }
+}
+
+/**
+ * @brief Wait until the first nbElem elements of the frame being written are in the segment
+ * 
+ * The frame is the one after the newest at the time of the call. The progress comes from
+ * the packet map with DAO_SHM_OPTIONS::packetMax, otherwise from the in-order partial writes
+ * of daoShmImagePart2Shm (DAO_FRAME_RECORD::filled). The wait also ends when the frame is
+ * committed, so writers of whole frames are supported too.
+ * 
+ * @param image 
+ * @param nbElem number of leading elements needed, e.g. (k + 1) * size[0] for rows 0..k
+ * @param timeoutNs maximum wait [ns], 0 to wait forever
+ * @param segment_idx FIFO index of the segment of the frame
+ * @return int_fast8_t DAO_SUCCESS, DAO_TIMEOUT, DAO_OVERWRITE if the segment is already being rewritten
+ */
+int_fast8_t daoShmWaitWritten(IMAGE *image, uint64_t nbElem, uint64_t timeoutNs, uint32_t *segment_idx)
+{
+    daoTrace("\n");
+    return daoShmWaitPrefix(image, nbElem, timeoutNs, segment_idx, NULL);
+}
+
+/**
+ * @brief Wait until the first nbElem elements of the frame in assembly are written
+ * 
+ * As daoShmWaitWritten, for images with packet maps, also returning the frame number.
+ * 
+ * @param image 
+ * @param nbElem number of leading elements needed
+ * @param timeoutNs maximum wait [ns], 0 to wait forever
+ * @param segment_idx FIFO index of the segment of the frame
+ * @param frameNumber number of the frame, can be NULL
+ * @return int_fast8_t DAO_SUCCESS, DAO_TIMEOUT, DAO_OVERWRITE if the segment is already being
+ *         rewritten, DAO_ERROR if the image has no packet maps
+ */
+int_fast8_t daoShmWaitPacketPrefix(IMAGE *image, uint64_t nbElem, uint64_t timeoutNs,
+                                   uint32_t *segment_idx, uint64_t *frameNumber)
+{
+    daoTrace("\n");
+    if (image->md[0].packetMax == 0)
+    {
+        return DAO_ERROR;
+    }
+    return daoShmWaitPrefix(image, nbElem, timeoutNs, segment_idx, frameNumber);
+}
+
 /**
  * @brief Post a semaphore
  * 
@@ -2980,4 +5531,30 @@ int_fast8_t daoSemLogPost(IMAGE *image)
     }
     #endif
     return DAO_SUCCESS;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Bump the futex sequence word and wake all the readers blocked on it
+ * 
+ * The wake system call is only issued when a reader is registered as waiting.
+ * 
+ * @param image 
+ * @return int_fast8_t 
+ */
+int_fast8_t daoFutexPost(IMAGE *image)
+{
+    daoTrace("\n");
+
+#ifdef _WIN32
+    InterlockedIncrement((volatile LONG *)&image->md[0].futexSeq);
+#else
+    __atomic_add_fetch(&image->md[0].futexSeq, 1, __ATOMIC_SEQ_CST);
+#endif
+#if defined(__linux__)
+    if (__atomic_load_n(&image->md[0].futexWaiters, __ATOMIC_SEQ_CST) > 0)
+    {
+        daoFutex(&image->md[0].futexSeq, FUTEX_WAKE, INT_MAX, NULL, 0);
+    }
+#endif
+    return DAO_SUCCESS;
+}
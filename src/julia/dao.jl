@@ -41,15 +41,19 @@ struct TIMESPECFIXED
 end
 
 # Image metadata structure, including various fields like name, size, data type, etc.
+# Mirrors IMAGE_METADATA of dao.h field by field, including the padding added by
+# DAO_CACHELINE_ALIGN, so that sizeof(IMAGE_METADATA) is the same as in C (4544 bytes on Linux)
+@static if Sys.isapple()
 struct IMAGE_METADATA
     name::NTuple{80, Cchar}         # Image Name
     naxis::uint8_t                  # Number of axes (1, 2, or 3)
     size::NTuple{3, uint32_t}       # Size along each axis
     nelement::uint64_t              # Total number of elements
     atype::uint8_t                  # Data type
+    recordOffset::uint32_t          # Offset of the DAO_FRAME_RECORD ring (first md only)
     creation_time::double           # Creation time since process start
     last_access::double             # Last access time since process start
-    atime::Union{TIMESPECFIXED}     # Acquisition time, fixed size
+    atime::TIMESPECFIXED            # Acquisition time, fixed size, on its own cache line
     shared::uint8_t                 # 1 if in shared memory
     status::uint8_t                 # Image status (logging, etc.)
     logflag::uint8_t                # Logging flag
@@ -64,9 +68,135 @@ struct IMAGE_METADATA
     packetNb::uint32_t              # Packet number (for partial writes)
     packetTotal::uint32_t           # Total number of packets (for partial writes)
     lastNbArray::NTuple{512, uint64_t} # Array for additional data, size to be adjusted
+    semCounter::NTuple{10, uint32_t} # Semaphore counters (macOS only)
+    semLogCounter::uint32_t         # Logging semaphore counter (macOS only)
+    fifo_size::uint32_t             # Number of segments of the FIFO
+    fifo_last_written::uint32_t     # Last segment written
+    futexSeq::uint32_t              # Incremented on every post (first md only)
+    syncFlags::uint8_t              # DAO_SYNC_* mechanisms posted by the writer
+    pad_allocFlags::NTuple{63, uint8_t} # DAO_CACHELINE_ALIGN padding
+    allocFlags::uint8_t             # DAO_SHM_* allocation flags (first md only)
+    numaNode::int16_t               # NUMA node of the pages, -1 if not bound (first md only)
+    layoutVersion::uint8_t          # DAO_SHM_LAYOUT_VERSION (first md only)
+    dataOffset::uint64_t            # Offset of segment 0 from the start of the file
+    segmentStride::uint64_t         # Distance between two segments
+    readerOffset::uint32_t          # Offset of the DAO_READER_CURSOR table, 0 if none
+    maxReaders::uint32_t            # Number of reader cursors
+    packetOffset::uint32_t          # Offset of the DAO_PACKET_MAP of segment 0, 0 if none
+    packetStride::uint32_t          # Distance between two packet maps
+    packetMax::uint32_t             # Number of bits of every completion bitmap
+    traceOffset::uint32_t           # Offset of the DAO_FRAME_TRACE of segment 0, 0 if none
+    pad_futexWaiters::NTuple{16, uint8_t} # DAO_CACHELINE_ALIGN padding
+    futexWaiters::uint32_t          # Readers blocked on futexSeq (first md only)
+    pad_mpscReserve::NTuple{60, uint8_t} # DAO_CACHELINE_ALIGN padding
+    mpscReserve::uint64_t           # Next DAO_SHM_MPSC ticket (first md only)
+    mpscCommit::uint64_t            # Ticket allowed to publish next (first md only)
+    pad_end::NTuple{48, uint8_t}    # Pads the size to a multiple of a cache line
+end
+else
+struct IMAGE_METADATA
+    name::NTuple{80, Cchar}         # Image Name
+    naxis::uint8_t                  # Number of axes (1, 2, or 3)
+    size::NTuple{3, uint32_t}       # Size along each axis
+    nelement::uint64_t              # Total number of elements
+    atype::uint8_t                  # Data type
+    recordOffset::uint32_t          # Offset of the DAO_FRAME_RECORD ring (first md only)
+    creation_time::double           # Creation time since process start
+    last_access::double             # Last access time since process start
+    atime::TIMESPECFIXED            # Acquisition time, fixed size, on its own cache line
+    shared::uint8_t                 # 1 if in shared memory
+    status::uint8_t                 # Image status (logging, etc.)
+    logflag::uint8_t                # Logging flag
+    sem::uint16_t                   # Number of semaphores in use
+    cnt0::uint64_t                  # General purpose counter
+    cnt1::uint64_t                  # In 3D buffer, last slice written
+    cnt2::uint64_t                  # In event mode, number of events
+    write::uint8_t                  # 1 if image is being written
+    NBkw::uint16_t                  # Number of keywords
+    lastPos::uint32_t               # Position of the last write
+    lastNb::uint32_t                # Number of last write
+    packetNb::uint32_t              # Packet number (for partial writes)
+    packetTotal::uint32_t           # Total number of packets (for partial writes)
+    lastNbArray::NTuple{512, uint64_t} # Array for additional data, size to be adjusted
+    fifo_size::uint32_t             # Number of segments of the FIFO
+    fifo_last_written::uint32_t     # Last segment written
+    futexSeq::uint32_t              # Incremented on every post (first md only)
+    syncFlags::uint8_t              # DAO_SYNC_* mechanisms posted by the writer
+    pad_allocFlags::NTuple{43, uint8_t} # DAO_CACHELINE_ALIGN padding
+    allocFlags::uint8_t             # DAO_SHM_* allocation flags (first md only)
+    numaNode::int16_t               # NUMA node of the pages, -1 if not bound (first md only)
+    layoutVersion::uint8_t          # DAO_SHM_LAYOUT_VERSION (first md only)
+    dataOffset::uint64_t            # Offset of segment 0 from the start of the file
+    segmentStride::uint64_t         # Distance between two segments
+    readerOffset::uint32_t          # Offset of the DAO_READER_CURSOR table, 0 if none
+    maxReaders::uint32_t            # Number of reader cursors
+    packetOffset::uint32_t          # Offset of the DAO_PACKET_MAP of segment 0, 0 if none
+    packetStride::uint32_t          # Distance between two packet maps
+    packetMax::uint32_t             # Number of bits of every completion bitmap
+    traceOffset::uint32_t           # Offset of the DAO_FRAME_TRACE of segment 0, 0 if none
+    pad_futexWaiters::NTuple{16, uint8_t} # DAO_CACHELINE_ALIGN padding
+    futexWaiters::uint32_t          # Readers blocked on futexSeq (first md only)
+    pad_mpscReserve::NTuple{60, uint8_t} # DAO_CACHELINE_ALIGN padding
+    mpscReserve::uint64_t           # Next DAO_SHM_MPSC ticket (first md only)
+    mpscCommit::uint64_t            # Ticket allowed to publish next (first md only)
+    pad_end::NTuple{48, uint8_t}    # Pads the size to a multiple of a cache line
+end
+end
+
+# Wait policy of a reader, see daoShmSetWaitPolicy
+struct DAO_WAIT_POLICY
+    spinNs::uint64_t           # Pure busy-spin phase duration [ns]
+    backoffNs::uint64_t        # Bounded spin with backoff phase duration [ns]
+    block::uint8_t             # DAO_WAIT_BLOCK_POLL, DAO_WAIT_BLOCK_FUTEX or DAO_WAIT_BLOCK_SEM
+    semNb::int32_t             # Semaphore used by DAO_WAIT_BLOCK_SEM
+end
+
+# Time spent by a reader in each phase of its waits
+struct DAO_WAIT_STATS
+    nWaits::uint64_t
+    spinNs::uint64_t
+    backoffNs::uint64_t
+    blockNs::uint64_t
+    nSpinWakes::uint64_t
+    nBackoffWakes::uint64_t
+    nBlockWakes::uint64_t
+    lastSpinNs::uint64_t
+    lastBackoffNs::uint64_t
+    lastBlockNs::uint64_t
+end
+
+# Per segment record of the frame, published with a seqlock
+struct DAO_FRAME_RECORD
+    seq::uint32_t              # Odd while the segment is being written
+    tag::uint32_t
+    cnt0::uint64_t             # Value of cnt0 the frame was published with
+    frameId::uint64_t
+    atimeNs::uint64_t
+    writeNs::uint64_t
+    filled::uint64_t
+    reserved::NTuple{2, uint64_t}
+end
+
+const DAO_TRACE_MAX_STAMPS = 10
+
+# One stage of the path of a frame through the pipeline
+struct DAO_TRACE_STAMP
+    stageId::uint32_t
+    reserved::uint32_t
+    enterTsc::uint64_t
+    exitTsc::uint64_t
+end
+
+# Path of a frame through the pipeline
+struct DAO_FRAME_TRACE
+    originId::uint64_t
+    nbStamp::uint32_t
+    dropped::uint32_t
+    stamp::NTuple{DAO_TRACE_MAX_STAMPS, DAO_TRACE_STAMP}
 end
 
 # The main IMAGE structure, including metadata, data array, and semaphores
+# Mirrors IMAGE of dao.h (sizeof 632 bytes), the C functions write every field
 struct IMAGE
     name::NTuple{80, Cchar}    # Local name
     used::uint8_t              # Usage flag: 1 if used, 0 otherwise
@@ -79,6 +209,17 @@ struct IMAGE
     kw::Ptr{IMAGE_KEYWORD}     # Pointer to IMAGE_KEYWORD array
     semReadPID::Ptr{int32_t}   # PIDs of processes waiting to read
     semWritePID::Ptr{int32_t}  # PID of the process writing the data
+    fifo_last_read::uint32_t   # Last segment read by this reader
+    fifo_last_read_cnt0::uint64_t # cnt0 of the last segment read
+    futex_last_seq::uint32_t   # Last md.futexSeq consumed by this reader
+    wait_policy::DAO_WAIT_POLICY # Wait policy of this reader
+    wait_stats::DAO_WAIT_STATS # Wait statistics of this reader
+    reader::Ptr{Cvoid}          # DAO_READER_CURSOR of this reader, if registered
+    record::Ptr{DAO_FRAME_RECORD} # DAO_FRAME_RECORD ring, one per segment
+    record_next::DAO_FRAME_RECORD # Record of the frame being written
+    type::Ptr{Cvoid}            # DAO_TYPE_INFO of atype
+    trace::Ptr{DAO_FRAME_TRACE} # DAO_FRAME_TRACE of segment 0, C_NULL if none
+    trace_next::DAO_FRAME_TRACE # Trace of the frame being written
 end
 
 
@@ -127,6 +268,13 @@ function daoShmImageCreateSem(image::Ptr{IMAGE}, NBsem::Int64)
     return result
 end
 
+# daoShmConvertToFloat wrapper
+function daoShmConvertToFloat(src::Ptr{Cvoid}, atype::UInt8, dst::Ptr{Float32}, n::UInt64)
+    result = ccall((:daoShmConvertToFloat, libda), Cint,
+                   (Ptr{Cvoid}, UInt8, Ptr{Float32}, UInt64), src, atype, dst, n)
+    return result
+end
+
 # daoShmImageCreate wrapper
 function daoShmImageCreate(image::Ptr{IMAGE}, name::String, naxis::Int64, size::Ptr{UInt32}, atype::UInt8, shared::Cint, NBkw::Cint)
     result = ccall((:daoShmImageCreate, libda), Cint,
@@ -208,6 +356,8 @@ function create_shm(name, data)
         atype = 9
     elseif eltype(data) == Float64 
         atype = 10
+    elseif eltype(data) == Float16
+        atype = 13
     else
         error("Unsupported type")
     end
@@ -290,6 +440,12 @@ function get_data(image, ;check::Bool=false, semNb::Int=0, spin::Bool=false)
         data = unsafe_wrap(Array, Ptr{Float32}(image.x.array), (sx,sy))
     elseif atype == 10
         data = unsafe_wrap(Array, Ptr{Float64}(image.x.array), (sx,sy))
+    elseif atype == 13
+        data = unsafe_wrap(Array, Ptr{Float16}(image.x.array), (sx,sy))
+    elseif atype == 14
+        # no native bfloat16, return a Float32 copy
+        data = Array{Float32}(undef, sx, sy)
+        dao.daoShmConvertToFloat(Ptr{Cvoid}(image.x.array), UInt8(atype), pointer(data), UInt64(sx * sy))
     else
         error("Unknown type")
     end
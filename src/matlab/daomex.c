@@ -281,6 +281,14 @@ void get_data(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         double *src = selectedImage[0].array.D;
         memcpy(dest, src, numRows * numCols * sizeof(double));
     }
+    else if (selectedImage[0].md[0].atype == _DATATYPE_FLOAT16
+             || selectedImage[0].md[0].atype == _DATATYPE_BFLOAT16)
+    {
+        // 16-bit floats are returned as single
+        dataMatrix = mxCreateNumericMatrix(numRows, numCols, mxSINGLE_CLASS, mxREAL);
+        daoShmConvertToFloat(selectedImage[0].array.V, selectedImage[0].md[0].atype,
+                             (float *)mxGetData(dataMatrix), (uint64_t)numRows * numCols);
+    }
 
 
 
@@ -316,7 +324,71 @@ void set_data(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     int numRows = mxGetM(data);
     int numCols = mxGetN(data);
 
-    daoShmImage2Shm(mxGetData(data), numRows*numCols, &selectedImage[0]);
+    uint64_t nbVal = (uint64_t)numRows * numCols;
+    uint8_t atype = selectedImage[0].md[0].atype;
+    int_fast8_t rval;
+
+    if (nbVal > selectedImage[0].md[0].nelement)
+    {
+        mexErrMsgIdAndTxt("MATLAB:set_data:tooManyElements",
+                          "%d x %d data does not fit in %s (%llu elements).", numRows, numCols,
+                          selectedImage[0].name, (unsigned long long)selectedImage[0].md[0].nelement);
+    }
+
+    if (atype == _DATATYPE_FLOAT16 || atype == _DATATYPE_BFLOAT16)
+    {
+        // 16-bit floats are converted from single or double into the next segment
+        const float *src = (const float *)mxGetData(data);
+        float *converted = NULL;
+        void *slot;
+        uint32_t slotIdx;
+
+        if (dataType == mxDOUBLE_CLASS)
+        {
+            const double *values = (const double *)mxGetData(data);
+            converted = (float *)mxMalloc(nbVal * sizeof(float));
+            for (uint64_t k = 0; k < nbVal; k++)
+            {
+                converted[k] = (float)values[k];
+            }
+            src = converted;
+        }
+        else if (dataType != mxSINGLE_CLASS)
+        {
+            mexErrMsgIdAndTxt("MATLAB:set_data:invalidDataType",
+                              "%s data cannot be written to a 16-bit float image, use single or double.",
+                              dataTypeName);
+        }
+
+        rval = daoShmAcquireWriteSlot(&selectedImage[0], &slot, &slotIdx);
+        if (rval == DAO_SUCCESS)
+        {
+            // the slot is committed in any case, an acquired slot blocks the other writers
+            int_fast8_t convert = daoShmConvertFromFloat(src, slot, atype, nbVal);
+            rval = daoShmCommitWriteSlot(&selectedImage[0], slotIdx);
+            if (convert != DAO_SUCCESS)
+            {
+                rval = convert;
+            }
+        }
+        mxFree(converted);
+    }
+    else
+    {
+        // the data is copied as is, its elements must have the size of the image ones
+        if (mxGetElementSize(data) != selectedImage[0].type->size)
+        {
+            mexErrMsgIdAndTxt("MATLAB:set_data:invalidDataType",
+                              "%s data does not match the data type of %s.", dataTypeName, selectedImage[0].name);
+        }
+        rval = daoShmImage2Shm(mxGetData(data), (uint32_t)nbVal, &selectedImage[0]);
+    }
+    if (rval != DAO_SUCCESS)
+    {
+        mexErrMsgIdAndTxt("MATLAB:set_data:daoError",
+                          "Writing %s failed.", selectedImage[0].name);
+    }
+
     // Print the type and size information
     daoDebug("Received data type: %s\n", dataTypeName);
     daoDebug("Received data size: %d x %d\n", numRows, numCols);
@@ -18,6 +18,11 @@ import datetime
 import ctypes
 import logging
 import daoLog
+# numpy has no bfloat16, ml_dtypes provides one. Without it BFLOAT16 data is returned as raw uint16 bits
+try:
+    from ml_dtypes import bfloat16 as npBfloat16
+except ImportError:
+    npBfloat16 = np.uint16
 # Load the shared library
 
 logFile = "/tmp/daolog.txt"
@@ -119,7 +124,8 @@ def npType2CtypesType(npArray):
         np.float32: ctypes.c_float,
         np.float64: ctypes.c_double,
         np.complex64: Complex64,
-        np.complex128: Complex128
+        np.complex128: Complex128,
+        np.float16: ctypes.c_uint16
     }.get(npType)
 
     return ctypesType
@@ -138,8 +144,12 @@ def npType2DaoType(npArray):
         np.float32: 9,
         np.float64: 10,
         np.complex64: 11,
-        np.complex128: 12
-    }.get(npType)
+        np.complex128: 12,
+        np.float16: 13
+    }
+    if npBfloat16 is not np.uint16:
+        daoType[npBfloat16] = 14
+    daoType = daoType.get(npType)
 
     return daoType
 
@@ -156,11 +166,22 @@ def daoType2NpType(daoType):
         9: np.float32,
         10: np.float64,
         11: np.complex64,
-        12: np.complex128
+        12: np.complex128,
+        13: np.float16,
+        14: npBfloat16
     }.get(daoType)
 
     return npType
 
+def daoAsNpType(data, daoType):
+    '''
+    Cast data read from the SHM to the numpy type of daoType.
+    16-bit floats are read as uint16 and reinterpreted, not converted.
+    '''
+    if daoType == 13 or daoType == 14:
+        return data.view(daoType2NpType(daoType))
+    return data.astype(daoType2NpType(daoType))
+
 def daoType2CtypesType(daoType):
     ctypesType = {
         1: ctypes.c_uint8,
@@ -174,7 +195,9 @@ def daoType2CtypesType(daoType):
         9: ctypes.c_float,
         10: ctypes.c_double,
         11: Complex64,
-        12: Complex128
+        12: Complex128,
+        13: ctypes.c_uint16,
+        14: ctypes.c_uint16
     }.get(daoType)
 
     return ctypesType
@@ -192,6 +215,90 @@ class TIMESPECFIXED(ctypes.Structure):
         ('secondlong', ctypes.c_int64)
     ]
 
+class DAO_SHM_OPTIONS(ctypes.Structure):
+    _fields_ = [
+        ('flags', ctypes.c_uint32),
+        ('numaNode', ctypes.c_int32),
+        ('packetMax', ctypes.c_uint32),
+        ('trace', ctypes.c_uint32)
+    ]
+
+class DAO_WAIT_POLICY(ctypes.Structure):
+    _fields_ = [
+        ('spinNs', ctypes.c_uint64),
+        ('backoffNs', ctypes.c_uint64),
+        ('block', ctypes.c_uint8),
+        ('semNb', ctypes.c_int32)
+    ]
+
+class DAO_WAIT_STATS(ctypes.Structure):
+    _fields_ = [
+        ('nWaits', ctypes.c_uint64),
+        ('spinNs', ctypes.c_uint64),
+        ('backoffNs', ctypes.c_uint64),
+        ('blockNs', ctypes.c_uint64),
+        ('nSpinWakes', ctypes.c_uint64),
+        ('nBackoffWakes', ctypes.c_uint64),
+        ('nBlockWakes', ctypes.c_uint64),
+        ('lastSpinNs', ctypes.c_uint64),
+        ('lastBackoffNs', ctypes.c_uint64),
+        ('lastBlockNs', ctypes.c_uint64)
+    ]
+
+class DAO_READER_CURSOR(ctypes.Structure):
+    _fields_ = [
+        ('pid', ctypes.c_int32),
+        ('readerId', ctypes.c_uint32),
+        ('flags', ctypes.c_uint32),
+        ('lastIdx', ctypes.c_uint32),
+        ('lastCnt0', ctypes.c_uint64),
+        ('heartbeatNs', ctypes.c_uint64),
+        ('name', ctypes.c_char * 32)
+    ]
+
+DAO_MAX_READERS = 32
+
+class DAO_FRAME_RECORD(ctypes.Structure):
+    _fields_ = [
+        ('seq', ctypes.c_uint32),
+        ('tag', ctypes.c_uint32),
+        ('cnt0', ctypes.c_uint64),
+        ('frameId', ctypes.c_uint64),
+        ('atimeNs', ctypes.c_uint64),
+        ('writeNs', ctypes.c_uint64),
+        ('filled', ctypes.c_uint64),
+        ('reserved', ctypes.c_uint64 * 2)
+    ]
+
+DAO_TRACE_MAX_STAMPS = 10
+
+class DAO_TRACE_STAMP(ctypes.Structure):
+    _fields_ = [
+        ('stageId', ctypes.c_uint32),
+        ('reserved', ctypes.c_uint32),
+        ('enterTsc', ctypes.c_uint64),
+        ('exitTsc', ctypes.c_uint64)
+    ]
+
+class DAO_FRAME_TRACE(ctypes.Structure):
+    _fields_ = [
+        ('originId', ctypes.c_uint64),
+        ('nbStamp', ctypes.c_uint32),
+        ('dropped', ctypes.c_uint32),
+        ('stamp', DAO_TRACE_STAMP * DAO_TRACE_MAX_STAMPS)
+    ]
+
+class DAO_PACKET_MAP(ctypes.Structure):
+    _fields_ = [
+        ('frameNumber', ctypes.c_uint64),
+        ('received', ctypes.c_uint32),
+        ('packetTotal', ctypes.c_uint32),
+        ('packetElems', ctypes.c_uint32),
+        ('writers', ctypes.c_uint32),
+        ('startNs', ctypes.c_uint64),
+        ('reserved', ctypes.c_uint64 * 4)
+    ]
+
 class IMAGE_KEYWORD(ctypes.Structure):
     _fields_ = [
         ("name", ctypes.c_char * 16),
@@ -200,6 +307,24 @@ class IMAGE_KEYWORD(ctypes.Structure):
         ("comment", ctypes.c_char * 80)
     ]
 
+def cachelineAligned(fields, aligned=("atime", "allocFlags", "futexWaiters", "mpscReserve"), line=64):
+    ''' --------------------------------------------------------------
+    Insert the padding added by DAO_CACHELINE_ALIGN in dao.h: the aligned
+    members start on a cache line and the structure size is a multiple of it
+    -------------------------------------------------------------- '''
+    def end(head):
+        marker = type('Head', (ctypes.Structure,), {'_fields_': head + [('end', ctypes.c_uint8 * 0)]})
+        return marker.end.offset
+
+    padded = []
+    for field in fields:
+        if field[0] in aligned and -end(padded) % line:
+            padded.append(('pad_' + field[0], ctypes.c_uint8 * (-end(padded) % line)))
+        padded.append(field)
+    if -end(padded) % line:
+        padded.append(('pad_end', ctypes.c_uint8 * (-end(padded) % line)))
+    return padded
+
 # Define the IMAGE_METADATA structure
 if sys.platform == "darwin":
     # Define the IMAGE_METADATA structure
@@ -210,12 +335,13 @@ if sys.platform == "darwin":
                 ("tsfixed", TIMESPECFIXED)
             ]
 
-        _fields_ = [
+        _fields_ = cachelineAligned([
             ("name", ctypes.c_char * 80),
             ("naxis", ctypes.c_uint8),
             ("size", ctypes.c_uint32 * 3),
             ("nelement", ctypes.c_uint64),
             ("atype", ctypes.c_uint8),
+            ("recordOffset", ctypes.c_uint32),
             ("creation_time", ctypes.c_double),
             ("last_access", ctypes.c_double),
             ("atime", ATIME),
@@ -236,8 +362,24 @@ if sys.platform == "darwin":
             ("semCounter", ctypes.c_uint32 * 10),
             ("semLogCounter", ctypes.c_uint32),
             ("fifo_size", ctypes.c_uint32),
-            ("fifo_last_written", ctypes.c_uint32)
-        ]
+            ("fifo_last_written", ctypes.c_uint32),
+            ("futexSeq", ctypes.c_uint32),
+            ("syncFlags", ctypes.c_uint8),
+            ("allocFlags", ctypes.c_uint8),
+            ("numaNode", ctypes.c_int16),
+            ("layoutVersion", ctypes.c_uint8),
+            ("dataOffset", ctypes.c_uint64),
+            ("segmentStride", ctypes.c_uint64),
+            ("readerOffset", ctypes.c_uint32),
+            ("maxReaders", ctypes.c_uint32),
+            ("packetOffset", ctypes.c_uint32),
+            ("packetStride", ctypes.c_uint32),
+            ("packetMax", ctypes.c_uint32),
+            ("traceOffset", ctypes.c_uint32),
+            ("futexWaiters", ctypes.c_uint32),
+            ("mpscReserve", ctypes.c_uint64),
+            ("mpscCommit", ctypes.c_uint64)
+        ])
 else:
     # Define the IMAGE_METADATA structure
     class IMAGE_METADATA(ctypes.Structure):
@@ -247,12 +389,13 @@ else:
                 ("tsfixed", TIMESPECFIXED)
             ]
 
-        _fields_ = [
+        _fields_ = cachelineAligned([
             ("name", ctypes.c_char * 80),
             ("naxis", ctypes.c_uint8),
             ("size", ctypes.c_uint32 * 3),
             ("nelement", ctypes.c_uint64),
             ("atype", ctypes.c_uint8),
+            ("recordOffset", ctypes.c_uint32),
             ("creation_time", ctypes.c_double),
             ("last_access", ctypes.c_double),
             ("atime", ATIME),
@@ -271,8 +414,24 @@ else:
             ("packetTotal", ctypes.c_uint32),
             ("lastNbArray", ctypes.c_uint64 * 512),
             ("fifo_size", ctypes.c_uint32),
-            ("fifo_last_written", ctypes.c_uint32)
-        ]
+            ("fifo_last_written", ctypes.c_uint32),
+            ("futexSeq", ctypes.c_uint32),
+            ("syncFlags", ctypes.c_uint8),
+            ("allocFlags", ctypes.c_uint8),
+            ("numaNode", ctypes.c_int16),
+            ("layoutVersion", ctypes.c_uint8),
+            ("dataOffset", ctypes.c_uint64),
+            ("segmentStride", ctypes.c_uint64),
+            ("readerOffset", ctypes.c_uint32),
+            ("maxReaders", ctypes.c_uint32),
+            ("packetOffset", ctypes.c_uint32),
+            ("packetStride", ctypes.c_uint32),
+            ("packetMax", ctypes.c_uint32),
+            ("traceOffset", ctypes.c_uint32),
+            ("futexWaiters", ctypes.c_uint32),
+            ("mpscReserve", ctypes.c_uint64),
+            ("mpscCommit", ctypes.c_uint64)
+        ])
     
 
 if sys.platform == "win32":
@@ -309,7 +468,16 @@ if sys.platform == "win32":
             ('semWritePID', ctypes.POINTER(ctypes.c_int32)),
             ('shmfm', ctypes.POINTER(ctypes.c_void_p)),
             ('fifo_last_read', ctypes.c_uint32),
-            ('fifo_last_read_cnt0', ctypes.c_uint64)
+            ('fifo_last_read_cnt0', ctypes.c_uint64),
+            ('futex_last_seq', ctypes.c_uint32),
+            ('wait_policy', DAO_WAIT_POLICY),
+            ('wait_stats', DAO_WAIT_STATS),
+            ('reader', ctypes.c_void_p),
+            ('record', ctypes.POINTER(DAO_FRAME_RECORD)),
+            ('record_next', DAO_FRAME_RECORD),
+            ('type', ctypes.c_void_p),
+            ('trace', ctypes.POINTER(DAO_FRAME_TRACE)),
+            ('trace_next', DAO_FRAME_TRACE)
         ]
 else:
     # Define the IMAGE structure
@@ -344,7 +512,16 @@ else:
             ('semReadPID', ctypes.POINTER(ctypes.c_int32)),
             ('semWritePID', ctypes.POINTER(ctypes.c_int32)),
             ('fifo_last_read', ctypes.c_uint32),
-            ('fifo_last_read_cnt0', ctypes.c_uint64)
+            ('fifo_last_read_cnt0', ctypes.c_uint64),
+            ('futex_last_seq', ctypes.c_uint32),
+            ('wait_policy', DAO_WAIT_POLICY),
+            ('wait_stats', DAO_WAIT_STATS),
+            ('reader', ctypes.c_void_p),
+            ('record', ctypes.POINTER(DAO_FRAME_RECORD)),
+            ('record_next', DAO_FRAME_RECORD),
+            ('type', ctypes.c_void_p),
+            ('trace', ctypes.POINTER(DAO_FRAME_TRACE)),
+            ('trace_next', DAO_FRAME_TRACE)
         ]
 
 class shm:
@@ -354,7 +531,20 @@ class shm:
     DAO_OVERWRITE = -2
     DAO_NOTREADY = -3
 
-    def __init__(self, fname=None, data=None, nbkw=0, pubPort=5555, subPort=5555, subHost='localhost', logLevel=0, depth=1):
+    # allocation flags of the shared memory (DAO_SHM_* in dao.h)
+    DAO_SHM_HUGEPAGE = 0x01
+    DAO_SHM_HUGETLB = 0x02
+    DAO_SHM_POPULATE = 0x04
+    DAO_SHM_MLOCK = 0x08
+    DAO_SHM_NUMA = 0x10
+    DAO_SHM_PAGE_ALIGN = 0x20
+    DAO_SHM_COMPACT_MD = 0x40
+    DAO_SHM_MPSC = 0x80
+
+    # reader cursor flags (DAO_READER_* in dao.h)
+    DAO_READER_BACKPRESSURE = 0x01
+
+    def __init__(self, fname=None, data=None, nbkw=0, pubPort=5555, subPort=5555, subHost='localhost', logLevel=0, depth=1, flags=0, numaNode=-1, packetMax=0, trace=0):
         # int8_t daoShmInit1D(const char *name, char *prefix, uint32_t nbVal, IMAGE **image);
         self.daoShmInit1D = daoLib.daoShmInit1D
         self.daoShmInit1D.argtypes = [
@@ -413,6 +603,23 @@ class shm:
         self.daoShmImagePart2ShmFinalize.argtypes = [ctypes.POINTER(IMAGE)]
         self.daoShmImagePart2ShmFinalize.restype = ctypes.c_int8
 
+        # int8_t daoShmAcquireWriteSlot(IMAGE *image, void **slot_ptr, uint32_t *slot_idx);
+        self.daoShmAcquireWriteSlot = daoLib.daoShmAcquireWriteSlot
+        self.daoShmAcquireWriteSlot.argtypes = [ctypes.POINTER(IMAGE), ctypes.POINTER(ctypes.c_void_p),
+                                                ctypes.POINTER(ctypes.c_uint32)]
+        self.daoShmAcquireWriteSlot.restype = ctypes.c_int8
+
+        # int8_t daoShmCommitWriteSlot(IMAGE *image, uint32_t slot_idx);
+        self.daoShmCommitWriteSlot = daoLib.daoShmCommitWriteSlot
+        self.daoShmCommitWriteSlot.argtypes = [ctypes.POINTER(IMAGE), ctypes.c_uint32]
+        self.daoShmCommitWriteSlot.restype = ctypes.c_int8
+
+        # int8_t daoShmConvertFromFloat(const float *src, void *dst, uint8_t atype, uint64_t n);
+        self.daoShmConvertFromFloat = daoLib.daoShmConvertFromFloat
+        self.daoShmConvertFromFloat.argtypes = [ctypes.POINTER(ctypes.c_float), ctypes.c_void_p, ctypes.c_uint8,
+                                                ctypes.c_uint64]
+        self.daoShmConvertFromFloat.restype = ctypes.c_int8
+
 
         # int8_t daoShmImageCreate_FIFO(IMAGE *image, const char *name, long naxis, uint32_t *size,
         #                              uint8_t atype, int shared, int NBkw);
@@ -429,6 +636,20 @@ class shm:
         ]
         self.daoShmImageCreate_FIFO.restype = ctypes.c_int8
 
+        self.daoShmImageCreateWithOptions = daoLib.daoShmImageCreateWithOptions
+        self.daoShmImageCreateWithOptions.argtypes = [
+            ctypes.POINTER(IMAGE),
+            ctypes.c_char_p,
+            ctypes.c_long,
+            ctypes.POINTER(ctypes.c_uint32),
+            ctypes.c_uint8,
+            ctypes.c_int,
+            ctypes.c_int,
+            ctypes.c_uint32,
+            ctypes.POINTER(DAO_SHM_OPTIONS)
+        ]
+        self.daoShmImageCreateWithOptions.restype = ctypes.c_int8
+
         # int8_t daoShmImageCreate(IMAGE *image, const char *name, long naxis, uint32_t *size,
         #                              uint8_t atype, int shared, int NBkw);
         self.daoShmImageCreate = daoLib.daoShmImageCreate
@@ -453,6 +674,17 @@ class shm:
         ]
         self.daoShmCombineShm2Shm.restype = ctypes.c_int8
 
+        # int8_t daoShmCombineShm2ShmGain(IMAGE **imageCube, IMAGE *image, int nbChannel, int nbVal, const float *gains);
+        self.daoShmCombineShm2ShmGain = daoLib.daoShmCombineShm2ShmGain
+        self.daoShmCombineShm2ShmGain.argtypes = [
+            ctypes.POINTER(ctypes.POINTER(IMAGE)),
+            ctypes.POINTER(IMAGE),
+            ctypes.c_int,
+            ctypes.c_int,
+            ctypes.POINTER(ctypes.c_float)
+        ]
+        self.daoShmCombineShm2ShmGain.restype = ctypes.c_int8
+
         # uint64_t daoShmGetCounter(IMAGE *image);
         self.daoShmGetCounter = daoLib.daoShmGetCounter
         self.daoShmGetCounter.argtypes = [ctypes.POINTER(IMAGE)]
@@ -473,10 +705,101 @@ class shm:
         ]
         self.daoShmWaitForSemaphoreTimeout.restype = ctypes.c_int8
 
+        self.daoShmWaitForFutex = daoLib.daoShmWaitForFutex
+        self.daoShmWaitForFutex.argtypes = [ctypes.POINTER(IMAGE)]
+        self.daoShmWaitForFutex.restype = ctypes.c_int8
+
+        self.daoShmWaitForFutexTimeout = daoLib.daoShmWaitForFutexTimeout
+        self.daoShmWaitForFutexTimeout.argtypes = [
+            ctypes.POINTER(IMAGE),
+            ctypes.POINTER(timespec)
+        ]
+        self.daoShmWaitForFutexTimeout.restype = ctypes.c_int8
+
         self.daoShmWaitForCounter = daoLib.daoShmWaitForCounter
         self.daoShmWaitForCounter.argtypes = [ctypes.POINTER(IMAGE)]
         self.daoShmWaitForCounter.restype = ctypes.c_int8
 
+        self.daoShmReadConsistent = daoLib.daoShmReadConsistent
+        self.daoShmReadConsistent.argtypes = [
+            ctypes.POINTER(IMAGE),
+            ctypes.c_void_p,
+            ctypes.POINTER(ctypes.c_uint32),
+            ctypes.POINTER(ctypes.c_uint64),
+            ctypes.c_uint32
+        ]
+        self.daoShmReadConsistent.restype = ctypes.c_int8
+
+        self.daoShmSetWaitPolicy = daoLib.daoShmSetWaitPolicy
+        self.daoShmSetWaitPolicy.argtypes = [ctypes.POINTER(IMAGE), ctypes.POINTER(DAO_WAIT_POLICY)]
+        self.daoShmSetWaitPolicy.restype = ctypes.c_int8
+
+        self.daoShmGetWaitStats = daoLib.daoShmGetWaitStats
+        self.daoShmGetWaitStats.argtypes = [ctypes.POINTER(IMAGE), ctypes.POINTER(DAO_WAIT_STATS)]
+        self.daoShmGetWaitStats.restype = ctypes.c_int8
+
+        self.daoShmSetNumaNode = daoLib.daoShmSetNumaNode
+        self.daoShmSetNumaNode.argtypes = [ctypes.POINTER(IMAGE), ctypes.c_int]
+        self.daoShmSetNumaNode.restype = ctypes.c_int8
+
+        self.daoShmGetNumaNode = daoLib.daoShmGetNumaNode
+        self.daoShmGetNumaNode.argtypes = [ctypes.POINTER(IMAGE), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_float)]
+        self.daoShmGetNumaNode.restype = ctypes.c_int8
+
+        self.daoShmSetFrameInfo = daoLib.daoShmSetFrameInfo
+        self.daoShmSetFrameInfo.argtypes = [ctypes.POINTER(IMAGE), ctypes.c_uint64, ctypes.c_uint64, ctypes.c_uint32]
+        self.daoShmSetFrameInfo.restype = ctypes.c_int8
+
+        self.daoShmGetFrameRecord = daoLib.daoShmGetFrameRecord
+        self.daoShmGetFrameRecord.argtypes = [ctypes.POINTER(IMAGE), ctypes.c_uint32, ctypes.POINTER(DAO_FRAME_RECORD)]
+        self.daoShmGetFrameRecord.restype = ctypes.c_int8
+
+        self.daoShmGetFrameTrace = daoLib.daoShmGetFrameTrace
+        self.daoShmGetFrameTrace.argtypes = [ctypes.POINTER(IMAGE), ctypes.c_uint32, ctypes.POINTER(DAO_FRAME_TRACE)]
+        self.daoShmGetFrameTrace.restype = ctypes.c_int8
+
+        self.daoShmTraceTscPerNs = daoLib.daoShmTraceTscPerNs
+        self.daoShmTraceTscPerNs.argtypes = []
+        self.daoShmTraceTscPerNs.restype = ctypes.c_double
+
+        # int8_t daoShmImagePacket2Shm(void *im, IMAGE *image, uint32_t packetId, uint32_t packetTotal,
+        #                              uint64_t frameNumber);
+        self.daoShmImagePacket2Shm = daoLib.daoShmImagePacket2Shm
+        self.daoShmImagePacket2Shm.argtypes = [ctypes.c_void_p, ctypes.POINTER(IMAGE), ctypes.c_uint32,
+                                               ctypes.c_uint32, ctypes.c_uint64]
+        self.daoShmImagePacket2Shm.restype = ctypes.c_int8
+
+        self.daoShmGetPacketMap = daoLib.daoShmGetPacketMap
+        self.daoShmGetPacketMap.argtypes = [ctypes.POINTER(IMAGE), ctypes.c_uint32, ctypes.POINTER(DAO_PACKET_MAP),
+                                            ctypes.POINTER(ctypes.c_uint32)]
+        self.daoShmGetPacketMap.restype = ctypes.c_int8
+
+        self.daoShmWaitPacketPrefix = daoLib.daoShmWaitPacketPrefix
+        self.daoShmWaitPacketPrefix.argtypes = [ctypes.POINTER(IMAGE), ctypes.c_uint64, ctypes.c_uint64,
+                                                ctypes.POINTER(ctypes.c_uint32), ctypes.POINTER(ctypes.c_uint64)]
+        self.daoShmWaitPacketPrefix.restype = ctypes.c_int8
+
+        self.daoShmWaitWritten = daoLib.daoShmWaitWritten
+        self.daoShmWaitWritten.argtypes = [ctypes.POINTER(IMAGE), ctypes.c_uint64, ctypes.c_uint64,
+                                           ctypes.POINTER(ctypes.c_uint32)]
+        self.daoShmWaitWritten.restype = ctypes.c_int8
+
+        self.daoShmReaderRegister = daoLib.daoShmReaderRegister
+        self.daoShmReaderRegister.argtypes = [ctypes.POINTER(IMAGE), ctypes.c_char_p, ctypes.c_uint32]
+        self.daoShmReaderRegister.restype = ctypes.c_int8
+
+        self.daoShmReaderUnregister = daoLib.daoShmReaderUnregister
+        self.daoShmReaderUnregister.argtypes = [ctypes.POINTER(IMAGE)]
+        self.daoShmReaderUnregister.restype = ctypes.c_int8
+
+        self.daoShmGetReaders = daoLib.daoShmGetReaders
+        self.daoShmGetReaders.argtypes = [ctypes.POINTER(IMAGE), ctypes.POINTER(DAO_READER_CURSOR), ctypes.POINTER(ctypes.c_uint32)]
+        self.daoShmGetReaders.restype = ctypes.c_int8
+
+        self.daoShmGetSlowestReader = daoLib.daoShmGetSlowestReader
+        self.daoShmGetSlowestReader.argtypes = [ctypes.POINTER(IMAGE), ctypes.POINTER(ctypes.c_uint32), ctypes.POINTER(ctypes.c_uint64)]
+        self.daoShmGetSlowestReader.restype = ctypes.c_int8
+
         # new FIFO functions
         self.daoShmGetNextSegment = daoLib.daoShmGetNextSegment
         self.daoShmGetNextSegment.argtypes = [ctypes.POINTER(IMAGE), ctypes.POINTER(ctypes.c_void_p),\
@@ -519,9 +842,12 @@ class shm:
 
             log.info("%s will be created or overwritten" % (fname,))
             dataSize = data.shape
-            self.daoShmImageCreate_FIFO(ctypes.byref(self.image), fname.encode('utf-8'), len(dataSize),\
+            if numaNode >= 0:
+                flags |= self.DAO_SHM_NUMA
+            options = DAO_SHM_OPTIONS(flags, numaNode, packetMax, trace)
+            self.daoShmImageCreateWithOptions(ctypes.byref(self.image), fname.encode('utf-8'), len(dataSize),\
                                 (ctypes.c_uint32 * len(dataSize))(*dataSize),\
-                                npType2DaoType(data), 1, 0, depth)
+                                npType2DaoType(data), 1, 0, depth, ctypes.byref(options))
             if data.flags['C_CONTIGUOUS']:
                 cData = data.ctypes.data_as(ctypes.c_void_p)
             else:
@@ -556,16 +882,38 @@ class shm:
 
         Parameters:
         ----------
-        - data: the array to upload to SHM
+        - data: the array to upload to SHM, of the SHM data type. Other
+          data is converted for FLOAT16 and BFLOAT16 SHM only.
         '''
-        # Call the daoShmImage2Shm function to feel the SHM
-        if data.flags['C_CONTIGUOUS']:
-            cData = data.ctypes.data_as(ctypes.c_void_p)
+        data = np.asarray(data)
+        atype = self.image.md.contents.atype
+        if data.size > self.image.md.contents.nelement:
+            raise ValueError("%d elements do not fit in the %d of the SHM"
+                             % (data.size, self.image.md.contents.nelement))
+
+        if data.dtype != daoType2NpType(atype):
+            if atype != 13 and atype != 14:
+                raise TypeError("%s data does not match the data type of the SHM" % data.dtype)
+            # 16-bit floats are converted from float32 in the slot, as daomex does
+            converted = np.ascontiguousarray(data, dtype=np.float32)
+            slot = ctypes.c_void_p(None)
+            slotIdx = ctypes.c_uint32()
+            result = self.daoShmAcquireWriteSlot(ctypes.byref(self.image), ctypes.byref(slot),
+                                                 ctypes.byref(slotIdx))
+            if result == self.DAO_SUCCESS:
+                # the slot is committed in any case, an acquired slot blocks the other writers
+                convert = self.daoShmConvertFromFloat(converted.ctypes.data_as(ctypes.POINTER(ctypes.c_float)),
+                                                      slot, atype, converted.size)
+                result = self.daoShmCommitWriteSlot(ctypes.byref(self.image), slotIdx)
+                if convert != self.DAO_SUCCESS:
+                    result = convert
         else:
-            cData = np.ascontiguousarray(data).ctypes.data_as(ctypes.c_void_p)
-
-        nbVal = ctypes.c_uint32(data.size)
-        result = self.daoShmImage2Shm(cData, nbVal, ctypes.byref(self.image))
+            # Call the daoShmImage2Shm function to feel the SHM
+            data = np.ascontiguousarray(data)
+            result = self.daoShmImage2Shm(data.ctypes.data_as(ctypes.c_void_p), ctypes.c_uint32(data.size),
+                                          ctypes.byref(self.image))
+        if result != self.DAO_SUCCESS:
+            raise RuntimeError("Writing %s failed" % self.image.name.decode())
 
     def get_data_next(self, wait=False, reform=True):
         ''' --------------------------------------------------------------
@@ -613,7 +961,7 @@ class shm:
                 data = data['real'] + 1j * data['imag']
             
             # Cast to the desired NumPy type (e.g., complex64, complex128, or float, or...)
-            data = data.astype(daoType2NpType(self.image.md.contents.atype))
+            data = daoAsNpType(data, self.image.md.contents.atype)
         
         return (result, data)
     
@@ -660,12 +1008,12 @@ class shm:
             data = data['real'] + 1j * data['imag']
         
         # Cast to the desired NumPy type (e.g., complex64, complex128, or float, or...)
-        data = data.astype(daoType2NpType(self.image.md.contents.atype))
+        data = daoAsNpType(data, self.image.md.contents.atype)
 
         return data
     
 
-    def get_data(self, check=False, reform=True, semNb=0, timeout=0, spin=False):
+    def get_data(self, check=False, reform=True, semNb=0, timeout=0, spin=False, futex=False, consistent=False):
         ''' --------------------------------------------------------------
         Reads and returns the newest data segment of the SHM file
 
@@ -673,10 +1021,22 @@ class shm:
         ----------
         - check: integer (last index) if not False, waits image update
         - reform: boolean, if True, reshapes the array in a 2-3D format
+        - futex: boolean, if True, waits on the futex word instead of semaphore semNb
+        - consistent: boolean, if True, copies the segment out with daoShmReadConsistent
+          so that it cannot be torn by a concurrent write
         -------------------------------------------------------------- '''
         if check == True:
             if spin == True:
                 result = self.daoShmWaitForCounter(ctypes.byref(self.image))
+            elif futex == True:
+                if timeout == 0:
+                    result = self.daoShmWaitForFutex(ctypes.byref(self.image))
+                else:
+                    ts = make_timespec_from_now(timeout)
+                    result = self.daoShmWaitForFutexTimeout(ctypes.byref(self.image), ctypes.byref(ts))
+                    if result != 0:
+                        log.error("Timeout waiting for futex")
+                        return None
             else:
                 if timeout == 0:
                     # On Windows, daoShmWaitForSemaphore returns DAO_TIMEOUT
@@ -697,8 +1057,14 @@ class shm:
         seg_idx = ctypes.c_uint32(0)
         seg_cnt0 = ctypes.c_uint64(0)
         
-        result = self.daoShmGetNewestSegment(ctypes.byref(self.image), ctypes.byref(arrayPtr),\
-                                           ctypes.byref(seg_idx), ctypes.byref(seg_cnt0))
+        if consistent == True:
+            buffer = (daoType2CtypesType(self.image.md.contents.atype) * self.image.md.contents.nelement)()
+            result = self.daoShmReadConsistent(ctypes.byref(self.image), ctypes.cast(buffer, ctypes.c_void_p),\
+                                               ctypes.byref(seg_idx), ctypes.byref(seg_cnt0), 0)
+            arrayPtr = ctypes.c_void_p(ctypes.addressof(buffer))
+        else:
+            result = self.daoShmGetNewestSegment(ctypes.byref(self.image), ctypes.byref(arrayPtr),\
+                                               ctypes.byref(seg_idx), ctypes.byref(seg_cnt0))
         
         # Cast our void pointer to the desired type
         arrayPtr = ctypes.cast(arrayPtr.value,\
@@ -723,7 +1089,7 @@ class shm:
             data = data['real'] + 1j * data['imag']
         
         # Cast to the desired NumPy type (e.g., complex64, complex128, or float, or...)
-        data = data.astype(daoType2NpType(self.image.md.contents.atype))
+        data = daoAsNpType(data, self.image.md.contents.atype)
 
         return data
 
@@ -816,10 +1182,10 @@ class shm:
                 # Reconstruct complex array by combining real and imaginary parts
                 current_data = current_data['real'] + 1j * current_data['imag']
 
-            history_data[idx_offset] = current_data 
+            history_data[idx_offset] = daoAsNpType(current_data, self.image.md.contents.atype)
 
         # Cast to the desired NumPy type (e.g., complex64, complex128, or float, or...)
-        history_data = history_data.astype(daoType2NpType(self.image.md.contents.atype))
+        history_data = daoAsNpType(history_data, self.image.md.contents.atype)
 
         return history_data
 
@@ -851,7 +1217,11 @@ class shm:
             adjusted_index = index % fifo_size
             seg_idx = ctypes.c_uint32(adjusted_index)
 
-        md = self.image.md[seg_idx.value]
+        # with DAO_SHM_COMPACT_MD only md[0] exists, it holds the newest frame
+        if self.image.md.contents.allocFlags & self.DAO_SHM_COMPACT_MD:
+            md = self.image.md[0]
+        else:
+            md = self.image.md[seg_idx.value]
         self.mtdata=struct2Dict(md)
 
         #decode time
@@ -881,6 +1251,97 @@ class shm:
         -------------------------------------------------------------- '''
         return self.get_meta_data()['cnt0']
 
+    def set_frame_info(self, frameId, atimeNs, tag=0):
+        ''' --------------------------------------------------------------
+        Set the frame id, acquisition time [ns] and tag recorded with
+        the next frame written
+        -------------------------------------------------------------- '''
+        return self.daoShmSetFrameInfo(ctypes.byref(self.image), frameId, atimeNs, tag)
+
+    def get_frame_record(self, index=None):
+        ''' --------------------------------------------------------------
+        Return the record (cnt0, frameId, atimeNs, writeNs, tag) of the
+        newest segment (index=None) or of a FIFO slot
+        -------------------------------------------------------------- '''
+        if index is None:
+            index = self.image.md.contents.fifo_last_written
+        record = DAO_FRAME_RECORD()
+        self.daoShmGetFrameRecord(ctypes.byref(self.image), index, ctypes.byref(record))
+        result = struct2Dict(record)
+        del result['reserved']
+        return result
+
+    def get_frame_trace(self, index=None):
+        ''' --------------------------------------------------------------
+        Return the trace of the newest segment (index=None) or of a FIFO
+        slot: origin frame id and, for every stage, its id with the enter
+        and exit times [us] from the enter of the first stage.
+        None if the SHM was not created with trace=1.
+        -------------------------------------------------------------- '''
+        if index is None:
+            index = self.image.md.contents.fifo_last_written
+        trace = DAO_FRAME_TRACE()
+        if self.daoShmGetFrameTrace(ctypes.byref(self.image), index, ctypes.byref(trace)) != 0:
+            return None
+        tscPerUs = self.daoShmTraceTscPerNs() * 1e3
+        stamps = trace.stamp[:trace.nbStamp]
+        t0 = stamps[0].enterTsc if stamps else 0
+        return {'originId': trace.originId,
+                'dropped': trace.dropped,
+                'stages': [(s.stageId, (s.enterTsc - t0) / tscPerUs, (s.exitTsc - t0) / tscPerUs)
+                           for s in stamps]}
+
+    def set_packet(self, packet, packetId, packetTotal, frameNumber):
+        ''' --------------------------------------------------------------
+        Write one packet of a frame (SHM created with packetMax > 0).
+        The frame is committed when its packetTotal packets are written.
+        -------------------------------------------------------------- '''
+        packet = np.ascontiguousarray(packet, dtype=daoType2NpType(self.image.md.contents.atype))
+        return self.daoShmImagePacket2Shm(packet.ctypes.data_as(ctypes.c_void_p), ctypes.byref(self.image),
+                                          packetId, packetTotal, frameNumber)
+
+    def get_packet_map(self, index):
+        ''' --------------------------------------------------------------
+        Return the packet map of a FIFO slot, with the number of
+        leading packets received in 'prefix'
+        -------------------------------------------------------------- '''
+        packetMap = DAO_PACKET_MAP()
+        prefix = ctypes.c_uint32(0)
+        self.daoShmGetPacketMap(ctypes.byref(self.image), index, ctypes.byref(packetMap), ctypes.byref(prefix))
+        result = struct2Dict(packetMap)
+        del result['writers']
+        del result['reserved']
+        result['prefix'] = prefix.value
+        return result
+
+    def wait_until_written(self, offset, timeout=0):
+        ''' --------------------------------------------------------------
+        Wait until the elements before offset of the frame being
+        written are in the SHM (packet maps or in-order partial writes).
+        timeout in seconds, 0 to wait forever.
+        Returns (result, FIFO index)
+        -------------------------------------------------------------- '''
+        idx = ctypes.c_uint32(0)
+        result = self.daoShmWaitWritten(ctypes.byref(self.image), offset, int(timeout * 1e9), ctypes.byref(idx))
+        return (result, idx.value)
+
+    def wait_rows(self, nbRows, timeout=0):
+        ''' --------------------------------------------------------------
+        Wait until rows 0..nbRows-1 of the frame being written are in
+        the SHM. timeout in seconds, 0 to wait forever.
+        Returns (result, FIFO index, frame number), the frame number
+        with packet maps only
+        -------------------------------------------------------------- '''
+        idx = ctypes.c_uint32(0)
+        frameNumber = ctypes.c_uint64(0)
+        nbElem = nbRows * self.image.md.contents.size[0]
+        if self.image.md.contents.packetMax > 0:
+            result = self.daoShmWaitPacketPrefix(ctypes.byref(self.image), nbElem, int(timeout * 1e9),
+                                                 ctypes.byref(idx), ctypes.byref(frameNumber))
+        else:
+            result = self.daoShmWaitWritten(ctypes.byref(self.image), nbElem, int(timeout * 1e9), ctypes.byref(idx))
+        return (result, idx.value, frameNumber.value)
+
     def get_frame_id(self,):
         ''' --------------------------------------------------------------
         Read the image counter from SHM
@@ -895,6 +1356,71 @@ class shm:
         # now I have tv_sec and tv_nsec we convert to a datetime
         return datetime.datetime.fromtimestamp(tv_sec) + datetime.timedelta(microseconds=tv_nsec/1000)
 
+    def set_wait_policy(self, spinNs=0, backoffNs=0, block=0, semNb=0):
+        ''' --------------------------------------------------------------
+        Set the spin-then-block policy used by the spin waits
+        block: 0 poll (legacy), 1 futex, 2 semaphore semNb
+        -------------------------------------------------------------- '''
+        policy = DAO_WAIT_POLICY(spinNs, backoffNs, block, semNb)
+        return self.daoShmSetWaitPolicy(ctypes.byref(self.image), ctypes.byref(policy))
+
+    def get_wait_stats(self, ):
+        ''' --------------------------------------------------------------
+        Return the time spent spinning and sleeping by the spin waits
+        -------------------------------------------------------------- '''
+        stats = DAO_WAIT_STATS()
+        self.daoShmGetWaitStats(ctypes.byref(self.image), ctypes.byref(stats))
+        return struct2Dict(stats)
+
+    def set_numa_node(self, node):
+        ''' --------------------------------------------------------------
+        Bind the SHM pages to a NUMA node (-1 removes the binding)
+        -------------------------------------------------------------- '''
+        return self.daoShmSetNumaNode(ctypes.byref(self.image), node)
+
+    def get_numa_node(self, ):
+        ''' --------------------------------------------------------------
+        Return the NUMA node holding most of the SHM pages (-1 if unknown)
+        and the fraction of the resident pages on that node
+        -------------------------------------------------------------- '''
+        node = ctypes.c_int()
+        fraction = ctypes.c_float()
+        self.daoShmGetNumaNode(ctypes.byref(self.image), ctypes.byref(node), ctypes.byref(fraction))
+        return node.value, fraction.value
+
+    def register_reader(self, name='', flags=0):
+        ''' --------------------------------------------------------------
+        Register this instance in the reader cursor table of the SHM
+        flags: DAO_READER_BACKPRESSURE to hold back the writer
+        -------------------------------------------------------------- '''
+        return self.daoShmReaderRegister(ctypes.byref(self.image), name.encode(), flags)
+
+    def unregister_reader(self, ):
+        ''' --------------------------------------------------------------
+        Release the reader cursor of this instance
+        -------------------------------------------------------------- '''
+        return self.daoShmReaderUnregister(ctypes.byref(self.image))
+
+    def get_readers(self, ):
+        ''' --------------------------------------------------------------
+        Return the cursors (pid, last cnt0, heartbeat...) of the readers
+        -------------------------------------------------------------- '''
+        cursors = (DAO_READER_CURSOR * DAO_MAX_READERS)()
+        nbReaders = ctypes.c_uint32()
+        self.daoShmGetReaders(ctypes.byref(self.image), cursors, ctypes.byref(nbReaders))
+        return [struct2Dict(cursors[k]) for k in range(nbReaders.value)]
+
+    def get_slowest_reader(self, ):
+        ''' --------------------------------------------------------------
+        Return the id and the lag in frames of the slowest reader,
+        None if no reader is registered
+        -------------------------------------------------------------- '''
+        readerId = ctypes.c_uint32()
+        lag = ctypes.c_uint64()
+        if self.daoShmGetSlowestReader(ctypes.byref(self.image), ctypes.byref(readerId), ctypes.byref(lag)) != self.DAO_SUCCESS:
+            return None
+        return readerId.value, lag.value
+
     def reset_tail(self, ):
         ''' --------------------------------------------------------------
         Reset the reading tail for this instance of the SHM
@@ -0,0 +1,186 @@
+/*****************************************************************************
+  DAO project
+  Benchmark of the SHM allocation flags (huge pages, pre-faulting, mlock)
+
+  For each combination of DAO_SHM_* flags, a deep FIFO of large frames is
+  created, then:
+   - create      : daoShmImageCreateWithOptions, which zeroes (so faults) the data
+   - first touch : one write per 4 kB page over the whole data area
+   - tlb         : reads of random pages over the whole data area (TLB misses)
+   - open        : daoShmShm2Img followed by one read per page, as a new reader
+ *****************************************************************************/
+
+/*==========================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+// DAO header
+#include "dao.h"
+
+#define PAGE 4096
+
+/*==========================================================================*/
+static uint32_t frameSize = 1024;          // frame is frameSize x frameSize floats
+static uint32_t depth = 16;                // FIFO depth
+static int nbPass = 20;                    // TLB passes
+static const char *shmDir = "/dev/shm";    // directory of the SHM files
+static const char *hugetlbDir = NULL;      // hugetlbfs mount, optional
+
+static void ShowHelp(const char *argv0)
+{
+    printf("%s of " __DATE__ " at " __TIME__ "\n", argv0);
+    printf("   arguments:\n");
+    printf("   -h               display this message and exit\n");
+    printf("   -s size          frame is size x size floats (default %u)\n", frameSize);
+    printf("   -f depth         FIFO depth (default %u)\n", depth);
+    printf("   -n passes        number of random-page passes (default %d)\n", nbPass);
+    printf("   -p dir           directory of the SHM files (default %s)\n", shmDir);
+    printf("   -H dir           hugetlbfs mount, enables the DAO_SHM_HUGETLB case\n");
+    printf("\n");
+}
+
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*--------------------------------------------------------------------------*/
+static void benchmark(const char *label, const char *dir, uint32_t flags)
+{
+    IMAGE writer;
+    IMAGE reader;
+    DAO_SHM_OPTIONS options;
+    uint32_t size[2] = { frameSize, frameSize };
+    char name[256];
+    size_t nbBytes = (size_t)frameSize * frameSize * depth * sizeof(float);
+    size_t nbPage = nbBytes / PAGE;
+    size_t *order;
+    volatile char *data;
+    double t0, tCreate, tTouch, tTlb, tOpen, tReopen;
+    size_t p;
+    int pass;
+    uint64_t sum = 0;
+
+    memset(&writer, 0, sizeof(IMAGE));
+    memset(&reader, 0, sizeof(IMAGE));
+    memset(&options, 0, sizeof(DAO_SHM_OPTIONS));
+    options.flags = flags;
+    snprintf(name, sizeof(name), "%s/allocBenchmark.im.shm", dir);
+
+    t0 = now();
+    if (daoShmImageCreateWithOptions(&writer, name, 2, size, _DATATYPE_FLOAT, 1, 0, depth, &options) != DAO_SUCCESS)
+    {
+        printf("%-24s could not create %s\n", label, name);
+        return;
+    }
+    tCreate = now() - t0;
+
+    // first touch
+    data = (volatile char *)writer.array.V;
+    t0 = now();
+    for (p = 0; p < nbPage; p++)
+    {
+        data[p * PAGE] = 1;
+    }
+    tTouch = now() - t0;
+
+    // random pages, a new TLB entry for almost every access with 4 kB pages
+    order = (size_t *)malloc(nbPage * sizeof(size_t));
+    for (p = 0; p < nbPage; p++)
+    {
+        order[p] = p;
+    }
+    srand(1);
+    for (p = nbPage - 1; p > 0; p--)
+    {
+        size_t q = (size_t)rand() % (p + 1);
+        size_t tmp = order[p];
+        order[p] = order[q];
+        order[q] = tmp;
+    }
+    t0 = now();
+    for (pass = 0; pass < nbPass; pass++)
+    {
+        for (p = 0; p < nbPage; p++)
+        {
+            sum += data[order[p] * PAGE + (pass * 64) % PAGE];
+        }
+    }
+    tTlb = now() - t0;
+
+    // a new reader mapping the stream
+    t0 = now();
+    daoShmShm2Img(name, &reader);
+    tOpen = now() - t0;
+    data = (volatile char *)reader.array.V;
+    t0 = now();
+    for (p = 0; p < nbPage; p++)
+    {
+        sum += data[p * PAGE];
+    }
+    tReopen = now() - t0;
+
+    printf("%-24s %10.2f %12.1f %12.2f %10.2f %12.1f\n", label,
+           tCreate * 1e3,
+           tTouch * 1e9 / nbPage,
+           tTlb * 1e9 / (nbPage * (double)nbPass),
+           tOpen * 1e3,
+           tReopen * 1e9 / nbPage);
+
+    free(order);
+    daoShmCloseShm(&reader);
+    daoShmCloseShm(&writer);
+    unlink(name);
+    if (sum == 42)
+    {
+        printf("\n");   // keep the reads alive
+    }
+}
+
+/*==========================================================================*/
+int main(int argc, char **argv)
+{
+    int c;
+
+    while ((c = getopt(argc, argv, "hs:f:n:p:H:")) != -1)
+    {
+        switch (c)
+        {
+            case 's': frameSize = (uint32_t)atoi(optarg); break;
+            case 'f': depth = (uint32_t)atoi(optarg); break;
+            case 'n': nbPass = atoi(optarg); break;
+            case 'p': shmDir = optarg; break;
+            case 'H': hugetlbDir = optarg; break;
+            case 'h': ShowHelp(argv[0]); return 0;
+            default:  ShowHelp(argv[0]); return 1;
+        }
+    }
+
+    daoSetLogLevel(0); // warnings and errors only
+
+    printf("%u x %u float frames, FIFO depth %u, %.1f MB of data\n\n", frameSize, frameSize, depth,
+           (double)frameSize * frameSize * depth * sizeof(float) / 1048576.0);
+    printf("%-24s %10s %12s %12s %10s %12s\n", "flags", "create[ms]", "touch[ns/pg]",
+           "tlb[ns/acc]", "open[ms]", "reader[ns/pg]");
+
+    benchmark("default", shmDir, 0);
+    benchmark("POPULATE", shmDir, DAO_SHM_POPULATE);
+    benchmark("POPULATE|MLOCK", shmDir, DAO_SHM_POPULATE | DAO_SHM_MLOCK);
+    benchmark("HUGEPAGE", shmDir, DAO_SHM_HUGEPAGE);
+    benchmark("HUGEPAGE|POPULATE", shmDir, DAO_SHM_HUGEPAGE | DAO_SHM_POPULATE);
+    benchmark("HUGEPAGE|POPULATE|MLOCK", shmDir, DAO_SHM_HUGEPAGE | DAO_SHM_POPULATE | DAO_SHM_MLOCK);
+    if (hugetlbDir != NULL)
+    {
+        benchmark("HUGETLB|POPULATE", hugetlbDir, DAO_SHM_HUGETLB | DAO_SHM_POPULATE);
+        benchmark("HUGETLB|POPULATE|MLOCK", hugetlbDir, DAO_SHM_HUGETLB | DAO_SHM_POPULATE | DAO_SHM_MLOCK);
+    }
+
+    return 0;
+}
+/*==========================================================================*/
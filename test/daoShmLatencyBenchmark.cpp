@@ -0,0 +1,420 @@
+/*****************************************************************************
+  DAO project
+  Write-to-wake latency benchmark of the SHM pipeline
+
+  A writer thread publishes frames stamped with CLOCK_MONOTONIC, reader
+  threads wait for them with one of the sync modes and record the time from
+  the stamp (taken just before the write) to their wake-up:
+   - sem     : Shm::get_frame(SEMn), one semaphore per reader
+   - futex   : Shm::get_frame(FUTEX)
+   - counter : Shm::get_frame(SPIN), daoShmWaitForCounter
+   - target  : Shm::get_frame(SPIN, cnt0), daoShmWaitForTargetCounter
+   - next    : Shm::get_next_frame(true, status), FIFO reader
+  The writer waits for every reader before the next frame, then leaves a gap
+  so that the readers are back in their wait: the latency is a wake-up, not a
+  queueing time. Frames not seen by a reader within a second are counted as
+  missed.
+
+  Every combination of mode, frame size, FIFO depth, number of readers and
+  pinning is run, and the results are written as JSON (p50, p99, p99.9, max
+  and a log2 histogram, in ns) for comparison between releases.
+ *****************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <daoShm.hpp>
+#include <daoNuma.hpp>
+
+/*==========================================================================*/
+enum class Mode { SEM, FUTEX, COUNTER, TARGET, NEXT };
+
+static const char *modeName(Mode mode)
+{
+    switch (mode)
+    {
+        case Mode::SEM:     return "sem";
+        case Mode::FUTEX:   return "futex";
+        case Mode::COUNTER: return "counter";
+        case Mode::TARGET:  return "target";
+        case Mode::NEXT:    return "next";
+    }
+    return "?";
+}
+
+// first bytes of every frame
+struct FrameHeader
+{
+    uint64_t writeNs;
+    uint64_t seq;
+};
+
+static const uint64_t STOP_SEQ = UINT64_MAX;
+static const int NB_BUCKET = 40;            // log2 histogram, 1 ns to ~18 min
+static const uint64_t ACK_TIMEOUT_NS = 1000000000ull;
+
+struct Config
+{
+    Mode mode;
+    size_t bytes;
+    uint32_t depth;
+    int readers;
+    bool pinned;
+};
+
+struct Shared
+{
+    std::atomic<uint64_t> acked{0};
+    std::atomic<int> ready{0};
+    std::atomic<int> running{0};
+};
+
+static std::vector<Mode> modes = { Mode::SEM, Mode::FUTEX, Mode::COUNTER, Mode::TARGET, Mode::NEXT };
+static std::vector<size_t> sizes = { 1 << 10, 16 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20 };
+static std::vector<uint32_t> depths = { 1, 16 };
+static std::vector<int> readerCounts = { 1, 2 };
+static std::vector<bool> pinning = { false, true };
+static uint64_t nbIter = 10000;
+static uint64_t gapNs = 50000;
+static int writerCore = 0;
+static int rtPriority = 0;
+static std::string shmDir = "/dev/shm";
+static const char *jsonFile = nullptr;
+
+static uint64_t nowNs()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static void waitNs(uint64_t ns)
+{
+    uint64_t t0 = nowNs();
+    while (nowNs() - t0 < ns)
+        sched_yield();
+}
+
+static int readerCore(int id)
+{
+    int nbCore = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    return (writerCore + 1 + id) % nbCore;
+}
+
+static void setRealTime()
+{
+    if (rtPriority > 0)
+    {
+        struct sched_param param;
+        param.sched_priority = rtPriority;
+        if (sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+            fprintf(stderr, "could not set SCHED_FIFO %d, running with the default policy\n", rtPriority);
+    }
+}
+
+/*--------------------------------------------------------------------------*/
+static void readerLoop(const Config &cfg, const std::string &name, int id, Shared &shared,
+                       std::vector<uint64_t> &samples)
+{
+    if (cfg.pinned)
+        Dao::Numa::SetProcAffinity(readerCore(id));
+    setRealTime();
+
+    Dao::Shm<uint8_t> shm(name);
+    const Dao::ShmSync sem = (Dao::ShmSync)((int32_t)Dao::ShmSync::SEM0 + id);
+    uint64_t target = shm.get_counter() + 1;
+    uint64_t lastSeq = 0;
+    int_fast8_t status;
+
+    shared.ready++;
+    while (true)
+    {
+        uint8_t *frame = nullptr;
+        switch (cfg.mode)
+        {
+            case Mode::SEM:     frame = shm.get_frame(sem); break;
+            case Mode::FUTEX:   frame = shm.get_frame(Dao::ShmSync::FUTEX); break;
+            case Mode::COUNTER: frame = shm.get_frame(Dao::ShmSync::SPIN); break;
+            case Mode::TARGET:  frame = shm.get_frame(Dao::ShmSync::SPIN, target); break;
+            case Mode::NEXT:    frame = shm.get_next_frame(true, status); break;
+        }
+        uint64_t wakeNs = nowNs();
+        if (frame == nullptr)
+            continue;
+
+        FrameHeader header;
+        memcpy(&header, frame, sizeof(header));
+        if (header.seq == STOP_SEQ)
+            break;
+        if (header.seq <= lastSeq)
+            continue;
+        lastSeq = header.seq;
+        target = shm.get_counter() + 1;
+        samples.push_back(wakeNs - header.writeNs);
+        shared.acked++;
+    }
+    shared.running--;
+}
+
+/*--------------------------------------------------------------------------*/
+static void printJsonResult(FILE *out, const Config &cfg, uint64_t iterations, uint64_t missed,
+                            std::vector<uint64_t> &samples, bool first)
+{
+    uint64_t hist[NB_BUCKET] = {};
+    double mean = 0;
+
+    std::sort(samples.begin(), samples.end());
+    for (uint64_t s : samples)
+    {
+        int b = (s == 0) ? 0 : std::min(NB_BUCKET - 1, 63 - __builtin_clzll(s));
+        hist[b]++;
+        mean += (double)s;
+    }
+    auto pct = [&](double p) -> uint64_t {
+        if (samples.empty())
+            return 0;
+        size_t k = (size_t)std::ceil(p * samples.size()) - 1;
+        return samples[std::min(k, samples.size() - 1)];
+    };
+    if (!samples.empty())
+        mean /= (double)samples.size();
+
+    fprintf(out, "%s    {\"mode\": \"%s\", \"frame_bytes\": %zu, \"depth\": %u, \"readers\": %d, \"pinned\": %s,\n",
+            first ? "" : ",\n", modeName(cfg.mode), cfg.bytes, cfg.depth, cfg.readers, cfg.pinned ? "true" : "false");
+    fprintf(out, "     \"iterations\": %lu, \"samples\": %zu, \"missed\": %lu,\n",
+            (unsigned long)iterations, samples.size(), (unsigned long)missed);
+    fprintf(out, "     \"latency_ns\": {\"mean\": %.0f, \"p50\": %lu, \"p99\": %lu, \"p99_9\": %lu, \"max\": %lu},\n",
+            mean, (unsigned long)pct(0.5), (unsigned long)pct(0.99), (unsigned long)pct(0.999),
+            (unsigned long)(samples.empty() ? 0 : samples.back()));
+    fprintf(out, "     \"histogram_log2_ns\": [");
+    for (int b = 0; b < NB_BUCKET; b++)
+        fprintf(out, "%s%lu", b ? ", " : "", (unsigned long)hist[b]);
+    fprintf(out, "]}");
+
+    fprintf(stderr, "%-8s %10zu %6u %8d %7s %10lu %8lu %10lu %10lu %10lu %10lu\n", modeName(cfg.mode), cfg.bytes,
+            cfg.depth, cfg.readers, cfg.pinned ? "yes" : "no", (unsigned long)samples.size(), (unsigned long)missed,
+            (unsigned long)pct(0.5), (unsigned long)pct(0.99), (unsigned long)pct(0.999),
+            (unsigned long)(samples.empty() ? 0 : samples.back()));
+}
+
+/*--------------------------------------------------------------------------*/
+static void benchmark(FILE *out, const Config &cfg, bool first)
+{
+    const std::string name = shmDir + "/latencyBenchmark.im.shm";
+    // large frames get fewer iterations, about 4 GB written per configuration at most
+    uint64_t iterations = std::max<uint64_t>(100, std::min<uint64_t>(nbIter, (4ull << 30) / cfg.bytes));
+    // 1 kB rows, a size that is not a multiple is rounded up
+    Dao::Shape shape = { 1024, (uint32_t)((cfg.bytes + 1023) / 1024) };
+    std::vector<uint8_t> frame((size_t)shape[0] * shape[1], 0);
+    std::vector<std::vector<uint64_t>> samples(cfg.readers);
+    std::vector<std::thread> threads;
+    Shared shared;
+    uint64_t missed = 0;
+    FrameHeader header;
+
+    if (cfg.pinned)
+        Dao::Numa::SetProcAffinity(writerCore);
+
+    {
+        Dao::Shm<uint8_t> shm(name, shape, frame.data(), cfg.depth);
+
+        shared.running = cfg.readers;
+        for (int r = 0; r < cfg.readers; r++)
+        {
+            samples[r].reserve(iterations);
+            threads.emplace_back(readerLoop, std::cref(cfg), std::cref(name), r, std::ref(shared), std::ref(samples[r]));
+        }
+        while (shared.ready < cfg.readers)
+            waitNs(100000);
+        waitNs(gapNs);
+
+        for (uint64_t k = 1; k <= iterations; k++)
+        {
+            header.seq = k;
+            header.writeNs = nowNs();
+            memcpy(frame.data(), &header, sizeof(header));
+            shm.set_frame(frame.data());
+
+            // every reader has seen the frame, or it is missed
+            uint64_t expected = k * cfg.readers;
+            uint64_t t0 = nowNs();
+            while (shared.acked.load() + missed < expected)
+            {
+                if (nowNs() - t0 > ACK_TIMEOUT_NS)
+                {
+                    missed = expected - shared.acked.load();
+                    break;
+                }
+                sched_yield();
+            }
+            waitNs(gapNs);
+        }
+
+        // wake the readers until they have all seen the stop frame
+        header.seq = STOP_SEQ;
+        memcpy(frame.data(), &header, sizeof(header));
+        while (shared.running > 0)
+        {
+            shm.set_frame(frame.data());
+            waitNs(1000000);
+        }
+        for (auto &t : threads)
+            t.join();
+    }
+    unlink(name.c_str());
+
+    std::vector<uint64_t> all;
+    for (auto &s : samples)
+        all.insert(all.end(), s.begin(), s.end());
+    printJsonResult(out, cfg, iterations, missed, all, first);
+}
+
+/*==========================================================================*/
+static size_t parseSize(const char *str)
+{
+    char *end;
+    double v = strtod(str, &end);
+    if (*end == 'k' || *end == 'K')
+        v *= 1024;
+    else if (*end == 'm' || *end == 'M')
+        v *= 1024 * 1024;
+    return (size_t)v;
+}
+
+template <class T, class F>
+static std::vector<T> parseList(const char *str, F parse)
+{
+    std::vector<T> list;
+    std::string s(str);
+    size_t start = 0;
+    while (start <= s.size())
+    {
+        size_t end = s.find(',', start);
+        if (end == std::string::npos)
+            end = s.size();
+        if (end > start)
+            list.push_back(parse(s.substr(start, end - start)));
+        start = end + 1;
+    }
+    return list;
+}
+
+static Mode parseMode(const std::string &s)
+{
+    for (Mode m : { Mode::SEM, Mode::FUTEX, Mode::COUNTER, Mode::TARGET, Mode::NEXT })
+        if (s == modeName(m))
+            return m;
+    fprintf(stderr, "unknown mode %s\n", s.c_str());
+    exit(1);
+}
+
+static void ShowHelp(const char *argv0)
+{
+    printf("%s of " __DATE__ " at " __TIME__ "\n", argv0);
+    printf("   arguments:\n");
+    printf("   -h               display this message and exit\n");
+    printf("   -m modes         sync modes among sem,futex,counter,target,next (default all)\n");
+    printf("   -s sizes         frame sizes in bytes, K and M suffixes (default 1K,16K,256K,1M,4M,16M)\n");
+    printf("   -f depths        FIFO depths (default 1,16)\n");
+    printf("   -r readers       numbers of reader threads, at most 10 (default 1,2)\n");
+    printf("   -p pinning       none, on or both (default both)\n");
+    printf("   -c core          core of the writer when pinned, reader i on core+1+i (default 0)\n");
+    printf("   -n iterations    frames per configuration (default %lu)\n", (unsigned long)nbIter);
+    printf("   -g gap           ns between the acknowledgement of a frame and the next (default %lu)\n",
+           (unsigned long)gapNs);
+    printf("   -R priority      SCHED_FIFO priority of the threads (default none)\n");
+    printf("   -d dir           directory of the SHM file (default %s)\n", shmDir.c_str());
+    printf("   -o file          JSON output (default stdout)\n");
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    FILE *out = stdout;
+    bool first = true;
+
+    while ((c = getopt(argc, argv, "hm:s:f:r:p:c:n:g:R:d:o:")) != -1)
+    {
+        switch (c)
+        {
+            case 'm': modes = parseList<Mode>(optarg, parseMode); break;
+            case 's': sizes = parseList<size_t>(optarg, [](const std::string &s) { return parseSize(s.c_str()); }); break;
+            case 'f': depths = parseList<uint32_t>(optarg, [](const std::string &s) { return (uint32_t)atoi(s.c_str()); }); break;
+            case 'r': readerCounts = parseList<int>(optarg, [](const std::string &s) { return atoi(s.c_str()); }); break;
+            case 'p':
+                if (strcmp(optarg, "none") == 0) pinning = { false };
+                else if (strcmp(optarg, "on") == 0) pinning = { true };
+                else pinning = { false, true };
+                break;
+            case 'c': writerCore = atoi(optarg); break;
+            case 'n': nbIter = strtoull(optarg, nullptr, 10); break;
+            case 'g': gapNs = strtoull(optarg, nullptr, 10); break;
+            case 'R': rtPriority = atoi(optarg); break;
+            case 'd': shmDir = optarg; break;
+            case 'o': jsonFile = optarg; break;
+            case 'h': ShowHelp(argv[0]); return 0;
+            default:  ShowHelp(argv[0]); return 1;
+        }
+    }
+    for (int r : readerCounts)
+    {
+        if (r < 1 || r > 10)
+        {
+            fprintf(stderr, "readers must be between 1 and 10 (one semaphore each)\n");
+            return 1;
+        }
+    }
+    for (size_t s : sizes)
+    {
+        if (s < sizeof(FrameHeader))
+        {
+            fprintf(stderr, "frames must be at least %zu bytes\n", sizeof(FrameHeader));
+            return 1;
+        }
+    }
+    if (jsonFile != nullptr && (out = fopen(jsonFile, "w")) == nullptr)
+    {
+        perror(jsonFile);
+        return 1;
+    }
+
+    daoSetLogLevel(0); // warnings and errors only
+    setRealTime();
+
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    fprintf(out, "{\"benchmark\": \"daoShmLatencyBenchmark\", \"host\": \"%s\", \"cpus\": %ld, \"gap_ns\": %lu, "
+            "\"rt_priority\": %d,\n \"results\": [\n", host, sysconf(_SC_NPROCESSORS_ONLN), (unsigned long)gapNs,
+            rtPriority);
+    fprintf(stderr, "%-8s %10s %6s %8s %7s %10s %8s %10s %10s %10s %10s\n", "mode", "bytes", "depth", "readers",
+            "pinned", "samples", "missed", "p50[ns]", "p99[ns]", "p99.9[ns]", "max[ns]");
+
+    for (bool pinned : pinning)
+        for (int readers : readerCounts)
+            for (uint32_t depth : depths)
+                for (size_t bytes : sizes)
+                    for (Mode mode : modes)
+                    {
+                        benchmark(out, Config{ mode, bytes, depth, readers, pinned }, first);
+                        first = false;
+                        fflush(out);
+                    }
+
+    fprintf(out, "\n ]}\n");
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
+/*==========================================================================*/
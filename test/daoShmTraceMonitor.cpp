@@ -0,0 +1,269 @@
+/*****************************************************************************
+  DAO project
+  Per-stage latency breakdown of a pipeline, from the frame traces of live streams
+
+  The streams must be created with DAO_SHM_OPTIONS::trace. The monitor polls the
+  DAO_FRAME_RECORD ring of every stream given on the command line, reads the
+  DAO_FRAME_TRACE of each new frame and, for every stage of the trace, accumulates:
+   - wait  : from the exit of the previous stage to the enter of this one
+             (wake-up, queueing behind older frames)
+   - stage : from the enter of the stage to the commit of its output
+  and the end-to-end time, from the enter of the first stage to the exit of the last.
+  Every interval a table of percentiles is printed per stream, in us.
+
+  Frames overwritten before the monitor saw them are counted as missed; use a
+  deeper FIFO or a shorter poll period if this happens.
+ *****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <getopt.h>
+
+// DAO header
+#include "dao.h"
+
+namespace
+{
+    double interval = 1.0;      // seconds between two reports
+    int nbReport = 0;           // number of reports, 0 to run until killed
+    int pollUs = 200;           // period of the record polling [us]
+
+    /*
+     * Latency samples of one quantity [ns]
+     */
+    struct Samples
+    {
+        std::vector<double> ns;
+
+        void add(double v) { ns.push_back(v); }
+
+        double percentile(double p)
+        {
+            size_t k = (size_t)(p * (ns.size() - 1) + 0.5);
+            std::nth_element(ns.begin(), ns.begin() + k, ns.end());
+            return ns[k];
+        }
+    };
+
+    /*
+     * Breakdown of one stage at its position in the traces of a stream
+     */
+    struct Stage
+    {
+        uint32_t stageId;
+        Samples wait;
+        Samples stage;
+    };
+
+    /*
+     * One monitored stream and its accumulated breakdown
+     */
+    struct Stream
+    {
+        std::string name;
+        IMAGE image {};
+        uint64_t lastCnt0 = 0;
+        uint64_t nbFrame = 0;
+        uint64_t nbMissed = 0;
+        uint64_t nbDropped = 0;
+        std::map<std::pair<uint32_t, uint32_t>, Stage> stages;   // (position, stage id)
+        Samples total;
+    };
+
+    void ShowHelp(const char *argv0)
+    {
+        printf("%s of " __DATE__ " at " __TIME__ "\n", argv0);
+        printf("usage: %s [options] stream.im.shm [stream.im.shm ...]\n", argv0);
+        printf("   arguments:\n");
+        printf("   -h               display this message and exit\n");
+        printf("   -i seconds       interval between two reports (default %.1f)\n", interval);
+        printf("   -n reports       number of reports, 0 to run until killed (default %d)\n", nbReport);
+        printf("   -p us            period of the polling of the streams (default %d)\n", pollUs);
+        printf("\n");
+    }
+
+    /*
+     * Add the trace of every frame written since the last poll
+     */
+    void Poll(Stream &stream, double tscPerNs)
+    {
+        uint32_t fifo_size = stream.image.md[0].fifo_size;
+        uint32_t newest = stream.image.md[0].fifo_last_written;
+        DAO_FRAME_RECORD record;
+        uint32_t nbNew = 0;
+
+        // walk back to the oldest frame not seen yet
+        while (nbNew < fifo_size)
+        {
+            daoShmGetFrameRecord(&stream.image, newest + fifo_size - nbNew, &record);
+            if (record.cnt0 <= stream.lastCnt0)
+            {
+                break;
+            }
+            nbNew++;
+        }
+
+        for (uint32_t k = nbNew; k > 0; --k)
+        {
+            uint32_t idx = (newest + fifo_size - (k - 1)) % fifo_size;
+            DAO_FRAME_TRACE trace;
+
+            daoShmGetFrameRecord(&stream.image, idx, &record);
+            daoShmGetFrameTrace(&stream.image, idx, &trace);
+            if (stream.lastCnt0 != 0 && record.cnt0 > stream.lastCnt0 + 1)
+            {
+                stream.nbMissed += record.cnt0 - stream.lastCnt0 - 1;
+            }
+            stream.lastCnt0 = std::max(stream.lastCnt0, record.cnt0);
+            stream.nbFrame++;
+            stream.nbDropped += trace.dropped;
+
+            for (uint32_t s = 0; s < trace.nbStamp; ++s)
+            {
+                const DAO_TRACE_STAMP &stamp = trace.stamp[s];
+                Stage &stage = stream.stages[std::make_pair(s, stamp.stageId)];
+                stage.stageId = stamp.stageId;
+                if (s > 0)
+                {
+                    stage.wait.add((double)(int64_t)(stamp.enterTsc - trace.stamp[s - 1].exitTsc) / tscPerNs);
+                }
+                stage.stage.add((double)(int64_t)(stamp.exitTsc - stamp.enterTsc) / tscPerNs);
+            }
+            if (trace.nbStamp > 0)
+            {
+                stream.total.add((double)(int64_t)(trace.stamp[trace.nbStamp - 1].exitTsc
+                                                   - trace.stamp[0].enterTsc) / tscPerNs);
+            }
+        }
+    }
+
+    void PrintSamples(const char *label, Samples &samples)
+    {
+        if (samples.ns.empty())
+        {
+            printf("  %-8s %10s\n", label, "-");
+            return;
+        }
+        double max = *std::max_element(samples.ns.begin(), samples.ns.end());
+        printf("  %-8s %10zu %10.2f %10.2f %10.2f %10.2f\n", label, samples.ns.size(),
+               samples.percentile(0.5) * 1e-3, samples.percentile(0.99) * 1e-3,
+               samples.percentile(0.999) * 1e-3, max * 1e-3);
+    }
+
+    /*
+     * Print the breakdown accumulated since the last report, then start over
+     */
+    void Report(Stream &stream)
+    {
+        printf("%s: %lu frames, %lu missed, %lu stages not stamped\n", stream.name.c_str(),
+               (unsigned long)stream.nbFrame, (unsigned long)stream.nbMissed, (unsigned long)stream.nbDropped);
+        printf("  %-8s %10s %10s %10s %10s %10s\n", "[us]", "n", "p50", "p99", "p99.9", "max");
+        for (auto &entry : stream.stages)
+        {
+            Stage &stage = entry.second;
+
+            if (stage.stageId == DAO_TRACE_NO_STAGE)
+            {
+                printf(" #%u stage -\n", entry.first.first);
+            }
+            else
+            {
+                printf(" #%u stage %u\n", entry.first.first, stage.stageId);
+            }
+            if (entry.first.first > 0)
+            {
+                PrintSamples("wait", stage.wait);
+            }
+            PrintSamples("stage", stage.stage);
+        }
+        printf(" end to end\n");
+        PrintSamples("total", stream.total);
+        printf("\n");
+
+        stream.nbFrame = 0;
+        stream.nbMissed = 0;
+        stream.nbDropped = 0;
+        stream.stages.clear();
+        stream.total.ns.clear();
+    }
+}
+
+/*==========================================================================*/
+int main(int argc, char **argv)
+{
+    int c;
+
+    while ((c = getopt(argc, argv, "hi:n:p:")) != -1)
+    {
+        switch (c)
+        {
+            case 'i': interval = atof(optarg); break;
+            case 'n': nbReport = atoi(optarg); break;
+            case 'p': pollUs = atoi(optarg); break;
+            case 'h': ShowHelp(argv[0]); return 0;
+            default:  ShowHelp(argv[0]); return 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        ShowHelp(argv[0]);
+        return 1;
+    }
+
+    daoSetLogLevel(0); // warnings and errors only
+
+    std::vector<Stream> streams(argc - optind);
+    for (size_t s = 0; s < streams.size(); ++s)
+    {
+        Stream &stream = streams[s];
+        stream.name = argv[optind + s];
+        if (daoShmShm2Img(stream.name.c_str(), &stream.image) != DAO_SUCCESS)
+        {
+            fprintf(stderr, "could not open %s\n", stream.name.c_str());
+            return 1;
+        }
+        if (stream.image.trace == NULL)
+        {
+            fprintf(stderr, "%s has no frame traces, create it with DAO_SHM_OPTIONS::trace\n", stream.name.c_str());
+            return 1;
+        }
+        // only the frames written from now on
+        stream.lastCnt0 = daoShmGetCounter(&stream.image);
+    }
+
+    const double tscPerNs = daoShmTraceTscPerNs();
+    printf("%.3f ticks per ns\n\n", tscPerNs);
+
+    for (int report = 0; nbReport == 0 || report < nbReport; ++report)
+    {
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(interval);
+        while (std::chrono::steady_clock::now() < end)
+        {
+            for (Stream &stream : streams)
+            {
+                Poll(stream, tscPerNs);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(pollUs));
+        }
+        for (Stream &stream : streams)
+        {
+            Report(stream);
+        }
+        fflush(stdout);
+    }
+
+    for (Stream &stream : streams)
+    {
+        daoShmCloseShm(&stream.image);
+    }
+    return 0;
+}
+/*==========================================================================*/
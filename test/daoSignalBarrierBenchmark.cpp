@@ -0,0 +1,171 @@
+/*****************************************************************************
+  DAO project
+  Cost of a fork-join episode of Dao::SignalTable against the number of threads
+
+  A master thread and nbThread-1 workers, pinned on consecutive cores, run
+  episodes of: master starts the workers, every worker acknowledges, master
+  returns once all acknowledged. The episode is timed on the master. Three ways
+  of synchronising are compared:
+   - range   : one start and one done signal per worker, SignalSendRange and
+               SignalReceiveSpinRange, the master polls nbThread-1 cache lines
+   - latch   : one SignalSend broadcast on a shared index, the workers report
+               on one shared index and the master waits with
+               SignalReceiveSpinCount
+   - barrier : every thread calls SignalBarrierWait twice
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+#include <daoSignalTable.hpp>
+#include <daoNuma.hpp>
+
+/*==========================================================================*/
+static std::vector<int> nbThreads = { 2, 4, 8 };
+static int firstCore = 0;
+static uint64_t nbEpisode = 10000;
+static uint64_t nbWarmup = 100;
+
+static uint64_t nowNs()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static void ShowHelp(const char *argv0)
+{
+    printf("%s of " __DATE__ " at " __TIME__ "\n", argv0);
+    printf("   arguments:\n");
+    printf("   -h               display this message and exit\n");
+    printf("   -t n,n,...       thread counts, master included (default 2,4,8)\n");
+    printf("   -c core          core of the master, the workers follow (default %d)\n", firstCore);
+    printf("   -n episodes      episodes per measurement (default %lu)\n", (unsigned long)nbEpisode);
+    printf("   -w episodes      warm-up episodes, not counted (default %lu)\n", (unsigned long)nbWarmup);
+    printf("\n");
+}
+
+/*--------------------------------------------------------------------------*/
+enum class Method { RANGE, LATCH, BARRIER };
+
+static void episodes(const char *label, Method method, int nbThread)
+{
+    const int nbWorker = nbThread - 1;
+    const uint64_t total = nbWarmup + nbEpisode;
+    // range: start signals 0..nbWorker-1, done signals nbWorker..2*nbWorker-1
+    // latch: start signal 0, done signal 1
+    Dao::SignalTable table(2 * nbThread);
+    std::vector<uint64_t> duration(nbEpisode);
+    std::vector<std::thread> workers;
+    int nbCore = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int w = 0; w < nbWorker; ++w)
+    {
+        workers.emplace_back([&table, method, nbThread, nbWorker, total, w, nbCore]() {
+            uint64_t seen = 0;
+            Dao::Numa::SetProcAffinity((firstCore + 1 + w) % nbCore);
+            for (uint64_t episode = 0; episode < total; ++episode)
+            {
+                switch (method)
+                {
+                    case Method::RANGE:
+                        table.SignalReceiveSpin(w);
+                        table.SignalSend(nbWorker + w);
+                        break;
+                    case Method::LATCH:
+                        table.SignalReceiveSpinBroadcast(0, seen);
+                        table.SignalSend(1);
+                        break;
+                    case Method::BARRIER:
+                        table.SignalBarrierWait(0, nbThread);
+                        table.SignalBarrierWait(0, nbThread);
+                        break;
+                }
+            }
+        });
+    }
+
+    Dao::Numa::SetProcAffinity(firstCore % nbCore);
+    for (uint64_t episode = 0; episode < total; ++episode)
+    {
+        uint64_t t0 = nowNs();
+        switch (method)
+        {
+            case Method::RANGE:
+                table.SignalSendRange(0, nbWorker);
+                table.SignalReceiveSpinRange(nbWorker, nbWorker);
+                break;
+            case Method::LATCH:
+                table.SignalSend(0);
+                table.SignalReceiveSpinCount(1, nbWorker);
+                break;
+            case Method::BARRIER:
+                table.SignalBarrierWait(0, nbThread);
+                table.SignalBarrierWait(0, nbThread);
+                break;
+        }
+        if (episode >= nbWarmup)
+            duration[episode - nbWarmup] = nowNs() - t0;
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+
+    std::sort(duration.begin(), duration.end());
+    printf("%-8s %7d %10lu %10lu %10lu %10lu\n", label, nbThread,
+           (unsigned long)duration[duration.size() / 2], (unsigned long)duration[duration.size() * 99 / 100],
+           (unsigned long)duration[duration.size() * 999 / 1000], (unsigned long)duration.back());
+}
+
+/*==========================================================================*/
+int main(int argc, char **argv)
+{
+    int c;
+
+    while ((c = getopt(argc, argv, "ht:c:n:w:")) != -1)
+    {
+        switch (c)
+        {
+            case 't':
+            {
+                std::string list(optarg);
+                size_t start = 0;
+                nbThreads.clear();
+                while (start <= list.size())
+                {
+                    size_t end = list.find(',', start);
+                    if (end == std::string::npos)
+                        end = list.size();
+                    nbThreads.push_back(atoi(list.substr(start, end - start).c_str()));
+                    start = end + 1;
+                }
+            } break;
+            case 'c': firstCore = atoi(optarg); break;
+            case 'n': nbEpisode = strtoull(optarg, nullptr, 10); break;
+            case 'w': nbWarmup = strtoull(optarg, nullptr, 10); break;
+            case 'h': ShowHelp(argv[0]); return 0;
+            default:  ShowHelp(argv[0]); return 1;
+        }
+    }
+    if (nbEpisode == 0 || std::any_of(nbThreads.begin(), nbThreads.end(), [](int n) { return n < 2; }))
+    {
+        ShowHelp(argv[0]);
+        return 1;
+    }
+
+    printf("fork-join episode [ns], %lu episodes\n", (unsigned long)nbEpisode);
+    printf("%-8s %7s %10s %10s %10s %10s\n", "method", "threads", "p50", "p99", "p99.9", "max");
+    for (int nbThread : nbThreads)
+    {
+        episodes("range", Method::RANGE, nbThread);
+        episodes("latch", Method::LATCH, nbThread);
+        episodes("barrier", Method::BARRIER, nbThread);
+    }
+    return 0;
+}
+/*==========================================================================*/
@@ -0,0 +1,190 @@
+/*****************************************************************************
+  DAO project
+  Ping-pong latency of Dao::SignalTable between pinned cores
+
+  Two threads pinned on a pair of cores bounce a signal: ping sends signal 0
+  and spins on signal 1, pong spins on signal 0 and answers on signal 1. The
+  round trip is timed on the ping side. Optional bystander threads send their
+  own signals, at the indices next to the ping-pong ones, as fast as they can.
+
+  Two layouts are compared:
+   - padded : Dao::SignalTable, one cache line per signal
+   - packed : the counters of consecutive signals in consecutive words, as the
+              table was before, so the bystanders write the cache line the
+              ping-pong threads spin on
+  With -s, the padded table is also measured with the pong thread blocked in
+  the kernel (SignalReceiveSleep) instead of spinning: the wake-up latency of
+  an idle thread.
+ *****************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+#include <daoSignalTable.hpp>
+#include <daoNuma.hpp>
+
+/*==========================================================================*/
+static std::vector<int> cores = { 0, 1 };
+static int nbBystander = 0;
+static uint64_t nbRound = 100000;
+static uint64_t nbWarmup = 1000;
+static bool sleeping = false;
+
+/*
+ * Signal counters in consecutive words, the layout of the previous SignalTable
+ */
+class PackedTable
+{
+    public:
+        explicit PackedTable(size_t max_signals) : signal(max_signals), tracker(max_signals) {}
+
+        inline void SignalSend(int index)
+        {
+            signal[index].fetch_add(1, std::memory_order_release);
+        }
+
+        inline void SignalReceiveSpin(int index)
+        {
+            uint64_t received = tracker[index].load(std::memory_order_relaxed);
+            while (signal[index].load(std::memory_order_acquire) <= received)
+            {
+                Dao::SignalTable::CpuRelax();
+            }
+            tracker[index].store(received + 1, std::memory_order_relaxed);
+        }
+
+    private:
+        std::vector<std::atomic<uint64_t>> signal;
+        std::vector<std::atomic<uint64_t>> tracker;
+};
+
+static uint64_t nowNs()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static void ShowHelp(const char *argv0)
+{
+    printf("%s of " __DATE__ " at " __TIME__ "\n", argv0);
+    printf("   arguments:\n");
+    printf("   -h               display this message and exit\n");
+    printf("   -c core,core,... cores, every pair is measured (default 0,1)\n");
+    printf("   -b bystanders    threads sending the neighbouring signals (default %d)\n", nbBystander);
+    printf("   -n rounds        round trips per pair (default %lu)\n", (unsigned long)nbRound);
+    printf("   -w rounds        warm-up round trips, not counted (default %lu)\n", (unsigned long)nbWarmup);
+    printf("   -s               also measure with the pong thread sleeping in SignalReceiveSleep\n");
+    printf("\n");
+}
+
+/*--------------------------------------------------------------------------*/
+template <class Table, bool Sleep = false>
+static void pingPong(const char *label, int pingCore, int pongCore)
+{
+    Table table(2 + nbBystander);
+    std::vector<uint64_t> rtt(nbRound);
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> bystanders;
+    int nbCore = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int b = 0; b < nbBystander; ++b)
+    {
+        bystanders.emplace_back([&table, &stop, b, pongCore, nbCore]() {
+            Dao::Numa::SetProcAffinity((pongCore + 1 + b) % nbCore);
+            while (!stop.load(std::memory_order_relaxed))
+                table.SignalSend(2 + b);
+        });
+    }
+
+    std::thread pong([&table, pongCore]() {
+        Dao::Numa::SetProcAffinity(pongCore);
+        for (uint64_t round = 0; round < nbWarmup + nbRound; ++round)
+        {
+            if constexpr (Sleep)
+                table.SignalReceiveSleep(0, 0);
+            else
+                table.SignalReceiveSpin(0);
+            table.SignalSend(1);
+        }
+    });
+
+    Dao::Numa::SetProcAffinity(pingCore);
+    for (uint64_t round = 0; round < nbWarmup + nbRound; ++round)
+    {
+        uint64_t t0 = nowNs();
+        table.SignalSend(0);
+        table.SignalReceiveSpin(1);
+        if (round >= nbWarmup)
+            rtt[round - nbWarmup] = nowNs() - t0;
+    }
+    pong.join();
+    stop = true;
+    for (std::thread &bystander : bystanders)
+        bystander.join();
+
+    std::sort(rtt.begin(), rtt.end());
+    printf("%-8s %4d %4d %10lu %10lu %10lu %10lu\n", label, pingCore, pongCore,
+           (unsigned long)rtt[rtt.size() / 2], (unsigned long)rtt[rtt.size() * 99 / 100],
+           (unsigned long)rtt[rtt.size() * 999 / 1000], (unsigned long)rtt.back());
+}
+
+/*==========================================================================*/
+int main(int argc, char **argv)
+{
+    int c;
+
+    while ((c = getopt(argc, argv, "hc:b:n:w:s")) != -1)
+    {
+        switch (c)
+        {
+            case 'c':
+            {
+                std::string list(optarg);
+                size_t start = 0;
+                cores.clear();
+                while (start <= list.size())
+                {
+                    size_t end = list.find(',', start);
+                    if (end == std::string::npos)
+                        end = list.size();
+                    cores.push_back(atoi(list.substr(start, end - start).c_str()));
+                    start = end + 1;
+                }
+            } break;
+            case 'b': nbBystander = atoi(optarg); break;
+            case 'n': nbRound = strtoull(optarg, nullptr, 10); break;
+            case 'w': nbWarmup = strtoull(optarg, nullptr, 10); break;
+            case 's': sleeping = true; break;
+            case 'h': ShowHelp(argv[0]); return 0;
+            default:  ShowHelp(argv[0]); return 1;
+        }
+    }
+    if (cores.size() < 2 || nbRound == 0)
+    {
+        ShowHelp(argv[0]);
+        return 1;
+    }
+
+    printf("round trip [ns], %lu rounds, %d bystanders\n", (unsigned long)nbRound, nbBystander);
+    printf("%-8s %4s %4s %10s %10s %10s %10s\n", "layout", "ping", "pong", "p50", "p99", "p99.9", "max");
+    for (size_t i = 0; i < cores.size(); ++i)
+    {
+        for (size_t j = i + 1; j < cores.size(); ++j)
+        {
+            pingPong<Dao::SignalTable>("padded", cores[i], cores[j]);
+            pingPong<PackedTable>("packed", cores[i], cores[j]);
+            if (sleeping)
+                pingPong<Dao::SignalTable, true>("sleep", cores[i], cores[j]);
+        }
+    }
+    return 0;
+}
+/*==========================================================================*/
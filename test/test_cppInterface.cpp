@@ -8,12 +8,19 @@
 
 #include <gtest/gtest.h>
 #include <daoShm.hpp>
+#include <daoNuma.hpp>
 #include <filesystem>
 #include <cstring>
 #include <thread>
 #include <future>
 #include <sstream>
 #include <chrono>
+#include <atomic>
+#include <vector>
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
  /**
   * @brief Test fixture for providing and cleaning up a shared memory file path.
@@ -238,6 +245,279 @@ TEST_F(Suite, SemXSync)
     waiter.join();
 }
 
+/**
+ * @brief Ensure correct frame sync via futex.
+ */
+TEST_F(Suite, FutexSync)
+{
+    bool syncDone = false;
+    float frame[] = { 3.1415f };
+    Dao::Shm<float> smem(shmPath_, { 1,1 });
+
+    std::thread waiter ([&]() {
+        float *frame_ = smem.get_frame(Dao::ShmSync::FUTEX);
+        syncDone = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(syncDone, false);
+    smem.set_frame(frame);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(syncDone, true);
+    waiter.join();
+}
+
+/**
+ * @brief Ensure futex sync times out when nothing is written.
+ */
+TEST_F(Suite, FutexSyncTimeout)
+{
+    Dao::Shm<float> smem(shmPath_, { 1,1 });
+
+    ASSERT_EQ(smem.get_frame(Dao::ShmSync::FUTEX, 1), nullptr);
+}
+
+/**
+ * @brief Ensure more readers than IMAGE_NB_SEMAPHORE are all woken by one futex post.
+ */
+TEST_F(Suite, FutexManyReaders)
+{
+    const int nbReaders = 2 * IMAGE_NB_SEMAPHORE;
+    std::atomic<int> nbWoken {0};
+    float frame[] = { 3.1415f };
+    Dao::Shm<float> writer(shmPath_, { 1,1 });
+    writer.set_sync_flags(DAO_SYNC_FUTEX);
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < nbReaders; ++i) {
+        readers.emplace_back([&]() {
+            Dao::Shm<float> reader(shmPath_);
+            if (reader.get_frame(Dao::ShmSync::FUTEX, 5) != nullptr)
+                nbWoken++;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    writer.set_frame(frame);
+
+    for (auto &reader : readers)
+        reader.join();
+    ASSERT_EQ(nbWoken, nbReaders);
+}
+
+/**
+ * @brief Ensure a frame arriving during the busy-spin phase is caught there.
+ */
+TEST_F(Suite, WaitPolicySpin)
+{
+    float frame[] = { 3.1415f };
+    Dao::Shm<float> writer(shmPath_, { 1,1 });
+    Dao::Shm<float> reader(shmPath_);
+    reader.set_wait_policy(2000000000, 0, DAO_WAIT_BLOCK_FUTEX);
+
+    std::thread sender([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        writer.set_frame(frame);
+    });
+    float *frame_ = reader.get_frame(Dao::ShmSync::SPIN);
+    sender.join();
+
+    ASSERT_EQ(*frame_, frame[0]);
+    DAO_WAIT_STATS stats = reader.get_wait_stats();
+    ASSERT_EQ(stats.nWaits, 1u);
+    ASSERT_EQ(stats.nSpinWakes, 1u);
+    ASSERT_EQ(stats.lastBlockNs, 0u);
+    ASSERT_GT(stats.lastSpinNs, 0u);
+}
+
+/**
+ * @brief Ensure a late frame is caught by the futex block after the spin phases.
+ */
+TEST_F(Suite, WaitPolicySpinThenBlock)
+{
+    int16_t frame_a[] = { 128 };
+    int16_t frame_b[] = { 129 };
+    Dao::Shm<int16_t> writer(shmPath_, { 1,1 }, frame_a, 4);
+    Dao::Shm<int16_t> reader(shmPath_);
+    reader.set_wait_policy(100000, 100000, DAO_WAIT_BLOCK_FUTEX);
+
+    std::thread sender([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        writer.set_frame(frame_b);
+    });
+    int16_t *frame_ = reader.get_frame(Dao::ShmSync::SPIN);
+    sender.join();
+
+    ASSERT_EQ(*frame_, 129);
+    DAO_WAIT_STATS stats = reader.get_wait_stats();
+    ASSERT_EQ(stats.nWaits, 1u);
+    ASSERT_EQ(stats.nBlockWakes, 1u);
+    ASSERT_GE(stats.lastSpinNs, 100000u);
+    ASSERT_GE(stats.lastBackoffNs, 100000u);
+    ASSERT_GT(stats.lastBlockNs, 0u);
+
+    reader.reset_wait_stats();
+    ASSERT_EQ(reader.get_wait_stats().nWaits, 0u);
+}
+
+/**
+ * @brief Ensure a frame written in place is published when the slot goes out of scope.
+ */
+TEST_F(Suite, AcquireCommit)
+{
+    Dao::Shm<float> smem(shmPath_, { 2,2 }, nullptr, 4);
+    const uint64_t cnt0 = smem.get_counter();
+
+    {
+        auto slot = smem.acquire();
+        ASSERT_EQ(slot.size(), 4u);
+        for (uint64_t i = 0; i < slot.size(); ++i)
+            slot[i] = 1.5f * i;
+        ASSERT_EQ(smem.get_counter(), cnt0);
+    }
+
+    ASSERT_EQ(smem.get_counter(), cnt0 + 1);
+    float *frame_ = smem.get_frame();
+    for (int i = 0; i < 4; ++i)
+        ASSERT_EQ(frame_[i], 1.5f * i);
+}
+
+/**
+ * @brief Ensure a slot is rejected once another frame has been written.
+ */
+TEST_F(Suite, AcquireCommitStale)
+{
+    float frame[] = { 3.1415f };
+    Dao::Shm<float> smem(shmPath_, { 1,1 }, nullptr, 4);
+
+    auto slot = smem.acquire();
+    slot[0] = 2.0f;
+    ASSERT_EQ(slot.commit(), DAO_SUCCESS);
+    ASSERT_EQ(slot.commit(), DAO_SUCCESS);
+
+    auto stale = smem.acquire();
+    smem.set_frame(frame);
+    ASSERT_EQ(stale.commit(), DAO_ERROR);
+    ASSERT_EQ(*smem.get_frame(), frame[0]);
+}
+
+/**
+ * @brief Ensure consistent reads never mix two frames while the writer runs at full rate.
+ */
+TEST_F(Suite, ReadConsistent)
+{
+    const uint32_t n = 256;
+    std::atomic<bool> done {false};
+    Dao::Shm<uint32_t> writer(shmPath_, { n,n }, nullptr, 2);
+    Dao::Shm<uint32_t> reader(shmPath_);
+
+    std::thread sender([&]() {
+        for (uint32_t k = 1; !done; ++k) {
+            auto slot = writer.acquire();
+            for (uint64_t i = 0; i < slot.size(); ++i)
+                slot[i] = k;
+        }
+    });
+
+    std::vector<uint32_t> frame(n * n);
+    for (int i = 0; i < 200; ++i) {
+        uint64_t cnt0;
+        ASSERT_EQ(reader.read_consistent(frame.data(), cnt0), DAO_SUCCESS);
+        for (uint32_t v : frame)
+            ASSERT_EQ(v, frame[0]);
+    }
+    done = true;
+    sender.join();
+}
+
+/**
+ * @brief Ensure allocation flags are recorded for readers and the memory stays usable.
+ */
+TEST_F(Suite, AllocFlags)
+{
+    float frame[] = { 1.0f, 2.0f, 3.0f, 4.0f };
+    DAO_SHM_OPTIONS options { DAO_SHM_HUGEPAGE | DAO_SHM_POPULATE | DAO_SHM_MLOCK, -1, 0, 0 };
+    Dao::Shm<float> writer(shmPath_, { 2,2 }, frame, 4, &options);
+    Dao::Shm<float> reader(shmPath_);
+
+    ASSERT_EQ(reader.get_meta_data(0)->allocFlags, options.flags);
+    ASSERT_EQ(std::memcmp(reader.get_frame(), frame, sizeof(frame)), 0);
+}
+
+/**
+ * @brief Ensure a shared memory created on a NUMA node reports its pages on that node.
+ */
+TEST_F(Suite, NumaPlacement)
+{
+#if defined(__linux__)
+    if(numa_available() < 0)
+        GTEST_SKIP() << "NUMA not available";
+#else
+    GTEST_SKIP() << "NUMA binding is Linux only";
+#endif
+
+    float frame[] = { 1.0f, 2.0f, 3.0f, 4.0f };
+    DAO_SHM_OPTIONS options { DAO_SHM_NUMA, Dao::Numa::Core2Node(0), 0, 0 };
+    Dao::Shm<float> writer(shmPath_, { 2,2 }, frame, 4, &options);
+    Dao::Shm<float> reader(shmPath_);
+
+    float fraction = 0.0f;
+    ASSERT_EQ(reader.get_meta_data(0)->numaNode, options.numaNode);
+    ASSERT_EQ(writer.get_numa_node(&fraction), options.numaNode);
+    ASSERT_FLOAT_EQ(fraction, 1.0f);
+
+    reader.set_numa_node(-1);
+    ASSERT_EQ(writer.get_meta_data(0)->numaNode, -1);
+    ASSERT_EQ(writer.get_meta_data(0)->allocFlags & DAO_SHM_NUMA, 0);
+}
+
+/**
+ * @brief Ensure the writer sees the lag of registered readers and releases the cursors of dead ones.
+ */
+TEST_F(Suite, ReaderRegistry)
+{
+    int16_t frame[] = { 1 };
+    Dao::Shm<int16_t> writer(shmPath_, { 1,1 }, frame, 8);
+    Dao::Shm<int16_t> reader(shmPath_);
+    int_fast8_t status;
+    uint64_t lag;
+
+    ASSERT_EQ(writer.slowest_reader(lag), -1);
+    reader.register_reader("fast", DAO_READER_BACKPRESSURE);
+    ASSERT_EQ(writer.get_readers().size(), 1u);
+    ASSERT_STREQ(writer.get_readers()[0].name, "fast");
+
+    for (int i = 0; i < 5; ++i)
+        writer.set_frame(frame);
+    ASSERT_EQ(writer.slowest_reader(lag), 0);
+    ASSERT_EQ(lag, 5u);
+    ASSERT_EQ(writer.wait_for_readers(2, 1000000), DAO_TIMEOUT);
+
+    for (int i = 0; i < 3; ++i)
+        reader.get_next_frame(false, status);
+    writer.slowest_reader(lag);
+    ASSERT_EQ(lag, 2u);
+    ASSERT_EQ(writer.wait_for_readers(2, 1000000), DAO_SUCCESS);
+
+#if !defined(_WIN32)
+    pid_t child = fork();
+    if (child == 0) {
+        Dao::Shm<int16_t> dying(shmPath_);
+        dying.register_reader("dying");
+        _exit(0);
+    }
+    ASSERT_GT(child, 0);
+    waitpid(child, nullptr, 0);
+    ASSERT_EQ(writer.get_readers().size(), 2u);
+    ASSERT_EQ(writer.check_readers(), 1u);
+    ASSERT_EQ(writer.get_readers().size(), 1u);
+#endif
+
+    reader.unregister_reader();
+    ASSERT_EQ(writer.get_readers().size(), 0u);
+}
+
 /**
  * @brief Ensure shape is returned correctly.
  */
@@ -325,6 +605,284 @@ TEST_F(Suite, FifoOverwrite)
     waiter.join();
 }
 
+/**
+ * @brief Ensure batched reads return the unread frames in order across the FIFO wrap.
+ */
+TEST_F(Suite, FifoBatch)
+{
+    int16_t frame[] = { 0 };
+    Dao::Shm<int16_t> writer(shmPath_, { 1,1 }, frame, 8);
+    Dao::Shm<int16_t> reader(shmPath_);
+    Dao::Shm<int16_t>::FrameBatch batch;
+
+    ASSERT_EQ(reader.get_next_frames(batch, 16), DAO_NOTREADY);
+    ASSERT_EQ(batch.size(), 0u);
+
+    for (int round = 0; round < 3; ++round) {
+        for (int16_t v = 1; v <= 6; ++v) {
+            frame[0] = v;
+            writer.set_frame(frame);
+        }
+        ASSERT_EQ(reader.get_next_frames(batch, 16, true), DAO_SUCCESS);
+        ASSERT_EQ(batch.size(), 6u);
+        ASSERT_EQ(batch.run(0).count + (batch.run_count() > 1 ? batch.run(1).count : 0), 6u);
+        for (uint32_t k = 0; k < batch.size(); ++k) {
+            ASSERT_EQ(*batch[k], (int16_t)(k + 1));
+            ASSERT_EQ(batch.cnt0()[k], batch.cnt0()[0] + k);
+        }
+    }
+    ASSERT_EQ(reader.get_next_frames(batch, 16), DAO_NOTREADY);
+
+    // limited batch size
+    for (int16_t v = 1; v <= 3; ++v) {
+        frame[0] = v;
+        writer.set_frame(frame);
+    }
+    ASSERT_EQ(reader.get_next_frames(batch, 2), DAO_SUCCESS);
+    ASSERT_EQ(batch.size(), 2u);
+    ASSERT_EQ(reader.get_next_frames(batch, 2), DAO_SUCCESS);
+    ASSERT_EQ(batch.size(), 1u);
+    ASSERT_EQ(*batch[0], 3);
+
+    // lapped: the frames not about to be overwritten are returned
+    for (int16_t v = 1; v <= 20; ++v) {
+        frame[0] = v;
+        writer.set_frame(frame);
+    }
+    ASSERT_EQ(reader.get_next_frames(batch, 16), DAO_OVERWRITE);
+    ASSERT_EQ(batch.size(), 7u);
+    ASSERT_EQ(*batch[6], 20);
+    ASSERT_EQ(*batch[0], 14);
+}
+
+/** @brief Ensure out-of-order packets are assembled, committed by the last one, and readable row by row */
+TEST_F(Suite, PacketAssembly)
+{
+    // 4 rows of 8 elements, one row per packet
+    DAO_SHM_OPTIONS options { 0, -1, 8, 0 };
+    Dao::Shm<float> writer(shmPath_, { 8,4 }, nullptr, 4, &options);
+    Dao::Shm<float> reader(shmPath_);
+    float packet[4][8];
+    int_fast8_t status;
+    uint64_t frame_number = 0;
+    uint32_t prefix;
+
+    for (int p = 0; p < 4; ++p)
+        for (int k = 0; k < 8; ++k)
+            packet[p][k] = (float)(p * 8 + k);
+    uint64_t cnt0 = reader.get_counter();
+
+    ASSERT_EQ(writer.set_packet(packet[1], 1, 4, 7), DAO_SUCCESS);
+    ASSERT_EQ(reader.wait_rows(1, status, 1000000), nullptr);
+    ASSERT_EQ(status, DAO_TIMEOUT);
+    ASSERT_EQ(writer.set_packet(packet[0], 0, 4, 7), DAO_SUCCESS);
+    float *rows = reader.wait_rows(2, status, 0, &frame_number);
+    ASSERT_NE(rows, nullptr);
+    ASSERT_EQ(frame_number, 7u);
+    ASSERT_EQ(rows[15], 15.0f);
+    ASSERT_EQ(reader.get_counter(), cnt0);
+
+    ASSERT_EQ(writer.set_packet(packet[3], 3, 4, 7), DAO_SUCCESS);
+    DAO_PACKET_MAP map = reader.get_packet_map((writer.get_meta_data(0)->fifo_last_written + 1) % 4, &prefix);
+    ASSERT_EQ(map.received, 3u);
+    ASSERT_EQ(prefix, 2u);
+    // a duplicate is not counted
+    ASSERT_EQ(writer.set_packet(packet[3], 3, 4, 7), DAO_SUCCESS);
+    ASSERT_EQ(reader.get_counter(), cnt0);
+    ASSERT_EQ(writer.set_packet(packet[2], 2, 4, 7), DAO_SUCCESS);
+    ASSERT_EQ(reader.get_counter(), cnt0 + 1);
+    ASSERT_EQ(reader.get_frame_record().frameId, 7u);
+    ASSERT_EQ(reader.get_frame()[31], 31.0f);
+
+    // a newer frame drops the incomplete one, its late packets are refused
+    ASSERT_EQ(writer.set_packet(packet[0], 0, 4, 8), DAO_SUCCESS);
+    ASSERT_EQ(writer.set_packet(packet[0], 0, 4, 9), DAO_SUCCESS);
+    ASSERT_EQ(writer.set_packet(packet[1], 1, 4, 8), DAO_ERROR);
+    for (uint32_t p = 1; p < 4; ++p)
+        ASSERT_EQ(writer.set_packet(packet[p], p, 4, 9), DAO_SUCCESS);
+    ASSERT_EQ(reader.get_counter(), cnt0 + 2);
+    ASSERT_EQ(reader.get_frame_record().frameId, 9u);
+}
+
+/** @brief Ensure strided views index, crop and slice a frame in place */
+TEST_F(Suite, ShmView)
+{
+    // 3 planes of 4 rows of 5 elements
+    Dao::Shm<int32_t> smem(shmPath_, { 5,4,3 });
+    int32_t frame[60];
+    for (int k = 0; k < 60; ++k)
+        frame[k] = k;
+    smem.set_frame(frame);
+
+    Dao::ShmView<int32_t, 3> cube = smem.view<3>(smem.get_frame());
+    ASSERT_EQ(cube.extent(0), 3u);
+    ASSERT_EQ(cube.extent(2), 5u);
+    ASSERT_TRUE(cube.is_contiguous());
+    ASSERT_EQ(cube(2, 1, 3), 2 * 20 + 1 * 5 + 3);
+
+    // region of interest: planes 1..2, rows 1..2, columns 2..4
+    Dao::ShmView<int32_t, 3> roi = cube.roi({ 1, 1, 2 }, { 2, 2, 3 });
+    ASSERT_EQ(roi.size(), 12u);
+    ASSERT_FALSE(roi.is_contiguous());
+    ASSERT_EQ(roi(0, 0, 0), 27);
+    ASSERT_EQ(roi(1, 1, 2), 54);
+    std::vector<int32_t> values(roi.begin(), roi.end());
+    ASSERT_EQ(values.size(), 12u);
+    ASSERT_EQ(values[3], 32);
+    ASSERT_EQ(values[11], 54);
+
+    // column 3 of plane 2, then a write through the view
+    Dao::ShmView<int32_t, 1> column = cube[2].slice<1>(3);
+    ASSERT_EQ(column.size(), 4u);
+    ASSERT_EQ(column.stride(0), 5u);
+    ASSERT_EQ(column(3), 58);
+    column(3) = -1;
+    ASSERT_EQ(smem.get_frame()[58], -1);
+
+    // a flat view merges the slowest dimensions
+    Dao::ShmView<const int32_t, 2> flat = smem.view<2>(smem.get_frame());
+    ASSERT_EQ(flat.extent(0), 12u);
+    ASSERT_EQ(flat.step({ 4, 2 })(2, 1), 8 * 5 + 2);
+
+    static constexpr int32_t table[6] = { 0, 1, 2, 3, 4, 5 };
+    constexpr Dao::ShmView<const int32_t, 2> cview(table, { 2, 3 });
+    static_assert(cview(1, 2) == 5, "constexpr indexing");
+}
+
+/** @brief Ensure 16-bit float streams are written and read through float conversions */
+TEST_F(Suite, HalfPrecision)
+{
+    std::vector<float> frame(40), back(40);
+    for (size_t k = 0; k < frame.size(); ++k)
+        frame[k] = 0.5f * (float)k - 3.0f;
+
+    Dao::Shm<dao_float16> half(shmPath_, { 8,5 });
+    ASSERT_EQ(half.get_meta_data(0)->atype, _DATATYPE_FLOAT16);
+    ASSERT_EQ(half.set_frame_float(frame.data()), DAO_SUCCESS);
+    ASSERT_EQ(half.get_frame()[2].bits, 0xc000);
+    ASSERT_EQ(half.get_frame_float(back.data()), DAO_SUCCESS);
+    ASSERT_EQ(back, frame);
+    std::filesystem::remove(shmPath_);
+
+    Dao::Shm<dao_bfloat16> bf16(shmPath_, { 8,5 });
+    ASSERT_EQ(bf16.set_frame_float(frame.data()), DAO_SUCCESS);
+    ASSERT_EQ(bf16.get_frame()[2].bits, 0xc000);
+    ASSERT_EQ(bf16.get_frame_float(back.data()), DAO_SUCCESS);
+    ASSERT_EQ(back, frame);
+    std::filesystem::remove(shmPath_);
+
+    // a float Shm opened on an integer stream writes nothing
+    Dao::Shm<int16_t> ints(shmPath_, { 8,5 });
+    Dao::Shm<float> wrong(shmPath_);
+    const uint64_t cnt0 = ints.get_counter();
+    ASSERT_EQ(wrong.set_frame_float(frame.data()), DAO_ERROR);
+    ASSERT_EQ(ints.get_counter(), cnt0);
+}
+
+/**
+ * @brief Ensure the trace of a frame is carried through a two-stage pipeline,
+ * each stage stamped in order after the origin frame id of the first one.
+ */
+TEST_F(Suite, FrameTrace)
+{
+    const std::string midPath = shmPath_ + ".mid";
+    DAO_SHM_OPTIONS options {};
+    options.trace = 1;
+    float frame[4] = { 1, 2, 3, 4 };
+
+    Dao::Shm<float> plain(shmPath_ + ".plain", { 2,2 });
+    ASSERT_FALSE(plain.has_trace());
+    std::filesystem::remove(shmPath_ + ".plain");
+
+    Dao::Shm<float> camera(shmPath_, { 2,2 }, nullptr, 4, &options);
+    Dao::Shm<float> mid(midPath, { 2,2 }, nullptr, 4, &options);
+    ASSERT_TRUE(camera.has_trace());
+    camera.set_trace_stage(1);
+    mid.set_trace_stage(2);
+
+    camera.set_frame_info(42, 0);
+    camera.set_frame(frame);
+    DAO_FRAME_TRACE trace = camera.get_frame_trace();
+    ASSERT_EQ(trace.originId, 42u);
+    ASSERT_EQ(trace.nbStamp, 1u);
+    ASSERT_EQ(trace.stamp[0].stageId, 1u);
+    ASSERT_GE(trace.stamp[0].exitTsc, trace.stamp[0].enterTsc);
+
+    // the second stage reads the frame of the first one and writes its own
+    Dao::Shm<float> input(shmPath_);
+    ASSERT_NE(input.get_frame(), nullptr);
+    mid.set_frame(frame);
+    trace = mid.get_frame_trace();
+    ASSERT_EQ(trace.originId, 42u);
+    ASSERT_EQ(trace.nbStamp, 2u);
+    ASSERT_EQ(trace.dropped, 0u);
+    ASSERT_EQ(trace.stamp[0].stageId, 1u);
+    ASSERT_EQ(trace.stamp[1].stageId, 2u);
+    ASSERT_GE(trace.stamp[1].enterTsc, trace.stamp[0].exitTsc);
+    ASSERT_GE(trace.stamp[1].exitTsc, trace.stamp[1].enterTsc);
+    std::filesystem::remove(midPath);
+}
+
+TEST_F(Suite, FrameTraceRewrittenInput)
+{
+    const std::string midPath = shmPath_ + ".mid";
+    DAO_SHM_OPTIONS options {};
+    options.trace = 1;
+    float frame[4] = { 1, 2, 3, 4 };
+
+    // depth 1: the next camera frame rewrites the segment the second stage read
+    Dao::Shm<float> camera(shmPath_, { 2,2 }, nullptr, 1, &options);
+    Dao::Shm<float> mid(midPath, { 2,2 }, nullptr, 1, &options);
+    camera.set_trace_stage(1);
+    mid.set_trace_stage(2);
+
+    camera.set_frame_info(42, 0);
+    camera.set_frame(frame);
+    const DAO_FRAME_TRACE first = camera.get_frame_trace();
+
+    // the second stage reads in its own thread; then its input is closed by another
+    // thread and the input segment rewritten before the second stage writes
+    Dao::Shm<float> *input = new Dao::Shm<float>(shmPath_);
+    std::atomic<int> step{0};
+    std::thread stage([&]() {
+        input->get_frame();
+        step = 1;
+        while (step != 2)
+            std::this_thread::yield();
+        mid.set_frame(frame);
+    });
+    while (step != 1)
+        std::this_thread::yield();
+    delete input;
+    camera.set_frame_info(43, 0);
+    camera.set_frame(frame);
+    ASSERT_EQ(camera.get_frame_trace().originId, 43u);
+    step = 2;
+    stage.join();
+
+    DAO_FRAME_TRACE trace = mid.get_frame_trace();
+    ASSERT_EQ(trace.originId, 42u);
+    ASSERT_EQ(trace.nbStamp, 2u);
+    ASSERT_EQ(trace.stamp[0].enterTsc, first.stamp[0].enterTsc);
+    ASSERT_EQ(trace.stamp[0].exitTsc, first.stamp[0].exitTsc);
+    ASSERT_EQ(trace.stamp[1].stageId, 2u);
+
+    // an input without traces gives the origin only, from its record when read
+    Dao::Shm<float> plain(shmPath_ + ".plain", { 2,2 });
+    plain.set_frame_info(7, 0);
+    plain.set_frame(frame);
+    ASSERT_NE(plain.get_frame(), nullptr);
+    plain.set_frame_info(8, 0);
+    plain.set_frame(frame);
+    mid.set_frame(frame);
+    trace = mid.get_frame_trace();
+    ASSERT_EQ(trace.originId, 7u);
+    ASSERT_EQ(trace.nbStamp, 1u);
+    ASSERT_EQ(trace.stamp[0].stageId, 2u);
+    std::filesystem::remove(shmPath_ + ".plain");
+    std::filesystem::remove(midPath);
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -1,9 +1,17 @@
 #include <gtest/gtest.h>
 #include <string>
+#include <atomic>
 #include <thread>
 #include <chrono>
 #include <memory>
 #include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/wait.h>
 
 
 extern "C" {
@@ -27,6 +35,775 @@ TEST(test_log_screen, set_up)
     int_fast8_t a = daoShmImageCreate(img, fp, naxis, size, atype, shared, NBkw);
 }
 
+/**
+ * @brief Fixture creating nbChannel input images and one output image of the same type.
+ */
+class test_combine : public ::testing::Test
+{
+protected:
+    void create(uint8_t atype, uint32_t nbVal, int nbChannel)
+    {
+        uint32_t size[2] = { nbVal, 1 };
+        inputs_.resize(nbChannel);
+        for (int k = 0; k < nbChannel; ++k)
+        {
+            std::string name = "/tmp/test_combine_in" + std::to_string(k) + ".im.shm";
+            ASSERT_EQ(daoShmImageCreate(&inputs_[k], name.c_str(), 2, size, atype, 1, 0), DAO_SUCCESS);
+            cube_.push_back(&inputs_[k]);
+        }
+        ASSERT_EQ(daoShmImageCreate_FIFO(&output_, "/tmp/test_combine_out.im.shm", 2, size, atype, 1, 0, 2),
+                  DAO_SUCCESS);
+    }
+
+    void TearDown() override
+    {
+        for (auto &input : inputs_)
+            daoShmCloseShm(&input);
+        daoShmCloseShm(&output_);
+    }
+
+    template <typename T>
+    static const T *segment(const IMAGE &image, uint32_t idx)
+    {
+        return (const T *)((const char *)image.array.V + idx * image.md[0].segmentStride);
+    }
+
+    std::vector<IMAGE> inputs_;
+    std::vector<IMAGE*> cube_;
+    IMAGE output_ {};
+};
+
+/**
+ * @brief Ensure the weighted float combine matches the scalar reference, including the tail elements.
+ */
+TEST_F(test_combine, float_gains)
+{
+    const uint32_t nbVal = 5000 + 3;
+    const int nbChannel = 12;
+    create(_DATATYPE_FLOAT, nbVal, nbChannel);
+
+    std::vector<float> gains(nbChannel);
+    std::vector<float> frame(nbVal);
+    for (int k = 0; k < nbChannel; ++k)
+    {
+        gains[k] = 0.5f + k;
+        for (uint32_t i = 0; i < nbVal; ++i)
+            frame[i] = 0.001f * i - k;
+        daoShmImage2Shm(frame.data(), nbVal, cube_[k]);
+    }
+
+    ASSERT_EQ(daoShmCombineShm2ShmGain(cube_.data(), &output_, nbChannel, nbVal, gains.data()), DAO_SUCCESS);
+
+    const float *out = segment<float>(output_, output_.md[0].fifo_last_written);
+    for (uint32_t i = 0; i < nbVal; ++i)
+    {
+        double ref = 0;
+        for (int k = 0; k < nbChannel; ++k)
+            ref += gains[k] * (0.001f * i - k);
+        ASSERT_NEAR(out[i], ref, 1e-3 * (1 + std::abs(ref)));
+    }
+}
+
+/**
+ * @brief Ensure the integer combine keeps the plain (modular) sum.
+ */
+TEST_F(test_combine, uint16_sum)
+{
+    const uint32_t nbVal = 300;
+    const int nbChannel = 3;
+    create(_DATATYPE_UINT16, nbVal, nbChannel);
+
+    std::vector<uint16_t> frame(nbVal);
+    for (int k = 0; k < nbChannel; ++k)
+    {
+        for (uint32_t i = 0; i < nbVal; ++i)
+            frame[i] = (uint16_t)(30000 + i + k);
+        daoShmImage2Shm(frame.data(), nbVal, cube_[k]);
+    }
+
+    ASSERT_EQ(daoShmCombineShm2Shm(cube_.data(), &output_, nbChannel, nbVal), DAO_SUCCESS);
+
+    const uint16_t *out = segment<uint16_t>(output_, output_.md[0].fifo_last_written);
+    for (uint32_t i = 0; i < nbVal; ++i)
+        ASSERT_EQ(out[i], (uint16_t)(3 * (30000 + i) + 3));
+}
+
+/**
+ * @brief Ensure the multi-threaded path for large images gives the plain sum.
+ */
+TEST_F(test_combine, double_large)
+{
+    const uint32_t nbVal = 1 << 19;
+    const int nbChannel = 4;
+    create(_DATATYPE_DOUBLE, nbVal, nbChannel);
+
+    std::vector<double> frame(nbVal);
+    for (int k = 0; k < nbChannel; ++k)
+    {
+        for (uint32_t i = 0; i < nbVal; ++i)
+            frame[i] = i * (k + 1);
+        daoShmImage2Shm(frame.data(), nbVal, cube_[k]);
+    }
+
+    ASSERT_EQ(daoShmCombineShm2Shm(cube_.data(), &output_, nbChannel, nbVal), DAO_SUCCESS);
+
+    const double *out = segment<double>(output_, output_.md[0].fifo_last_written);
+    for (uint32_t i = 0; i < nbVal; ++i)
+        ASSERT_EQ(out[i], 10.0 * i);
+}
+
+/**
+ * @brief Ensure the incremental combiner tracks changed channels and matches a full combine.
+ */
+TEST_F(test_combine, incremental)
+{
+    const uint32_t nbVal = 1000;
+    const int nbChannel = 8;
+    create(_DATATYPE_FLOAT, nbVal, nbChannel);
+
+    std::vector<float> gains(nbChannel);
+    std::vector<float> frame(nbVal);
+    for (int k = 0; k < nbChannel; ++k)
+    {
+        gains[k] = 1.0f + 0.25f * k;
+        for (uint32_t i = 0; i < nbVal; ++i)
+            frame[i] = (float)(i % 17) + k;
+        daoShmImage2Shm(frame.data(), nbVal, cube_[k]);
+    }
+
+    DAO_COMBINER comb;
+    ASSERT_EQ(daoShmCombinerInit(&comb, cube_.data(), &output_, nbChannel, nbVal, gains.data()), DAO_SUCCESS);
+    ASSERT_EQ(daoShmCombinerUpdate(&comb), DAO_NOTREADY);
+
+    // only the last two channels move
+    for (int iter = 0; iter < 50; ++iter)
+    {
+        for (int k = nbChannel - 2; k < nbChannel; ++k)
+        {
+            for (uint32_t i = 0; i < nbVal; ++i)
+                frame[i] = 0.1f * iter * i - k;
+            daoShmImage2Shm(frame.data(), nbVal, cube_[k]);
+        }
+        ASSERT_EQ(daoShmCombinerUpdate(&comb), DAO_SUCCESS);
+    }
+    ASSERT_EQ(comb.nbUpdates, 50u);
+    ASSERT_EQ(comb.nbChannelUpdates, 100u);
+
+    ASSERT_EQ(daoShmCombinerSetGain(&comb, 0, 3.0f), DAO_SUCCESS);
+    gains[0] = 3.0f;
+    ASSERT_EQ(daoShmCombinerUpdate(&comb), DAO_SUCCESS);
+
+    const float *last = segment<float>(output_, output_.md[0].fifo_last_written);
+    std::vector<float> incremental(last, last + nbVal);
+    ASSERT_EQ(daoShmCombineShm2ShmGain(cube_.data(), &output_, nbChannel, nbVal, gains.data()), DAO_SUCCESS);
+    const float *full = segment<float>(output_, output_.md[0].fifo_last_written);
+    for (uint32_t i = 0; i < nbVal; ++i)
+        ASSERT_NEAR(incremental[i], full[i], 1e-3 * (1 + std::abs(full[i])));
+
+    daoShmCombinerFree(&comb);
+}
+
+/**
+ * @brief Ensure the incremental combiner reads channels larger than nbVal whole and combines their first nbVal elements.
+ */
+TEST_F(test_combine, larger_channels)
+{
+    const uint32_t chanVal = 4096;
+    const int nbVal = 100;
+    const int nbChannel = 3;
+    create(_DATATYPE_FLOAT, chanVal, nbChannel);
+
+    std::vector<float> frame(chanVal);
+    for (int k = 0; k < nbChannel; ++k)
+    {
+        for (uint32_t i = 0; i < chanVal; ++i)
+            frame[i] = (float)(k + 1);
+        daoShmImage2Shm(frame.data(), chanVal, cube_[k]);
+    }
+
+    DAO_COMBINER comb;
+    ASSERT_EQ(daoShmCombinerInit(&comb, cube_.data(), &output_, nbChannel, nbVal, NULL), DAO_SUCCESS);
+    for (int iter = 1; iter <= 5; ++iter)
+    {
+        for (uint32_t i = 0; i < chanVal; ++i)
+            frame[i] = 10.0f * iter;
+        daoShmImage2Shm(frame.data(), chanVal, cube_[1]);
+        ASSERT_EQ(daoShmCombinerUpdate(&comb), DAO_SUCCESS);
+
+        const float *out = segment<float>(output_, output_.md[0].fifo_last_written);
+        for (int i = 0; i < nbVal; ++i)
+            ASSERT_EQ(out[i], 1.0f + 10.0f * iter + 3.0f);
+    }
+    ASSERT_EQ(comb.nbChannelUpdates, 5u);
+
+    daoShmCombinerFree(&comb);
+}
+
+/**
+ * @brief Ensure every metadata block and every segment starts on a cache line, the first segment on a page.
+ */
+TEST(test_layout, aligned_segments)
+{
+    const char *name = "/tmp/test_layout.im.shm";
+    uint32_t size[2] = { 3, 5 };
+    IMAGE image {};
+    IMAGE reader {};
+
+    ASSERT_EQ(sizeof(IMAGE_METADATA) % DAO_CACHELINE_SIZE, 0u);
+    ASSERT_EQ(offsetof(IMAGE_METADATA, atime) % DAO_CACHELINE_SIZE, 0u);
+    ASSERT_EQ(offsetof(IMAGE_METADATA, futexWaiters) % DAO_CACHELINE_SIZE, 0u);
+    // the layout read with every segment access is not on the line of the FIFO head
+    ASSERT_EQ(offsetof(IMAGE_METADATA, allocFlags) % DAO_CACHELINE_SIZE, 0u);
+    ASSERT_EQ(offsetof(IMAGE_METADATA, fifo_last_written) / DAO_CACHELINE_SIZE,
+              offsetof(IMAGE_METADATA, futexSeq) / DAO_CACHELINE_SIZE);
+    ASSERT_LT(offsetof(IMAGE_METADATA, futexSeq), offsetof(IMAGE_METADATA, allocFlags));
+    ASSERT_EQ(offsetof(IMAGE_METADATA, dataOffset) / DAO_CACHELINE_SIZE,
+              offsetof(IMAGE_METADATA, traceOffset) / DAO_CACHELINE_SIZE);
+
+    ASSERT_EQ(daoShmImageCreate_FIFO(&image, name, 2, size, _DATATYPE_UINT8, 1, 0, 3), DAO_SUCCESS);
+    ASSERT_EQ(image.md[0].layoutVersion, DAO_SHM_LAYOUT_VERSION);
+    ASSERT_EQ((uintptr_t)image.array.V % DAO_SHM_PAGE_SIZE, 0u);
+    ASSERT_EQ(image.md[0].segmentStride, (uint64_t)DAO_CACHELINE_SIZE);
+
+    uint8_t frame[15];
+    for (int i = 0; i < 15; ++i)
+        frame[i] = (uint8_t)(i + 1);
+    ASSERT_EQ(daoShmImage2Shm(frame, 15, &image), DAO_SUCCESS);
+    ASSERT_EQ(daoShmShm2Img(name, &reader), DAO_SUCCESS);
+    void *newest;
+    uint32_t idx;
+    uint64_t cnt0;
+    ASSERT_EQ(daoShmGetNewestSegment(&reader, &newest, &idx, &cnt0), DAO_SUCCESS);
+    ASSERT_EQ((uintptr_t)newest % DAO_CACHELINE_SIZE, 0u);
+    ASSERT_EQ(std::memcmp(newest, frame, sizeof(frame)), 0);
+    daoShmCloseShm(&reader);
+    daoShmCloseShm(&image);
+
+    DAO_SHM_OPTIONS options { DAO_SHM_PAGE_ALIGN, -1, 0, 0 };
+    ASSERT_EQ(daoShmImageCreateWithOptions(&image, name, 2, size, _DATATYPE_UINT8, 1, 0, 3, &options), DAO_SUCCESS);
+    ASSERT_EQ(image.md[0].segmentStride, (uint64_t)DAO_SHM_PAGE_SIZE);
+    daoShmCloseShm(&image);
+}
+
+/**
+ * @brief Ensure files with the layout of an older DAO version are refused by daoShmShm2Img and read by daoShmReadLegacy.
+ */
+TEST(test_layout, legacy_reader)
+{
+    const char *name = "/tmp/test_legacy.im.shm";
+    // metadata blocks ended after fifo_last_written, with no padding before the data
+    const size_t mdSize = (offsetof(IMAGE_METADATA, fifo_last_written) + sizeof(uint32_t) + 7) / 8 * 8;
+    const uint32_t fifo_size = 2;
+    const float frames[2][4] = { { 1.0f, 2.0f, 3.0f, 4.0f }, { 5.0f, 6.0f, 7.0f, 8.0f } };
+
+    std::vector<char> file(fifo_size * (mdSize + sizeof(frames[0])), 0);
+    for (uint32_t k = 0; k < fifo_size; ++k)
+    {
+        IMAGE_METADATA md {};
+        md.naxis = 2;
+        md.size[0] = 4;
+        md.size[1] = 1;
+        md.nelement = 4;
+        md.atype = _DATATYPE_FLOAT;
+        md.shared = 1;
+        md.cnt0 = 10 + k;
+        md.fifo_size = fifo_size;
+        md.fifo_last_written = 1;
+        std::memcpy(file.data() + k * mdSize, &md, mdSize);
+        std::memcpy(file.data() + fifo_size * mdSize + k * sizeof(frames[0]), frames[k], sizeof(frames[0]));
+    }
+    FILE *f = fopen(name, "wb");
+    ASSERT_NE(f, nullptr);
+    ASSERT_EQ(fwrite(file.data(), 1, file.size(), f), file.size());
+    fclose(f);
+
+    IMAGE image {};
+    ASSERT_EQ(daoShmShm2Img(name, &image), DAO_ERROR);
+
+    float dst[4];
+    uint64_t cnt0 = 0;
+    ASSERT_EQ(daoShmReadLegacy(name, dst, sizeof(dst), &cnt0), DAO_SUCCESS);
+    ASSERT_EQ(cnt0, 11u);
+    ASSERT_EQ(std::memcmp(dst, frames[1], sizeof(dst)), 0);
+    ASSERT_EQ(daoShmReadLegacy(name, dst, 2, &cnt0), DAO_ERROR);
+    remove(name);
+}
+
+/**
+ * @brief Ensure a deep compact-metadata FIFO stays small and its frame records follow every write.
+ */
+TEST(test_layout, compact_records)
+{
+    const char *name = "/tmp/test_records.im.shm";
+    const uint32_t depth = 10000;
+    uint32_t size[2] = { 4, 4 };
+    IMAGE image {};
+    IMAGE reader {};
+    DAO_SHM_OPTIONS options { DAO_SHM_COMPACT_MD, -1, 0, 0 };
+
+    ASSERT_EQ(sizeof(DAO_FRAME_RECORD), (size_t)DAO_CACHELINE_SIZE);
+    ASSERT_EQ(daoShmImageCreateWithOptions(&image, name, 2, size, _DATATYPE_FLOAT, 1, 0, depth, &options), DAO_SUCCESS);
+    // one metadata block, one record and one 64 byte segment per frame
+    ASSERT_LT((uint64_t)image.memsize, sizeof(IMAGE_METADATA) + 4096 + depth * 2 * 64 + 2 * DAO_SHM_PAGE_SIZE);
+    ASSERT_EQ(daoShmShm2Img(name, &reader), DAO_SUCCESS);
+
+    float frame[16] = {};
+    for (uint32_t k = 0; k < 2 * depth + 5; ++k)
+    {
+        frame[0] = (float)k;
+        daoShmSetFrameInfo(&image, 1000 + k, 42 + k, k % 3);
+        ASSERT_EQ(daoShmImage2Shm(frame, 16, &image), DAO_SUCCESS);
+    }
+    // the md holds the newest frame, the records every frame still in the FIFO
+    ASSERT_EQ(daoShmGetCounter(&reader), 2ull * depth + 5);
+    ASSERT_EQ(reader.md[0].cnt0, 2ull * depth + 5);
+    for (uint32_t back = 0; back < depth; back += 999)
+    {
+        uint32_t idx = (reader.md[0].fifo_last_written + depth - back) % depth;
+        uint32_t k = 2 * depth + 4 - back;
+        DAO_FRAME_RECORD record;
+        void *segment;
+        ASSERT_EQ(daoShmGetFrameRecord(&reader, idx, &record), DAO_SUCCESS);
+        ASSERT_EQ(record.cnt0, (uint64_t)k + 1);
+        ASSERT_EQ(record.frameId, 1000u + k);
+        ASSERT_EQ(record.atimeNs, 42u + k);
+        ASSERT_EQ(record.tag, k % 3);
+        ASSERT_EQ(record.seq % 2, 0u);
+        ASSERT_GT(record.writeNs, 0u);
+        daoShmGetArbitrarySegment(&reader, &segment, idx);
+        ASSERT_EQ(((float *)segment)[0], (float)k);
+    }
+
+    // sequential FIFO reading uses the records
+    void *segment;
+    uint32_t idx;
+    uint64_t cnt0;
+    ASSERT_EQ(daoShmGetNextSegment(&reader, &segment, &idx, &cnt0), DAO_OVERWRITE);
+    ASSERT_EQ(daoShmGetNextSegment(&reader, &segment, &idx, &cnt0), DAO_NOTREADY);
+    ASSERT_EQ(daoShmImage2Shm(frame, 16, &image), DAO_SUCCESS);
+    ASSERT_EQ(daoShmGetNextSegment(&reader, &segment, &idx, &cnt0), DAO_SUCCESS);
+    ASSERT_EQ(cnt0, 2ull * depth + 6);
+
+    daoShmCloseShm(&reader);
+    daoShmCloseShm(&image);
+    std::remove(name);
+}
+
+/**
+ * @brief Ensure a reader following a writer process is never lapped while the FIFO is deeper than
+ * the frames written: a segment is published only once its record is complete.
+ */
+TEST(test_layout, publish_order)
+{
+    const char *name = "/tmp/test_publish.im.shm";
+    const uint32_t depth = 4096;
+    const uint32_t nbFrame = 4000;
+    uint32_t size[2] = { 16, 1 };
+    IMAGE image {};
+
+    ASSERT_EQ(daoShmImageCreate_FIFO(&image, name, 2, size, _DATATYPE_UINT32, 1, 0, depth), DAO_SUCCESS);
+    uint64_t cnt0 = daoShmGetCounter(&image);
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        IMAGE writer {};
+        uint32_t frame[16] = {};
+        if (daoShmShm2Img(name, &writer) != DAO_SUCCESS)
+            _exit(1);
+        for (uint32_t k = 0; k < nbFrame; ++k)
+        {
+            frame[0] = k;
+            if (daoShmImage2Shm(frame, 16, &writer) != DAO_SUCCESS)
+                _exit(2);
+        }
+        _exit(0);
+    }
+
+    uint32_t nbRead = 0;
+    while (nbRead < nbFrame)
+    {
+        void *segment;
+        uint32_t idx;
+        uint64_t segmentCnt0;
+        int_fast8_t rval = daoShmGetNextSegment(&image, &segment, &idx, &segmentCnt0);
+        ASSERT_NE(rval, DAO_OVERWRITE);
+        if (rval == DAO_SUCCESS)
+        {
+            ASSERT_EQ(segmentCnt0, cnt0 + nbRead + 1);
+            ASSERT_EQ(((uint32_t *)segment)[0], nbRead);
+            nbRead++;
+        }
+    }
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    daoShmCloseShm(&image);
+    std::remove(name);
+}
+
+/**
+ * @brief Ensure the type registry matches the SIZEOF_DATATYPE_ constants and is cached in the IMAGE.
+ */
+TEST(test_types, registry)
+{
+    const char *name = "/tmp/test_types.im.shm";
+    const size_t sizes[DAO_NB_DATATYPE] = { 0,
+        SIZEOF_DATATYPE_UINT8, SIZEOF_DATATYPE_INT8, SIZEOF_DATATYPE_UINT16, SIZEOF_DATATYPE_INT16,
+        SIZEOF_DATATYPE_UINT32, SIZEOF_DATATYPE_INT32, SIZEOF_DATATYPE_UINT64, SIZEOF_DATATYPE_INT64,
+        SIZEOF_DATATYPE_FLOAT, SIZEOF_DATATYPE_DOUBLE, SIZEOF_DATATYPE_COMPLEX_FLOAT, SIZEOF_DATATYPE_COMPLEX_DOUBLE,
+        SIZEOF_DATATYPE_FLOAT16, SIZEOF_DATATYPE_BFLOAT16 };
+    uint32_t size[2] = { 3, 2 };
+    IMAGE image {};
+    IMAGE reader {};
+
+    ASSERT_EQ(daoShmTypeInfo(0), nullptr);
+    ASSERT_EQ(daoShmTypeInfo(DAO_NB_DATATYPE), nullptr);
+    for (uint8_t atype = 1; atype < DAO_NB_DATATYPE; ++atype)
+    {
+        const DAO_TYPE_INFO *info = daoShmTypeInfo(atype);
+        ASSERT_NE(info, nullptr);
+        ASSERT_EQ(info->atype, atype);
+        ASSERT_EQ(info->size, sizes[atype]);
+        ASSERT_NE(info->combine, nullptr);
+    }
+    ASSERT_TRUE(daoShmTypeInfo(_DATATYPE_COMPLEX_DOUBLE)->isComplex);
+
+    ASSERT_EQ(daoShmImageCreate(&image, name, 2, size, _DATATYPE_INT16, 1, 0), DAO_SUCCESS);
+    ASSERT_EQ(image.type, daoShmTypeInfo(_DATATYPE_INT16));
+    ASSERT_EQ(daoShmShm2Img(name, &reader), DAO_SUCCESS);
+    ASSERT_EQ(reader.type, image.type);
+    daoShmCloseShm(&reader);
+    daoShmCloseShm(&image);
+    std::remove(name);
+}
+
+/**
+ * @brief Ensure the 16-bit float conversions round to nearest even, in the vector body and in the tail.
+ */
+TEST(test_types, half_conversion)
+{
+    const float values[8] = { 1.0f, -2.0f, 65504.0f, 65520.0f, 5.9604645e-08f, 1.0f + 1.0f / 2048, 1.0f + 3.0f / 256, 0.1f };
+    const uint16_t half[8] = { 0x3c00, 0xc000, 0x7bff, 0x7c00, 0x0001, 0x3c00, 0x3c0c, 0x2e66 };
+    const uint16_t bf16[8] = { 0x3f80, 0xc000, 0x4780, 0x4780, 0x3380, 0x3f80, 0x3f82, 0x3dcd };
+    const uint32_t n = 8 * 5;
+    std::vector<float> src(n), back(n);
+    std::vector<uint16_t> dst(n);
+
+    for (uint32_t i = 0; i < n; ++i)
+        src[i] = values[i % 8];
+
+    ASSERT_EQ(daoShmConvertFromFloat(src.data(), dst.data(), _DATATYPE_FLOAT16, n), DAO_SUCCESS);
+    for (uint32_t i = 0; i < n; ++i)
+        ASSERT_EQ(dst[i], half[i % 8]) << i;
+    ASSERT_EQ(daoShmConvertToFloat(dst.data(), _DATATYPE_FLOAT16, back.data(), n), DAO_SUCCESS);
+    ASSERT_EQ(back[0], 1.0f);
+    ASSERT_EQ(back[4], 5.9604645e-08f);
+    ASSERT_TRUE(std::isinf(back[3]));
+
+    ASSERT_EQ(daoShmConvertFromFloat(src.data(), dst.data(), _DATATYPE_BFLOAT16, n), DAO_SUCCESS);
+    for (uint32_t i = 0; i < n; ++i)
+        ASSERT_EQ(dst[i], bf16[i % 8]) << i;
+    ASSERT_EQ(daoShmConvertToFloat(dst.data(), _DATATYPE_BFLOAT16, back.data(), n), DAO_SUCCESS);
+    ASSERT_EQ(back[1], -2.0f);
+    ASSERT_EQ(back[6], 1.0f + 2.0f / 128);
+
+    ASSERT_EQ(daoShmConvertToFloat(dst.data(), _DATATYPE_INT16, back.data(), n), DAO_ERROR);
+}
+
+/**
+ * @brief Ensure a reader waiting for leading rows wakes up on in-order partial writes, before the frame is finalized.
+ */
+TEST(test_partial, wait_written)
+{
+    const char *name = "/tmp/test_partial.im.shm";
+    uint32_t size[2] = { 16, 8 };
+    IMAGE image {};
+    IMAGE reader {};
+    uint16_t rows[8][16];
+    uint32_t idx;
+
+    for (int r = 0; r < 8; ++r)
+        for (int c = 0; c < 16; ++c)
+            rows[r][c] = (uint16_t)(r * 16 + c);
+    ASSERT_EQ(daoShmImageCreate_FIFO(&image, name, 2, size, _DATATYPE_UINT16, 1, 0, 3), DAO_SUCCESS);
+    ASSERT_EQ(daoShmShm2Img(name, &reader), DAO_SUCCESS);
+
+    for (int frame = 0; frame < 4; ++frame)
+    {
+        uint64_t cnt0 = daoShmGetCounter(&reader);
+        ASSERT_EQ(daoShmWaitWritten(&reader, 3 * 16, 1000000, &idx), DAO_TIMEOUT);
+        for (int r = 0; r < 3; ++r)
+            daoShmImagePart2Shm((char *)rows[r], 16, &image, r * 16, r, 8, frame);
+        ASSERT_EQ(daoShmWaitWritten(&reader, 3 * 16, 1000000, &idx), DAO_SUCCESS);
+        ASSERT_EQ(daoShmWaitWritten(&reader, 4 * 16, 1000000, &idx), DAO_TIMEOUT);
+        void *segment;
+        daoShmGetArbitrarySegment(&reader, &segment, idx);
+        ASSERT_EQ(((uint16_t *)segment)[47], 47);
+
+        // a gap does not move the filled mark
+        daoShmImagePart2Shm((char *)rows[5], 16, &image, 5 * 16, 5, 8, frame);
+        ASSERT_EQ(daoShmWaitWritten(&reader, 4 * 16, 1000000, &idx), DAO_TIMEOUT);
+
+        std::thread writer([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            for (int r = 3; r < 8; ++r)
+                daoShmImagePart2Shm((char *)rows[r], 16, &image, r * 16, r, 8, frame);
+            daoShmImagePart2ShmFinalize(&image);
+        });
+        ASSERT_EQ(daoShmWaitWritten(&reader, 6 * 16, 0, &idx), DAO_SUCCESS);
+        writer.join();
+        ASSERT_EQ(daoShmGetCounter(&reader), cnt0 + 1);
+        DAO_FRAME_RECORD record;
+        ASSERT_EQ(daoShmGetFrameRecord(&reader, image.md[0].fifo_last_written, &record), DAO_SUCCESS);
+        ASSERT_EQ(record.filled, 128u);
+    }
+
+    daoShmCloseShm(&reader);
+    daoShmCloseShm(&image);
+    std::remove(name);
+}
+
+/**
+ * @brief Ensure two threads writing interleaved packets of consecutive frames only commit whole frames:
+ * a late packet of a dropped frame never lands in the frame that took its map.
+ */
+TEST(test_packet, interleaved_frames)
+{
+    const char *name = "/tmp/test_packet.im.shm";
+    const uint32_t packetTotal = 8;
+    const uint32_t packetElems = 1024;
+    const uint64_t nbFrame = 2000;
+    uint32_t size[2] = { packetTotal * packetElems, 1 };
+    IMAGE image {};
+    IMAGE reader {};
+    DAO_SHM_OPTIONS options {};
+    options.numaNode = -1;
+    options.packetMax = packetTotal;
+
+    ASSERT_EQ(daoShmImageCreateWithOptions(&image, name, 2, size, _DATATYPE_UINT32, 1, 0, 4, &options), DAO_SUCCESS);
+    ASSERT_EQ(daoShmShm2Img(name, &reader), DAO_SUCCESS);
+    uint64_t cnt0 = daoShmGetCounter(&reader);
+
+    // each thread writes half of the packets of every frame, at its own pace
+    std::atomic<int> running { 2 };
+    auto writer = [&](uint32_t first) {
+        std::vector<uint32_t> packet(packetElems);
+        for (uint64_t frame = 1; frame <= nbFrame; ++frame)
+        {
+            std::fill(packet.begin(), packet.end(), (uint32_t)frame);
+            for (uint32_t p = first; p < packetTotal; p += 2)
+            {
+                daoShmImagePacket2Shm(packet.data(), &image, p, packetTotal, frame);
+                if ((frame + p) % 7 == 0)
+                    std::this_thread::yield();
+            }
+        }
+        running--;
+    };
+    std::thread even(writer, 0);
+    std::thread odd(writer, 1);
+
+    // every committed frame holds the packets of its own frame number only
+    std::vector<uint32_t> copy(packetTotal * packetElems);
+    auto check = [&]() {
+        uint32_t idx;
+        uint64_t segmentCnt0;
+        DAO_FRAME_RECORD record;
+        if (daoShmGetCounter(&reader) == cnt0
+            || daoShmReadConsistent(&reader, copy.data(), &idx, &segmentCnt0, 0) != DAO_SUCCESS
+            || daoShmGetFrameRecord(&reader, idx, &record) != DAO_SUCCESS || record.cnt0 != segmentCnt0)
+            return;
+        for (uint32_t v : copy)
+            ASSERT_EQ(v, (uint32_t)record.frameId);
+    };
+    while (running > 0)
+    {
+        check();
+        std::this_thread::yield();
+    }
+    even.join();
+    odd.join();
+    check();
+
+    ASSERT_GT(daoShmGetCounter(&reader), cnt0);
+    DAO_FRAME_RECORD record;
+    ASSERT_EQ(daoShmGetFrameRecord(&reader, reader.md[0].fifo_last_written, &record), DAO_SUCCESS);
+    ASSERT_EQ(record.frameId, nbFrame);
+
+    daoShmCloseShm(&reader);
+    daoShmCloseShm(&image);
+    std::remove(name);
+}
+
+/**
+ * @brief Ensure several writer processes publish every frame of a DAO_SHM_MPSC image once, untorn and in order per writer.
+ */
+TEST(test_mpsc, writer_processes)
+{
+    const char *name = "/tmp/test_mpsc.im.shm";
+    const int nbWriter = 4;
+    const uint32_t nbFrame = 2000;
+    const uint32_t depth = 64;
+    uint32_t size[2] = { 256, 1 };
+    IMAGE image {};
+    DAO_SHM_OPTIONS options { DAO_SHM_MPSC, -1, 0, 0 };
+
+    ASSERT_EQ(daoShmImageCreateWithOptions(&image, name, 2, size, _DATATYPE_UINT32, 1, 0, depth, &options), DAO_SUCCESS);
+    uint64_t cnt0 = daoShmGetCounter(&image);
+
+    std::vector<pid_t> pids;
+    for (int w = 0; w < nbWriter; ++w)
+    {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0)
+        {
+            IMAGE writer {};
+            std::vector<uint32_t> frame(256);
+            if (daoShmShm2Img(name, &writer) != DAO_SUCCESS)
+                _exit(1);
+            for (uint32_t k = 0; k < nbFrame; ++k)
+            {
+                void *slot;
+                uint32_t idx;
+                // every element carries the writer and the frame number, a torn frame mixes them
+                for (auto &v : frame)
+                    v = ((uint32_t)w << 24) | k;
+                if (k % 2 == 0)
+                {
+                    if (daoShmImage2Shm(frame.data(), 256, &writer) != DAO_SUCCESS)
+                        _exit(2);
+                }
+                else
+                {
+                    daoShmAcquireWriteSlot(&writer, &slot, &idx);
+                    memcpy(slot, frame.data(), 256 * sizeof(uint32_t));
+                    if (daoShmCommitWriteSlot(&writer, idx) != DAO_SUCCESS)
+                        _exit(3);
+                }
+            }
+            _exit(0);
+        }
+        pids.push_back(pid);
+    }
+
+    // follow the stream while the writers run
+    std::vector<uint32_t> copy(256);
+    std::vector<int64_t> last(nbWriter, -1);
+    uint32_t nbRead = 0;
+    for (int running = nbWriter; running > 0;)
+    {
+        void *segment;
+        uint32_t idx;
+        uint64_t segmentCnt0;
+        int_fast8_t rval = daoShmGetNextSegment(&image, &segment, &idx, &segmentCnt0);
+        if (rval == DAO_SUCCESS || rval == DAO_OVERWRITE)
+        {
+            memcpy(copy.data(), segment, 256 * sizeof(uint32_t));
+            if (daoShmCheckSegmentOverwrite(&image) == DAO_SUCCESS)
+            {
+                uint32_t w = copy[0] >> 24;
+                ASSERT_LT(w, (uint32_t)nbWriter);
+                for (uint32_t v : copy)
+                    ASSERT_EQ(v, copy[0]);
+                ASSERT_GT((int64_t)(copy[0] & 0xffffff), last[w]);
+                last[w] = copy[0] & 0xffffff;
+                nbRead++;
+            }
+        }
+        else if (rval == DAO_NOTREADY)
+        {
+            int status;
+            pid_t done = waitpid(-1, &status, WNOHANG);
+            if (done > 0)
+            {
+                ASSERT_TRUE(WIFEXITED(status));
+                ASSERT_EQ(WEXITSTATUS(status), 0);
+                running--;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    ASSERT_EQ(daoShmGetCounter(&image), cnt0 + nbWriter * nbFrame);
+    ASSERT_EQ(image.md[0].mpscReserve, image.md[0].mpscCommit);
+    ASSERT_GT(nbRead, 0u);
+    // the quiet write has no ticket, it could overwrite a reserved segment
+    ASSERT_EQ(daoShmImage2ShmQuiet(copy.data(), 256, &image), DAO_ERROR);
+    // so do the partial writes and their finalize
+    ASSERT_EQ(daoShmImagePart2Shm((char *)copy.data(), 128, &image, 0, 0, 2, 1), DAO_ERROR);
+    ASSERT_EQ(daoShmImagePacket2Shm(copy.data(), &image, 0, 2, 1), DAO_ERROR);
+    ASSERT_EQ(daoShmImagePart2ShmFinalize(&image), DAO_ERROR);
+    ASSERT_EQ(image.md[0].mpscReserve, image.md[0].mpscCommit);
+    // the last frames of the FIFO have consecutive counters
+    for (uint32_t back = 0; back < depth; ++back)
+    {
+        DAO_FRAME_RECORD record;
+        daoShmGetFrameRecord(&image, image.md[0].fifo_last_written + depth - back, &record);
+        ASSERT_EQ(record.cnt0, cnt0 + nbWriter * nbFrame - back);
+    }
+
+    daoShmCloseShm(&image);
+    std::remove(name);
+
+    // the packet assembly is single-producer
+    IMAGE packets {};
+    options.packetMax = 8;
+    ASSERT_EQ(daoShmImageCreateWithOptions(&packets, name, 2, size, _DATATYPE_UINT32, 1, 0, depth, &options), DAO_ERROR);
+}
+
+/**
+ * @brief Ensure a trace extended past DAO_TRACE_MAX_STAMPS stages keeps its first stamps,
+ * counts the others as dropped and survives a reader opening the file.
+ */
+TEST(test_trace, stamps)
+{
+    const char *name = "/tmp/test_trace.im.shm";
+    uint32_t size[2] = { 4, 4 };
+    float frame[16] = { 0 };
+    DAO_SHM_OPTIONS options { 0, -1, 0, 1 };
+    IMAGE image {};
+    IMAGE reader {};
+    DAO_FRAME_TRACE trace;
+    uint32_t nbStage = DAO_TRACE_MAX_STAMPS + 2;
+
+    ASSERT_EQ(daoShmImageCreateWithOptions(&image, name, 2, size, _DATATYPE_FLOAT, 1, 0, 4, &options), DAO_SUCCESS);
+    ASSERT_NE(image.trace, nullptr);
+    ASSERT_GT(daoShmTraceTscPerNs(), 0.0);
+
+    // a frame written without stage starts an empty trace with the frame id as origin
+    daoShmSetFrameInfo(&image, 7, 0, 0);
+    daoShmImage2Shm(frame, 16, &image);
+    ASSERT_EQ(daoShmGetFrameTrace(&image, image.md[0].fifo_last_written, &trace), DAO_SUCCESS);
+    ASSERT_EQ(trace.originId, 7u);
+    ASSERT_EQ(trace.nbStamp, 0u);
+
+    // every frame continues the trace of the previous one
+    for (uint32_t stage = 0; stage < nbStage; ++stage)
+    {
+        ASSERT_EQ(daoShmTraceFrom(&image, &image, image.md[0].fifo_last_written, stage, daoShmTraceTsc()), DAO_SUCCESS);
+        daoShmImage2Shm(frame, 16, &image);
+    }
+
+    ASSERT_EQ(daoShmShm2Img(name, &reader), DAO_SUCCESS);
+    ASSERT_EQ(daoShmGetFrameTrace(&reader, reader.md[0].fifo_last_written, &trace), DAO_SUCCESS);
+    ASSERT_EQ(trace.originId, 7u);
+    ASSERT_EQ(trace.nbStamp, (uint32_t)DAO_TRACE_MAX_STAMPS);
+    ASSERT_EQ(trace.dropped, 2u);
+    for (uint32_t stage = 0; stage < DAO_TRACE_MAX_STAMPS; ++stage)
+    {
+        ASSERT_EQ(trace.stamp[stage].stageId, stage);
+        ASSERT_GE(trace.stamp[stage].exitTsc, trace.stamp[stage].enterTsc);
+    }
+
+    daoShmCloseShm(&reader);
+    daoShmCloseShm(&image);
+    std::remove(name);
+}
 
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv); 
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include <daoSignalTable.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+/**
+ * @brief Ensure every signal is alone on its cache line.
+ */
+TEST(SignalTable, layout)
+{
+    EXPECT_EQ(sizeof(Dao::SignalSlot), (size_t)SIGNAL_CACHELINE_SIZE);
+    EXPECT_EQ(alignof(Dao::SignalSlot), (size_t)SIGNAL_CACHELINE_SIZE);
+}
+
+/**
+ * @brief Ensure signals are counted and acknowledged one at a time.
+ */
+TEST(SignalTable, send_receive)
+{
+    Dao::SignalTable table(8);
+
+    EXPECT_EQ(table.SignalReceive(3), 0);
+    table.SignalSend(3);
+    table.SignalSendRange(3, 2);
+    EXPECT_EQ(table.SignalsPending(3), 2u);
+    EXPECT_EQ(table.SignalsPending(4), 1u);
+    EXPECT_EQ(table.SignalReceive(3), 1);
+    table.SignalReceiveSpin(3);
+    EXPECT_EQ(table.SignalReceive(3), 0);
+    table.SignalReset(4);
+    EXPECT_EQ(table.SignalsPending(4), 0u);
+}
+
+/**
+ * @brief Ensure SignalReceiveSpinTimeout gives up after the timeout and returns as soon as a signal arrives.
+ */
+TEST(SignalTable, spin_timeout)
+{
+    using namespace std::chrono;
+    Dao::SignalTable table(4);
+
+    auto t0 = steady_clock::now();
+    EXPECT_EQ(table.SignalReceiveSpinTimeout(1, 2000), 0u);
+    EXPECT_GE(duration_cast<microseconds>(steady_clock::now() - t0).count(), 2000);
+
+    std::thread sender([&table]() {
+        std::this_thread::sleep_for(milliseconds(1));
+        table.SignalSend(1);
+    });
+    EXPECT_EQ(table.SignalReceiveSpinTimeout(1, 10000000), 1u);
+    sender.join();
+    EXPECT_EQ(table.SignalsPending(1), 0u);
+}
+
+/**
+ * @brief Ensure the data written before a signal is seen by its receiver (release/acquire).
+ */
+TEST(SignalTable, ping_pong)
+{
+    const int nbRound = 200;
+    Dao::SignalTable table(2);
+    uint64_t payload[4] = { 0 };
+    std::atomic<int> errors{0};
+
+    std::thread pong([&]() {
+        for (int round = 1; round <= nbRound; ++round)
+        {
+            table.SignalReceiveSpin(0);
+            for (uint64_t value : payload)
+            {
+                if (value != (uint64_t)round)
+                    errors++;
+            }
+            table.SignalSend(1);
+        }
+    });
+    for (int round = 1; round <= nbRound; ++round)
+    {
+        for (uint64_t &value : payload)
+            value = round;
+        table.SignalSend(0);
+        table.SignalReceiveSpin(1);
+    }
+    pong.join();
+    EXPECT_EQ(errors.load(), 0);
+}
+
+/**
+ * @brief Ensure no thread leaves a barrier episode before every thread arrived, and one is the last.
+ */
+TEST(SignalTable, barrier)
+{
+    const int nbThread = 4;
+    const int nbEpisode = 20;
+    Dao::SignalTable table(1);
+    std::atomic<int> arrived{0};
+    std::atomic<int> nbLast{0};
+    std::atomic<int> errors{0};
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < nbThread; ++t)
+    {
+        threads.emplace_back([&]() {
+            for (int episode = 1; episode <= nbEpisode; ++episode)
+            {
+                arrived++;
+                if (table.SignalBarrierWait(0, nbThread))
+                    nbLast++;
+                if (arrived.load() < episode * nbThread)
+                    errors++;
+                // nobody arrives at the next episode before everyone checked this one
+                table.SignalBarrierWait(0, nbThread);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    EXPECT_EQ(errors.load(), 0);
+    EXPECT_EQ(nbLast.load(), nbEpisode);
+}
+
+/**
+ * @brief Ensure the fan-in latch waits for every worker and a broadcast starts every worker.
+ */
+TEST(SignalTable, fan_in_broadcast)
+{
+    const int nbThread = 3;
+    const int nbRound = 10;
+    Dao::SignalTable table(2);
+    std::atomic<int> done{0};
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < nbThread; ++t)
+    {
+        threads.emplace_back([&]() {
+            uint64_t seen = 0;
+            for (int round = 0; round < nbRound; ++round)
+            {
+                table.SignalReceiveSpinBroadcast(0, seen);
+                done++;
+                table.SignalSend(1);
+            }
+        });
+    }
+    for (int round = 1; round <= nbRound; ++round)
+    {
+        table.SignalSend(0);
+        table.SignalReceiveSpinCount(1, nbThread);
+        EXPECT_EQ(done.load(), round * nbThread);
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    EXPECT_EQ(table.SignalsPending(1), 0u);
+}
+
+/**
+ * @brief Ensure a receiver blocked in SignalReceiveSleep is woken by SignalSend and uses no CPU meanwhile.
+ */
+TEST(SignalTable, sleep_wake)
+{
+    Dao::SignalTable table(2);
+    std::atomic<bool> waiting{false};
+    double cpuMs = 0;
+    double wakeMs = 0;
+    std::chrono::steady_clock::time_point sent;
+
+    std::thread receiver([&]() {
+        struct timespec c0, c1;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+        waiting = true;
+        table.SignalReceiveSleep(0, 0);
+        wakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count();
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+        cpuMs = (c1.tv_sec - c0.tv_sec) * 1e3 + (c1.tv_nsec - c0.tv_nsec) * 1e-6;
+    });
+    while (!waiting)
+        std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    sent = std::chrono::steady_clock::now();
+    table.SignalSend(0);
+    receiver.join();
+    EXPECT_LT(cpuMs, 20.0);
+    EXPECT_LT(wakeMs, 50.0);
+    EXPECT_EQ(table.SignalsPending(0), 0u);
+
+    // a signal already pending returns at once, a timeout only re-checks
+    table.SignalSend(1);
+    table.SignalReceiveSleep(1, 1000);
+    EXPECT_EQ(table.SignalsPending(1), 0u);
+}
+
+/**
+ * @brief Ensure no wake-up is lost when both sides of a ping-pong block in the kernel.
+ */
+TEST(SignalTable, sleep_ping_pong)
+{
+    const int nbRound = 2000;
+    Dao::SignalTable table(2);
+
+    std::thread pong([&table]() {
+        for (int round = 0; round < nbRound; ++round)
+        {
+            table.SignalReceiveSleep(0, 0);
+            table.SignalSend(1);
+        }
+    });
+    for (int round = 0; round < nbRound; ++round)
+    {
+        table.SignalSend(0);
+        table.SignalReceiveSleep(1, 0);
+    }
+    pong.join();
+    EXPECT_EQ(table.SignalsPending(0), 0u);
+    EXPECT_EQ(table.SignalsPending(1), 0u);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv); 
+    return RUN_ALL_TESTS();
+}
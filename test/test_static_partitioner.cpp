@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <daoStaticPartitioner.hpp>
+#include <daoLog.hpp>
+#include <stdexcept>
+#include <vector>
+
+static Dao::Log::Logger logger("Partitioner", Dao::Log::Logger::DESTINATION::SCREEN);
+
+/**
+ * @brief Ensure the chunks cover the range, in order, with aligned boundaries.
+ */
+TEST(StaticPartitioner, chunks)
+{
+    const size_t align = 16;
+    for (size_t n : {0, 1, 15, 16, 17, 1000, 1024})
+    {
+        for (size_t nbThread : {1, 3, 4, 7})
+        {
+            size_t next = 100;
+            for (size_t k = 0; k < nbThread; ++k)
+            {
+                size_t b, e;
+                Dao::StaticPartitioner::GetChunk(100, 100 + n, align, nbThread, k, b, e);
+                EXPECT_EQ(b, next);
+                EXPECT_LE(b, e);
+                EXPECT_TRUE(e == 100 + n || (e - 100) % align == 0);
+                next = e;
+            }
+            EXPECT_EQ(next, 100 + n);
+        }
+    }
+}
+
+/**
+ * @brief Ensure every index is run once per call, always by the same thread.
+ */
+TEST(StaticPartitioner, parallel_for)
+{
+    Dao::StaticPartitioner partitioner("part", logger, {-1, -1}, false);
+    std::vector<int> owner(1000, -1);
+    std::vector<int> hits(1000, 0);
+
+    ASSERT_EQ(partitioner.Size(), 3u);
+    for (int call = 0; call < 5; ++call)
+    {
+        int moved = 0;
+        partitioner.parallel_for(0, owner.size(), 16, [&](size_t b, size_t e, size_t k) {
+            for (size_t i = b; i < e; ++i)
+            {
+                hits[i]++;
+                if (owner[i] != -1 && owner[i] != (int)k)
+                    moved++;
+                owner[i] = (int)k;
+            }
+        });
+        EXPECT_EQ(moved, 0);
+    }
+    for (size_t i = 0; i < hits.size(); ++i)
+        ASSERT_EQ(hits[i], 5) << i;
+    EXPECT_EQ(owner.front(), 0);
+    EXPECT_EQ(owner.back(), 2);
+
+    EXPECT_EQ(partitioner.GetCallStats().count, 5u);
+    for (const Dao::StaticPartitioner::ThreadStats &stats : partitioner.GetStats())
+    {
+        EXPECT_EQ(stats.chunk.count, 5u);
+        EXPECT_LE(stats.chunk.minNs, stats.chunk.maxNs);
+    }
+    partitioner.ResetStats();
+    EXPECT_EQ(partitioner.GetCallStats().count, 0u);
+}
+
+/**
+ * @brief Ensure an exception thrown in a chunk is rethrown once every chunk is done.
+ */
+TEST(StaticPartitioner, exception)
+{
+    Dao::StaticPartitioner partitioner("part", logger, {-1}, false);
+    std::vector<int> hits(64, 0);
+
+    EXPECT_THROW(partitioner.parallel_for(0, hits.size(), 1, [&](size_t b, size_t e, size_t k) {
+        for (size_t i = b; i < e; ++i)
+            hits[i]++;
+        if (k == 1)
+            throw std::runtime_error("chunk failed");
+    }), std::runtime_error);
+    for (int hit : hits)
+        EXPECT_EQ(hit, 1);
+
+    // still usable
+    partitioner.parallel_for(0, hits.size(), 1, [&](size_t b, size_t e, size_t) {
+        for (size_t i = b; i < e; ++i)
+            hits[i]++;
+    });
+    for (int hit : hits)
+        EXPECT_EQ(hit, 2);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
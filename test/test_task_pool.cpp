@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <daoTaskPool.hpp>
+#include <daoLog.hpp>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static Dao::Log::Logger logger("TaskPool", Dao::Log::Logger::DESTINATION::SCREEN);
+
+/**
+ * @brief Ensure every index of the range is visited exactly once, whatever the grain.
+ */
+TEST(TaskPool, coverage)
+{
+    Dao::TaskPool pool("pool", logger, {-1, -1, -1}, false, 64);
+    std::vector<std::atomic<int>> hits(10007);
+
+    for (size_t grain : {1, 7, 100, 20000})
+    {
+        for (std::atomic<int> &hit : hits)
+            hit = 0;
+        pool.parallel_for(0, hits.size(), grain, [&hits](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i)
+                hits[i]++;
+        });
+        int wrong = 0;
+        for (std::atomic<int> &hit : hits)
+            wrong += hit.load() != 1;
+        EXPECT_EQ(wrong, 0) << "grain " << grain;
+    }
+    // empty range
+    pool.parallel_for(5, 5, 1, [](size_t, size_t) { FAIL(); });
+}
+
+/**
+ * @brief Ensure a parallel_for called from a task completes on the worker deques.
+ */
+TEST(TaskPool, nested)
+{
+    Dao::TaskPool pool("pool", logger, {-1, -1}, false, 64);
+    std::atomic<long> sum{0};
+
+    pool.parallel_for(0, 8, 1, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
+        {
+            pool.parallel_for(0, 100, 10, [&](size_t bb, size_t ee) {
+                sum += (long)(ee - bb);
+            });
+        }
+    });
+    EXPECT_EQ(sum.load(), 800);
+}
+
+/**
+ * @brief Ensure an exception thrown by a task is rethrown by parallel_for once the range is done.
+ */
+TEST(TaskPool, exception)
+{
+    Dao::TaskPool pool("pool", logger, {-1, -1}, false, 64);
+    std::atomic<size_t> done{0};
+
+    EXPECT_THROW(pool.parallel_for(0, 1000, 10, [&](size_t b, size_t e) {
+        done += e - b;
+        if (b <= 500 && 500 < e)
+            throw std::runtime_error("task failed");
+    }), std::runtime_error);
+    EXPECT_EQ(done.load(), 1000u);
+
+    // the pool is still usable
+    done = 0;
+    pool.parallel_for(0, 1000, 10, [&](size_t b, size_t e) { done += e - b; });
+    EXPECT_EQ(done.load(), 1000u);
+}
+
+/**
+ * @brief Ensure the utilisation counters follow the work done by the workers.
+ */
+TEST(TaskPool, stats)
+{
+    Dao::TaskPool pool("pool", logger, {-1, -1}, false, 64);
+    std::vector<Dao::TaskPool::WorkerStats> stats = pool.GetStats();
+
+    ASSERT_EQ(stats.size(), 2u);
+    for (const Dao::TaskPool::WorkerStats &s : stats)
+    {
+        EXPECT_EQ(s.core, -1);
+        EXPECT_GE(s.utilization, 0.0);
+        EXPECT_LE(s.utilization, 1.0);
+    }
+
+    uint64_t tasks = 0;
+    for (int round = 0; round < 20 && tasks == 0; ++round)
+    {
+        pool.parallel_for(0, 64, 1, [](size_t, size_t) {
+            volatile double x = 0;
+            for (int i = 0; i < 100000; ++i)
+                x = x + 1.0;
+        });
+        tasks = 0;
+        for (const Dao::TaskPool::WorkerStats &s : pool.GetStats())
+            tasks += s.tasks;
+    }
+    EXPECT_GT(tasks, 0u);
+
+    pool.ResetStats();
+    for (const Dao::TaskPool::WorkerStats &s : pool.GetStats())
+    {
+        EXPECT_EQ(s.tasks, 0u);
+        EXPECT_EQ(s.busyNs, 0u);
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}